@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+// A bump allocator for the nodes of the AST.
+// Nodes are placed one after another in large blocks, and are never freed on
+// their own. When the arena is destroyed, the destructors of the nodes are
+// called, and the blocks are freed together.
+class Arena
+{
+public:
+	Arena() = default;
+	~Arena();
+
+	Arena(Arena const&) = delete;
+	Arena& operator=(Arena const&) = delete;
+
+	template <typename T, typename... Args>
+	T* make(Args&&... args)
+	{
+		auto node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			destructors.push_back({ node, [](void* p) { static_cast<T*>(p)->~T(); } });
+
+		return node;
+	}
+
+	// moves the nodes of other into this arena, leaving other empty
+	// used to keep the nodes made on a thread after the thread ends
+	void take(Arena& other);
+
+private:
+	void* allocate(std::size_t size, std::size_t align);
+
+	struct Destructor
+	{
+		void* node;
+		void (*destroy)(void*);
+	};
+
+	std::vector<std::unique_ptr<std::byte[]>> blocks;
+	std::vector<Destructor> destructors;
+
+	// the free space at the end of the last block
+	std::byte* curr = nullptr;
+	std::size_t space = 0;
+};
+
+// the arena of the current thread, which holds the AST for the compilation
+Arena& ast_arena();
+
+template <typename T, typename... Args>
+T* make_node(Args&&... args)
+{
+	return ast_arena().make<T>(std::forward<Args>(args)...);
+}
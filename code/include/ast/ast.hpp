@@ -1,32 +1,49 @@
 #pragma once
 
 #include "parser_scope.hpp"
+#include "symbols.hpp"
 #include "expression.hpp"
+#include "ir.hpp"
 #include "bytecode.hpp"
 #include "value_type.hpp"
 #include "error.hpp"
 
-#include <memory>
 #include <vector>
 #include <string>
 
 namespace expr { class Expression; }
 
 class AST;
-using AST_Block = std::vector<std::shared_ptr<AST>>;
+using AST_Block = std::vector<AST*>;
+
+// optimizes each statement in the block, removing the statements that have
+// no effect and the statements that come after an unconditional return
+void optimize_block(AST_Block& block, ParserScope& scope);
+
+// returns the truth value of a condition if it is known at compile time
+std::optional<bool> constant_condition(expr::expr_p const& cond);
 
 
 class AST
 {
 public:
-	AST(Location const& loc);
+	AST(SourcePos loc);
 
-	// this function must be called before generate_codes()
+	// this function must be called before generate_ir()
 	virtual void check(ParserScope& scope) = 0;
-	virtual bytecodes_t generate_codes() const = 0;
+
+	// must be called after check() and before generate_ir()
+	// returns false if the statement has no effect and can be removed
+	virtual bool optimize(ParserScope& scope) = 0;
+
+	// appends the statement to the current block of the builder
+	virtual void generate_ir(ir::Builder& builder) const = 0;
+
+	// returns true if every path through the statement ends with a return
+	virtual bool always_returns() const;
 
 protected:
-	Location loc;
+	SourcePos loc;
 };
 
 
@@ -34,17 +51,18 @@ class VariableInit : public AST
 {
 public:
 	VariableInit(
-		Location const& _loc,
-		std::string const& _name,
+		SourcePos _loc,
+		symbol_t _name,
 		ValueType const& _type,
 		std::vector<std::optional<expr::expr_p>> const& _arr_sizes,
 		expr::expr_p const& expr);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
-	std::string name;
+	symbol_t name;
 	ValueType type;
 	std::vector<std::optional<expr::expr_p>> arr_sizes;
 	expr::expr_p expr;
@@ -58,19 +76,21 @@ class VariableAssign : public AST
 {
 public:
 	VariableAssign(
-		Location const& _loc,
-		std::string const& _var_name,
+		SourcePos _loc,
+		symbol_t _var_name,
 		std::string const& _assign_op,
 		expr::expr_p const& _expr);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
-	std::string var_name;
+	symbol_t var_name;
 	std::string assign_op;
 	expr::expr_p expr;
 
+	std::optional<ValueType> var_type;
 	std::optional<ValueType> assign_type;
 	std::optional<bytecode_t> id;
 };
@@ -80,17 +100,20 @@ class Conditional : public AST
 {
 public:
 	Conditional(
-		Location const& _loc,
+		SourcePos _loc,
 		std::vector<
-			std::pair<std::shared_ptr<expr::Expression>, AST_Block>
+			std::pair<expr::expr_p, AST_Block>
 		> const& _conditionals);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
+
+	bool always_returns() const override;
 
 private:
 	std::vector<
-		std::pair<std::shared_ptr<expr::Expression>, AST_Block>
+		std::pair<expr::expr_p, AST_Block>
 	> conditionals;
 };
 
@@ -99,12 +122,13 @@ class While : public AST
 {
 public:
 	While(
-		Location const& _loc,
+		SourcePos _loc,
 		expr::expr_p const& _cond,
 		AST_Block const& _block);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
 	expr::expr_p cond_expr;
@@ -118,17 +142,21 @@ public:
 	// params:
 	//   _block should already include VariableAssign statement
 	For(
-		Location const& _loc,
-		VariableInit const& _var_init,
+		SourcePos _loc,
+		VariableInit* _var_init,
 		expr::expr_p const& _cond_expr,
 		AST_Block const& _block);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
-	VariableInit var_init;
+	VariableInit* var_init;
 	While loop;
+
+	// set when the condition is always false, only the initialization is kept
+	bool is_loop_removed;
 };
 
 
@@ -136,25 +164,27 @@ class Function : public AST
 {
 public:
 	Function(
-		Location const& _loc,
-		std::string const& _name,
-		std::vector<std::string> const& _param_names,
+		SourcePos _loc,
+		symbol_t _name,
+		std::vector<symbol_t> const& _param_names,
 		std::vector<std::string> const& _param_types,
 		std::string const& _rtn_type,
 		AST_Block const& _block);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
-	std::string name;
-	std::vector<std::string> param_names;
+	symbol_t name;
+	std::vector<symbol_t> param_names;
 	std::vector<ValueType> param_types;
 	std::optional<ValueType> rtn_type;
 	AST_Block block;
 
 	bytecode_t id;
 	std::vector<bytecode_t> param_ids;
+	std::vector<bytecode_t> var_ids;
 };
 
 
@@ -162,11 +192,14 @@ class Return : public AST
 {
 public:
 	Return(
-		Location const& _loc,
+		SourcePos _loc,
 		expr::expr_p const& _expr);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
+
+	bool always_returns() const override;
 
 private:
 	expr::expr_p expr;
@@ -177,16 +210,17 @@ class ArrayMethod : public AST
 {
 public:
 	ArrayMethod(
-		Location const& _loc,
-		std::string const& _var_name,
+		SourcePos _loc,
+		symbol_t _var_name,
 		std::vector<expr::expr_p> const& _subscripts,
 		expr::expr_p const& _assign_expr);
 
 	void check(ParserScope& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
 
 private:
-	std::string var_name;
+	symbol_t var_name;
 	std::vector<expr::expr_p> subscripts;
 	expr::expr_p assign_expr;
 
@@ -200,25 +234,30 @@ class FunctionCall : public AST, public expr::Expression
 {
 public:
 	FunctionCall(
-		Location const& _loc,
-		std::string const& _name,
+		SourcePos _loc,
+		symbol_t _name,
 		std::vector<expr::expr_p> const& _arg_exprs);
 
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr);
-
 	void check(ParserScope& scope) override;
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
-	bytecodes_t generate_codes() const override;
+	bool optimize(ParserScope& scope) override;
+	expr::expr_p optimize(ParserScope const& scope) override;
+	void generate_ir(ir::Builder& builder) const override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 
-	int precedence() const;
+	bool has_side_effects() const override;
 
 private:
-	std::string name;
+	// returns std::nullopt for void functions
+	std::optional<ir::value_t> generate_call(ir::Builder& builder) const;
+
+private:
+	symbol_t name;
 	std::vector<expr::expr_p> arg_exprs;
 
 	std::optional<bytecode_t> id;
+	std::optional<ValueType> rtn_type;
+	bool is_pure;
 
 	bool is_expr;
 };
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "arena.hpp"
 #include "parser_scope.hpp"
+#include "symbols.hpp"
+#include "ir.hpp"
 #include "bytecode.hpp"
 #include "value_type.hpp"
 #include "error.hpp"
 
-#include <memory>
 #include <variant>
 #include <optional>
 #include <string>
@@ -14,7 +16,7 @@ namespace expr
 {
 
 class Expression;
-using expr_p = std::shared_ptr<Expression>;
+using expr_p = Expression*;
 
 
 enum class ExpressionType
@@ -33,33 +35,32 @@ class Expression
 public:
 	Expression(
 		ExpressionType _type,
-		Location const& _loc);
-
-	virtual void insert_node(
-		expr_p const& node,
-		expr_p* prev = nullptr) = 0;
+		SourcePos _loc);
 
 	virtual std::optional<ValueType> type_check(ParserScope const& scope) = 0;
-	virtual bytecodes_t generate_codes() const = 0;
 
-public:
-	virtual int precedence() const = 0;
+	// must be called after type_check() and before generate_value()
+	// returns the expression that should replace this one, which may be itself
+	virtual expr_p optimize(ParserScope const& scope) = 0;
+
+	// appends the instructions that evaluate the expression to the current block
+	// of the builder, and returns the value of the expression
+	virtual ir::value_t generate_value(ir::Builder& builder) const = 0;
+
+	// returns true if evaluating the expression does more than produce its value
+	virtual bool has_side_effects() const = 0;
 
 public:
 	bool is_operator() const;
 	bool is_value() const;
 
 public:
+	// true if the expression is in brackets
 	bool guard;
 	ExpressionType type;
 
 protected:
-	Location loc;
-
-	static int subscript_prec;
-	static int unary_op_prec;
-	static int bin_op_prec;
-	static int single_prec;
+	SourcePos loc;
 };
 
 
@@ -72,23 +73,20 @@ struct UnaryOp : public Expression
 {
 public:
 	UnaryOp(
-		Location const& _loc,
+		SourcePos _loc,
 		std::string const& _type,
 		expr::expr_p const& _expr = nullptr);
 
 	UnaryOp(
-		Location const& _loc,
+		SourcePos _loc,
 		UnaryOpType _type,
 		expr::expr_p const& _expr = nullptr);
 
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr) override;
-
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
-	bytecodes_t generate_codes() const;
+	expr::expr_p optimize(ParserScope const& scope) override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 
-	int precedence() const override;
+	bool has_side_effects() const override;
 
 private:
 	UnaryOpType type;
@@ -115,26 +113,33 @@ class BinaryOp : public Expression
 {
 public:
 	BinaryOp(
-		Location const& _loc,
+		SourcePos _loc,
 		std::string const& _type,
 		expr::expr_p const& _lhs = nullptr,
 		expr::expr_p const& _rhs = nullptr);
 
 	BinaryOp(
-		Location const& _loc,
+		SourcePos _loc,
 		BinaryOpType _type,
 		expr::expr_p const& _lhs = nullptr,
 		expr::expr_p const& _rhs = nullptr);
 
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr) override;
-
-	bytecodes_t generate_codes() const override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
+	expr::expr_p optimize(ParserScope const& scope) override;
+
+	bool has_side_effects() const override;
 
 public:
-	int precedence() const override;
+private:
+	// algebraic simplification of integer and float operations with one constant operand,
+	// such as removing identity operations and combining constant terms
+	expr::expr_p simplify();
+
+	// multiplication, division and modulo by a positive integer constant use
+	// shifts or multiplication instead
+	// returns std::nullopt if the operation is not one of these
+	std::optional<ir::value_t> generate_reduced_value(ir::Builder& builder) const;
 
 private:
 	BinaryOpType type;
@@ -149,17 +154,14 @@ class Array : public Expression
 {
 public:
 	Array(
-		Location const& _loc,
+		SourcePos _loc,
 		std::vector<expr_p> const& _arr);
 
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr) override;
-
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
-	bytecodes_t generate_codes() const override;
+	expr::expr_p optimize(ParserScope const& scope) override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 
-	int precedence() const override;
+	bool has_side_effects() const override;
 
 private:
 	std::vector<expr_p> arr;
@@ -170,22 +172,20 @@ class Variable : public Expression
 {
 public:
 	Variable(
-		Location const& _loc,
-		std::string const& _name);
-
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr) override;
+		SourcePos _loc,
+		symbol_t _name);
 
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
-	bytecodes_t generate_codes() const override;
+	expr::expr_p optimize(ParserScope const& scope) override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 
-	int precedence() const override;
+	bool has_side_effects() const override;
 
 private:
-	std::string name;
+	symbol_t name;
 
 	std::optional<bytecode_t> id;
+	std::optional<ValueType> var_type;
 };
 
 
@@ -194,26 +194,45 @@ private:
 class Value : public Expression
 {
 public:
+	// parses the literal as it appears in the source code
 	Value(
-		Location const& _loc,
+		SourcePos _loc,
 		ValueType::PrimType _type,
 		std::string const& _val);
 
-	void insert_node(
-		expr::expr_p const& node,
-		expr::expr_p* prev = nullptr) override;
+	// bool, char and int values
+	Value(
+		SourcePos _loc,
+		ValueType::PrimType _type,
+		int64_t _val);
+
+	Value(
+		SourcePos _loc,
+		float _val);
 
 	std::optional<ValueType> type_check(ParserScope const& scope) override;
-	bytecodes_t generate_codes() const override;
+	expr::expr_p optimize(ParserScope const& scope) override;
+	ir::value_t generate_value(ir::Builder& builder) const override;
 
-	int precedence() const override;
+	bool has_side_effects() const override;
 
 public:
+	ValueType::PrimType get_type() const;
+
+	// bool, char and int values are stored as int64_t, the same as the interpreter
+	int64_t as_int() const;
+	float as_float() const;
+	std::string const& as_str() const;
+
+	// returns a copy of this value converted to the type,
+	// following the same casts as the interpreter
+	Value* cast(ValueType::PrimType _type) const;
+
 	static bytecodes_t int_to_bytecodes(uint64_t uint64);
 
 private:
 	ValueType::PrimType type;
-	std::string val;
+	std::variant<int64_t, float, std::string> val;
 };
 
 }
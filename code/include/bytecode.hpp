@@ -27,7 +27,7 @@ enum struct BytecodeType : bytecode_t
 	FLOAT4,					//
 	FLOAT8,					//
 	STR,					// S_INT1 (length) (characters)
-	ARR,					// [elements] ARR (size)
+	ARR,					// [elements] ARR (size)			// the first element is pushed first
 
 	NEGATIVE_I, NEGATIVE_F,				// [val] NEGATIVE 
 	NOT_I, NOT_F,					//
@@ -38,6 +38,13 @@ enum struct BytecodeType : bytecode_t
 	DIV_I, DIV_F,
 	MOD_I,
 
+	// integer operations on a constant, which is an operand instead of being on the stack
+	SHIFT_LEFT_I,			// [val] SHIFT_LEFT_I (shift)
+	DIV_POW2_I,				// [val] DIV_POW2_I (shift)
+	MOD_POW2_I,				// [val] MOD_POW2_I (shift)
+	DIV_MAGIC_I,			// [val] DIV_MAGIC_I S_INT (magic) (shift)
+	MOD_MAGIC_I,			// [val] MOD_MAGIC_I S_INT (magic) (shift) S_INT (divisor)
+
 	LESSER_I, LESSER_F, LESSER_S,
 	GREATER_I, GREATER_F, GREATER_S,
 	LESSER_EQUALS_I, LESSER_EQUALS_F, LESSER_EQUALS_S,
@@ -47,22 +54,39 @@ enum struct BytecodeType : bytecode_t
 	AND,
 	OR,
 
-	SUBSCRIPT,
+	SUBSCRIPT,				// [index] [container] SUBSCRIPT
+	SUBSCRIPT_UNCHECKED,	// [index] [container] SUBSCRIPT_UNCHECKED	// the index is known to be in bounds
 	ALLOCATE,
 
 	I2F, F2I,
 
 	LOAD,					// LOAD  (var_id)
 	STORE,					// STORE (id)
-	SET_INDEX,				// indicies, id
+	STORE_KEEP,				// STORE_KEEP (id)					// stores without popping the value
+	SET_INDEX,				// [indices] [val] SET_INDEX (id) (count)	// the first index is pushed first
+	SET_INDEX_UNCHECKED,	// [indices] [val] SET_INDEX_UNCHECKED (id) (count)	// the indices are known to be in bounds
 	STORE_A,
 
 	JUMP_IF_FALSE,			// [cond] JUMP_IF_FALSE (offset)	// jumps to next in conditional chain
-	JUMP,					// JUMP (offset)					// jumps to end of conditional chain
-	NJUMP,
+	JUMP_IF_TRUE,			// [cond] JUMP_IF_TRUE (offset)
+	// the offsets are 4 bytes, from the end of the instruction, and the other
+	// operands are stored in as many bytes as shown, lowest byte first
+	JUMP,					// JUMP (offset)					// jumps forwards, such as to the end of a conditional chain
+	NJUMP,					// NJUMP (offset)					// jumps backwards, to the start of a loop
+	TABLE_SWITCH,			// [val] TABLE_SWITCH (low: 8) (count: 2) (default offset) (offset of each val from low: count)
+	LOOKUP_SWITCH,			// [val] LOOKUP_SWITCH (count: 2) (default offset) (key: 8, offset: count)	// the keys are in ascending order
+
+	// a whole loop over the elements of arrays, where the program works out the
+	// value of each element, see kernel.hpp
+	// the operand count includes the array or the sum
+	VECTOR_MAP,				// [start] [end] [array] [operands..] VECTOR_MAP (operand count) (program length) (program)	// the array with element i set to the program's value, for each i from start to before end
+	VECTOR_SUM,				// [start] [end] [sum] [operands..] VECTOR_SUM (operand count) (program length) (program)		// the sum plus the program's value, for each i from start to before end
+
+	COUNT,					// COUNT (counter: 4)				// adds one to a counter of the profile, with --profile-out
 
 	RETURN,					// [val] RETURN
-	CALL					// [parameters as expressions] FUNC_CALL
+	CALL,					// [parameters as expressions] FUNC_CALL
+	POP						// [val] POP						// discards the value
 };
 
 namespace night
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+#include <cstddef>
+#include <stdint.h>
+
+// Character classes of the lexer, the same as std::isspace, std::isalpha and
+// std::isdigit in the "C" locale, looked up in a table instead of going through
+// the locale.
+namespace char_class
+{
+
+constexpr uint8_t SPACE = 1 << 0;
+constexpr uint8_t ALPHA = 1 << 1;
+constexpr uint8_t DIGIT = 1 << 2;
+constexpr uint8_t UNDERSCORE = 1 << 3;
+
+constexpr auto table = [] {
+	std::array<uint8_t, 256> classes{};
+
+	for (unsigned char c : { ' ', '\t', '\n', '\v', '\f', '\r' })
+		classes[c] = SPACE;
+
+	for (int c = 'a'; c <= 'z'; ++c)
+		classes[c] = ALPHA;
+	for (int c = 'A'; c <= 'Z'; ++c)
+		classes[c] = ALPHA;
+	for (int c = '0'; c <= '9'; ++c)
+		classes[c] = DIGIT;
+
+	classes['_'] = UNDERSCORE;
+
+	return classes;
+}();
+
+constexpr bool is(char c, uint8_t classes) { return table[(unsigned char)c] & classes; }
+
+constexpr bool is_space(char c) { return is(c, SPACE); }
+constexpr bool is_alpha(char c) { return is(c, ALPHA); }
+constexpr bool is_digit(char c) { return is(c, DIGIT); }
+
+// letters, digits and underscores, which make up the rest of a variable or keyword
+constexpr bool is_word(char c) { return is(c, ALPHA | DIGIT | UNDERSCORE); }
+
+}
+
+// Scanning for the end of a run of characters, used by the lexer.
+// Each function starts at index pos of str, and returns the index of the first
+// character that ends the run, or the size of str if there is none.
+// With SSE2, 16 characters are checked at a time, and the rest one at a time.
+
+// skips spaces, tabs and the other std::isspace characters
+std::size_t skip_spaces(std::string_view str, std::size_t pos);
+
+// skips letters, digits and underscores
+std::size_t skip_word(std::string_view str, std::size_t pos);
+
+// skips digits
+std::size_t skip_digits(std::string_view str, std::size_t pos);
+
+// finds the closing quote of a string, or the first backslash before it
+std::size_t find_quote_or_escape(std::string_view str, std::size_t pos);
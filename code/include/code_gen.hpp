@@ -3,4 +3,10 @@
 #include "bytecode.hpp"
 #include "ast/ast.hpp"
 
-bytecodes_t code_gen(AST_Block const& block);
\ No newline at end of file
+// 2 also unrolls loops, set with the -O flag (default 1)
+extern int optimization_level;
+
+// pure recursive functions keep the results of their calls, set with the --memoize flag
+extern bool memoize_functions;
+
+bytecodes_t code_gen(AST_Block& block);
\ No newline at end of file
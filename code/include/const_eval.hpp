@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstddef>
+
+namespace ir
+{
+
+// steps the interpreter can take to evaluate every call of a module, as counted
+// by EvalLimit
+constexpr std::size_t eval_step_budget = 1 << 20;
+
+// calls can not be nested deeper than this while evaluating
+constexpr std::size_t eval_max_depth = 128;
+
+// Compile time evaluation.
+// Calls to pure user functions whose arguments are all constants are run by the
+// interpreter while compiling, and replaced by their results.
+//   calls that return arrays are not evaluated, since arrays have no constants
+//   a call is left as it is if it runs out of steps, or would stop the program
+//   with an error, which then happens when the program runs
+//   calls share one budget of steps, and a function that runs out of steps is
+//   not evaluated again, nor are calls with the same arguments as one that failed
+//   results of evaluated calls can be the arguments of other calls
+// every function of the module is lowered for the interpreter, from copies, so
+// this should run after the other passes
+// returns true if any call was replaced
+bool evaluate_constant_calls(Module& module);
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ir
+{
+
+// Common subexpression elimination.
+// An operation, or a call to a pure function, that computes the same value as
+// one before it in its block, or in a block that dominates it, uses that value
+// instead, and the instructions only it used are removed.
+//   values are the same by the range analysis, so the variables they load are
+//   not assigned to in between
+//   operations that only combine variables and constants are recomputed, since
+//   keeping their value costs as much as computing it again
+// returns true if any value was reused
+bool eliminate_common_subexpressions(Function& func);
+
+}
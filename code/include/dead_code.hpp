@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ir
+{
+
+// Dead function elimination.
+// Removes the functions that can not be reached through calls from the top
+// level code, so they are never lowered.
+// returns true if any function was removed
+bool remove_dead_functions(Module& module);
+
+// Dead variable elimination.
+// Removes the assignments to variables that are never read, along with the
+// values only they used.
+//   variables assigned through an index are kept, since the index can be out of
+//   bounds
+// returns true if any assignment was removed
+bool remove_dead_variables(Module& module);
+
+// Gives the variables that are still used the lowest ids, in the order they are
+// first used, so the variables created by lowering have more ids left.
+// sets ParserScope::next_var_id to the first id that is not used
+void renumber_variables(Module& module);
+
+}
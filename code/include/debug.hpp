@@ -40,4 +40,7 @@ void logn(T out) { std::cout << out << '\n'; }
 // prints out all the bytecodes
 void log_codes(bytecodes_t const& codes);
 
+// prints the hits, misses and results of each memoized function, shown with -d
+void log_memo_tables(std::ostream& out);
+
 }
\ No newline at end of file
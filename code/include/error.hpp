@@ -1,5 +1,7 @@
 #pragma once
 
+#include "source_table.hpp"
+
 #include <source_location>
 #include <stdexcept>
 #include <sstream>
@@ -11,17 +13,13 @@
 #define NIGHT_CREATE_FATAL(msg)				  night::error::get().create_fatal_error(msg, lexer.loc);
 #define NIGHT_CREATE_FATAL_LEXER(msg)		  night::error::get().create_fatal_error(msg, loc);
 
-struct Location
-{
-	std::string file;
-	int line, col;
-};
-
 namespace night {
 
 class error
 {
 public:
+	// each thread has its own errors, so files can be parsed on many threads
+	// the errors of a thread are only seen by other threads when thrown
 	static error& get();
 
 	std::string what() const;
@@ -37,6 +35,18 @@ public:
 		std::string const& msg, Location const& loc,
 		std::source_location const& s_loc = std::source_location::current()) noexcept;
 
+	// the same as above, for positions of the AST
+	void create_warning(std::string const& msg, SourcePos pos,
+		std::source_location const& s_loc = std::source_location::current()) noexcept;
+
+	void create_minor_error(std::string const& msg, SourcePos pos,
+		std::source_location const& s_loc = std::source_location::current()) noexcept;
+
+	[[nodiscard]]
+	error const& create_fatal_error(
+		std::string const& msg, SourcePos pos,
+		std::source_location const& s_loc = std::source_location::current()) noexcept;
+
 	bool has_minor_errors() const;
 
 public:
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "peephole.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+// functions with at most this many bytecodes are inlined,
+// set with the -i flag where 0 turns inlining off
+extern std::size_t inline_threshold;
+
+// thresholds of single functions, which are used instead of inline_threshold,
+// set from the profile read with --profile-in
+extern std::unordered_map<bytecode_t, std::size_t> inline_thresholds;
+
+// hot functions are inlined up to this many times the size of inline_threshold
+constexpr std::size_t hot_inline_factor = 4;
+
+// Replaces calls to small, non-recursive functions with the codes of the
+// functions, in the codes and in the codes of every function in
+// InterpreterScope::funcs.
+//   parameters are stored from the stack before the inlined codes, and
+//   RETURN becomes a jump to the end of them, leaving the value on the stack
+//   variable ids are unique across the whole program, so the inlined codes keep
+//   the ids of the function
+void inline_functions(bytecodes_t& codes);
+
+// returns the decoded codes of every function that can be inlined
+//   functions that assign to variables other than their own are not inlined,
+//   since a call only assigns to a copy of the caller's variables
+std::unordered_map<bytecode_t, std::vector<Instruction>> find_inline_funcs();
+
+// replaces each call to a function in inline_funcs with the function's codes
+// returns true if any call was replaced
+bool inline_calls(
+	std::vector<Instruction>& instrs,
+	std::unordered_map<bytecode_t, std::vector<Instruction>> const& inline_funcs);
@@ -10,9 +10,35 @@
 #include <optional>
 #include <bitset>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecodes_t const& codes);
 
+// Limits the interpreter when it runs code while compiling. Each backward jump,
+// each call to a user function, and each element of an allocated array takes a step.
+struct EvalLimit
+{
+	std::size_t steps;
+	std::size_t max_depth;
+	std::size_t depth;
+};
+
+// std::nullopt when running a program, which has no limit
+extern std::optional<EvalLimit> eval_limit;
+
+// counters of the COUNT bytecodes, by their index, set up when compiling with --profile-out
+extern std::vector<uint64_t> profile_counts;
+
+// thrown by the interpreter, when it has a limit, if it runs out of steps, if
+// calls are nested too deeply, or before an operation that would crash the
+// program, such as division by zero
+struct EvalAbort
+{
+	// true if the steps ran out, rather than the program stopping
+	bool out_of_steps = false;
+};
+
 // iterator
 //   start: int code type
 //   end:   last code of int
@@ -47,6 +73,33 @@ T get_int(bytecodes_t::const_iterator& it)
 	return num;
 }
 
+// reads an integer stored in exactly sizeof(T) bytes, lowest byte first,
+// like the operands of a TABLE_SWITCH
+// iterator
+//   start: code before the integer
+//   end:   last code of the integer
+template <typename T>
+T get_fixed_int(bytecodes_t::const_iterator& it)
+{
+	uint64_t num = 0;
+	for (std::size_t i = 0; i < sizeof(T); ++i)
+		num |= (uint64_t)*(++it) << (8 * i);
+
+	return (T)num;
+}
+
+
+// returns the high 64 bits of the 128 bit product
+int64_t mult_high(int64_t a, int64_t b);
+
+// returns the magic number and shift that div_magic() uses to divide by the
+// divisor with a multiplication instead of a division
+// divisor must be at least 2 and not a power of two
+std::pair<int64_t, int> division_magic(int64_t divisor);
+
+// divides val by the divisor that magic and shift were computed from,
+// the same as val / divisor
+int64_t div_magic(int64_t val, int64_t magic, int shift);
 
 // iterator
 //   start: bytecode type
@@ -64,6 +117,7 @@ void push_str(std::stack<intpr::Value>& s, bytecodes_t::const_iterator& it);
 //   end:   last code of strarring
 void push_arr(std::stack<intpr::Value>& s, bytecodes_t::const_iterator& it);
 
-void push_subscript(std::stack<intpr::Value>& s);
+// the index is only checked against the size of the container if is_checked is true
+void push_subscript(std::stack<intpr::Value>& s, bool is_checked);
 
 intpr::Value pop(std::stack<intpr::Value>& s);
\ No newline at end of file
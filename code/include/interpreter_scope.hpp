@@ -5,7 +5,10 @@
 #include <unordered_map>
 #include <vector>
 #include <variant>
+#include <optional>
 #include <string>
+#include <cstddef>
+#include <stdint.h>
 
 namespace intpr
 {
@@ -39,6 +42,48 @@ struct Value
 // <id, val>
 using var_container = std::unordered_map<bytecode_t, intpr::Value>;
 
+// Results of the calls to a pure function, by their arguments, which are all
+// bool, char, int or float.
+// An open addressing hash table with linear probing, that doubles in size when
+// it is half full, and stops adding results once it holds max_results of them.
+class MemoTable
+{
+public:
+	static constexpr std::size_t max_results = 1 << 20;
+
+	MemoTable(std::size_t _arity);
+
+	// returns nullptr if there is no result for the arguments
+	intpr::Value const* find(std::vector<intpr::Value> const& args);
+
+	// does nothing if the table is full
+	void insert(std::vector<intpr::Value> const& args, intpr::Value const& result);
+
+	std::size_t size() const;
+
+public:
+	// calls that found their result, and calls that did not
+	std::size_t hits, misses;
+
+private:
+	static int64_t key_of(intpr::Value const& arg);
+
+	// returns the slot with the arguments, or the empty slot they would go in
+	std::size_t find_slot(std::vector<intpr::Value> const& args) const;
+
+	void grow();
+
+private:
+	std::size_t arity;
+	std::size_t result_count;
+
+	// the arguments of each slot, as arity keys
+	std::vector<int64_t> keys;
+
+	// empty slots have no result
+	std::vector<std::optional<intpr::Value>> results;
+};
+
 struct InterpreterFunction;
 using func_container = std::unordered_map<bytecode_t, InterpreterFunction>;
 
@@ -46,6 +91,12 @@ struct InterpreterFunction
 {
 	std::vector<bytecode_t> param_ids;
 	bytecodes_t codes;
+
+	// ids of the parameters and of the variables declared in the function
+	std::vector<bytecode_t> var_ids;
+
+	// only for memoized functions, set with the --memoize flag
+	std::optional<MemoTable> memo = std::nullopt;
 };
 
 struct InterpreterScope
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "value_type.hpp"
+#include "error.hpp"
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <variant>
+#include <optional>
+#include <utility>
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+/* Typed SSA intermediate representation between the AST and the bytecodes.
+ *
+ * A function is a list of basic blocks, each ending in a terminator. Every value
+ * is defined by exactly one instruction, and Night variables are only read and
+ * written through LOAD and STORE instructions, so passes can reason about values
+ * without knowing about the stack or jump offsets. The bytecodes are lowered from it.
+ */
+namespace ir
+{
+
+// index into Function::value_types
+using value_t = std::size_t;
+
+// index into Function::blocks
+using block_t = std::size_t;
+
+// comments indicate how the instruction is dumped
+// [] indicate operands, which are values
+// () indicate the other members of the instruction
+enum class Op
+{
+	CONST,		// %v = type const (constant)
+	LOAD,		// %v = type load (id)
+	STORE,		// store (id) [value]
+	SET_INDEX,	// set_index (id) [indices..] [value]		// set_index_unchecked if the indices are in bounds
+	CALL,		// %v = type call (id) [args..]				// void functions have no result
+	PHI,		// %v = type phi [value from each block in blocks..]
+	BYTECODE	// %v = type (code) [operands..] (immediates)	// operands are pushed in order before the code
+};
+
+struct Instruction
+{
+	Op op;
+	std::optional<value_t> result = std::nullopt;
+	std::vector<value_t> operands = {};
+
+	// PHI, the block each operand comes from
+	std::vector<block_t> blocks = {};
+
+	// variable id of a LOAD, STORE or SET_INDEX, or function id of a CALL
+	bytecode_t id = 0;
+
+	// CALL, true if the function has no side effects and its return value
+	// only depends on its arguments
+	bool is_pure = false;
+
+	// SET_INDEX, true if every index is known to be in bounds, so none are checked
+	bool in_bounds = false;
+
+	// BYTECODE, and the codes that follow it, such as the shift of a SHIFT_LEFT_I
+	BytecodeType code = {};
+	bytecodes_t immediates = {};
+
+	// CONST, bool, char and int values are stored as int64_t, the same as the interpreter
+	std::variant<int64_t, float, std::string> constant = {};
+
+	// the statement the instruction was built for, which errors found when
+	// lowering are reported at, or 0 for instructions made by the passes
+	SourcePos loc = {};
+};
+
+enum class TerminatorType
+{
+	JUMP,		// jump true_block
+	BRANCH,		// branch [value] true_block false_block	// true_block is taken if the value is not zero
+	RETURN,		// return [value]							// the value is optional
+	SWITCH		// switch [value] (key: block..) false_block	// the block of the key equal to the value is taken, or false_block if there is none
+};
+
+struct Terminator
+{
+	TerminatorType type;
+	std::optional<value_t> value;
+	block_t true_block, false_block;
+
+	// SWITCH, the keys and their blocks, in ascending order of the keys
+	std::vector<std::pair<int64_t, block_t>> cases = {};
+};
+
+struct BasicBlock
+{
+	// phis are always at the start of the block
+	std::vector<Instruction> instrs;
+
+	// a block without a terminator returns without a value, like the end of a function
+	std::optional<Terminator> terminator;
+
+	// times the block ran in the profile read with --profile-in,
+	// copies of the block have the same count
+	std::optional<uint64_t> count;
+
+	// index of the counter of the block when compiling with --profile-out,
+	// which lowering adds one to with a COUNT at the start of the block
+	std::optional<uint32_t> counter;
+};
+
+struct Function
+{
+	std::string name;
+	SourcePos loc = {};
+
+	// the entry block is the first block
+	std::vector<BasicBlock> blocks = {};
+	std::vector<ValueType> value_types = {};
+
+	std::vector<bytecode_t> param_ids = {};
+	std::vector<ValueType> param_types = {};
+	std::optional<ValueType> rtn_type = std::nullopt;
+
+	// true if the function has no side effects and its return value only
+	// depends on its arguments, set by find_pure_functions()
+	bool is_pure = false;
+
+	// ids of the parameters and of the variables declared in the function,
+	// lowering adds the ids of the variables it creates
+	std::vector<bytecode_t> var_ids = {};
+};
+
+struct Module
+{
+	Function main{ "main" };
+	std::map<bytecode_t, Function> funcs;
+
+	// only used when dumping
+	std::unordered_map<bytecode_t, std::string> var_names;
+};
+
+
+// Appends instructions to the end of the current block of a function.
+// Instructions added after a terminator start a new block, which can never be reached.
+class Builder
+{
+public:
+	// the function's first block is created if it has none
+	Builder(Module& _module, Function& _func);
+
+	value_t constant(ValueType::PrimType type, int64_t val);
+	value_t constant(float val);
+	value_t constant(std::string const& val);
+
+	value_t load(bytecode_t var_id, ValueType const& type);
+	void store(bytecode_t var_id, value_t value);
+	void set_index(bytecode_t var_id, std::vector<value_t> const& indices, value_t value);
+
+	// returns std::nullopt for void functions
+	std::optional<value_t> call(bytecode_t func_id, std::vector<value_t> const& args, std::optional<ValueType> const& rtn_type, bool is_pure);
+
+	value_t op(BytecodeType code, std::vector<value_t> const& operands, ValueType const& type, bytecodes_t const& immediates = {});
+
+	// inserted after the other phis at the start of the current block
+	value_t phi(ValueType const& type, std::vector<std::pair<block_t, value_t>> const& incoming);
+
+	block_t create_block();
+	void set_block(block_t block);
+	block_t get_block() const;
+
+	void jump(block_t block);
+	void branch(value_t cond, block_t true_block, block_t false_block);
+	void ret(std::optional<value_t> const& value);
+
+	ValueType const& type_of(value_t value) const;
+
+public:
+	Module& module;
+	Function& func;
+
+	// position of the statement being built, given to each instruction
+	SourcePos loc;
+
+private:
+	value_t create_value(ValueType const& type);
+	Instruction& insert(Instruction const& instr);
+	void terminate(Terminator const& terminator);
+
+private:
+	block_t current;
+};
+
+
+struct Loop
+{
+	block_t header;
+
+	// blocks of the loop, including the header, in reverse postorder
+	std::vector<block_t> blocks = {};
+};
+
+
+// returns true if the instruction does more than produce its value
+bool has_side_effects(Instruction const& instr);
+
+// returns true if the instruction can stop the program with an error,
+// such as division by zero or an index out of range
+bool can_fail(Instruction const& instr);
+
+// blocks that can not be reached from the entry block are left out,
+// and the true block of a branch comes before its false block when it can
+std::vector<block_t> reverse_postorder(Function const& func);
+
+// the same as reverse_postorder(), but the block of a branch that ran more times
+// in the profile comes first, so it is the one that falls through
+std::vector<block_t> layout_order(Function const& func);
+
+std::vector<block_t> successors(BasicBlock const& block);
+
+// predecessors of each block, only counting blocks that can be reached
+std::vector<std::vector<block_t>> predecessors(Function const& func);
+
+// immediate dominator of each block, where the entry block is its own immediate
+// dominator, and blocks that can not be reached have none
+std::vector<std::optional<block_t>> dominators(Function const& func);
+
+// The dominator tree of a function, numbered by a walk of the tree, so whether a
+// block dominates another is found without going up the tree.
+struct DominatorTree
+{
+	explicit DominatorTree(Function const& func);
+
+	// returns true if every path from the entry block to block b goes through block a
+	bool dominates(block_t a, block_t b) const;
+
+	// the same as dominators()
+	std::vector<std::optional<block_t>> idoms;
+
+private:
+	// when the walk enters and leaves each block, where a block dominates the
+	// blocks entered after it and left before it
+	std::vector<std::size_t> entries, exits;
+};
+
+// natural loops of the function, where loops that share a header are merged,
+// inner loops come before the loops that contain them
+std::vector<Loop> find_loops(Function const& func);
+
+// calls change() with each loop, inner loops first, along with all of the loops,
+// and returns true if it changed any of them
+// the loops are only found again once each has been tried, and a loop containing
+// one that changed waits until then, as the blocks it was found with are out of date
+bool change_loops(Function& func, std::function<bool(Loop const&, std::vector<Loop> const&)> const& change);
+
+// returns the block that every path from outside the loop into its header goes
+// through, and that only jumps to the header, creating it if there is none
+// returns std::nullopt if the header has phis and a new block would be needed
+std::optional<block_t> get_preheader(Function& func, Loop const& loop);
+
+// returns true if a value defined in the block is used by an instruction or
+// terminator of another block
+bool is_used_outside(Function const& func, block_t block);
+
+// removes the instructions whose values are never used, and that have no side
+// effects and can not fail
+// returns true if any instruction was removed
+bool remove_unused_values(Function& func);
+
+// a SWITCH is lowered to a TABLE_SWITCH if its table would have fewer than
+// max_table_span entries, and at most table_density entries for each key,
+// otherwise it is lowered to a LOOKUP_SWITCH
+constexpr uint64_t max_table_span = 1 << 12;
+constexpr uint64_t table_density = 2;
+
+// Lowers the function to bytecodes.
+//   a value used once, by a later instruction in the same block, is left on the stack
+//   when the stack order allows it, other values are stored in new variables
+//   constants are pushed again at each use
+//   phis are stored in new variables at the end of each predecessor
+//   the blocks a SWITCH goes to can not have phis
+//   the blocks are placed in layout_order()
+// throws a fatal error if a jump offset does not fit, or there are no variable ids left
+bytecodes_t lower(Function& func);
+
+// prints out the module, in the format described by Op and TerminatorType
+void dump(Module const& module, std::ostream& out);
+void dump(Function const& func, Module const& module, std::ostream& out);
+
+// set with the -r flag
+extern bool print_ir;
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "interpreter_scope.hpp"
+#include "bytecode.hpp"
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+// Codes of the program of a VECTOR_MAP or VECTOR_SUM, which works out a value for
+// each index i of the loop the kernel replaces, on a stack of its own.
+// operands are the values pushed before the kernel, after the start and end
+// () indicate the next code of the program
+enum struct KernelCode : bytecode_t
+{
+	OPERAND_I, OPERAND_F,	// OPERAND (j)		// the int or float in operand j
+	ELEMENT_I, ELEMENT_F,	// ELEMENT (j)		// element i of the int or float array in operand j
+	INDEX,					// INDEX			// i
+
+	NEGATIVE_I, NEGATIVE_F,
+	ADD_I, ADD_F,
+	SUB_I, SUB_F,
+	MULT_I, MULT_F,
+	SHIFT_LEFT_I,			// SHIFT_LEFT_I (shift)
+
+	I2F, F2I
+};
+
+// Values are worked out for this many indices at a time. Each code of the program
+// is a single loop over all of them, on plain ints and floats instead of values,
+// which the compiler turns into SIMD instructions.
+constexpr std::size_t kernel_block_size = 256;
+
+// sets element i of operands[0], an array, to the program's value,
+// for each i from start to before end
+// throws std::out_of_range at the same index, and for the same array, as the loop
+// the kernel replaces, after setting the elements before it
+void vector_map(std::vector<intpr::Value>& operands, int64_t start, int64_t end, bytecodes_t const& program);
+
+// returns operands[0], an int or a float, plus the program's value,
+// for each i from start to before end
+// floats are added in order of i, the same as the loop the kernel replaces
+// throws std::out_of_range the same as vector_map()
+intpr::Value vector_sum(std::vector<intpr::Value> const& operands, int64_t start, int64_t end, bytecodes_t const& program);
+
+// returns true if the value of the program is a float
+bool is_float_kernel(bytecodes_t const& program);
@@ -2,21 +2,31 @@
 
 #include "token.hpp"
 #include "error.hpp"
+#include "source_table.hpp"
 
 #include <source_location>
-#include <fstream>
 #include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
 #include <optional>
 
-struct Location;
-
+// The whole file is read into a single buffer when the lexer is created, and
+// tokens are views into it, so they are valid for as long as the lexer is.
 class Lexer
 {
 public:
 	Lexer() = default;
 	Lexer(std::string const& _file_name);
+
+	// lexes the part of a file that starts at the beginning of first_line
+	// start is the position of the part in the source table
+	Lexer(std::string const& _file_name, std::string _source, int first_line, SourcePos start);
 	~Lexer() = default;
 
+	Lexer(Lexer const&) = delete;
+	Lexer& operator=(Lexer const&) = delete;
+
 public:
 	Token const& eat();
 	Token const& peek();
@@ -25,6 +35,9 @@ public:
 	Token const& expect(TokenType type, std::string const& err = "\n", std::source_location const& s_loc = std::source_location::current());
 	void curr_check(TokenType type, std::source_location const& s_loc = std::source_location::current());
 
+	// the position of loc in the source table
+	SourcePos pos() const;
+
 	// used for testing
 	void scan_code(std::string const& code);
 
@@ -39,13 +52,48 @@ private:
 	bool new_line();
 	Token eat_new_line();
 
+	// sets file_line to the line starting at next_line
+	void set_line();
+
 public:
 	Location loc;
 
 private:
-	std::fstream file;
-	std::string file_line;
+	std::string source;
+
+	// position of the start of source in the source table
+	uint32_t start = 0;
 
-	Token curr_tok;
+	// the current line of the source, without its newline
+	std::string_view file_line;
+	std::size_t line_start = 0;
+	std::size_t next_line = 0;
+
+	// strings and characters that are not the same as in the source, because
+	// of escape sequences or newlines, are kept here instead
+	// a deque never moves its elements, so tokens can view them
+	std::deque<std::string> literals;
+
+	Token curr_tok = {};
 	std::optional<Token> prev_tok;
-};
\ No newline at end of file
+};
+
+// returns the whole of a file
+// throws a fatal error if the file can not be opened
+std::string read_source(std::string const& file_name);
+
+// A part of a source file, starting at the beginning of a line.
+struct SourceChunk
+{
+	std::string_view source;
+	int line;
+};
+
+// Splits source into chunks of at least chunk_size characters, where possible.
+// Chunks only end after a top level statement, at the end of a line, so each
+// chunk can be lexed and parsed on its own.
+//   a top level statement ends with a semicolon or closing curly bracket that
+//   is not in brackets, strings, characters or comments, and is not followed
+//   by an elif or else
+// After an unmatched closing bracket, the rest of the source is a single chunk.
+std::vector<SourceChunk> split_source(std::string_view source, std::size_t chunk_size);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ir
+{
+
+// Loop invariant code motion.
+// Moves computations whose operands do not change in a loop to the loop's
+// preheader, so they run once instead of on every iteration.
+//   operations, and calls to pure functions, are invariant if their operands are
+//   defined outside of the loop or are invariant, and variables are invariant if
+//   they are not assigned to in the loop
+//   instructions that can fail are only moved if they are in the loop's header
+//   before any side effects, since the header runs at least once
+//   variable loads and constants are only moved along with a computation using them
+// returns true if any instruction was moved
+bool hoist_loop_invariants(Function& func);
+
+// moves the invariant computations of a single loop
+// returns true if any instruction was moved
+bool hoist_loop_invariants(Function& func, Loop const& loop);
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstddef>
+
+namespace ir
+{
+
+// headers with more instructions than this are not copied
+constexpr std::size_t inversion_threshold = 32;
+
+// Loop inversion.
+// A loop that tests its condition in its header, and jumps back to the header at
+// the end of each iteration, instead tests a copy of the condition at the end of
+// each iteration and branches back to the start of its body. The header is then
+// only a guard before the first iteration, and each iteration takes one branch
+// instead of a branch and a jump.
+//   the values of the header can only be used by the header
+//   checks removed from the header are kept in the copies, since their ranges
+//   were only known at the header
+// should run after the passes that find loops by their headers
+// returns true if any loop was inverted
+bool invert_loops(Function& func);
+
+// inverts a single loop
+// returns true if the loop was inverted
+bool invert_loop(Function& func, Loop const& loop);
+
+}
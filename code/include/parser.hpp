@@ -3,15 +3,17 @@
 #include "lexer.hpp"
 #include "bytecode.hpp"
 #include "parser_scope.hpp"
+#include "symbols.hpp"
 #include "interpreter.hpp"
 #include "ast/ast.hpp"
 #include "ast/expression.hpp"
 #include "value_type.hpp"
 
-#include <memory>
 #include <string>
 
 // The starting function of the Parsing stage.
+// Large files are split into chunks of top level statements with
+// split_source(), which are parsed on as many threads as there are cores.
 AST_Block parse_file(std::string const& main_file);
 
 // Parses a scope of statements.
@@ -31,14 +33,14 @@ AST_Block parse_stmts(
 // lexer
 //   start: first token of statement
 //   end:   first token of next statement
-std::shared_ptr<AST> parse_stmt(
+AST* parse_stmt(
 	Lexer& lexer);
 
 // three cases:
 //   variable init
 //   variable assign
 //   function call
-std::shared_ptr<AST> parse_var(Lexer& lexer);
+AST* parse_var(Lexer& lexer);
 
 // lexer:
 //   start: variable type
@@ -46,7 +48,7 @@ std::shared_ptr<AST> parse_var(Lexer& lexer);
 // examples:
 //   my_var int;
 //   my_var int = [expression];
-VariableInit parse_var_init(Lexer& lexer, std::string const& var_name);
+VariableInit* parse_var_init(Lexer& lexer, symbol_t var_name);
 
 // lexer:
 //   start: assignment operator
@@ -54,20 +56,20 @@ VariableInit parse_var_init(Lexer& lexer, std::string const& var_name);
 // examples:
 //   my_var = [expression];
 //   for (;; my_var += 1) {}
-VariableAssign parse_var_assign(Lexer& lexer, std::string const& var_name);
+VariableAssign* parse_var_assign(Lexer& lexer, symbol_t var_name);
 
-ArrayMethod parse_array_method(Lexer& lexer, std::string const& var_name);
+ArrayMethod* parse_array_method(Lexer& lexer, symbol_t var_name);
 
 // lexer
 //   start: open brakcet
 //   end: closing bracket
-expr::FunctionCall parse_func_call(Lexer& lexer, std::string const& func_name);
+expr::FunctionCall* parse_func_call(Lexer& lexer, symbol_t func_name);
 
-Conditional parse_if(Lexer& lexer);
-While parse_while(Lexer& lexer);
-For parse_for(Lexer& lexer);
-Function parse_func(Lexer& lexer);
-Return parse_return(Lexer& lexer);
+Conditional* parse_if(Lexer& lexer);
+While* parse_while(Lexer& lexer);
+For* parse_for(Lexer& lexer);
+Function* parse_func(Lexer& lexer);
+Return* parse_return(Lexer& lexer);
 
 // if expr is null, it is the callers responsibility to handle,
 // or set err_on_empty to true to display an error message in that event
@@ -75,4 +77,6 @@ Return parse_return(Lexer& lexer);
 //   start: first token of expression
 //   end: first token after expression
 // turns tokens into AST
+//   operators are parsed by their binding power, so each node is made once,
+//   with its operands already parsed
 expr::expr_p parse_expr(Lexer& lexer, bool err_on_empty);
\ No newline at end of file
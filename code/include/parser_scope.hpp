@@ -3,18 +3,37 @@
 #include "bytecode.hpp"
 #include "value_type.hpp"
 #include "error.hpp"
+#include "symbols.hpp"
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <optional>
 #include <string>
+#include <cstddef>
+
+namespace expr { class Value; }
 
 struct ParserVariable;
 struct ParserFunction;
 
-using scope_var_container  = std::unordered_map<std::string, ParserVariable>;
-using scope_func_container = std::unordered_multimap<std::string, ParserFunction>;
+// overloads are found by hashing the types of the arguments of a call, so
+// resolving a call does not compare it against each overload in turn
+struct SignatureHash
+{
+	std::size_t operator()(std::vector<ValueType> const& param_types) const;
+};
+
+struct SignatureEqual
+{
+	bool operator()(std::vector<ValueType> const& param_types1, std::vector<ValueType> const& param_types2) const;
+};
+
+using scope_var_container      = std::unordered_map<symbol_t, ParserVariable>;
+// <parameter types, function>
+using scope_overload_container = std::unordered_map<std::vector<ValueType>, ParserFunction, SignatureHash, SignatureEqual>;
+using scope_func_container     = std::unordered_map<symbol_t, scope_overload_container>;
 
 struct ParserVariable
 {
@@ -27,44 +46,87 @@ struct ParserFunction
 	// used when generating bytecode for function call
 	bytecode_t id;
 
-	std::vector<std::string> param_names;
-	std::vector<ValueType> param_types;
+	std::vector<symbol_t> param_names;
 	std::optional<ValueType> rtn_type;
+
+	// true if the function has no side effects, and its return value only
+	// depends on its arguments
+	bool is_pure;
 };
 
+// Scopes form a chain from the innermost scope out to the global scope.
+// Each scope only holds what is created in it, so entering a scope does not
+// copy the variables of the scopes around it, and lookups walk up the chain.
 struct ParserScope
 {
+	// the global scope
 	ParserScope();
-	ParserScope(ParserScope const& upper_scope);
-	ParserScope(ParserScope const& upper_scope, std::optional<ValueType> const& _rtn_type);
+	// a scope inside upper_scope, with the same return type
+	explicit ParserScope(ParserScope const* upper_scope);
+	// a function body inside upper_scope
+	ParserScope(ParserScope const* upper_scope, std::optional<ValueType> const& _rtn_type);
+
+	// inner scopes point to this scope, so it can not be copied
+	ParserScope(ParserScope const&) = delete;
+	ParserScope& operator=(ParserScope const&) = delete;
 
 	// returns id for new variable if successful
 	// returns nullopt if unsuccessful - redefinition or variable scope limit
 	std::optional<bytecode_t> create_variable(
-		std::string const& name,
+		symbol_t name,
 		ValueType const& type,
-		Location const& loc
+		SourcePos loc
 	);
 
-	// returns func it if successful
-	// throws const char* if unsuccessful
-
-	static scope_func_container::iterator create_function(
-		std::string const& name,
-		std::vector<std::string> const& param_names,
+	// returns the function if successful
+	// throws const char* if unsuccessful - an overload with the same parameter
+	// types is already defined
+	static ParserFunction const& create_function(
+		symbol_t name,
+		std::vector<symbol_t> const& param_names,
 		std::vector<ValueType> const& param_types,
 		std::optional<ValueType> const& rtn_type
 	);
 
-	void check_return_type(std::optional<ValueType> const& _rtn_type, Location const& loc) const;
+	// returns the overload whose parameter types are the argument types
+	// returns nullptr if there is none
+	static ParserFunction const* find_function(symbol_t name, std::vector<ValueType> const& arg_types);
+
+	// returns nullptr if the variable is not defined in this scope or any
+	// scope around it
+	ParserVariable const* find_variable(symbol_t name) const;
+
+	// returns nullptr if the variable does not have a constant value
+	expr::Value* find_constant(bytecode_t id) const;
+
+	// the variable is initialized with a constant and never reassigned
+	// used for constant propagation in the rest of this scope
+	void set_constant(bytecode_t id, expr::Value* value);
+
+	void check_return_type(std::optional<ValueType> const& _rtn_type, SourcePos loc) const;
 
 	std::optional<ValueType> const& get_curr_rtn_type() const;
 	void set_curr_rtn_type(std::optional<ValueType> const& _curr_rtn_type);
 
 	static scope_func_container funcs;
 
-	scope_var_container vars;
+	// variable ids are unique across the whole program,
+	// this is the id given to the next variable created
+	static bytecode_t next_var_id;
+
+	// ids of variables that are assigned to after their initialization,
+	// filled in during type checking
+	static std::unordered_set<bytecode_t> reassigned_vars;
 
 private:
+	// nullptr for the global scope
+	ParserScope const* upper;
+
+	scope_var_container vars;
+
+	// <id, value>
+	// filled in during optimization
+	std::unordered_map<bytecode_t, expr::Value*> constant_vars;
+
 	std::optional<ValueType> rtn_type;
 };
\ No newline at end of file
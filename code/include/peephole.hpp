@@ -0,0 +1,84 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <vector>
+#include <optional>
+#include <functional>
+#include <stdint.h>
+
+// A decoded bytecode, so rules can match whole instructions instead of bytes.
+struct Instruction
+{
+	BytecodeType type;
+
+	// every integer constant is decoded as S_INT8 with its value in val,
+	// and is encoded in its smallest form again
+	int64_t val;
+
+	// operands that are copied as they are, such as the id of a LOAD,
+	// or the length and characters of a STR
+	bytecodes_t operands;
+
+	// index of the instruction a JUMP, JUMP_IF_FALSE or JUMP_IF_TRUE goes to,
+	// where a jump to the end of the codes has the index one past the last instruction
+	//   NJUMP is decoded as JUMP, and the direction is worked out when encoding
+	//   the offset pushed before a conditional jump is part of the jump
+	std::size_t target;
+
+	// index of the instruction each case of a TABLE_SWITCH or LOOKUP_SWITCH goes
+	// to, and target is where the values without a case go
+	//   the cases of a TABLE_SWITCH are the values from val, one after another
+	//   the cases of a LOOKUP_SWITCH are the keys, in ascending order
+	std::vector<std::size_t> targets = {};
+	std::vector<int64_t> keys = {};
+};
+
+struct PeepholeRule
+{
+	// types of the consecutive instructions the rule matches
+	std::vector<BytecodeType> pattern;
+
+	// returns the instructions that replace the matched instructions,
+	// or std::nullopt if the rule does not apply to them
+	std::function<std::optional<std::vector<Instruction>>(std::vector<Instruction> const&)> rewrite;
+};
+
+// Rewrites short sequences of bytecodes into cheaper ones until no more
+// rewrites apply, keeping jump offsets correct. If the codes can not be
+// decoded, or an offset no longer fits in its bytecode, they are left unchanged.
+void peephole(bytecodes_t& codes);
+
+// returns std::nullopt if a jump does not land at the start of an instruction
+std::optional<std::vector<Instruction>> decode_instructions(bytecodes_t const& codes);
+
+// returns std::nullopt if a jump or a switch has an offset that does not fit in
+// 4 bytes, or a switch has too many cases
+std::optional<bytecodes_t> encode_instructions(std::vector<Instruction> const& instrs);
+
+// replaces windows of instructions matched by a rule in the rule table,
+// the instructions of a window, other than the first, can not be jumped to
+// returns true if any instruction was replaced
+bool apply_rules(std::vector<Instruction>& instrs);
+
+// jumps and switch cases that land on a JUMP go straight to its target instead
+// returns true if any jump was changed
+bool thread_jumps(std::vector<Instruction>& instrs);
+
+// removes jumps to the next instruction, and instructions after a JUMP,
+// RETURN or switch that are not jumped to
+// returns true if any instruction was removed
+bool remove_dead_codes(std::vector<Instruction>& instrs);
+
+// removes the marked instructions, and jumps to a removed instruction go to
+// the next instruction that is kept
+void remove_instructions(std::vector<Instruction>& instrs, std::vector<bool> const& removed);
+
+bool is_jump(BytecodeType type);
+
+// TABLE_SWITCH and LOOKUP_SWITCH
+bool is_switch(BytecodeType type);
+
+// calls fn with the index of each instruction that the jump or switch can go to,
+// which fn can change
+void for_each_target(Instruction& instr, std::function<void(std::size_t&)> const& fn);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <optional>
+#include <string>
+#include <stdint.h>
+
+namespace ir
+{
+
+// blocks that ran at least this many times in the profile are hot
+constexpr uint64_t hot_count = 1000;
+
+// set with the --profile-out and --profile-in flags
+extern std::optional<std::string> profile_out_file;
+extern std::optional<std::string> profile_in_file;
+
+// Profile-guided optimization.
+// A program compiled with --profile-out counts how many times each of its blocks
+// runs, and writes the counts to a file when it ends. A program compiled with
+// --profile-in reads them back into the blocks, where they decide which side of
+// each branch falls through, which loops are unrolled, and which functions are
+// inlined.
+//   the counts give the direction of each branch, the number of calls to each
+//   function and at each call site, and the trip count of each loop
+//   blocks are known by their function and their index when the IR is generated,
+//   so a profile only fits the source it was written from
+
+// gives each block of the module a counter in profile_counts
+// should run right after the IR is generated
+void instrument(Module& module);
+
+// writes the counters given by instrument() to the file, one line for each block
+// throws a fatal error if the file can not be written
+void write_profile(std::string const& file);
+
+// sets the count of each block of the module from the file, where blocks of a
+// function in the file that have no line of their own never ran
+// should run right after the IR is generated
+// throws a fatal error if the file can not be read, or was not written by write_profile()
+void read_profile(Module& module, std::string const& file);
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ir
+{
+
+// Interprocedural purity analysis.
+// A function is pure if it only uses its parameters and its own variables, and
+// only calls pure functions. print and input are the only builtins that are not
+// pure. Functions that call each other, or themselves, are pure unless one of
+// them does something else that is not pure.
+// Marks every pure function, and every call to one, as pure, so the passes that
+// move and reuse pure calls can see them.
+// returns true if any call was marked
+bool find_pure_functions(Module& module);
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <vector>
+#include <bitset>
+#include <optional>
+#include <limits>
+#include <stdint.h>
+
+namespace ir
+{
+
+// every integer from lo to hi, where the limits of int64_t mean there is no bound
+struct Range
+{
+	int64_t lo, hi;
+
+	bool operator==(Range const&) const = default;
+
+	static constexpr int64_t min = std::numeric_limits<int64_t>::min();
+	static constexpr int64_t max = std::numeric_limits<int64_t>::max();
+};
+
+// an instruction, as its block and its index in the block
+struct Position
+{
+	block_t block;
+	std::size_t index;
+};
+
+// Integer range analysis of the values of a function.
+//   the range of a variable covers every value stored to it in the function,
+//   and is only used where the variable is always assigned to before
+//   ranges are narrowed in the blocks that can only be reached through one side
+//   of a branch, by the values the branch compares, such as i < len(s) or i < 10
+//   lengths of strings and arrays are known from allocations and constants
+// the function can not be changed while the analysis is used
+class RangeAnalysis
+{
+public:
+	RangeAnalysis(Function const& func);
+
+	// range of the value wherever it is used
+	Range range_of(value_t value) const;
+
+	// range of the value in the block
+	Range range_at(value_t value, block_t block) const;
+
+	// minimum length of each dimension of a string or array, starting from the
+	// outermost, only as many dimensions as are known
+	std::vector<int64_t> lengths_of(value_t container) const;
+	std::vector<int64_t> lengths_of(bytecode_t var_id, Position const& pos) const;
+
+	// returns true if a branch leading to the block compared the index against
+	// the length of the string
+	bool is_below_length(value_t index, value_t str, block_t block) const;
+
+	// returns true if the values are always equal where both are defined, since
+	// they are computed the same way, from variables that are not assigned in between
+	bool is_same_value(value_t a, value_t b) const;
+
+private:
+	// lhs < rhs, or lhs <= rhs
+	struct Fact
+	{
+		value_t lhs, rhs;
+		bool or_equal;
+	};
+
+	using VarSet = std::bitset<bytecode_t_lim + 1>;
+
+	// conditions that are known to hold in the block
+	std::vector<Fact> facts_at(block_t block) const;
+	void add_facts(value_t cond, bool is_true, std::vector<Fact>& facts) const;
+
+	// elements is true if assigning to an element of a variable changes the value
+	bool is_same_value(value_t a, value_t b, bool elements) const;
+
+	bool is_assigned(bytecode_t var_id, Position const& pos) const;
+
+	// returns true if the variable is not assigned to on any path from one
+	// instruction to the other, where the first dominates the second
+	bool is_unchanged(bytecode_t var_id, Position const& from, Position const& to, bool elements) const;
+
+	bool dominates(Position const& a, Position const& b) const;
+
+	void find_assigned_vars();
+	void find_ranges();
+	void find_lengths();
+
+private:
+	Function const& func;
+
+	std::vector<block_t> order;
+	std::vector<std::vector<block_t>> preds;
+	DominatorTree doms;
+
+	std::vector<Instruction const*> defs;
+	std::vector<Position> positions;
+
+	// variables that are assigned to on every path to the start of each block
+	std::vector<VarSet> assigned_vars;
+
+	std::vector<Range> ranges;
+	std::vector<std::vector<int64_t>> lengths;
+	std::vector<std::optional<std::vector<int64_t>>> var_lengths;
+};
+
+// Bounds check elimination.
+// Changes subscripts and array assignments whose indices are always in bounds,
+// by the range analysis, to their unchecked forms.
+// should run after the passes that move instructions between blocks
+// returns true if any check was removed
+bool remove_bounds_checks(Function& func);
+
+}
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "parser_scope.hpp"
+#include "symbols.hpp"
 
-#include <string>
-
-bool check_variable_defined(ParserScope const& scope, std::string const& name, Location const& loc);
-bool check_function_defined(ParserScope const& scope, std::string const& name, Location const& loc);
\ No newline at end of file
+bool check_variable_defined(ParserScope const& scope, symbol_t name, SourcePos loc);
+bool check_function_defined(ParserScope const& scope, symbol_t name, SourcePos loc);
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <stdint.h>
+
+struct Location
+{
+	std::string file;
+	int line;
+	std::size_t col;
+};
+
+// A position in one of the source files, as an offset into all of them laid
+// end to end, so nodes of the AST do not each keep a copy of their file name.
+// The file, line and column are found from the source table when needed, which
+// is only when there is an error.
+struct SourcePos
+{
+	// 0 is not in any file, and is used by nodes that are not in the source
+	uint32_t offset = 0;
+};
+
+namespace source_table
+{
+
+// adds a file to the table, and returns the position of its first character
+// must not be called while other threads are using the table
+// throws a fatal error if the files are too large for a SourcePos
+SourcePos add_file(std::string const& file_name, std::string_view source);
+
+// returns the file, line and column of a position
+// the line and column are the same as Lexer::loc when it was at the position
+Location location(SourcePos pos);
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstddef>
+
+namespace ir
+{
+
+// chains with fewer cases than this are left as branches
+constexpr std::size_t min_switch_cases = 3;
+
+// Switch formation.
+// A chain of branches that each compare the same int or char to a different
+// constant, like the conditions of an if and its elifs, becomes a single SWITCH,
+// which is lowered to a jump table or a binary search instead of a comparison
+// for each case.
+//   each block after the first in the chain can only load the variable, or
+//   reuse the value, and compare it, and is only reached from the block before it
+//   when two cases have the same key, the first one is taken
+//   the blocks the chain goes to can not have phis
+// should run after the passes that only know about branches
+// returns true if any switch was formed
+bool form_switches(Function& func);
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <stdint.h>
+
+// An identifier, interned so the type checker compares and hashes integers
+// instead of strings. Equal names are always given the same symbol.
+using symbol_t = uint32_t;
+
+namespace symbols
+{
+
+// returns the symbol of a name, adding it to the table if it is new
+// safe to call from the threads that parse chunks of a file
+symbol_t intern(std::string_view name);
+
+// returns the name of a symbol, which stays valid for the whole compilation
+std::string const& name(symbol_t symbol);
+
+}
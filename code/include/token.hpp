@@ -1,6 +1,9 @@
 #pragma once
 
+#include "symbols.hpp"
+
 #include <string>
+#include <string_view>
 
 enum class TokenType
 {
@@ -46,7 +49,11 @@ enum class TokenType
 struct Token
 {
 	TokenType type;
-	std::string str;
+	// a view into the source held by the lexer
+	std::string_view str;
+
+	// the interned name of a VARIABLE or TYPE token
+	symbol_t symbol = 0;
 };
 
 namespace night
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <optional>
+#include <cstddef>
+#include <stdint.h>
+
+namespace ir
+{
+
+// loops that run at most this many times, by a count known when compiling,
+// are fully unrolled
+constexpr std::size_t full_unroll_count = 16;
+
+// a loop is not unrolled if the copies of its body would have more
+// instructions than this
+constexpr std::size_t unroll_budget = 256;
+
+// number of copies of the body of a loop whose count is only known when it runs,
+// set with the -u flag where 1 turns partial unrolling off
+extern std::size_t unroll_factor;
+
+// a loop that compares a counter against a bound in its header, and adds step
+// to the counter at the end of each iteration
+struct CountedLoop
+{
+	bytecode_t var_id;
+
+	// the comparison, as if the counter is its left operand
+	BytecodeType cmp;
+	value_t counter, bound;
+	int64_t step;
+
+	// known if the block entering the loop stores a constant to the counter,
+	// and if the bound is a constant
+	std::optional<int64_t> start, end;
+};
+
+// returns std::nullopt if the loop is not a counted loop, where the header's
+// branch is the only way out of it and its values are not used outside of it
+std::optional<CountedLoop> find_counted_loop(Function const& func, Loop const& loop);
+
+// Loop unrolling, only for counted loops, such as
+//   for (i int = 0; i < n; i += 1)
+// where the header only compares a counter against a value that does not change
+// in the loop, and the counter is only assigned to by adding a constant at the
+// end of each iteration.
+//   loops with a start and end known when compiling are replaced by a copy of
+//   their body for each iteration, where the counter is a constant
+//   other loops run unroll_factor copies of their body for each test of a new
+//   header, and the original loop runs the iterations that are left over
+// only innermost loops are unrolled, and each loop at most once
+// with a profile, only loops whose header ran at least hot_count times are unrolled,
+// and only partly if they ran at least unroll_factor iterations each time
+// should run before loop inversion, which changes the shape of counted loops
+// returns true if any loop was unrolled
+bool unroll_loops(Function& func);
+
+// unrolls a single loop
+// returns true if the loop was unrolled
+bool unroll_loop(Function& func, Loop const& loop);
+
+}
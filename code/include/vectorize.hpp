@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ir
+{
+
+// Loop vectorization.
+// A counted loop over the elements of arrays, whose body is a single block, such as
+//   for (i int = 0; i < n; i += 1) { a[i] = b[i] * k + c[i]; }
+//   for (i int = 0; i < n; i += 1) { sum += b[i]; }
+// becomes a single VECTOR_MAP or VECTOR_SUM, which runs every iteration of the loop
+// in the interpreter, instead of copying each array out of its variable for
+// every element that is read.
+//   the counter starts anywhere, goes up by one, and is compared with < or <=
+//   the body can only read the counter, elements of int and float arrays at the
+//   counter, and values that do not change in the loop, and combine them with
+//   +, -, *, negation and conversions
+//   the body either sets element i of a single array, or adds to a single
+//   variable, and does nothing else but add one to the counter
+// the body's block only runs the kernel and sets the counter to its last value,
+// and then leaves the loop, so an out of bounds element stops the program at the
+// same index as the loop
+// should run before loop unrolling, which copies the body
+// returns true if any loop was vectorized
+bool vectorize_loops(Function& func);
+
+}
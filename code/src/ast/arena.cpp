@@ -0,0 +1,60 @@
+#include "ast/arena.hpp"
+
+#include <memory>
+#include <iterator>
+#include <cstddef>
+
+constexpr std::size_t block_size = 64 * 1024;
+
+Arena::~Arena()
+{
+	// nodes are destroyed in the reverse order they were made in
+	for (auto it = std::rbegin(destructors); it != std::rend(destructors); ++it)
+		it->destroy(it->node);
+}
+
+void Arena::take(Arena& other)
+{
+	blocks.insert(std::end(blocks),
+		std::make_move_iterator(std::begin(other.blocks)), std::make_move_iterator(std::end(other.blocks)));
+	destructors.insert(std::end(destructors), std::begin(other.destructors), std::end(other.destructors));
+
+	other.blocks.clear();
+	other.destructors.clear();
+	other.curr = nullptr;
+	other.space = 0;
+}
+
+void* Arena::allocate(std::size_t size, std::size_t align)
+{
+	void* p = curr;
+	if (std::align(align, size, p, space))
+	{
+		curr = (std::byte*)p + size;
+		space -= size;
+		return p;
+	}
+
+	// nodes larger than a block are given a block of their own, so the rest of
+	// the current block can still be used
+	if (size + align > block_size)
+	{
+		blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(size + align));
+
+		p = blocks.back().get();
+		std::size_t big_space = size + align;
+		return std::align(align, size, p, big_space);
+	}
+
+	blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(block_size));
+	curr = blocks.back().get();
+	space = block_size;
+
+	return allocate(size, align);
+}
+
+Arena& ast_arena()
+{
+	thread_local Arena arena;
+	return arena;
+}
@@ -1,24 +1,64 @@
 #include "ast/ast.hpp"
+#include "ast/arena.hpp"
 #include "bytecode.hpp"
 #include "interpreter_scope.hpp"
 #include "parser_scope.hpp"
 #include "scope_check.hpp"
+#include "symbols.hpp"
 #include "utils.hpp"
 #include "error.hpp"
 #include "debug.hpp"
 
+#include <algorithm>
 #include <limits>
 #include <vector>
-#include <memory>
 #include <assert.h>
 #include <ranges>
 
-AST::AST(Location const& _loc)
+void optimize_block(AST_Block& block, ParserScope& scope)
+{
+	for (auto it = std::begin(block); it != std::end(block);)
+	{
+		if (!(*it)->optimize(scope))
+		{
+			it = block.erase(it);
+			continue;
+		}
+
+		// statements after a return can never be reached
+		if ((*it)->always_returns())
+		{
+			block.erase(it + 1, std::end(block));
+			break;
+		}
+
+		++it;
+	}
+}
+
+std::optional<bool> constant_condition(expr::expr_p const& cond)
+{
+	auto cond_value = dynamic_cast<expr::Value*>(cond);
+
+	// the interpreter reads conditions as integers, so float conditions are left alone
+	if (!cond_value || cond_value->get_type() == ValueType::FLOAT)
+		return std::nullopt;
+
+	return cond_value->as_int() != 0;
+}
+
+
+AST::AST(SourcePos _loc)
 	: loc(_loc) {}
 
+bool AST::always_returns() const
+{
+	return false;
+}
+
 VariableInit::VariableInit(
-	Location const& _loc,
-	std::string const& _name,
+	SourcePos _loc,
+	symbol_t _name,
 	ValueType const& _type,
 	std::vector<std::optional<expr::expr_p>> const& _arr_sizes,
 	expr::expr_p const& _expr)
@@ -31,6 +71,16 @@ void VariableInit::check(ParserScope& scope)
 {
 	assert(expr);
 
+	for (auto const& arr_size : arr_sizes)
+	{
+		if (!arr_size.has_value() || !*arr_size)
+			continue;
+
+		auto size_type = (*arr_size)->type_check(scope);
+		if (size_type.has_value() && !size_type->is_prim())
+			night::error::get().create_minor_error("array size is type '" + night::to_str(*size_type) + "', expected type bool, char, or int'", loc);
+	}
+
 	auto _id = scope.create_variable(name, type, loc);
 	if (_id.has_value())
 		id = _id;
@@ -41,65 +91,89 @@ void VariableInit::check(ParserScope& scope)
 
 	if (expr_type.has_value() && !compare_relative_vt(type, *expr_type))
 		night::error::get().create_minor_error(
-			"variable '" + name + "' of type '" + night::to_str(type) +
+			"variable '" + symbols::name(name) + "' of type '" + night::to_str(type) +
 			"' can not be initialized with expression of type '" + night::to_str(*expr_type) + "'", loc);
 }
 
-bytecodes_t VariableInit::generate_codes() const
+bool VariableInit::optimize(ParserScope& scope)
+{
+	assert(expr);
+
+	for (auto& arr_size : arr_sizes)
+	{
+		if (arr_size.has_value() && *arr_size)
+			*arr_size = (*arr_size)->optimize(scope);
+	}
+
+	expr = expr->optimize(scope);
+
+	// constant propagation
+	// a variable that is never reassigned keeps its initial value, so its uses
+	// can be replaced with that value
+	if (!id.has_value() || !arr_sizes.empty() || ParserScope::reassigned_vars.contains(*id))
+		return true;
+
+	if (auto value = dynamic_cast<expr::Value*>(expr))
+		scope.set_constant(*id, value->cast(type.type));
+
+	return true;
+}
+
+void VariableInit::generate_ir(ir::Builder& builder) const
 {
+	builder.loc = loc;
+
 	assert(expr);
 	assert(id.has_value());
 
+	builder.module.var_names[*id] = symbols::name(name);
+
 	if (!arr_sizes.empty() && *arr_sizes[0])
 	{
-		bytecodes_t codes;
-		
-		if (type.type == ValueType::INT)
-		{
-			codes.push_back((bytecode_t)BytecodeType::S_INT1);
-			codes.push_back(0);
-		}
-		else if (type.type == ValueType::FLOAT)
-		{
-			codes.push_back((bytecode_t)BytecodeType::FLOAT4);
-			codes.push_back(0);
-		}
-		else
+		// every element starts as the default value of the element type
+		ir::value_t arr;
+		switch (type.type)
 		{
+		case ValueType::BOOL:
+		case ValueType::CHAR:
+		case ValueType::INT:
+			arr = builder.constant(type.type, 0);
+			break;
+		case ValueType::FLOAT:
+			arr = builder.constant(0.0f);
+			break;
+		case ValueType::STR:
+			arr = builder.constant(std::string());
+			break;
+		default:
 			throw debug::unhandled_case(type.type);
 		}
 
 		for (int i = arr_sizes.size() - 1; i >= 0; --i)
 		{
-			auto size_codes = (*arr_sizes[i])->generate_codes();
-			codes.insert(std::end(codes), std::begin(size_codes), std::end(size_codes));
-
-			codes.push_back((bytecode_t)BytecodeType::ALLOCATE);
+			auto size = (*arr_sizes[i])->generate_value(builder);
+			arr = builder.op(BytecodeType::ALLOCATE, { arr, size }, ValueType(type.type, arr_sizes.size() - i));
 		}
 
-		codes.push_back((bytecode_t)BytecodeType::STORE);
-		codes.push_back(*id);
-
-		return codes;
+		builder.store(*id, arr);
 	}
 	else
 	{
-		bytecodes_t codes = expr->generate_codes();
+		auto value = expr->generate_value(builder);
 
-		if (expr_type == ValueType::FLOAT && type == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::F2I);
+		if (type == ValueType::FLOAT && expr_type != ValueType::FLOAT)
+			value = builder.op(BytecodeType::I2F, { value }, ValueType::FLOAT);
+		else if (type != ValueType::FLOAT && expr_type == ValueType::FLOAT)
+			value = builder.op(BytecodeType::F2I, { value }, type);
 
-		codes.push_back((bytecode_t)BytecodeType::STORE);
-		codes.push_back(*id);
-		
-		return codes;
+		builder.store(*id, value);
 	}
 }
 
 
 VariableAssign::VariableAssign(
-	Location const& _loc,
-	std::string const& _var_name,
+	SourcePos _loc,
+	symbol_t _var_name,
 	std::string const& _assign_op,
 	expr::expr_p const& _expr)
 	: AST(_loc), var_name(_var_name), assign_op(_assign_op), expr(_expr), assign_type(std::nullopt), id(std::nullopt) {}
@@ -108,85 +182,69 @@ void VariableAssign::check(ParserScope& scope)
 {
 	assert(expr);
 
-	if (!scope.vars.contains(var_name))
-		night::error::get().create_minor_error("variable '" + var_name + "' is undefined", loc);
+	if (!scope.find_variable(var_name))
+	{
+		night::error::get().create_minor_error("variable '" + symbols::name(var_name) + "' is undefined", loc);
+		return;
+	}
+
+	// compound assignments are checked and generated as an assignment of a
+	// binary operation, so x += 1 is x = x + 1
+	if (assign_op != "=")
+	{
+		expr = make_node<expr::BinaryOp>(loc, assign_op.substr(0, assign_op.length() - 1),
+			make_node<expr::Variable>(loc, var_name), expr);
+
+		assign_op = "=";
+	}
 
 	auto expr_type = expr->type_check(scope);
 
 	if (!expr_type.has_value() || night::error::get().has_minor_errors())
 		return;
 
-	id = scope.vars[var_name].id;
+	auto var = scope.find_variable(var_name);
 
-	if (!compare_relative_vt(scope.vars[var_name].type, *expr_type))
+	id = var->id;
+	ParserScope::reassigned_vars.insert(*id);
+
+	if (!compare_relative_vt(var->type, *expr_type))
 		night::error::get().create_minor_error(
-			"variable '" + var_name + "' of type '" + night::to_str(scope.vars[var_name].type) +
+			"variable '" + symbols::name(var_name) + "' of type '" + night::to_str(var->type) +
 			"can not be assigned to type '" + night::to_str(*expr_type) + "'", loc);
 
+	var_type = var->type;
 	assign_type = *expr_type;
-
 }
 
-bytecodes_t VariableAssign::generate_codes() const
+bool VariableAssign::optimize(ParserScope& scope)
 {
-	bytecodes_t codes;// = expr->generate_codes();
+	assert(expr);
 
-	if (assign_op != "=")
-	{
-		codes.push_back((bytecode_t)BytecodeType::LOAD);
-		codes.push_back(*id);
+	expr = expr->optimize(scope);
+	return true;
+}
 
-		auto expr_codes = expr->generate_codes();
-		codes.insert(std::end(codes), std::begin(expr_codes), std::end(expr_codes));
+void VariableAssign::generate_ir(ir::Builder& builder) const
+{
+	builder.loc = loc;
 
-		if (assign_op == "+=")
-		{
-			if (assign_type == ValueType::FLOAT)
-				codes.push_back((bytecode_t)BytecodeType::ADD_F);
-			else if (assign_type == ValueType::STR)
-				codes.push_back((bytecode_t)BytecodeType::ADD_S);
-			else
-				codes.push_back((bytecode_t)BytecodeType::ADD_I);
-		}
-		else if (assign_op == "-=")
-		{
-			if (assign_type == ValueType::FLOAT)
-				codes.push_back((bytecode_t)BytecodeType::SUB_F);
-			else
-				codes.push_back((bytecode_t)BytecodeType::SUB_I);
-		}
-		else if (assign_op == "*=")
-		{
-			if (assign_type == ValueType::FLOAT)
-				codes.push_back((bytecode_t)BytecodeType::MULT_F);
-			else
-				codes.push_back((bytecode_t)BytecodeType::MULT_I);
-		}
-		else if (assign_op == "/=")
-		{
-			if (assign_type == ValueType::FLOAT)
-				codes.push_back((bytecode_t)BytecodeType::DIV_F);
-			else
-				codes.push_back((bytecode_t)BytecodeType::DIV_I);
-		}
-		else
-			throw debug::unhandled_case(assign_op);
-	}
-	else
-	{
-		auto expr_codes = expr->generate_codes();
-		codes.insert(std::end(codes), std::begin(expr_codes), std::end(expr_codes));
-	}
+	assert(expr);
+	assert(id.has_value());
 
-	codes.push_back((bytecode_t)BytecodeType::STORE);
-	codes.push_back(*id);
+	auto value = expr->generate_value(builder);
 
-	return codes;
+	if (var_type == ValueType::FLOAT && assign_type != ValueType::FLOAT)
+		value = builder.op(BytecodeType::I2F, { value }, ValueType::FLOAT);
+	else if (var_type != ValueType::FLOAT && assign_type == ValueType::FLOAT)
+		value = builder.op(BytecodeType::F2I, { value }, *var_type);
+
+	builder.store(*id, value);
 }
 
 
 Conditional::Conditional(
-	Location const& _loc,
+	SourcePos _loc,
 	std::vector<std::pair<expr::expr_p, AST_Block>
 	> const& _conditionals)
 	: AST(_loc), conditionals(_conditionals) {}
@@ -202,53 +260,105 @@ void Conditional::check(ParserScope& scope)
 				"expected type 'bool', 'char', or 'int',"
 				"condition is type '" + night::to_str(*cond_type) + "'", loc);
 
-		ParserScope conditional_scope(scope);
+		ParserScope conditional_scope(&scope);
 		for (auto& stmt : block)
 			stmt->check(conditional_scope);
 	}
 }
 
-bytecodes_t Conditional::generate_codes() const
+bool Conditional::optimize(ParserScope& scope)
 {
-	bytecodes_t codes;
-	std::vector<int> jumps;
-
-	for (auto const& [cond_expr, stmts] : conditionals)
+	for (auto it = std::begin(conditionals); it != std::end(conditionals);)
 	{
-		// condition
-		auto cond_codes = cond_expr->generate_codes();
-		codes.insert(std::end(codes), std::begin(cond_codes), std::end(cond_codes));
+		auto& [cond, block] = *it;
 
-		codes.push_back((bytecode_t)BytecodeType::JUMP_IF_FALSE);
-		int offset_index = codes.size();
+		cond = cond->optimize(scope);
 
-		// statements
-		for (auto const& stmt : stmts)
+		ParserScope conditional_scope(&scope);
+		optimize_block(block, conditional_scope);
+
+		auto cond_value = constant_condition(cond);
+
+		// branches that are never taken are removed
+		if (cond_value.has_value() && !*cond_value)
+		{
+			it = conditionals.erase(it);
+			continue;
+		}
+
+		// branches after one that is always taken can never be reached
+		if (cond_value.has_value() && *cond_value)
 		{
-			auto stmt_codes = stmt->generate_codes();
-			codes.insert(std::end(codes), std::begin(stmt_codes), std::end(stmt_codes));
+			conditionals.erase(it + 1, std::end(conditionals));
+			break;
 		}
 
-		// insert offset before JUMP_IF_FALSE
-		auto jif_codes = expr::Value::int_to_bytecodes(codes.size() - offset_index + 2);
-		codes.insert(std::begin(codes) + offset_index - 1, std::begin(jif_codes), std::end(jif_codes));
+		++it;
+	}
+
+	// trailing branches with empty bodies do nothing, so they are removed as long
+	// as evaluating their conditions does nothing either
+	while (!conditionals.empty() && conditionals.back().second.empty() &&
+		   !conditionals.back().first->has_side_effects())
+		conditionals.pop_back();
+
+	return !conditionals.empty();
+}
+
+void Conditional::generate_ir(ir::Builder& builder) const
+{
+	builder.loc = loc;
+
+	auto end_block = builder.create_block();
 
+	for (auto const& [cond_expr, stmts] : conditionals)
+	{
+		// a branch that is always taken is the last branch after optimization,
+		// so it does not need to test its condition
+		if (constant_condition(cond_expr) == true)
+		{
+			for (auto const& stmt : stmts)
+				stmt->generate_ir(builder);
 
-		codes.push_back((bytecode_t)BytecodeType::JUMP);
-		jumps.push_back(codes.size() + jumps.size());
+			break;
+		}
+
+		auto cond = cond_expr->generate_value(builder);
+
+		auto then_block = builder.create_block();
+		auto next_block = builder.create_block();
+		builder.branch(cond, then_block, next_block);
+
+		builder.set_block(then_block);
+		for (auto const& stmt : stmts)
+			stmt->generate_ir(builder);
+
+		builder.jump(end_block);
+		builder.set_block(next_block);
 	}
 
-	// insert offsets after JUMP
-	int final_size = codes.size() + jumps.size();
-	for (int i = 0; i < jumps.size(); ++i)
-		codes.insert(std::begin(codes) + jumps[i], final_size - jumps[i] - 1);
+	builder.jump(end_block);
+	builder.set_block(end_block);
+}
+
+bool Conditional::always_returns() const
+{
+	// without a branch that is always taken, there is a path that skips every branch
+	if (conditionals.empty() || constant_condition(conditionals.back().first) != true)
+		return false;
+
+	for (auto const& [cond, block] : conditionals)
+	{
+		if (block.empty() || !block.back()->always_returns())
+			return false;
+	}
 
-	return codes;
+	return true;
 }
 
 
 While::While(
-	Location const& _loc,
+	SourcePos _loc,
 	expr::expr_p const& _cond,
 	AST_Block const& _block)
 	: AST(_loc), cond_expr(_cond), block(_block) {}
@@ -262,68 +372,84 @@ void While::check(ParserScope& scope)
 			"condition is type '" + night::to_str(*cond_type) + "', "
 			"expected type 'bool', 'char', 'int', or 'float'", loc);
 
-	ParserScope while_scope(scope);
+	ParserScope while_scope(&scope);
 
 	for (auto& stmt : block)
 		stmt->check(while_scope);
 }
 
-bytecodes_t While::generate_codes() const
+bool While::optimize(ParserScope& scope)
 {
-	auto codes = cond_expr->generate_codes();
+	cond_expr = cond_expr->optimize(scope);
 
-	codes.push_back((bytecode_t)BytecodeType::JUMP_IF_FALSE);
-	auto offset_index = codes.size();
+	ParserScope while_scope(&scope);
+	optimize_block(block, while_scope);
 
-	for (auto const& stmt : block)
-	{
-		auto stmt_codes = stmt->generate_codes();
-		codes.insert(std::end(codes), std::begin(stmt_codes), std::end(stmt_codes));
-	}
+	// loops that never run are removed
+	return constant_condition(cond_expr) != false;
+}
+
+void While::generate_ir(ir::Builder& builder) const
+{
+	builder.loc = loc;
 
-	auto jif_codes = expr::Value::int_to_bytecodes(codes.size() - offset_index + 2);
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
 
-	codes.push_back((bytecode_t)BytecodeType::NJUMP);
-	codes.push_back(codes.size() + jif_codes.size() + 1);
+	builder.jump(cond_block);
+	builder.set_block(cond_block);
 
-	// insert offset before JUMP_IF_FALSE
-	codes.insert(std::begin(codes) + offset_index - 1, std::begin(jif_codes), std::end(jif_codes));
+	auto cond = cond_expr->generate_value(builder);
+	builder.branch(cond, body_block, end_block);
 
+	builder.set_block(body_block);
+	for (auto const& stmt : block)
+		stmt->generate_ir(builder);
 
-	return codes;
+	builder.jump(cond_block);
+	builder.set_block(end_block);
 }
 
 
 For::For(
-	Location const& _loc,
-	VariableInit const& _var_init,
+	SourcePos _loc,
+	VariableInit* _var_init,
 	expr::expr_p const& _cond_expr,
 	AST_Block const& _block)
-	: AST(_loc), var_init(_var_init), loop(_loc, _cond_expr, _block) {}
+	: AST(_loc), var_init(_var_init), loop(_loc, _cond_expr, _block), is_loop_removed(false) {}
 
 void For::check(ParserScope& scope)
 {
-	ParserScope for_scope(scope);
+	ParserScope for_scope(&scope);
 
-	var_init.check(for_scope);
+	var_init->check(for_scope);
 	loop.check(for_scope);
 }
 
-bytecodes_t For::generate_codes() const
+bool For::optimize(ParserScope& scope)
 {
-	auto codes = var_init.generate_codes();
+	ParserScope for_scope(&scope);
+
+	var_init->optimize(for_scope);
+	is_loop_removed = !loop.optimize(for_scope);
+
+	return true;
+}
 
-	auto loop_codes = loop.generate_codes();
-	codes.insert(std::end(codes), std::begin(loop_codes), std::end(loop_codes));
+void For::generate_ir(ir::Builder& builder) const
+{
+	var_init->generate_ir(builder);
 
-	return codes;
+	if (!is_loop_removed)
+		loop.generate_ir(builder);
 }
 
 
 Function::Function(
-	Location const& _loc,
-	std::string const& _name,
-	std::vector<std::string> const& _param_names,
+	SourcePos _loc,
+	symbol_t _name,
+	std::vector<symbol_t> const& _param_names,
 	std::vector<std::string> const& _param_types,
 	std::string const& _rtn_type,
 	AST_Block const& _block)
@@ -340,7 +466,11 @@ Function::Function(
 
 void Function::check(ParserScope& global_scope)
 {
-	ParserScope func_scope(global_scope, rtn_type);
+	ParserScope func_scope(&global_scope, rtn_type);
+
+	// every variable created while checking the function is a parameter
+	// or a local variable of it
+	auto first_var_id = ParserScope::next_var_id;
 
 	for (std::size_t i = 0; i < param_names.size(); ++i)
 	{
@@ -352,38 +482,48 @@ void Function::check(ParserScope& global_scope)
 
 	try {
 		// define the function now in ParserScope so it will be defined in recursive calls
-		auto func_it = ParserScope::create_function(name, param_names, param_types, rtn_type);
-		id = func_it->second.id;
+		id = ParserScope::create_function(name, param_names, param_types, rtn_type).id;
 	}
-	catch (std::string const& e) {
+	catch (char const* e) {
 		night::error::get().create_minor_error(e, loc);
 	}
 
 	for (auto& stmt : block)
 		stmt->check(func_scope);
+
+	for (auto var_id = first_var_id; var_id < ParserScope::next_var_id; ++var_id)
+		var_ids.push_back(var_id);
 }
 
-bytecodes_t Function::generate_codes() const
+bool Function::optimize(ParserScope& global_scope)
 {
-	InterpreterScope::funcs[id] = {};
+	ParserScope func_scope(&global_scope, rtn_type);
+	optimize_block(block, func_scope);
 
-	for (auto const& param_id : param_ids)
-		InterpreterScope::funcs[id].param_ids.push_back(param_id);
+	return true;
+}
 
-	for (auto const& stmt : block)
-	{
-		auto stmt_codes = stmt->generate_codes();
-		InterpreterScope::funcs[id].codes.insert(
-			std::end(InterpreterScope::funcs[id].codes),
-			std::begin(stmt_codes), std::end(stmt_codes));
-	}
+void Function::generate_ir(ir::Builder& builder) const
+{
+	auto& func = builder.module.funcs[id];
+	func = { symbols::name(name), loc };
 
-	return {};
+	func.param_ids = param_ids;
+	func.param_types = param_types;
+	func.rtn_type = rtn_type;
+	func.var_ids = var_ids;
+
+	for (std::size_t i = 0; i < param_ids.size(); ++i)
+		builder.module.var_names[param_ids[i]] = symbols::name(param_names[i]);
+
+	ir::Builder func_builder(builder.module, func);
+	for (auto const& stmt : block)
+		stmt->generate_ir(func_builder);
 }
 
 
 Return::Return(
-	Location const& _loc,
+	SourcePos _loc,
 	expr::expr_p const& _expr)
 	: AST(_loc), expr(_expr) {}
 
@@ -393,27 +533,46 @@ void Return::check(ParserScope& scope)
 	scope.check_return_type(expr_type, loc);
 }
 
-bytecodes_t Return::generate_codes() const
+bool Return::optimize(ParserScope& scope)
+{
+	if (expr)
+		expr = expr->optimize(scope);
+
+	return true;
+}
+
+void Return::generate_ir(ir::Builder& builder) const
 {
-	auto codes = expr->generate_codes();
+	builder.loc = loc;
 
-	codes.push_back((bytecode_t)BytecodeType::RETURN);
+	if (expr)
+		builder.ret(expr->generate_value(builder));
+	else
+		builder.ret(std::nullopt);
+}
 
-	return codes;
+bool Return::always_returns() const
+{
+	return true;
 }
 
 
 ArrayMethod::ArrayMethod(
-	Location const& _loc,
-	std::string const& _var_name,
+	SourcePos _loc,
+	symbol_t _var_name,
 	std::vector<expr::expr_p> const& _subscripts,
 	expr::expr_p const& _assign_expr)
 	: AST(_loc), var_name(_var_name), subscripts(_subscripts), assign_expr(_assign_expr), id(std::nullopt) {}
 
 void ArrayMethod::check(ParserScope& scope)
 {
-	if (scope.vars[var_name].type.dim != subscripts.size())
-		night::error::get().create_minor_error("too many subscripts for variable of dimension '" + std::to_string(scope.vars[var_name].type.dim) + "'", loc);
+	if (!check_variable_defined(scope, var_name, loc))
+		return;
+
+	auto var = scope.find_variable(var_name);
+
+	if (var->type.dim != (int)subscripts.size())
+		night::error::get().create_minor_error("too many subscripts for variable of dimension '" + std::to_string(var->type.dim) + "'", loc);
 
 	for (auto const& subscript : subscripts)
 	{
@@ -428,52 +587,49 @@ void ArrayMethod::check(ParserScope& scope)
 	{
 		auto const& assign_type = assign_expr->type_check(scope);
 
-		if (assign_type.has_value() && !compare_relative_vt(ValueType(scope.vars[var_name].type.type, scope.vars[var_name].type.dim - subscripts.size()), *assign_type))
-			night::error::get().create_minor_error("array of type '" + night::to_str(scope.vars[var_name].type) + "' can not be assigned to expression of type '" +
+		if (assign_type.has_value() && !compare_relative_vt(ValueType(var->type.type, var->type.dim - subscripts.size()), *assign_type))
+			night::error::get().create_minor_error("array of type '" + night::to_str(var->type) + "' can not be assigned to expression of type '" +
 				night::to_str(assign_type->type) + "'", loc);
 	}
 
-	id = scope.vars[var_name].id;
+	id = var->id;
+	ParserScope::reassigned_vars.insert(*id);
 }
 
-bytecodes_t ArrayMethod::generate_codes() const
+bool ArrayMethod::optimize(ParserScope& scope)
 {
-	assert(id.has_value());
-	assert(assign_expr);
+	for (auto& subscript : subscripts)
+		subscript = subscript->optimize(scope);
 
-	bytecodes_t codes;
+	if (assign_expr)
+		assign_expr = assign_expr->optimize(scope);
 
-	for (int i = subscripts.size() - 1; i >= 0; --i)
-	{
-		assert(subscripts[i]);
+	return true;
+}
 
-		auto subscript_codes = subscripts[i]->generate_codes();
-		codes.insert(std::end(codes), std::begin(subscript_codes), std::end(subscript_codes));
-	}
+void ArrayMethod::generate_ir(ir::Builder& builder) const
+{
+	builder.loc = loc;
 
-	auto assign_codes = assign_expr->generate_codes();
-	codes.insert(std::end(codes), std::begin(assign_codes), std::end(assign_codes));
+	assert(id.has_value());
+	assert(assign_expr);
 
-	codes.push_back((bytecode_t)BytecodeType::SET_INDEX);
-	codes.push_back(*id);
+	std::vector<ir::value_t> indices;
+	for (auto const& subscript : subscripts)
+	{
+		assert(subscript);
+		indices.push_back(subscript->generate_value(builder));
+	}
 
-	return codes;
+	builder.set_index(*id, indices, assign_expr->generate_value(builder));
 }
 
 
 expr::FunctionCall::FunctionCall(
-	Location const& _loc,
-	std::string const& _name,
+	SourcePos _loc,
+	symbol_t _name,
 	std::vector<expr::expr_p> const& _arg_exprs)
-	: AST(_loc), Expression(expr::ExpressionType::FUNCTION_CALL, _loc), name(_name), arg_exprs(_arg_exprs), id(std::nullopt), is_expr(true) {}
-
-void expr::FunctionCall::insert_node(
-	expr::expr_p const& node,
-	expr::expr_p* prev)
-{
-	node->insert_node(std::make_shared<FunctionCall>(AST::loc, name, arg_exprs));
-	*prev = node;
-}
+	: AST(_loc), Expression(expr::ExpressionType::FUNCTION_CALL, _loc), name(_name), arg_exprs(_arg_exprs), id(std::nullopt), is_pure(false), is_expr(true) {}
 
 void expr::FunctionCall::check(ParserScope& scope)
 {
@@ -483,8 +639,6 @@ void expr::FunctionCall::check(ParserScope& scope)
 
 std::optional<ValueType> expr::FunctionCall::type_check(ParserScope const& scope)
 {
-	auto [func, range_end] = ParserScope::funcs.equal_range(name);
-
 	check_function_defined(scope, name, AST::loc);
 
 	// check argument types
@@ -507,15 +661,9 @@ std::optional<ValueType> expr::FunctionCall::type_check(ParserScope const& scope
 
 	// match function with ParserScope function based on name and argument types
 
-	for (; func != range_end; ++func)
-	{
-		if (std::equal(std::begin(arg_types), std::end(arg_types),
-					   std::begin(func->second.param_types), std::end(func->second.param_types),
-			compare_absolute_vt))
-			break;
-	}
+	auto func = ParserScope::find_function(name, arg_types);
 
-	if (func == range_end)
+	if (!func)
 	{
 		std::string s_types;
 		for (auto const& type : arg_types)
@@ -525,38 +673,108 @@ std::optional<ValueType> expr::FunctionCall::type_check(ParserScope const& scope
 		if (s_types.length() >= 2)
 			s_types = s_types.substr(0, s_types.size() - 2);
 
-		night::error::get().create_minor_error("arguments in function call '" + name + "' are of type '" + s_types +
+		night::error::get().create_minor_error("arguments in function call '" + symbols::name(name) + "' are of type '" + s_types +
 			"', and do not match with the parameters in its function definition", AST::loc);
+
+		return std::nullopt;
 	}
 
-	if (is_expr && !func->second.rtn_type.has_value())
-		night::error::get().create_minor_error("function '" + func->first + "' can not have a return type of void when used in an expression", AST::loc);
+	if (is_expr && !func->rtn_type.has_value())
+		night::error::get().create_minor_error("function '" + symbols::name(name) + "' can not have a return type of void when used in an expression", AST::loc);
+
+	id = func->id;
+	rtn_type = func->rtn_type;
+	is_pure = func->is_pure;
 
-	id = func->second.id;
-	return func->second.rtn_type;
+	return rtn_type;
 }
 
-bytecodes_t expr::FunctionCall::generate_codes() const
+bool expr::FunctionCall::optimize(ParserScope& scope)
 {
-	assert(id.has_value());
+	for (auto& arg_expr : arg_exprs)
+		arg_expr = arg_expr->optimize(scope);
+
+	return true;
+}
 
-	bytecodes_t codes;
+expr::expr_p expr::FunctionCall::optimize(ParserScope const& scope)
+{
+	assert(id.has_value());
 
-	for (auto const& param : arg_exprs)
+	std::vector<expr::Value*> arg_values;
+	for (auto& arg_expr : arg_exprs)
 	{
-		assert(param);
+		arg_expr = arg_expr->optimize(scope);
+
+		if (auto arg_value = dynamic_cast<expr::Value*>(arg_expr))
+			arg_values.push_back(arg_value);
+	}
 
-		auto param_codes = param->generate_codes();
-		codes.insert(std::end(codes), std::begin(param_codes), std::end(param_codes));
+	if (arg_values.size() != arg_exprs.size())
+		return this;
+
+	// builtin functions without side effects are evaluated at compile time
+	// ids match the ones in ParserScope::funcs and interpret_bytecodes()
+	switch (*id)
+	{
+	case 6: // char(int)
+		return make_node<expr::Value>(AST::loc, ValueType::CHAR, arg_values[0]->as_int());
+	case 7: // int(str)
+		try {
+			return make_node<expr::Value>(AST::loc, ValueType::INT, (int64_t)std::stoll(arg_values[0]->as_str()));
+		}
+		catch (std::exception const&) {
+			// invalid strings are left for the interpreter to fail on
+			return this;
+		}
+	case 8: // int(char)
+		return make_node<expr::Value>(AST::loc, ValueType::INT, arg_values[0]->as_int());
+	case 9: // str(int)
+		return make_node<expr::Value>(AST::loc, ValueType::STR, std::to_string(arg_values[0]->as_int()));
+	case 10: // str(float)
+		return make_node<expr::Value>(AST::loc, ValueType::STR, std::to_string(arg_values[0]->as_float()));
+	case 11: // len(str)
+		return make_node<expr::Value>(AST::loc, ValueType::INT, (int64_t)arg_values[0]->as_str().length());
+	default:
+		return this;
 	}
+}
+
+void expr::FunctionCall::generate_ir(ir::Builder& builder) const
+{
+	builder.loc = AST::loc;
+
+	// the value returned by a call used as a statement is unused
+	generate_call(builder);
+}
 
-	codes.push_back((bytecode_t)BytecodeType::CALL);
-	codes.push_back(*id);
+ir::value_t expr::FunctionCall::generate_value(ir::Builder& builder) const
+{
+	assert(rtn_type.has_value());
+	return *generate_call(builder);
+}
+
+std::optional<ir::value_t> expr::FunctionCall::generate_call(ir::Builder& builder) const
+{
+	assert(id.has_value());
+
+	std::vector<ir::value_t> args;
+	for (auto const& arg_expr : arg_exprs)
+	{
+		assert(arg_expr);
+		args.push_back(arg_expr->generate_value(builder));
+	}
 
-	return codes;
+	return builder.call(*id, args, rtn_type, is_pure);
 }
 
-int expr::FunctionCall::precedence() const
+bool expr::FunctionCall::has_side_effects() const
 {
-	return single_prec;
+	assert(id.has_value());
+
+	if (!is_pure)
+		return true;
+
+	return std::any_of(std::begin(arg_exprs), std::end(arg_exprs),
+		[](expr::expr_p const& arg_expr) { return arg_expr->has_side_effects(); });
 }
@@ -1,33 +1,34 @@
 #include "ast/expression.hpp"
 #include "ast/ast.hpp"
+#include "ast/arena.hpp"
 #include "bytecode.hpp"
 #include "parser_scope.hpp"
 #include "parser.hpp"
 #include "scope_check.hpp"
+#include "symbols.hpp"
 #include "error.hpp"
 #include "debug.hpp"
 
 #include <algorithm>
+#include <limits>
 #include <optional>
-#include <memory>
 #include <vector>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <bit>
 #include <assert.h>
 
 expr::Expression::Expression(
-	expr::ExpressionType _type, Location const& _loc)
+	expr::ExpressionType _type, SourcePos _loc)
 	: guard(false), type(_type), loc(_loc) {}
 
 bool expr::Expression::is_operator() const { return type == ExpressionType::BINARY_OP || type == ExpressionType::UNARY_OP; };
 bool expr::Expression::is_value() const { return type == ExpressionType::BRACKET || type == ExpressionType::UNARY_OP || type == ExpressionType::BINARY_OP; };
 
-int expr::Expression::bin_op_prec    = 10;
-int expr::Expression::unary_op_prec  = 100;
-int expr::Expression::single_prec	 = 1000;
-
 
 expr::UnaryOp::UnaryOp(
-	Location const& _loc,
+	SourcePos _loc,
 	std::string const& _type,
 	expr::expr_p const& _expr)
 	: Expression(ExpressionType::UNARY_OP, _loc), expr(_expr)
@@ -38,30 +39,11 @@ expr::UnaryOp::UnaryOp(
 }
 
 expr::UnaryOp::UnaryOp(
-	Location const& _loc,
+	SourcePos _loc,
 	UnaryOpType _type,
 	expr::expr_p const& _expr)
 	: Expression(ExpressionType::UNARY_OP, _loc), type(_type), expr(_expr) {}
 
-void expr::UnaryOp::insert_node(
-	expr::expr_p const& node,
-	expr::expr_p* prev)
-{
-	if (!expr)
-	{
-		expr = node;
-	}
-	else if (node->precedence() > precedence())
-	{
-		expr->insert_node(node, &expr);
-	}
-	else
-	{
-		node->insert_node(std::make_shared<UnaryOp>(loc, type, expr));
-		*prev = node;
-	}
-}
-
 std::optional<ValueType> expr::UnaryOp::type_check(ParserScope const& scope)
 {
 	assert(expr);
@@ -115,25 +97,30 @@ std::optional<ValueType> expr::UnaryOp::type_check(ParserScope const& scope)
 	return std::nullopt;
 }
 
-bytecodes_t expr::UnaryOp::generate_codes() const
+expr::expr_p expr::UnaryOp::optimize(ParserScope const& scope)
 {
-	bytecodes_t codes = expr->generate_codes();
+	expr = expr->optimize(scope);
+
+	auto value = dynamic_cast<Value*>(expr);
+	if (!value)
+		return this;
 
 	switch (type)
 	{
 	case UnaryOpType::NEGATIVE:
+		// unsigned arithmetic so overflow wraps around like it does in the interpreter
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::NEGATIVE_I);
+			return make_node<Value>(loc, ValueType::INT, (int64_t)(0 - (uint64_t)value->as_int()));
 		if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::NEGATIVE_F);
+			return make_node<Value>(loc, -value->as_float());
 
 		break;
 
 	case UnaryOpType::NOT:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::NOT_I);
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)!value->as_int());
 		if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::NOT_F);
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)!value->as_float());
 
 		break;
 
@@ -141,27 +128,46 @@ bytecodes_t expr::UnaryOp::generate_codes() const
 		throw debug::unhandled_case((int)type);
 	}
 
-	return codes;
+	return this;
 }
 
-int expr::UnaryOp::precedence() const
+ir::value_t expr::UnaryOp::generate_value(ir::Builder& builder) const
 {
-	if (guard)
-		return single_prec;
+	auto value = expr->generate_value(builder);
 
 	switch (type)
 	{
-	case UnaryOpType::NOT:
 	case UnaryOpType::NEGATIVE:
-		return unary_op_prec + 1;
+		if (op_code == ValueType::INT)
+			return builder.op(BytecodeType::NEGATIVE_I, { value }, *op_code);
+		if (op_code == ValueType::FLOAT)
+			return builder.op(BytecodeType::NEGATIVE_F, { value }, *op_code);
+
+		break;
+
+	case UnaryOpType::NOT:
+		if (op_code == ValueType::INT)
+			return builder.op(BytecodeType::NOT_I, { value }, ValueType::BOOL);
+		if (op_code == ValueType::FLOAT)
+			return builder.op(BytecodeType::NOT_F, { value }, ValueType::BOOL);
+
+		break;
+
 	default:
 		throw debug::unhandled_case((int)type);
 	}
+
+	throw debug::unhandled_case((int)type);
+}
+
+bool expr::UnaryOp::has_side_effects() const
+{
+	return expr->has_side_effects();
 }
 
 
 expr::BinaryOp::BinaryOp(
-	Location const& _loc,
+	SourcePos _loc,
 	std::string const& _type,
 	expr::expr_p const& _lhs,
 	expr::expr_p const& _rhs)
@@ -185,35 +191,12 @@ expr::BinaryOp::BinaryOp(
 }
 
 expr::BinaryOp::BinaryOp(
-	Location const& _loc,
+	SourcePos _loc,
 	BinaryOpType _type,
 	expr::expr_p const& _lhs,
 	expr::expr_p const& _rhs)
 	: Expression(ExpressionType::BINARY_OP, _loc), type(_type), lhs(_lhs), rhs(_rhs) {}
 
-void expr::BinaryOp::insert_node(
-	expr::expr_p const& node,
-	expr::expr_p* prev)
-{
-	if (!lhs)
-	{
-		lhs = node;
-	}
-	else if (!rhs)
-	{
-		rhs = node;
-	}
-	else if (node->precedence() > precedence())
-	{
-		rhs->insert_node(node, &rhs);
-	}
-	else
-	{
-		node->insert_node(std::make_shared<BinaryOp>(loc, type, lhs, rhs));
-		*prev = node;
-	}
-}
-
 std::optional<ValueType> expr::BinaryOp::type_check(ParserScope const& scope)
 {
 	assert(lhs);
@@ -251,7 +234,7 @@ std::optional<ValueType> expr::BinaryOp::type_check(ParserScope const& scope)
 			if (rhs_type == ValueType::FLOAT)
 			{
 				if (lhs_type != ValueType::FLOAT)
-					cast_rhs = BytecodeType::I2F;
+					cast_lhs = BytecodeType::I2F;
 
 				return op_code = ValueType::FLOAT;
 			}
@@ -289,8 +272,7 @@ std::optional<ValueType> expr::BinaryOp::type_check(ParserScope const& scope)
 			
 			if (lhs_type == ValueType::FLOAT && rhs_type != ValueType::FLOAT)
 			{
-				if (lhs_type != ValueType::FLOAT)
-					cast_lhs = BytecodeType::I2F;
+				cast_rhs = BytecodeType::I2F;
 
 				op_code = ValueType::FLOAT;
 				return ValueType::BOOL;
@@ -316,8 +298,7 @@ std::optional<ValueType> expr::BinaryOp::type_check(ParserScope const& scope)
 
 			if (lhs_type == ValueType::FLOAT && rhs_type != ValueType::FLOAT)
 			{
-				if (lhs_type != ValueType::FLOAT)
-					cast_lhs = BytecodeType::I2F;
+				cast_rhs = BytecodeType::I2F;
 
 				return ValueType::BOOL;
 			}
@@ -347,179 +328,469 @@ std::optional<ValueType> expr::BinaryOp::type_check(ParserScope const& scope)
 	return std::nullopt;
 }
 
-bytecodes_t expr::BinaryOp::generate_codes() const
+expr::expr_p expr::BinaryOp::optimize(ParserScope const& scope)
 {
-	bytecodes_t codes;
+	lhs = lhs->optimize(scope);
+	rhs = rhs->optimize(scope);
+
+	auto lhs_val = dynamic_cast<Value*>(lhs);
+	auto rhs_val = dynamic_cast<Value*>(rhs);
+
+	if (!lhs_val || !rhs_val)
+		return simplify();
+
+	// apply the same casts the interpreter would
+	if (cast_lhs == BytecodeType::I2F)
+		lhs_val = lhs_val->cast(ValueType::FLOAT);
+	if (cast_rhs == BytecodeType::I2F)
+		rhs_val = rhs_val->cast(ValueType::FLOAT);
+
+	switch (type)
+	{
+	case BinaryOpType::AND:
+	case BinaryOpType::OR: {
+		if (lhs_val->get_type() == ValueType::FLOAT || rhs_val->get_type() == ValueType::FLOAT)
+			return this;
+
+		bool res = type == BinaryOpType::AND
+			? lhs_val->as_int() && rhs_val->as_int()
+			: lhs_val->as_int() || rhs_val->as_int();
+
+		return make_node<Value>(loc, ValueType::BOOL, (int64_t)res);
+	}
 
-	auto codes_lhs = lhs->generate_codes();
-	codes.insert(std::end(codes), std::begin(codes_lhs), std::end(codes_lhs));
+	case BinaryOpType::SUBSCRIPT: {
+		// lhs is the index, rhs is the container
+		if (rhs_val->get_type() != ValueType::STR)
+			return this;
+
+		auto index = lhs_val->as_int();
+		auto const& str = rhs_val->as_str();
+
+		// out of range indices are left for the interpreter to fail on
+		if (index < 0 || index >= (int64_t)str.length())
+			return this;
+
+		return make_node<Value>(loc, ValueType::CHAR, (int64_t)str[index]);
+	}
+
+	default:
+		break;
+	}
+
+	if (op_code == ValueType::INT)
+	{
+		auto l = lhs_val->as_int();
+		auto r = rhs_val->as_int();
+
+		// unsigned arithmetic so overflow wraps around like it does in the interpreter
+		switch (type)
+		{
+		case BinaryOpType::ADD:
+			return make_node<Value>(loc, ValueType::INT, (int64_t)((uint64_t)l + (uint64_t)r));
+		case BinaryOpType::SUB:
+			return make_node<Value>(loc, ValueType::INT, (int64_t)((uint64_t)l - (uint64_t)r));
+		case BinaryOpType::MULT:
+			return make_node<Value>(loc, ValueType::INT, (int64_t)((uint64_t)l * (uint64_t)r));
+		case BinaryOpType::DIV:
+		case BinaryOpType::MOD:
+			// division by zero and overflow are left for the interpreter
+			if (r == 0 || (l == std::numeric_limits<int64_t>::min() && r == -1))
+				return this;
+
+			return make_node<Value>(loc, ValueType::INT, type == BinaryOpType::DIV ? l / r : l % r);
+		case BinaryOpType::LESSER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l < r));
+		case BinaryOpType::GREATER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l > r));
+		case BinaryOpType::LESSER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l <= r));
+		case BinaryOpType::GREATER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l >= r));
+		case BinaryOpType::EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l == r));
+		case BinaryOpType::NOT_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l != r));
+		default:
+			break;
+		}
+	}
+	else if (op_code == ValueType::FLOAT)
+	{
+		auto l = lhs_val->as_float();
+		auto r = rhs_val->as_float();
+
+		switch (type)
+		{
+		case BinaryOpType::ADD:
+			return make_node<Value>(loc, l + r);
+		case BinaryOpType::SUB:
+			return make_node<Value>(loc, l - r);
+		case BinaryOpType::MULT:
+			return make_node<Value>(loc, l * r);
+		case BinaryOpType::DIV:
+			return make_node<Value>(loc, l / r);
+		case BinaryOpType::LESSER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l < r));
+		case BinaryOpType::GREATER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l > r));
+		case BinaryOpType::LESSER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l <= r));
+		case BinaryOpType::GREATER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l >= r));
+		case BinaryOpType::EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l == r));
+		case BinaryOpType::NOT_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l != r));
+		default:
+			break;
+		}
+	}
+	else if (op_code == ValueType::STR)
+	{
+		auto const& l = lhs_val->as_str();
+		auto const& r = rhs_val->as_str();
+
+		switch (type)
+		{
+		case BinaryOpType::ADD:
+			return make_node<Value>(loc, ValueType::STR, l + r);
+		case BinaryOpType::LESSER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l < r));
+		case BinaryOpType::GREATER:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l > r));
+		case BinaryOpType::LESSER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l <= r));
+		case BinaryOpType::GREATER_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l >= r));
+		case BinaryOpType::EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l == r));
+		case BinaryOpType::NOT_EQUALS:
+			return make_node<Value>(loc, ValueType::BOOL, (int64_t)(l != r));
+		default:
+			break;
+		}
+	}
+
+	return this;
+}
+
+expr::expr_p expr::BinaryOp::simplify()
+{
+	// casts change the values of the operands, so operations with casts are left alone
+	if (cast_lhs.has_value() || cast_rhs.has_value())
+		return this;
+
+	if (op_code == ValueType::INT)
+	{
+		// constants are moved to the right of commutative operations,
+		// evaluating a constant does nothing so the order does not matter
+		if ((type == BinaryOpType::ADD || type == BinaryOpType::MULT) && dynamic_cast<Value*>(lhs))
+			std::swap(lhs, rhs);
+
+		auto rhs_val = dynamic_cast<Value*>(rhs);
+		if (!rhs_val)
+			return this;
+
+		auto c = rhs_val->as_int();
+
+		// constant terms are combined, (x + c1) - c2 is x + (c1 - c2)
+		// unsigned arithmetic wraps around the same as the interpreter
+		auto lhs_op = dynamic_cast<BinaryOp*>(lhs);
+		if (lhs_op && lhs_op->op_code == ValueType::INT && !lhs_op->cast_lhs.has_value() && !lhs_op->cast_rhs.has_value())
+		{
+			auto inner_val = dynamic_cast<Value*>(lhs_op->rhs);
+
+			bool is_additive = (type == BinaryOpType::ADD || type == BinaryOpType::SUB) &&
+				(lhs_op->type == BinaryOpType::ADD || lhs_op->type == BinaryOpType::SUB);
+
+			if (inner_val && is_additive)
+			{
+				auto c1 = (uint64_t)inner_val->as_int();
+				auto c2 = (uint64_t)c;
+
+				auto sum = (int64_t)((lhs_op->type == BinaryOpType::ADD ? c1 : -c1) +
+									 (type == BinaryOpType::ADD ? c2 : -c2));
+
+				lhs = lhs_op->lhs;
+
+				if (sum < 0 && sum != std::numeric_limits<int64_t>::min())
+				{
+					type = BinaryOpType::SUB;
+					c = -sum;
+				}
+				else
+				{
+					type = BinaryOpType::ADD;
+					c = sum;
+				}
+
+				rhs = make_node<Value>(loc, ValueType::INT, c);
+			}
+			else if (inner_val && type == BinaryOpType::MULT && lhs_op->type == BinaryOpType::MULT)
+			{
+				c = (int64_t)((uint64_t)inner_val->as_int() * (uint64_t)c);
+
+				lhs = lhs_op->lhs;
+				rhs = make_node<Value>(loc, ValueType::INT, c);
+			}
+		}
+
+		switch (type)
+		{
+		case BinaryOpType::ADD:
+		case BinaryOpType::SUB:
+			if (c == 0)
+				return lhs;
+			break;
+		case BinaryOpType::MULT:
+			if (c == 1)
+				return lhs;
+			if (c == 0 && !lhs->has_side_effects())
+				return make_node<Value>(loc, ValueType::INT, (int64_t)0);
+			break;
+		case BinaryOpType::DIV:
+			if (c == 1)
+				return lhs;
+			break;
+		case BinaryOpType::MOD:
+			if ((c == 1 || c == -1) && !lhs->has_side_effects())
+				return make_node<Value>(loc, ValueType::INT, (int64_t)0);
+			break;
+		default:
+			break;
+		}
+	}
+	else if (op_code == ValueType::FLOAT)
+	{
+		auto rhs_val = dynamic_cast<Value*>(rhs);
+		if (!rhs_val)
+			return this;
+
+		auto c = rhs_val->as_float();
+
+		// x + 0.0 is not x when x is -0.0, but these are exact for every x
+		if (((type == BinaryOpType::MULT || type == BinaryOpType::DIV) && c == 1.0f) ||
+			(type == BinaryOpType::SUB && c == 0.0f && !std::signbit(c)))
+			return lhs;
+	}
+
+	return this;
+}
+
+std::optional<ir::value_t> expr::BinaryOp::generate_reduced_value(ir::Builder& builder) const
+{
+	if (op_code != ValueType::INT || cast_lhs.has_value() || cast_rhs.has_value())
+		return std::nullopt;
+
+	if (type != BinaryOpType::MULT && type != BinaryOpType::DIV && type != BinaryOpType::MOD)
+		return std::nullopt;
+
+	auto rhs_val = dynamic_cast<Value*>(rhs);
+	if (!rhs_val || rhs_val->as_int() < 2)
+		return std::nullopt;
+
+	auto c = rhs_val->as_int();
+	bool is_pow2 = (c & (c - 1)) == 0;
+
+	// multiplication by a constant that is not a power of two is as fast as it gets
+	if (type == BinaryOpType::MULT && !is_pow2)
+		return std::nullopt;
+
+	auto value = lhs->generate_value(builder);
+
+	if (is_pow2)
+	{
+		bytecodes_t shift{ (bytecode_t)std::countr_zero((uint64_t)c) };
+
+		switch (type)
+		{
+		case BinaryOpType::MULT:
+			return builder.op(BytecodeType::SHIFT_LEFT_I, { value }, ValueType::INT, shift);
+		case BinaryOpType::DIV:
+			return builder.op(BytecodeType::DIV_POW2_I, { value }, ValueType::INT, shift);
+		case BinaryOpType::MOD:
+			return builder.op(BytecodeType::MOD_POW2_I, { value }, ValueType::INT, shift);
+		default:
+			throw debug::unhandled_case((int)type);
+		}
+	}
+
+	auto [magic, shift] = division_magic(c);
+
+	auto immediates = Value::int_to_bytecodes(magic);
+	immediates.push_back((bytecode_t)shift);
+
+	if (type == BinaryOpType::DIV)
+		return builder.op(BytecodeType::DIV_MAGIC_I, { value }, ValueType::INT, immediates);
+
+	auto divisor_codes = Value::int_to_bytecodes(c);
+	immediates.insert(std::end(immediates), std::begin(divisor_codes), std::end(divisor_codes));
+
+	return builder.op(BytecodeType::MOD_MAGIC_I, { value }, ValueType::INT, immediates);
+}
+
+ir::value_t expr::BinaryOp::generate_value(ir::Builder& builder) const
+{
+	if (auto reduced_value = generate_reduced_value(builder); reduced_value.has_value())
+		return *reduced_value;
+
+	auto lhs_value = lhs->generate_value(builder);
 
 	if (cast_lhs.has_value())
-		codes.push_back((bytecode_t)*cast_lhs);
+		lhs_value = builder.op(*cast_lhs, { lhs_value }, ValueType::FLOAT);
 	
-	auto codes_rhs = rhs->generate_codes();
-	codes.insert(std::end(codes), std::begin(codes_rhs), std::end(codes_rhs));
+	auto rhs_value = rhs->generate_value(builder);
 
 	if (cast_rhs.has_value())
-		codes.push_back((bytecode_t)*cast_rhs);
+		rhs_value = builder.op(*cast_rhs, { rhs_value }, ValueType::FLOAT);
 
+	std::optional<BytecodeType> code;
 	switch (type)
 	{
 	case BinaryOpType::ADD:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::ADD_I);
+			code = BytecodeType::ADD_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::ADD_F);
+			code = BytecodeType::ADD_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::ADD_S);
+			code = BytecodeType::ADD_S;
 
 		break;
 
 	case BinaryOpType::SUB:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::SUB_I);
+			code = BytecodeType::SUB_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::SUB_F);
+			code = BytecodeType::SUB_F;
 
 		break;
 
 	case BinaryOpType::MULT:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::MULT_I);
+			code = BytecodeType::MULT_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::MULT_F);
+			code = BytecodeType::MULT_F;
 
 		break;
 
 	case BinaryOpType::DIV:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::DIV_I);
+			code = BytecodeType::DIV_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::DIV_F);
+			code = BytecodeType::DIV_F;
 
 		break;
 
 	case BinaryOpType::MOD:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::MOD_I);
+			code = BytecodeType::MOD_I;
 
 		break;
 
 	case BinaryOpType::LESSER:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_I);
+			code = BytecodeType::LESSER_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_F);
+			code = BytecodeType::LESSER_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_S);
+			code = BytecodeType::LESSER_S;
 
 		break;
 
 	case BinaryOpType::GREATER:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_I);
+			code = BytecodeType::GREATER_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_F);
+			code = BytecodeType::GREATER_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_S);
+			code = BytecodeType::GREATER_S;
 
 		break;
 
 	case BinaryOpType::LESSER_EQUALS:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_EQUALS_I);
+			code = BytecodeType::LESSER_EQUALS_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_EQUALS_F);
+			code = BytecodeType::LESSER_EQUALS_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::LESSER_EQUALS_S);
+			code = BytecodeType::LESSER_EQUALS_S;
 
 		break;
 	case BinaryOpType::GREATER_EQUALS:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_EQUALS_I);
+			code = BytecodeType::GREATER_EQUALS_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_EQUALS_F);
+			code = BytecodeType::GREATER_EQUALS_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::GREATER_EQUALS_S);
+			code = BytecodeType::GREATER_EQUALS_S;
 		break;
 	case BinaryOpType::EQUALS:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::EQUALS_I);
+			code = BytecodeType::EQUALS_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::EQUALS_F);
+			code = BytecodeType::EQUALS_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::EQUALS_S);
+			code = BytecodeType::EQUALS_S;
 		break;
 	case BinaryOpType::NOT_EQUALS:
 		if (op_code == ValueType::INT)
-			codes.push_back((bytecode_t)BytecodeType::NOT_EQUALS_I);
+			code = BytecodeType::NOT_EQUALS_I;
 		else if (op_code == ValueType::FLOAT)
-			codes.push_back((bytecode_t)BytecodeType::NOT_EQUALS_F);
+			code = BytecodeType::NOT_EQUALS_F;
 		else if (op_code == ValueType::STR)
-			codes.push_back((bytecode_t)BytecodeType::NOT_EQUALS_S);
+			code = BytecodeType::NOT_EQUALS_S;
 		break;
 	case BinaryOpType::AND:
-		codes.push_back((bytecode_t)BytecodeType::AND);
+		code = BytecodeType::AND;
 		break;
 	case BinaryOpType::OR:
-		codes.push_back((bytecode_t)BytecodeType::OR);
+		code = BytecodeType::OR;
 		break;
 	case BinaryOpType::SUBSCRIPT:
-		codes.push_back((bytecode_t)BytecodeType::SUBSCRIPT);
+		code = BytecodeType::SUBSCRIPT;
 		break;
 	default:
 		throw debug::unhandled_case((int)type);
 	}
 
-	return codes;
-}
-
-int expr::BinaryOp::precedence() const
-{
-	if (guard)
-		return single_prec;
+	if (!code.has_value())
+		throw debug::unhandled_case((int)type);
 
 	switch (type)
 	{
-	case BinaryOpType::AND:
-	case BinaryOpType::OR:
-		return bin_op_prec + 1;
-	case BinaryOpType::EQUALS:
-	case BinaryOpType::NOT_EQUALS:
-		return bin_op_prec + 2;
-	case BinaryOpType::LESSER:
-	case BinaryOpType::GREATER:
-	case BinaryOpType::LESSER_EQUALS:
-	case BinaryOpType::GREATER_EQUALS:
-		return bin_op_prec + 3;
 	case BinaryOpType::ADD:
 	case BinaryOpType::SUB:
-		return bin_op_prec + 4;
 	case BinaryOpType::MULT:
 	case BinaryOpType::DIV:
 	case BinaryOpType::MOD:
-		return bin_op_prec + 5;
-	case BinaryOpType::SUBSCRIPT:
-		return bin_op_prec + 6;
+		return builder.op(*code, { lhs_value, rhs_value }, *op_code);
+
+	// the container is the right operand
+	case BinaryOpType::SUBSCRIPT: {
+		auto const& container_type = builder.type_of(rhs_value);
+
+		if (container_type == ValueType::STR)
+			return builder.op(*code, { lhs_value, rhs_value }, ValueType::CHAR);
+
+		return builder.op(*code, { lhs_value, rhs_value }, ValueType(container_type.type, container_type.dim - 1));
+	}
 	default:
-		throw debug::unhandled_case((int)type);
+		return builder.op(*code, { lhs_value, rhs_value }, ValueType::BOOL);
 	}
 }
 
+bool expr::BinaryOp::has_side_effects() const
+{
+	return lhs->has_side_effects() || rhs->has_side_effects();
+}
+
 
 expr::Array::Array(
-	Location const& _loc,
+	SourcePos _loc,
 	std::vector<expr_p> const& _arr)
 	: Expression(ExpressionType::ARRAY, _loc), arr(_arr) {}
 
-void expr::Array::insert_node(
-	std::shared_ptr<expr::Expression> const& node,
-	std::shared_ptr<expr::Expression>* prev)
-{
-	node->insert_node(std::make_shared<expr::Array>(loc, arr));
-	*prev = node;
-}
-
 std::optional<ValueType> expr::Array::type_check(ParserScope const& scope)
 {
 	std::optional<ValueType> arr_type;
@@ -541,124 +812,192 @@ std::optional<ValueType> expr::Array::type_check(ParserScope const& scope)
 	return arr_type;
 }
 
-bytecodes_t expr::Array::generate_codes() const
+expr::expr_p expr::Array::optimize(ParserScope const& scope)
 {
-	bytecodes_t codes;
+	for (auto& elem : arr)
+		elem = elem->optimize(scope);
+
+	return this;
+}
 
+ir::value_t expr::Array::generate_value(ir::Builder& builder) const
+{
+	std::vector<ir::value_t> elems;
 	for (auto const& elem : arr)
-	{
-		auto elem_codes = elem->generate_codes();
-		codes.insert(std::begin(codes), std::begin(elem_codes), std::end(elem_codes));
-	}
+		elems.push_back(elem->generate_value(builder));
 
-	codes.push_back((bytecode_t)BytecodeType::ARR);
-	codes.push_back((bytecode_t)arr.size());
+	// an empty array has no element type, and is only used to initialize or
+	// assign to an array variable, so it is typed as an int array
+	ValueType arr_type(ValueType::INT, 1);
+	if (!elems.empty())
+		arr_type = ValueType(builder.type_of(elems[0]).type, builder.type_of(elems[0]).dim + 1);
 
-	return codes;
+	return builder.op(BytecodeType::ARR, elems, arr_type, { (bytecode_t)arr.size() });
 }
 
-int expr::Array::precedence() const
+bool expr::Array::has_side_effects() const
 {
-	return single_prec;
+	return std::any_of(std::begin(arr), std::end(arr),
+		[](expr::expr_p const& elem) { return elem->has_side_effects(); });
 }
 
 
 expr::Variable::Variable(
-	Location const& _loc,
-	std::string const& _name)
+	SourcePos _loc,
+	symbol_t _name)
 	: Expression(ExpressionType::VARIABLE, _loc), name(_name), id(std::nullopt) {}
 
-void expr::Variable::insert_node(
-	expr::expr_p const& node,
-	expr::expr_p* prev)
-{
-	node->insert_node(std::make_shared<expr::Variable>(loc, name));
-	*prev = node;
-}
-
 std::optional<ValueType> expr::Variable::type_check(ParserScope const& scope)
 {
 	if (!check_variable_defined(scope, name, loc))
 		return std::nullopt;
 
-	id = scope.vars.at(name).id;
-	return scope.vars.at(name).type;
+	auto var = scope.find_variable(name);
+
+	id = var->id;
+	var_type = var->type;
+
+	return var_type;
 }
 
-bytecodes_t expr::Variable::generate_codes() const
+expr::expr_p expr::Variable::optimize(ParserScope const& scope)
+{
+	if (!id.has_value())
+		return this;
+
+	if (auto value = scope.find_constant(*id))
+		return value;
+
+	return this;
+}
+
+ir::value_t expr::Variable::generate_value(ir::Builder& builder) const
 {
 	assert(id.has_value());
-	return { (bytecode_t)BytecodeType::LOAD, *id };
+	assert(var_type.has_value());
+
+	return builder.load(*id, *var_type);
 }
 
-int expr::Variable::precedence() const
+bool expr::Variable::has_side_effects() const
 {
-	return single_prec;
+	return false;
 }
 
 
 expr::Value::Value(
-	Location const& _loc,
+	SourcePos _loc,
 	ValueType::PrimType _type,
 	std::string const& _val)
-	: Expression(ExpressionType::VALUE, _loc), type(_type), val(_val) {}
+	: Expression(ExpressionType::VALUE, _loc), type(_type)
+{
+	switch (type)
+	{
+	case ValueType::BOOL:
+		assert(_val == "true" || _val == "false");
+		val = (int64_t)(_val == "true");
+		break;
 
-void expr::Value::insert_node(
-	expr::expr_p const& node,
-	expr::expr_p* prev)
+	case ValueType::CHAR:
+		assert(_val.length() == 1);
+		val = (int64_t)(bytecode_t)_val[0];
+		break;
+
+	case ValueType::INT:
+		val = (int64_t)std::stoull(_val);
+		break;
+
+	case ValueType::FLOAT:
+		val = std::stof(_val);
+		break;
+
+	case ValueType::STR:
+		val = _val;
+		break;
+
+	default:
+		throw debug::unhandled_case((int)type);
+	}
+}
+
+expr::Value::Value(
+	SourcePos _loc,
+	ValueType::PrimType _type,
+	int64_t _val)
+	: Expression(ExpressionType::VALUE, _loc), type(_type), val(_val)
 {
-	node->insert_node(std::make_shared<expr::Value>(loc, type, val));
-	*prev = node;
+	assert(type == ValueType::BOOL || type == ValueType::CHAR || type == ValueType::INT);
 }
 
+expr::Value::Value(
+	SourcePos _loc,
+	float _val)
+	: Expression(ExpressionType::VALUE, _loc), type(ValueType::FLOAT), val(_val) {}
+
 std::optional<ValueType> expr::Value::type_check(ParserScope const& scope)
 {
 	return type;
 }
 
-bytecodes_t expr::Value::generate_codes() const
+expr::expr_p expr::Value::optimize(ParserScope const& scope)
+{
+	return this;
+}
+
+ir::value_t expr::Value::generate_value(ir::Builder& builder) const
 {
 	switch (type)
 	{
 	case ValueType::BOOL:
-		assert(val == "true" || val == "false");
-		return { (bytecode_t)BytecodeType::S_INT1, val == "true" };
-
 	case ValueType::CHAR:
-		assert(val.length() == 1);
-		return { (bytecode_t)BytecodeType::S_INT1, (bytecode_t)val[0] };
-
 	case ValueType::INT:
-		return Value::int_to_bytecodes(std::stoull(val));
+		return builder.constant(type, as_int());
+	case ValueType::FLOAT:
+		return builder.constant(as_float());
+	case ValueType::STR:
+		return builder.constant(as_str());
+	default:
+		throw debug::unhandled_case((int)(type));
+	}
+}
 
-	case ValueType::FLOAT: {
-		bytecodes_t codes(sizeof(float));
+bool expr::Value::has_side_effects() const
+{
+	return false;
+}
 
-		float val_f = std::stof(val);
-		memcpy(codes.data(), &val_f, sizeof(float));
+ValueType::PrimType expr::Value::get_type() const
+{
+	return type;
+}
 
-		codes.insert(std::begin(codes), (bytecode_t)BytecodeType::FLOAT4);
-		return codes;
-	}
-	case ValueType::STR: {
-		bytecodes_t codes{ (bytecode_t)BytecodeType::STR };
-		
-		auto length_codes = Value::int_to_bytecodes(val.length());
-		codes.insert(std::end(codes), std::begin(length_codes), std::end(length_codes));
+int64_t expr::Value::as_int() const
+{
+	return std::get<int64_t>(val);
+}
 
-		for (char c : val)
-			codes.push_back((bytecode_t)c);
+float expr::Value::as_float() const
+{
+	return std::get<float>(val);
+}
 
-		return codes;
-	}
-	default:
-		throw debug::unhandled_case((int)(type));
-	}
+std::string const& expr::Value::as_str() const
+{
+	return std::get<std::string>(val);
 }
 
-int expr::Value::precedence() const
+expr::Value* expr::Value::cast(ValueType::PrimType _type) const
 {
-	return single_prec;
+	if (type == ValueType::FLOAT && _type != ValueType::FLOAT)
+		return make_node<Value>(loc, _type, (int64_t)as_float());
+
+	if (type != ValueType::FLOAT && _type == ValueType::FLOAT)
+		return make_node<Value>(loc, (float)as_int());
+
+	auto value = make_node<Value>(*this);
+	value->type = _type;
+
+	return value;
 }
 
 bytecodes_t expr::Value::int_to_bytecodes(uint64_t uint64)
@@ -28,7 +28,15 @@ std::string night::to_str(BytecodeType type)
 		return "FLOAT4";
 	case BytecodeType::FLOAT8:
 		return "FLOAT8";
+	case BytecodeType::STR:
+		return "STR";
+	case BytecodeType::ARR:
+		return "ARR";
 
+	case BytecodeType::NEGATIVE_I:
+		return "NEGATIVE_I";
+	case BytecodeType::NEGATIVE_F:
+		return "NEGATIVE_F";
 	case BytecodeType::NOT_I:
 		return "NOT_I";
 	case BytecodeType::NOT_F:
@@ -51,21 +59,111 @@ std::string night::to_str(BytecodeType type)
 		return "DIV_I";
 	case BytecodeType::DIV_F:
 		return "DIV_F";
+	case BytecodeType::MOD_I:
+		return "MOD_I";
+	case BytecodeType::SHIFT_LEFT_I:
+		return "SHIFT_LEFT_I";
+	case BytecodeType::DIV_POW2_I:
+		return "DIV_POW2_I";
+	case BytecodeType::MOD_POW2_I:
+		return "MOD_POW2_I";
+	case BytecodeType::DIV_MAGIC_I:
+		return "DIV_MAGIC_I";
+	case BytecodeType::MOD_MAGIC_I:
+		return "MOD_MAGIC_I";
+
+	case BytecodeType::LESSER_I:
+		return "LESSER_I";
+	case BytecodeType::LESSER_F:
+		return "LESSER_F";
+	case BytecodeType::LESSER_S:
+		return "LESSER_S";
+	case BytecodeType::GREATER_I:
+		return "GREATER_I";
+	case BytecodeType::GREATER_F:
+		return "GREATER_F";
+	case BytecodeType::GREATER_S:
+		return "GREATER_S";
+	case BytecodeType::LESSER_EQUALS_I:
+		return "LESSER_EQUALS_I";
+	case BytecodeType::LESSER_EQUALS_F:
+		return "LESSER_EQUALS_F";
+	case BytecodeType::LESSER_EQUALS_S:
+		return "LESSER_EQUALS_S";
+	case BytecodeType::GREATER_EQUALS_I:
+		return "GREATER_EQUALS_I";
+	case BytecodeType::GREATER_EQUALS_F:
+		return "GREATER_EQUALS_F";
+	case BytecodeType::GREATER_EQUALS_S:
+		return "GREATER_EQUALS_S";
+	case BytecodeType::EQUALS_I:
+		return "EQUALS_I";
+	case BytecodeType::EQUALS_F:
+		return "EQUALS_F";
+	case BytecodeType::EQUALS_S:
+		return "EQUALS_S";
+	case BytecodeType::NOT_EQUALS_I:
+		return "NOT_EQUALS_I";
+	case BytecodeType::NOT_EQUALS_F:
+		return "NOT_EQUALS_F";
+	case BytecodeType::NOT_EQUALS_S:
+		return "NOT_EQUALS_S";
+	case BytecodeType::AND:
+		return "AND";
+	case BytecodeType::OR:
+		return "OR";
+
+	case BytecodeType::SUBSCRIPT:
+		return "SUBSCRIPT";
+	case BytecodeType::SUBSCRIPT_UNCHECKED:
+		return "SUBSCRIPT_UNCHECKED";
+	case BytecodeType::ALLOCATE:
+		return "ALLOCATE";
+	case BytecodeType::I2F:
+		return "I2F";
+	case BytecodeType::F2I:
+		return "F2I";
 
 	case BytecodeType::LOAD:
 		return "LOAD";
 	case BytecodeType::STORE:
 		return "STORE";
+	case BytecodeType::STORE_KEEP:
+		return "STORE_KEEP";
+	case BytecodeType::SET_INDEX:
+		return "SET_INDEX";
+	case BytecodeType::SET_INDEX_UNCHECKED:
+		return "SET_INDEX_UNCHECKED";
+	case BytecodeType::STORE_A:
+		return "STORE_A";
 
 	case BytecodeType::JUMP:
 		return "JUMP";
 	case BytecodeType::JUMP_IF_FALSE:
 		return "JUMP_IF_FALSE";
+	case BytecodeType::JUMP_IF_TRUE:
+		return "JUMP_IF_TRUE";
+	case BytecodeType::NJUMP:
+		return "NJUMP";
+	case BytecodeType::TABLE_SWITCH:
+		return "TABLE_SWITCH";
+	case BytecodeType::LOOKUP_SWITCH:
+		return "LOOKUP_SWITCH";
+
+	case BytecodeType::VECTOR_MAP:
+		return "VECTOR_MAP";
+	case BytecodeType::VECTOR_SUM:
+		return "VECTOR_SUM";
+
+	case BytecodeType::COUNT:
+		return "COUNT";
 
 	case BytecodeType::RETURN:
 		return "RETURN";
 	case BytecodeType::CALL:
 		return "FUNC_CALL";
+	case BytecodeType::POP:
+		return "POP";
 
 	default:
 		throw debug::unhandled_case((int)type);
@@ -0,0 +1,139 @@
+#include "char_scan.hpp"
+
+#include <algorithm>
+#include <string_view>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+namespace
+{
+
+using chars_t = __m128i;
+
+// each byte of the results is all ones where the character is in the class
+
+chars_t in_range(chars_t chars, char lo, char hi)
+{
+	auto offset = _mm_sub_epi8(chars, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8((char)(hi - lo))), offset);
+}
+
+chars_t equals(chars_t chars, char c)
+{
+	return _mm_cmpeq_epi8(chars, _mm_set1_epi8(c));
+}
+
+}
+#endif
+
+namespace
+{
+
+// the characters of each kind of run, one at a time, or 16 at a time with SSE2
+
+struct Spaces
+{
+	static bool is_run(char c) { return char_class::is_space(c); }
+
+#if defined(__SSE2__)
+	static chars_t is_run(chars_t chars)
+	{
+		return _mm_or_si128(equals(chars, ' '), in_range(chars, '\t', '\r'));
+	}
+#endif
+};
+
+struct Digits
+{
+	static bool is_run(char c) { return char_class::is_digit(c); }
+
+#if defined(__SSE2__)
+	static chars_t is_run(chars_t chars)
+	{
+		return in_range(chars, '0', '9');
+	}
+#endif
+};
+
+struct Words
+{
+	static bool is_run(char c) { return char_class::is_word(c); }
+
+#if defined(__SSE2__)
+	static chars_t is_run(chars_t chars)
+	{
+		// setting the 0x20 bit makes upper case letters lower case, and leaves the
+		// lower case ones as they are
+		auto letters = in_range(_mm_or_si128(chars, _mm_set1_epi8(0x20)), 'a', 'z');
+		return _mm_or_si128(_mm_or_si128(letters, Digits::is_run(chars)), equals(chars, '_'));
+	}
+#endif
+};
+
+struct NotQuotesOrEscapes
+{
+	static bool is_run(char c) { return c != '"' && c != '\\'; }
+
+#if defined(__SSE2__)
+	static chars_t is_run(chars_t chars)
+	{
+		auto ends = _mm_or_si128(equals(chars, '"'), equals(chars, '\\'));
+		return _mm_andnot_si128(ends, _mm_set1_epi8(-1));
+	}
+#endif
+};
+
+// most runs of spaces, and most words and numbers, are shorter than this, and
+// end before it is worth loading a vector
+constexpr std::size_t short_run_size = 8;
+
+}
+
+// returns the index of the first character from pos that is not in the run
+template <typename Run>
+static std::size_t scan(std::string_view str, std::size_t pos)
+{
+	for (auto short_end = std::min(str.size(), pos + short_run_size); pos < short_end; ++pos)
+	{
+		if (!Run::is_run(str[pos]))
+			return pos;
+	}
+
+#if defined(__SSE2__)
+	for (; pos + sizeof(chars_t) <= str.size(); pos += sizeof(chars_t))
+	{
+		auto chars = _mm_loadu_si128((chars_t const*)(str.data() + pos));
+		auto ends = ~_mm_movemask_epi8(Run::is_run(chars)) & 0xFFFF;
+
+		if (ends)
+			return pos + __builtin_ctz(ends);
+	}
+#endif
+
+	while (pos < str.size() && Run::is_run(str[pos]))
+		++pos;
+
+	return pos;
+}
+
+std::size_t skip_spaces(std::string_view str, std::size_t pos)
+{
+	return scan<Spaces>(str, pos);
+}
+
+std::size_t skip_word(std::string_view str, std::size_t pos)
+{
+	return scan<Words>(str, pos);
+}
+
+std::size_t skip_digits(std::string_view str, std::size_t pos)
+{
+	return scan<Digits>(str, pos);
+}
+
+std::size_t find_quote_or_escape(std::string_view str, std::size_t pos)
+{
+	return scan<NotQuotesOrEscapes>(str, pos);
+}
@@ -1,11 +1,105 @@
 #include "code_gen.hpp"
 #include "bytecode.hpp"
 #include "ast/ast.hpp"
+#include "ir.hpp"
+#include "purity.hpp"
+#include "licm.hpp"
+#include "range.hpp"
+#include "vectorize.hpp"
+#include "unroll.hpp"
+#include "loop_inversion.hpp"
+#include "cse.hpp"
+#include "switch.hpp"
+#include "const_eval.hpp"
+#include "dead_code.hpp"
+#include "profile.hpp"
+#include "peephole.hpp"
+#include "inliner.hpp"
+#include "interpreter_scope.hpp"
 
-bytecodes_t code_gen(AST_Block const& block)
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+int optimization_level = 1;
+bool memoize_functions = false;
+
+// loop inversion changes the shape of loops the other passes look for, so it comes
+// after them, and common subexpressions are only reused after the loop passes,
+// since a header's values used outside of it keep its loop from being changed
+// switches are formed last, since the other passes only follow branches
+// array loops are vectorized before unrolling copies their bodies
+// with a profile, loops are unrolled at any level, since only hot loops are unrolled
+// a program that writes a profile keeps the blocks of its source, so the count
+// of a loop's header is not moved into copies of it or into a kernel
+static void optimize_ir(ir::Function& func)
+{
+	bool keeps_blocks = ir::profile_out_file.has_value();
+
+	ir::hoist_loop_invariants(func);
+	ir::remove_bounds_checks(func);
+
+	if (!keeps_blocks)
+		ir::vectorize_loops(func);
+
+	if (!keeps_blocks && (optimization_level >= 2 || func.blocks[0].count.has_value()))
+		ir::unroll_loops(func);
+
+	if (!keeps_blocks)
+		ir::invert_loops(func);
+
+	ir::eliminate_common_subexpressions(func);
+
+	if (!keeps_blocks)
+		ir::form_switches(func);
+}
+
+// the arguments of a memoized function are its key in a hash table, so they
+// are all bool, char, int or float
+// only functions that can call themselves are memoized, since the others are
+// rarely called again with the same arguments
+static bool should_memoize(ir::Module const& module, bytecode_t id)
+{
+	auto const& func = module.funcs.at(id);
+	if (!func.is_pure || !func.rtn_type.has_value() || func.param_types.empty())
+		return false;
+
+	for (auto const& type : func.param_types)
+	{
+		if (!type.is_prim())
+			return false;
+	}
+
+	std::vector<bytecode_t> worklist{ id };
+	std::unordered_set<bytecode_t> visited;
+
+	while (!worklist.empty())
+	{
+		auto const& curr = module.funcs.at(worklist.back());
+		worklist.pop_back();
+
+		for (auto const& block : curr.blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				if (instr.op != ir::Op::CALL || !module.funcs.contains(instr.id))
+					continue;
+
+				if (instr.id == id)
+					return true;
+
+				if (visited.insert(instr.id).second)
+					worklist.push_back(instr.id);
+			}
+		}
+	}
+
+	return false;
+}
+
+bytecodes_t code_gen(AST_Block& block)
 {
 	ParserScope global_scope;
-	bytecodes_t codes;
 
 	for (auto const& ast : block)
 		ast->check(global_scope);
@@ -13,11 +107,56 @@ bytecodes_t code_gen(AST_Block const& block)
 	if (night::error::get().has_minor_errors())
 		throw night::error::get();
 
+	optimize_block(block, global_scope);
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
 	for (auto const& ast : block)
+		ast->generate_ir(builder);
+
+	if (ir::profile_in_file.has_value())
+		ir::read_profile(module, *ir::profile_in_file);
+	if (ir::profile_out_file.has_value())
+		ir::instrument(module);
+
+	ir::find_pure_functions(module);
+
+	optimize_ir(module.main);
+	for (auto& [id, func] : module.funcs)
+		optimize_ir(func);
+
+	// evaluated calls can leave functions and variables unused
+	ir::evaluate_constant_calls(module);
+	ir::remove_dead_functions(module);
+	ir::remove_dead_variables(module);
+	ir::renumber_variables(module);
+
+	if (ir::print_ir)
+		ir::dump(module, std::clog);
+
+	auto codes = ir::lower(module.main);
+
+	for (auto& [id, func] : module.funcs)
 	{
-		auto ast_codes = ast->generate_codes();
-		codes.insert(std::end(codes), std::begin(ast_codes), std::end(ast_codes));
+		auto func_codes = ir::lower(func);
+		InterpreterScope::funcs[id] = { func.param_ids, func_codes, func.var_ids };
+
+		if (memoize_functions && should_memoize(module, id))
+			InterpreterScope::funcs[id].memo.emplace(func.param_ids.size());
+
+		// functions that were never called in the profile are not inlined, so
+		// their codes are only in one place
+		auto calls = func.blocks[0].count;
+		if (calls.has_value())
+			inline_thresholds[id] = *calls == 0 ? 0 : *calls >= ir::hot_count ? inline_threshold * hot_inline_factor : inline_threshold;
 	}
 
+	inline_functions(codes);
+
+	peephole(codes);
+	for (auto& [id, func] : InterpreterScope::funcs)
+		peephole(func.codes);
+
 	return codes;
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "const_eval.hpp"
+#include "ir.hpp"
+#include "interpreter.hpp"
+#include "interpreter_scope.hpp"
+#include "parser_scope.hpp"
+
+#include <exception>
+#include <optional>
+#include <set>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using Constant = decltype(ir::Instruction::constant);
+
+// shared by every call evaluated in a module
+struct EvalState
+{
+	std::size_t steps = ir::eval_step_budget;
+
+	// functions that ran out of steps, which are not evaluated again
+	std::unordered_set<bytecode_t> out_of_steps;
+
+	// <function id, arguments>
+	// calls that stopped with an error, which would stop again
+	std::set<std::pair<bytecode_t, std::vector<Constant>>> failed_calls;
+};
+
+// returns std::nullopt if the call did not finish within the limit
+static std::optional<intpr::Value> evaluate_call(ir::Function const& callee, bytecode_t id, std::vector<intpr::Value> const& args, EvalState& state)
+{
+	InterpreterScope scope;
+	for (std::size_t i = 0; i < args.size(); ++i)
+		scope.vars[callee.param_ids[i]] = args[i];
+
+	eval_limit = EvalLimit{ state.steps, ir::eval_max_depth, 0 };
+
+	std::optional<intpr::Value> result;
+	try {
+		result = interpret_bytecodes(scope, InterpreterScope::funcs[id].codes);
+	}
+	catch (EvalAbort const& e) {
+		if (e.out_of_steps)
+			state.out_of_steps.insert(id);
+	}
+	catch (std::exception const&) {}
+
+	state.steps = eval_limit->steps;
+	eval_limit = std::nullopt;
+	return result;
+}
+
+static bool evaluate_calls(ir::Module const& module, ir::Function& func, EvalState& state)
+{
+	using namespace ir;
+
+	// constants of the function, including the results of the calls evaluated so far
+	std::vector<std::optional<Constant>> constants(func.value_types.size());
+	for (auto const& block : func.blocks)
+	{
+		for (auto const& instr : block.instrs)
+		{
+			if (instr.op == Op::CONST)
+				constants[*instr.result] = instr.constant;
+		}
+	}
+
+	auto to_value = [](Constant const& constant) {
+		if (auto val = std::get_if<int64_t>(&constant))
+			return intpr::Value(*val);
+		if (auto val = std::get_if<float>(&constant))
+			return intpr::Value(*val);
+
+		return intpr::Value(std::get<std::string>(constant));
+	};
+
+	bool changed = false;
+
+	// blocks are in reverse postorder, so the results used as arguments are found first
+	for (auto block : reverse_postorder(func))
+	{
+		for (auto& instr : func.blocks[block].instrs)
+		{
+			if (instr.op != Op::CALL || !instr.is_pure || !instr.result.has_value() || !module.funcs.contains(instr.id) ||
+				state.out_of_steps.contains(instr.id))
+				continue;
+
+			auto const& type = func.value_types[*instr.result];
+			if (type.dim > 0)
+				continue;
+
+			std::pair<bytecode_t, std::vector<Constant>> call{ instr.id, {} };
+			std::vector<intpr::Value> args;
+			for (auto operand : instr.operands)
+			{
+				if (!constants[operand].has_value())
+					break;
+
+				call.second.push_back(*constants[operand]);
+				args.push_back(to_value(*constants[operand]));
+			}
+
+			if (args.size() != instr.operands.size() || state.failed_calls.contains(call))
+				continue;
+
+			auto result = evaluate_call(module.funcs.at(instr.id), instr.id, args, state);
+			if (!result.has_value())
+			{
+				if (!state.out_of_steps.contains(instr.id))
+					state.failed_calls.insert(std::move(call));
+
+				continue;
+			}
+
+			Instruction constant{ Op::CONST, instr.result };
+			switch (type.type)
+			{
+			case ValueType::FLOAT: constant.constant = result->f; break;
+			case ValueType::STR:   constant.constant = result->s; break;
+			default:			   constant.constant = result->i; break;
+			}
+
+			instr = constant;
+			constants[*instr.result] = instr.constant;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+bool ir::evaluate_constant_calls(Module& module)
+{
+	if (module.funcs.empty())
+		return false;
+
+	// lowering creates variables, so the ids given to the copies are given out
+	// again when the functions are lowered for good
+	auto next_var_id = ParserScope::next_var_id;
+
+	for (auto const& [id, func] : module.funcs)
+	{
+		auto copy = func;
+		auto codes = lower(copy);
+		InterpreterScope::funcs[id] = { copy.param_ids, codes, copy.var_ids };
+	}
+
+	ParserScope::next_var_id = next_var_id;
+
+	EvalState state;
+
+	bool changed = evaluate_calls(module, module.main, state);
+	for (auto& [id, func] : module.funcs)
+		changed = evaluate_calls(module, func, state) || changed;
+
+	for (auto const& [id, func] : module.funcs)
+		InterpreterScope::funcs.erase(id);
+
+	return changed;
+}
@@ -0,0 +1,107 @@
+#include "cse.hpp"
+#include "ir.hpp"
+#include "range.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+bool ir::eliminate_common_subexpressions(Function& func)
+{
+	auto value_count = func.value_types.size();
+	auto order = reverse_postorder(func);
+	DominatorTree doms(func);
+
+	std::vector<Instruction const*> defs(value_count, nullptr);
+	for (auto block : order)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.result.has_value())
+				defs[*instr.result] = &instr;
+		}
+	}
+
+	// a value used again is kept in a variable, which costs about as much as an
+	// operation on variables and constants
+	auto is_worth_reusing = [&](Instruction const& instr) {
+		if (!instr.result.has_value() || has_side_effects(instr))
+			return false;
+
+		switch (instr.op)
+		{
+		case Op::CALL:
+			return true;
+		case Op::BYTECODE:
+			if (instr.code == BytecodeType::SUBSCRIPT || instr.code == BytecodeType::SUBSCRIPT_UNCHECKED)
+				return true;
+
+			return std::any_of(std::begin(instr.operands), std::end(instr.operands), [&](value_t operand) {
+				return defs[operand] && (defs[operand]->op == Op::BYTECODE || defs[operand]->op == Op::CALL);
+			});
+		default:
+			return false;
+		}
+	};
+
+	std::vector<std::optional<value_t>> replacements(value_count);
+	bool changed = false;
+
+	{
+		RangeAnalysis analysis(func);
+
+		// the values that can be reused, and their blocks, in reverse postorder,
+		// so a value is always found before the values it dominates
+		std::vector<std::pair<block_t, value_t>> available;
+
+		for (auto block : order)
+		{
+			for (auto const& instr : func.blocks[block].instrs)
+			{
+				if (!is_worth_reusing(instr))
+					continue;
+
+				auto it = std::find_if(std::begin(available), std::end(available), [&](auto const& other) {
+					return doms.dominates(other.first, block) && analysis.is_same_value(other.second, *instr.result);
+				});
+
+				if (it != std::end(available))
+				{
+					replacements[*instr.result] = it->second;
+					changed = true;
+				}
+				else
+				{
+					available.push_back({ block, *instr.result });
+				}
+			}
+		}
+	}
+
+	if (!changed)
+		return false;
+
+	// values are only replaced by values that are not replaced themselves
+	auto replace = [&](value_t& value) {
+		value = replacements[value].value_or(value);
+	};
+
+	for (auto& block : func.blocks)
+	{
+		std::erase_if(block.instrs, [&](Instruction const& instr) {
+			return instr.result.has_value() && replacements[*instr.result].has_value();
+		});
+
+		for (auto& instr : block.instrs)
+			std::for_each(std::begin(instr.operands), std::end(instr.operands), replace);
+
+		if (block.terminator.has_value() && block.terminator->value.has_value())
+			replace(*block.terminator->value);
+	}
+
+	remove_unused_values(func);
+
+	return true;
+}
@@ -0,0 +1,118 @@
+#include "dead_code.hpp"
+#include "ir.hpp"
+#include "parser_scope.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
+#include <string>
+#include <vector>
+
+bool ir::remove_dead_functions(Module& module)
+{
+	std::unordered_set<bytecode_t> reachable;
+	std::vector<Function const*> worklist{ &module.main };
+
+	while (!worklist.empty())
+	{
+		auto func = worklist.back();
+		worklist.pop_back();
+
+		for (auto const& block : func->blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				if (instr.op == Op::CALL && module.funcs.contains(instr.id) && reachable.insert(instr.id).second)
+					worklist.push_back(&module.funcs.at(instr.id));
+			}
+		}
+	}
+
+	return std::erase_if(module.funcs, [&](auto const& func) { return !reachable.contains(func.first); }) > 0;
+}
+
+bool ir::remove_dead_variables(Module& module)
+{
+	std::vector<Function*> funcs{ &module.main };
+	for (auto& [id, func] : module.funcs)
+		funcs.push_back(&func);
+
+	std::unordered_set<bytecode_t> read_vars;
+	for (auto func : funcs)
+	{
+		for (auto const& block : func->blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				if (instr.op == Op::LOAD || instr.op == Op::SET_INDEX)
+					read_vars.insert(instr.id);
+			}
+		}
+	}
+
+	bool changed = false;
+	for (auto func : funcs)
+	{
+		bool func_changed = false;
+		for (auto& block : func->blocks)
+		{
+			func_changed = std::erase_if(block.instrs, [&](Instruction const& instr) {
+				return instr.op == Op::STORE && !read_vars.contains(instr.id);
+			}) > 0 || func_changed;
+		}
+
+		if (func_changed)
+		{
+			remove_unused_values(*func);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+void ir::renumber_variables(Module& module)
+{
+	std::vector<Function*> funcs{ &module.main };
+	for (auto& [id, func] : module.funcs)
+		funcs.push_back(&func);
+
+	std::unordered_map<bytecode_t, bytecode_t> new_ids;
+	auto renumber = [&](bytecode_t& var_id) {
+		auto [it, is_new] = new_ids.try_emplace(var_id, (bytecode_t)new_ids.size());
+		var_id = it->second;
+	};
+
+	for (auto func : funcs)
+	{
+		// parameters are assigned by every call, even if they are never read
+		for (auto& param_id : func->param_ids)
+			renumber(param_id);
+
+		for (auto& block : func->blocks)
+		{
+			for (auto& instr : block.instrs)
+			{
+				if (instr.op == Op::LOAD || instr.op == Op::STORE || instr.op == Op::SET_INDEX)
+					renumber(instr.id);
+			}
+		}
+
+		// variables that are never used are left out
+		std::erase_if(func->var_ids, [&](bytecode_t var_id) { return !new_ids.contains(var_id); });
+		for (auto& var_id : func->var_ids)
+			var_id = new_ids.at(var_id);
+	}
+
+	std::unordered_map<bytecode_t, std::string> var_names;
+	for (auto const& [var_id, name] : module.var_names)
+	{
+		if (new_ids.contains(var_id))
+			var_names[new_ids.at(var_id)] = name;
+	}
+
+	module.var_names = var_names;
+	ParserScope::next_var_id = (bytecode_t)new_ids.size();
+}
@@ -1,5 +1,6 @@
 #include "debug.hpp"
 #include "parser_scope.hpp"
+#include "interpreter_scope.hpp"
 #include "bytecode.hpp"
 
 #include <iostream>
@@ -11,4 +12,14 @@ void debug::log_codes(bytecodes_t const& codes)
 
 	std::clog << "[printing bytecodes]\n";
 	std::clog << "[end of bytecodes]";
+}
+
+void debug::log_memo_tables(std::ostream& out)
+{
+	for (auto const& [id, func] : InterpreterScope::funcs)
+	{
+		if (func.memo.has_value())
+			out << "[memo] function " << (int)id << ": " << func.memo->hits << " hits, "
+				<< func.memo->misses << " misses, " << func.memo->size() << " results\n";
+	}
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "error.hpp"
+#include "source_table.hpp"
 
 #include <source_location>
 #include <string>
@@ -8,7 +9,7 @@ night::error::error()
 
 night::error& night::error::get()
 {
-	static error instance;
+	thread_local error instance;
 	return instance;
 }
 
@@ -42,6 +43,23 @@ night::error const& night::error::create_fatal_error(
 	return *this;
 }
 
+void night::error::create_warning(std::string const& msg, SourcePos pos, std::source_location const& s_loc) noexcept
+{
+	create_warning(msg, source_table::location(pos), s_loc);
+}
+
+void night::error::create_minor_error(std::string const& msg, SourcePos pos, std::source_location const& s_loc) noexcept
+{
+	create_minor_error(msg, source_table::location(pos), s_loc);
+}
+
+night::error const& night::error::create_fatal_error(
+	std::string const& msg, SourcePos pos,
+	std::source_location const& s_loc) noexcept
+{
+	return create_fatal_error(msg, source_table::location(pos), s_loc);
+}
+
 bool night::error::has_minor_errors() const
 {
 	return !minor_errors.empty();
@@ -0,0 +1,168 @@
+#include "inliner.hpp"
+#include "peephole.hpp"
+#include "interpreter_scope.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+std::size_t inline_threshold = 64;
+std::unordered_map<bytecode_t, std::size_t> inline_thresholds;
+
+void inline_functions(bytecodes_t& codes)
+{
+	if (inline_threshold == 0)
+		return;
+
+	auto inline_funcs = find_inline_funcs();
+	if (inline_funcs.empty())
+		return;
+
+	auto inline_into = [&](bytecodes_t& codes) {
+		auto instrs = decode_instructions(codes);
+		if (!instrs.has_value())
+			return;
+
+		// inlined codes can contain calls to other functions that can be inlined
+		bool changed = false;
+		while (inline_calls(*instrs, inline_funcs))
+			changed = true;
+
+		if (!changed)
+			return;
+
+		// if a jump offset no longer fits, the calls are left as they are
+		auto inlined_codes = encode_instructions(*instrs);
+		if (inlined_codes.has_value())
+			codes = *inlined_codes;
+	};
+
+	inline_into(codes);
+	for (auto& [id, func] : InterpreterScope::funcs)
+		inline_into(func.codes);
+}
+
+std::unordered_map<bytecode_t, std::vector<Instruction>> find_inline_funcs()
+{
+	std::unordered_map<bytecode_t, std::vector<Instruction>> inline_funcs;
+
+	for (auto const& [id, func] : InterpreterScope::funcs)
+	{
+		auto threshold = inline_thresholds.contains(id) ? inline_thresholds.at(id) : inline_threshold;
+		if (func.codes.size() > threshold)
+			continue;
+
+		auto instrs = decode_instructions(func.codes);
+		if (!instrs.has_value())
+			continue;
+
+		bool assigns_own_vars = std::all_of(std::begin(*instrs), std::end(*instrs), [&](Instruction const& instr) {
+			if (instr.type != BytecodeType::STORE && instr.type != BytecodeType::STORE_KEEP &&
+				instr.type != BytecodeType::SET_INDEX && instr.type != BytecodeType::SET_INDEX_UNCHECKED)
+				return true;
+
+			return std::find(std::begin(func.var_ids), std::end(func.var_ids), instr.operands[0]) != std::end(func.var_ids);
+		});
+
+		if (assigns_own_vars)
+			inline_funcs[id] = *instrs;
+	}
+
+	// inlining a function that reaches itself through calls to other functions
+	// that are inlined would never end
+	std::function<bool(bytecode_t, bytecode_t, std::unordered_set<bytecode_t>&)> reaches =
+		[&](bytecode_t from, bytecode_t to, std::unordered_set<bytecode_t>& visited) {
+			if (!visited.insert(from).second)
+				return false;
+
+			for (auto const& instr : inline_funcs[from])
+			{
+				if (instr.type != BytecodeType::CALL || !inline_funcs.contains(instr.operands[0]))
+					continue;
+
+				if (instr.operands[0] == to || reaches(instr.operands[0], to, visited))
+					return true;
+			}
+
+			return false;
+		};
+
+	std::vector<bytecode_t> recursive_funcs;
+	for (auto const& [id, instrs] : inline_funcs)
+	{
+		std::unordered_set<bytecode_t> visited;
+		if (reaches(id, id, visited))
+			recursive_funcs.push_back(id);
+	}
+
+	for (auto id : recursive_funcs)
+		inline_funcs.erase(id);
+
+	return inline_funcs;
+}
+
+bool inline_calls(
+	std::vector<Instruction>& instrs,
+	std::unordered_map<bytecode_t, std::vector<Instruction>> const& inline_funcs)
+{
+	std::vector<Instruction> inlined;
+
+	// jumps of the inlined functions already have their new targets
+	std::vector<bool> is_inlined;
+
+	// index in the inlined instructions of each instruction
+	std::vector<std::size_t> new_indices(instrs.size() + 1);
+	bool changed = false;
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		new_indices[i] = inlined.size();
+
+		if (instrs[i].type != BytecodeType::CALL || !inline_funcs.contains(instrs[i].operands[0]))
+		{
+			inlined.push_back(instrs[i]);
+			is_inlined.push_back(false);
+			continue;
+		}
+
+		auto id = instrs[i].operands[0];
+		auto const& param_ids = InterpreterScope::funcs[id].param_ids;
+		auto const& func_instrs = inline_funcs.at(id);
+
+		// the last argument is on top of the stack
+		for (int j = (int)param_ids.size() - 1; j >= 0; --j)
+		{
+			inlined.push_back(Instruction{ BytecodeType::STORE, 0, { param_ids[j] }, 0 });
+			is_inlined.push_back(true);
+		}
+
+		auto start = inlined.size();
+
+		for (auto instr : func_instrs)
+		{
+			if (instr.type == BytecodeType::RETURN)
+				instr = Instruction{ BytecodeType::JUMP, 0, {}, func_instrs.size() };
+
+			for_each_target(instr, [&](std::size_t& target) { target += start; });
+
+			inlined.push_back(instr);
+			is_inlined.push_back(true);
+		}
+
+		changed = true;
+	}
+
+	new_indices[instrs.size()] = inlined.size();
+
+	for (std::size_t i = 0; i < inlined.size(); ++i)
+	{
+		if (!is_inlined[i])
+			for_each_target(inlined[i], [&](std::size_t& target) { target = new_indices[target]; });
+	}
+
+	instrs = inlined;
+	return changed;
+}
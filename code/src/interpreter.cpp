@@ -1,14 +1,38 @@
 #include "interpreter.hpp"
 #include "interpreter_scope.hpp"
+#include "kernel.hpp"
 #include "error.hpp"
 #include "debug.hpp"
 
 #include <iostream>
 #include <cmath>
 #include <stack>
+#include <vector>
 #include <optional>
 #include <cstring>
 #include <assert.h>
+#include <limits>
+
+std::optional<EvalLimit> eval_limit = std::nullopt;
+std::vector<uint64_t> profile_counts;
+
+static void take_step()
+{
+	if (!eval_limit.has_value())
+		return;
+
+	if (eval_limit->steps == 0)
+		throw EvalAbort{ true };
+
+	--eval_limit->steps;
+}
+
+// division by zero, and the one division that overflows, stop the program
+static void check_division(int64_t lhs, int64_t rhs)
+{
+	if (eval_limit.has_value() && (rhs == 0 || (rhs == -1 && lhs == std::numeric_limits<int64_t>::min())))
+		throw EvalAbort();
+}
 
 std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecodes_t const& codes)
 {
@@ -47,35 +71,49 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 			s.emplace((int64_t)!pop(s).f);
 			break;
 
-		case BytecodeType::ADD_I:
-			s.emplace(pop(s).i + pop(s).i);
+		case BytecodeType::ADD_I: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).i + s2.i);
 			break;
-		case BytecodeType::ADD_F:
-			s.emplace(pop(s).f + pop(s).f);
+		}
+		case BytecodeType::ADD_F: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).f + s2.f);
 			break;
+		}
 		case BytecodeType::ADD_S: {
 			auto s2 = pop(s);
 			s.emplace(pop(s).s + s2.s);
 			break;
 		}
 
-		case BytecodeType::SUB_I:
-			s.emplace(-pop(s).i + pop(s).i);
+		case BytecodeType::SUB_I: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).i - s2.i);
 			break;
-		case BytecodeType::SUB_F:
-			s.emplace(-pop(s).f + pop(s).f);
+		}
+		case BytecodeType::SUB_F: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).f - s2.f);
 			break;
+		}
 
-		case BytecodeType::MULT_I:
-			s.emplace(pop(s).i * pop(s).i);
+		case BytecodeType::MULT_I: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).i * s2.i);
 			break;
-		case BytecodeType::MULT_F:
-			s.emplace(pop(s).f * pop(s).f);
+		}
+		case BytecodeType::MULT_F: {
+			auto s2 = pop(s);
+			s.emplace(pop(s).f * s2.f);
 			break;
+		}
 
 		case BytecodeType::DIV_I: {
 			auto s2 = pop(s);
-			s.emplace(pop(s).i / s2.i);
+			auto s1 = pop(s);
+			check_division(s1.i, s2.i);
+			s.emplace(s1.i / s2.i);
 			break;
 		}
 		case BytecodeType::DIV_F: {
@@ -85,50 +123,116 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 		}
 		case BytecodeType::MOD_I: {
 			auto s2 = pop(s);
-			s.emplace(pop(s).i % s2.i);
+			auto s1 = pop(s);
+			check_division(s1.i, s2.i);
+			s.emplace(s1.i % s2.i);
 			break;
 		}
 
-		// stack values are in opposite order, so we switch signs to account for that
-		case BytecodeType::LESSER_I:
-			s.emplace(int64_t(pop(s).i > pop(s).i));
+		case BytecodeType::SHIFT_LEFT_I: {
+			auto shift = *(++it);
+			s.emplace((int64_t)((uint64_t)pop(s).i << shift));
 			break;
-		case BytecodeType::LESSER_F:
-			s.emplace(int64_t(pop(s).f > pop(s).f));
+		}
+		case BytecodeType::DIV_POW2_I: {
+			auto shift = *(++it);
+			auto val = pop(s).i;
+
+			// negative values are biased so the shift rounds towards zero like division
+			auto bias = (val >> 63) & (((int64_t)1 << shift) - 1);
+			s.emplace((val + bias) >> shift);
 			break;
-		case BytecodeType::LESSER_S:
-			s.emplace(int64_t(pop(s).s < pop(s).s));
+		}
+		case BytecodeType::MOD_POW2_I: {
+			auto mask = ((int64_t)1 << *(++it)) - 1;
+			auto val = pop(s).i;
+
+			// negative values keep their sign like the remainder of division
+			auto bias = (val >> 63) & mask;
+			s.emplace(((val + bias) & mask) - bias);
 			break;
+		}
+		case BytecodeType::DIV_MAGIC_I: {
+			auto magic = get_int<int64_t>(++it);
+			auto shift = *(++it);
 
-		case BytecodeType::GREATER_I:
-			s.emplace(int64_t(pop(s).i < pop(s).i));
+			s.emplace(div_magic(pop(s).i, magic, shift));
 			break;
-		case BytecodeType::GREATER_F:
-			s.emplace(int64_t(pop(s).f < pop(s).f));
+		}
+		case BytecodeType::MOD_MAGIC_I: {
+			auto magic = get_int<int64_t>(++it);
+			auto shift = *(++it);
+			auto divisor = get_int<int64_t>(++it);
+
+			auto val = pop(s).i;
+			s.emplace(val - div_magic(val, magic, shift) * divisor);
 			break;
-		case BytecodeType::GREATER_S:
-			s.emplace(int64_t(pop(s).s > pop(s).s));
+		}
+
+		// the right operand is on top of the stack, so it is popped first
+		case BytecodeType::LESSER_I: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i < s2.i));
 			break;
+		}
+		case BytecodeType::LESSER_F: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).f < s2.f));
+			break;
+		}
+		case BytecodeType::LESSER_S: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).s < s2.s));
+			break;
+		}
 
-		case BytecodeType::LESSER_EQUALS_I:
-			s.emplace((int64_t)(pop(s).i >= pop(s).i));
+		case BytecodeType::GREATER_I: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i > s2.i));
 			break;
-		case BytecodeType::LESSER_EQUALS_F:
-			s.emplace((int64_t)(pop(s).f >= pop(s).f));
+		}
+		case BytecodeType::GREATER_F: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).f > s2.f));
 			break;
-		case BytecodeType::LESSER_EQUALS_S:
-			s.emplace((int64_t)(pop(s).s >= pop(s).s));
+		}
+		case BytecodeType::GREATER_S: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).s > s2.s));
 			break;
+		}
 
-		case BytecodeType::GREATER_EQUALS_I:
-			s.emplace((int64_t)(pop(s).i <= pop(s).i));
+		case BytecodeType::LESSER_EQUALS_I: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i <= s2.i));
 			break;
-		case BytecodeType::GREATER_EQUALS_F:
-			s.emplace((int64_t)(pop(s).f <= pop(s).f));
+		}
+		case BytecodeType::LESSER_EQUALS_F: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).f <= s2.f));
 			break;
-		case BytecodeType::GREATER_EQUALS_S:
-			s.emplace((int64_t)(pop(s).s <= pop(s).s));
+		}
+		case BytecodeType::LESSER_EQUALS_S: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).s <= s2.s));
+			break;
+		}
+
+		case BytecodeType::GREATER_EQUALS_I: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i >= s2.i));
+			break;
+		}
+		case BytecodeType::GREATER_EQUALS_F: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).f >= s2.f));
+			break;
+		}
+		case BytecodeType::GREATER_EQUALS_S: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).s >= s2.s));
 			break;
+		}
 
 		case BytecodeType::EQUALS_I:
 			s.emplace(int64_t(pop(s).i == pop(s).i));
@@ -140,20 +244,47 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 			s.emplace(int64_t(pop(s).s == pop(s).s));
 			break;
 
-		case BytecodeType::AND:
-			s.emplace(int64_t(pop(s).i && pop(s).i));
+		case BytecodeType::NOT_EQUALS_I:
+			s.emplace(int64_t(pop(s).i != pop(s).i));
+			break;
+		case BytecodeType::NOT_EQUALS_F:
+			s.emplace(int64_t(pop(s).f != pop(s).f));
+			break;
+		case BytecodeType::NOT_EQUALS_S:
+			s.emplace(int64_t(pop(s).s != pop(s).s));
+			break;
+
+		case BytecodeType::AND: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i && s2.i));
 			break;
-		case BytecodeType::OR:
-			s.emplace(int64_t(pop(s).i || pop(s).i));
+		}
+		case BytecodeType::OR: {
+			auto s2 = pop(s);
+			s.emplace(int64_t(pop(s).i || s2.i));
 			break;
+		}
 
 		case BytecodeType::SUBSCRIPT:
-			push_subscript(s);
+			push_subscript(s, true);
+			break;
+		case BytecodeType::SUBSCRIPT_UNCHECKED:
+			push_subscript(s, false);
 			break;
 
 		case BytecodeType::ALLOCATE: {
 			auto size = pop(s);
 			auto expr = pop(s);
+
+			if (eval_limit.has_value())
+			{
+				if (size.i < 0)
+					throw EvalAbort();
+				if ((uint64_t)size.i > eval_limit->steps)
+					throw EvalAbort{ true };
+				eval_limit->steps -= size.i;
+			}
+
 			s.emplace(std::vector<intpr::Value>(size.i, expr));
 			break;
 		}
@@ -173,15 +304,26 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 			scope.vars[*(++it)] = pop(s);
 			break;
 
-		case BytecodeType::SET_INDEX: {
+		case BytecodeType::STORE_KEEP:
+			scope.vars[*(++it)] = s.top();
+			break;
+
+		case BytecodeType::SET_INDEX:
+		case BytecodeType::SET_INDEX_UNCHECKED: {
+			bool is_checked = (BytecodeType)*it == BytecodeType::SET_INDEX;
 			auto expr = pop(s);
 			auto id = *(++it);
+			auto count = *(++it);
+
+			// the last index is on top of the stack
+			std::vector<int64_t> indices(count);
+			for (int i = count - 1; i >= 0; --i)
+				indices[i] = pop(s).i;
+
 			intpr::Value* val = &scope.vars[id];
-			while (!s.empty())
-			{
-				auto i = pop(s).i;
-				val = &val->v[i];
-			}
+			for (auto i : indices)
+				val = is_checked ? &val->v.at(i) : &val->v[i];
+
 			*val = expr;
 			break;
 		}
@@ -189,16 +331,137 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 		case BytecodeType::JUMP_IF_FALSE: {
 			auto offset = pop(s).i;
 			if (!pop(s).i)
+			{
+				if (offset < 0)
+					take_step();
+				std::advance(it, offset);
+			}
+			break;
+		}
+		case BytecodeType::JUMP_IF_TRUE: {
+			auto offset = pop(s).i;
+			if (pop(s).i)
+			{
+				if (offset < 0)
+					take_step();
 				std::advance(it, offset);
+			}
+			break;
+		}
+
+		case BytecodeType::JUMP: {
+			auto offset = get_fixed_int<uint32_t>(it);
+			std::advance(it, offset);
+			break;
+		}
+		case BytecodeType::NJUMP: {
+			auto offset = get_fixed_int<uint32_t>(it);
+			take_step();
+			std::advance(it, -(int64_t)offset);
+			break;
+		}
+
+		case BytecodeType::TABLE_SWITCH: {
+			auto val = pop(s).i;
+			auto low = get_fixed_int<int64_t>(it);
+			auto count = get_fixed_int<uint16_t>(it);
+			auto offset = get_fixed_int<int32_t>(it);
+
+			auto table = it;
+			std::advance(it, 4 * count);
+
+			if (val >= low && (uint64_t)val - (uint64_t)low < count)
+			{
+				std::advance(table, 4 * ((uint64_t)val - (uint64_t)low));
+				offset = get_fixed_int<int32_t>(table);
+			}
+
+			if (offset < 0)
+				take_step();
+			std::advance(it, offset);
 			break;
 		}
+		case BytecodeType::LOOKUP_SWITCH: {
+			auto val = pop(s).i;
+			auto count = get_fixed_int<uint16_t>(it);
+			auto offset = get_fixed_int<int32_t>(it);
+
+			auto cases = it;
+			std::advance(it, 12 * count);
+
+			// each case is a key and its offset
+			std::size_t low = 0, high = count;
+			while (low < high)
+			{
+				auto mid = low + (high - low) / 2;
+				auto entry = cases + 12 * mid;
+				auto key = get_fixed_int<int64_t>(entry);
+
+				if (key < val)
+				{
+					low = mid + 1;
+				}
+				else if (key > val)
+				{
+					high = mid;
+				}
+				else
+				{
+					offset = get_fixed_int<int32_t>(entry);
+					break;
+				}
+			}
+
+			if (offset < 0)
+				take_step();
+			std::advance(it, offset);
+			break;
+		}
+
+		case BytecodeType::VECTOR_MAP:
+		case BytecodeType::VECTOR_SUM: {
+			bool is_map = (BytecodeType)*it == BytecodeType::VECTOR_MAP;
+			auto count = *(++it);
+			auto length = *(++it);
+
+			bytecodes_t program(it + 1, it + 1 + length);
+			std::advance(it, length);
+
+			std::vector<intpr::Value> operands(count);
+			for (int i = count - 1; i >= 0; --i)
+				operands[i] = pop(s);
+
+			auto end = pop(s).i;
+			auto start = pop(s).i;
+
+			// each index is an iteration of the loop the kernel replaces
+			if (eval_limit.has_value() && start < end)
+			{
+				if ((uint64_t)end - (uint64_t)start > eval_limit->steps)
+					throw EvalAbort{ true };
+				eval_limit->steps -= (uint64_t)end - (uint64_t)start;
+			}
 
-		case BytecodeType::JUMP:
-			std::advance(it, *(++it));
+			if (is_map)
+			{
+				vector_map(operands, start, end, program);
+				s.push(operands[0]);
+			}
+			else
+			{
+				s.push(vector_sum(operands, start, end, program));
+			}
 			break;
-		case BytecodeType::NJUMP:
-			std::advance(it, -(*(++it)));
+		}
+
+		case BytecodeType::COUNT: {
+			auto counter = get_fixed_int<uint32_t>(it);
+
+			// code run while compiling is not part of the profile
+			if (!eval_limit.has_value())
+				++profile_counts[counter];
 			break;
+		}
 
 		case BytecodeType::RETURN:
 			if (s.empty())
@@ -222,7 +485,7 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 				break;
 			}
 			case 6: {
-				s.emplace(std::string(1, char(pop(s).i)));
+				// chars are stored as ints, so char(int) does nothing
 				break;
 			}
 			case 7: {
@@ -246,14 +509,44 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 				break;
 			}
 			default: {
+				auto& func = InterpreterScope::funcs[id];
+
+				// the last argument is on top of the stack
+				std::vector<intpr::Value> args(func.param_ids.size());
+				for (int i = (int)args.size() - 1; i >= 0; --i)
+					args[i] = pop(s);
+
+				if (func.memo.has_value())
+				{
+					if (auto result = func.memo->find(args))
+					{
+						s.push(*result);
+						break;
+					}
+				}
+
 				InterpreterScope func_scope{ scope.vars };
+				for (std::size_t i = 0; i < args.size(); ++i)
+					func_scope.vars[func.param_ids[i]] = args[i];
+
+				if (eval_limit.has_value())
+				{
+					take_step();
+					if (++eval_limit->depth > eval_limit->max_depth)
+						throw EvalAbort();
+				}
 
-				for (int i = 0; i < scope.funcs[id].param_ids.size(); ++i)
-					func_scope.vars[InterpreterScope::funcs[id].param_ids[i]] = pop(s);
+				auto rtn_value = interpret_bytecodes(func_scope, func.codes);
 
-				auto rtn_value = interpret_bytecodes(func_scope, InterpreterScope::funcs[id].codes);
+				if (eval_limit.has_value())
+					--eval_limit->depth;
 				if (rtn_value.has_value())
+				{
+					if (func.memo.has_value())
+						func.memo->insert(args, *rtn_value);
+
 					s.push(*rtn_value);
+				}
 
 				break;
 			}
@@ -262,6 +555,10 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 			break;
 		}
 
+		case BytecodeType::POP:
+			s.pop();
+			break;
+
 		default:
 			throw debug::unhandled_case(*it);
 		}
@@ -270,6 +567,69 @@ std::optional<intpr::Value> interpret_bytecodes(InterpreterScope& scope, bytecod
 	return std::nullopt;
 }
 
+int64_t mult_high(int64_t a, int64_t b)
+{
+	uint64_t ua = a, ub = b;
+
+	// unsigned multiplication of 32 bit halves
+	uint64_t lo_lo = (ua & 0xFFFFFFFF) * (ub & 0xFFFFFFFF);
+	uint64_t hi_lo = (ua >> 32) * (ub & 0xFFFFFFFF);
+	uint64_t lo_hi = (ua & 0xFFFFFFFF) * (ub >> 32);
+	uint64_t hi_hi = (ua >> 32) * (ub >> 32);
+
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	uint64_t high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+
+	// corrects the unsigned result for negative operands
+	if (a < 0) high -= ub;
+	if (b < 0) high -= ua;
+
+	return (int64_t)high;
+}
+
+std::pair<int64_t, int> division_magic(int64_t divisor)
+{
+	assert(divisor >= 2);
+
+	// Hacker's Delight, signed division by a positive constant
+	uint64_t const two63 = (uint64_t)1 << 63;
+	uint64_t const d = divisor;
+
+	uint64_t anc = two63 - 1 - two63 % d;
+	int p = 63;
+
+	uint64_t q1 = two63 / anc, r1 = two63 - q1 * anc;
+	uint64_t q2 = two63 / d,   r2 = two63 - q2 * d;
+	uint64_t delta;
+
+	do {
+		++p;
+
+		q1 *= 2; r1 *= 2;
+		if (r1 >= anc) { ++q1; r1 -= anc; }
+
+		q2 *= 2; r2 *= 2;
+		if (r2 >= d) { ++q2; r2 -= d; }
+
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	return { (int64_t)(q2 + 1), p - 64 };
+}
+
+int64_t div_magic(int64_t val, int64_t magic, int shift)
+{
+	auto quotient = mult_high(magic, val);
+
+	if (magic < 0)
+		quotient = (int64_t)((uint64_t)quotient + (uint64_t)val);
+
+	quotient >>= shift;
+
+	// rounds towards zero for negative values
+	return quotient + (int64_t)((uint64_t)quotient >> 63);
+}
+
 void push_float(std::stack<intpr::Value>& s, bytecodes_t::const_iterator& it)
 {
 	int count;
@@ -310,24 +670,25 @@ void push_arr(std::stack<intpr::Value>& s, bytecodes_t::const_iterator& it)
 {
 	bytecode_t size = *(++it);
 
-	std::vector<intpr::Value> v;
-	for (int i = 0; i < size; ++i)
-		v.push_back(pop(s));
+	// the last element is on top of the stack
+	std::vector<intpr::Value> v(size);
+	for (int i = size - 1; i >= 0; --i)
+		v[i] = pop(s);
 
 	s.emplace(v);
 }
 
-void push_subscript(std::stack<intpr::Value>& s)
+void push_subscript(std::stack<intpr::Value>& s, bool is_checked)
 {
 	auto container = pop(s);
 	auto index = pop(s);
 
 	if (container.type == intpr::ValueType::ARR)
-		s.emplace(container.v.at(index.i));
+		s.emplace(is_checked ? container.v.at(index.i) : container.v[index.i]);
 	else if (container.type == intpr::ValueType::PTR)
-		s.emplace(container.p->v[index.i]);
+		s.emplace(is_checked ? container.p->v.at(index.i) : container.p->v[index.i]);
 	else if (container.type == intpr::ValueType::STR)
-		s.emplace(int64_t(container.s.at(index.i)));
+		s.emplace(int64_t(is_checked ? container.s.at(index.i) : container.s[index.i]));
 	else
 		throw debug::unhandled_case((int)container.type);
 }
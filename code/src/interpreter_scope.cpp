@@ -1,4 +1,6 @@
 #include "interpreter_scope.hpp"
+
+#include <bit>
 #include <string>
 
 func_container InterpreterScope::funcs = {};
@@ -21,4 +23,101 @@ intpr::Value::Value(Value* _p)
 intpr::Value::Value(Value const& _v)
 	: type(_v.type), i(_v.i), f(_v.f), s(_v.s), v(_v.v), p(_v.p) {}
 
-int InterpreterScope::new_id() { static int id = 7; return ++id; }
\ No newline at end of file
+int InterpreterScope::new_id() { static int id = 7; return ++id; }
+
+MemoTable::MemoTable(std::size_t _arity)
+	: hits(0), misses(0), arity(_arity), result_count(0), keys(16 * _arity), results(16) {}
+
+intpr::Value const* MemoTable::find(std::vector<intpr::Value> const& args)
+{
+	auto const& result = results[find_slot(args)];
+	if (!result.has_value())
+	{
+		++misses;
+		return nullptr;
+	}
+
+	++hits;
+	return &*result;
+}
+
+void MemoTable::insert(std::vector<intpr::Value> const& args, intpr::Value const& result)
+{
+	if (result_count == max_results)
+		return;
+
+	if (2 * (result_count + 1) > results.size())
+		grow();
+
+	auto slot = find_slot(args);
+	if (results[slot].has_value())
+		return;
+
+	for (std::size_t i = 0; i < arity; ++i)
+		keys[slot * arity + i] = key_of(args[i]);
+
+	results[slot] = result;
+	++result_count;
+}
+
+std::size_t MemoTable::size() const
+{
+	return result_count;
+}
+
+int64_t MemoTable::key_of(intpr::Value const& arg)
+{
+	if (arg.type == intpr::ValueType::FLOAT)
+		return std::bit_cast<int32_t>(arg.f);
+
+	return arg.i;
+}
+
+std::size_t MemoTable::find_slot(std::vector<intpr::Value> const& args) const
+{
+	// FNV-1a over the keys
+	uint64_t hash = 14695981039346656037ull;
+	for (auto const& arg : args)
+	{
+		hash ^= (uint64_t)key_of(arg);
+		hash *= 1099511628211ull;
+	}
+
+	// the number of slots is a power of two
+	auto mask = results.size() - 1;
+	for (auto slot = (std::size_t)(hash ^ (hash >> 32)) & mask; ; slot = (slot + 1) & mask)
+	{
+		if (!results[slot].has_value())
+			return slot;
+
+		bool is_match = true;
+		for (std::size_t i = 0; i < arity && is_match; ++i)
+			is_match = keys[slot * arity + i] == key_of(args[i]);
+
+		if (is_match)
+			return slot;
+	}
+}
+
+void MemoTable::grow()
+{
+	auto old_keys = std::move(keys);
+	auto old_results = std::move(results);
+
+	keys.assign(2 * old_keys.size(), 0);
+	results.assign(2 * old_results.size(), std::nullopt);
+
+	std::vector<intpr::Value> args(arity);
+	for (std::size_t slot = 0; slot < old_results.size(); ++slot)
+	{
+		if (!old_results[slot].has_value())
+			continue;
+
+		for (std::size_t i = 0; i < arity; ++i)
+			args[i] = intpr::Value((int64_t)old_keys[slot * arity + i]);
+
+		auto new_slot = find_slot(args);
+		std::copy(std::begin(old_keys) + slot * arity, std::begin(old_keys) + (slot + 1) * arity, std::begin(keys) + new_slot * arity);
+		results[new_slot] = std::move(old_results[slot]);
+	}
+}
@@ -0,0 +1,1235 @@
+#include "ir.hpp"
+#include "peephole.hpp"
+#include "parser_scope.hpp"
+#include "symbols.hpp"
+#include "ast/expression.hpp"
+#include "bytecode.hpp"
+#include "error.hpp"
+#include "debug.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <optional>
+#include <string>
+#include <cstring>
+#include <ostream>
+#include <assert.h>
+
+bool ir::print_ir = false;
+
+ir::Builder::Builder(Module& _module, Function& _func)
+	: module(_module), func(_func), current(0)
+{
+	if (func.blocks.empty())
+		func.blocks.emplace_back();
+}
+
+ir::value_t ir::Builder::constant(ValueType::PrimType type, int64_t val)
+{
+	assert(type == ValueType::BOOL || type == ValueType::CHAR || type == ValueType::INT);
+
+	Instruction instr{ Op::CONST, create_value(type) };
+	instr.constant = val;
+
+	return *insert(instr).result;
+}
+
+ir::value_t ir::Builder::constant(float val)
+{
+	Instruction instr{ Op::CONST, create_value(ValueType::FLOAT) };
+	instr.constant = val;
+
+	return *insert(instr).result;
+}
+
+ir::value_t ir::Builder::constant(std::string const& val)
+{
+	Instruction instr{ Op::CONST, create_value(ValueType::STR) };
+	instr.constant = val;
+
+	return *insert(instr).result;
+}
+
+ir::value_t ir::Builder::load(bytecode_t var_id, ValueType const& type)
+{
+	Instruction instr{ Op::LOAD, create_value(type) };
+	instr.id = var_id;
+
+	return *insert(instr).result;
+}
+
+void ir::Builder::store(bytecode_t var_id, value_t value)
+{
+	Instruction instr{ Op::STORE, std::nullopt, { value } };
+	instr.id = var_id;
+
+	insert(instr);
+}
+
+void ir::Builder::set_index(bytecode_t var_id, std::vector<value_t> const& indices, value_t value)
+{
+	Instruction instr{ Op::SET_INDEX, std::nullopt, indices };
+	instr.operands.push_back(value);
+	instr.id = var_id;
+
+	insert(instr);
+}
+
+std::optional<ir::value_t> ir::Builder::call(bytecode_t func_id, std::vector<value_t> const& args, std::optional<ValueType> const& rtn_type, bool is_pure)
+{
+	Instruction instr{ Op::CALL, std::nullopt, args };
+	instr.id = func_id;
+	instr.is_pure = is_pure;
+
+	if (rtn_type.has_value())
+		instr.result = create_value(*rtn_type);
+
+	return insert(instr).result;
+}
+
+ir::value_t ir::Builder::op(BytecodeType code, std::vector<value_t> const& operands, ValueType const& type, bytecodes_t const& immediates)
+{
+	Instruction instr{ Op::BYTECODE, create_value(type), operands };
+	instr.code = code;
+	instr.immediates = immediates;
+
+	return *insert(instr).result;
+}
+
+ir::value_t ir::Builder::phi(ValueType const& type, std::vector<std::pair<block_t, value_t>> const& incoming)
+{
+	Instruction instr{ Op::PHI, create_value(type) };
+	for (auto const& [block, value] : incoming)
+	{
+		instr.blocks.push_back(block);
+		instr.operands.push_back(value);
+	}
+
+	instr.loc = loc;
+
+	auto& instrs = func.blocks[current].instrs;
+	auto it = std::find_if(std::begin(instrs), std::end(instrs),
+		[](Instruction const& instr) { return instr.op != Op::PHI; });
+
+	return *instrs.insert(it, instr)->result;
+}
+
+ir::block_t ir::Builder::create_block()
+{
+	func.blocks.emplace_back();
+	return func.blocks.size() - 1;
+}
+
+void ir::Builder::set_block(block_t block)
+{
+	assert(block < func.blocks.size());
+	current = block;
+}
+
+ir::block_t ir::Builder::get_block() const
+{
+	return current;
+}
+
+void ir::Builder::jump(block_t block)
+{
+	terminate({ TerminatorType::JUMP, std::nullopt, block, block });
+}
+
+void ir::Builder::branch(value_t cond, block_t true_block, block_t false_block)
+{
+	terminate({ TerminatorType::BRANCH, cond, true_block, false_block });
+}
+
+void ir::Builder::ret(std::optional<value_t> const& value)
+{
+	terminate({ TerminatorType::RETURN, value, 0, 0 });
+}
+
+ValueType const& ir::Builder::type_of(value_t value) const
+{
+	return func.value_types.at(value);
+}
+
+ir::value_t ir::Builder::create_value(ValueType const& type)
+{
+	func.value_types.push_back(type);
+	return func.value_types.size() - 1;
+}
+
+ir::Instruction& ir::Builder::insert(Instruction const& instr)
+{
+	if (func.blocks[current].terminator.has_value())
+		current = create_block();
+
+	auto& inserted = func.blocks[current].instrs.emplace_back(instr);
+	inserted.loc = loc;
+
+	return inserted;
+}
+
+void ir::Builder::terminate(Terminator const& terminator)
+{
+	if (func.blocks[current].terminator.has_value())
+		current = create_block();
+
+	func.blocks[current].terminator = terminator;
+}
+
+
+bool ir::has_side_effects(Instruction const& instr)
+{
+	switch (instr.op)
+	{
+	case Op::STORE:
+	case Op::SET_INDEX:
+		return true;
+	case Op::CALL:
+		return !instr.is_pure;
+	default:
+		return false;
+	}
+}
+
+bool ir::can_fail(Instruction const& instr)
+{
+	switch (instr.op)
+	{
+	case Op::SET_INDEX:
+		return !instr.in_bounds;
+
+	// int() fails on strings that are not numbers
+	case Op::CALL:
+		return true;
+
+	case Op::BYTECODE:
+		switch (instr.code)
+		{
+		case BytecodeType::DIV_I:
+		case BytecodeType::MOD_I:
+		case BytecodeType::SUBSCRIPT:
+		case BytecodeType::ALLOCATE:
+		case BytecodeType::VECTOR_MAP:
+		case BytecodeType::VECTOR_SUM:
+			return true;
+		default:
+			return false;
+		}
+
+	default:
+		return false;
+	}
+}
+
+// the successors of a branch are swapped if by_count is true and its false block
+// ran more times than its true block
+static std::vector<ir::block_t> reverse_postorder(ir::Function const& func, bool by_count)
+{
+	using namespace ir;
+
+	std::vector<block_t> postorder;
+	std::vector<bool> visited(func.blocks.size(), false);
+
+	std::function<void(block_t)> visit = [&](block_t block) {
+		visited[block] = true;
+
+		// successors are visited last to first, so the first successor ends up
+		// right after the block
+		auto succs = successors(func.blocks[block]);
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (by_count && terminator.has_value() && terminator->type == TerminatorType::BRANCH &&
+			func.blocks[terminator->false_block].count.value_or(0) > func.blocks[terminator->true_block].count.value_or(0))
+			std::swap(succs[0], succs[1]);
+
+		for (auto it = std::rbegin(succs); it != std::rend(succs); ++it)
+		{
+			if (!visited[*it])
+				visit(*it);
+		}
+
+		postorder.push_back(block);
+	};
+
+	if (!func.blocks.empty())
+		visit(0);
+
+	return std::vector<block_t>(std::rbegin(postorder), std::rend(postorder));
+}
+
+std::vector<ir::block_t> ir::reverse_postorder(Function const& func)
+{
+	return ::reverse_postorder(func, false);
+}
+
+std::vector<ir::block_t> ir::layout_order(Function const& func)
+{
+	return ::reverse_postorder(func, true);
+}
+
+std::vector<ir::block_t> ir::successors(BasicBlock const& block)
+{
+	if (!block.terminator.has_value())
+		return {};
+
+	switch (block.terminator->type)
+	{
+	case TerminatorType::JUMP:
+		return { block.terminator->true_block };
+	case TerminatorType::BRANCH:
+		return { block.terminator->true_block, block.terminator->false_block };
+	case TerminatorType::RETURN:
+		return {};
+	case TerminatorType::SWITCH: {
+		std::vector<block_t> succs;
+		for (auto const& [key, block] : block.terminator->cases)
+		{
+			if (std::find(std::begin(succs), std::end(succs), block) == std::end(succs))
+				succs.push_back(block);
+		}
+
+		if (std::find(std::begin(succs), std::end(succs), block.terminator->false_block) == std::end(succs))
+			succs.push_back(block.terminator->false_block);
+
+		return succs;
+	}
+	default:
+		throw debug::unhandled_case((int)block.terminator->type);
+	}
+}
+
+std::vector<std::vector<ir::block_t>> ir::predecessors(Function const& func)
+{
+	std::vector<std::vector<block_t>> preds(func.blocks.size());
+
+	for (auto block : reverse_postorder(func))
+	{
+		for (auto succ : successors(func.blocks[block]))
+		{
+			if (std::find(std::begin(preds[succ]), std::end(preds[succ]), block) == std::end(preds[succ]))
+				preds[succ].push_back(block);
+		}
+	}
+
+	return preds;
+}
+
+std::vector<std::optional<ir::block_t>> ir::dominators(Function const& func)
+{
+	auto order = reverse_postorder(func);
+	auto preds = predecessors(func);
+
+	std::vector<std::optional<block_t>> idoms(func.blocks.size());
+	if (order.empty())
+		return idoms;
+
+	std::vector<std::size_t> order_indices(func.blocks.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order_indices[order[i]] = i;
+
+	// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+	auto intersect = [&](block_t a, block_t b) {
+		while (a != b)
+		{
+			while (order_indices[a] > order_indices[b])
+				a = *idoms[a];
+			while (order_indices[b] > order_indices[a])
+				b = *idoms[b];
+		}
+
+		return a;
+	};
+
+	idoms[order[0]] = order[0];
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (std::size_t i = 1; i < order.size(); ++i)
+		{
+			std::optional<block_t> idom;
+			for (auto pred : preds[order[i]])
+			{
+				if (idoms[pred].has_value())
+					idom = idom.has_value() ? intersect(pred, *idom) : pred;
+			}
+
+			if (idoms[order[i]] != idom)
+			{
+				idoms[order[i]] = idom;
+				changed = true;
+			}
+		}
+	}
+
+	return idoms;
+}
+
+ir::DominatorTree::DominatorTree(Function const& func)
+	: idoms(dominators(func)), entries(func.blocks.size()), exits(func.blocks.size())
+{
+	std::vector<std::vector<block_t>> children(func.blocks.size());
+	for (auto block : reverse_postorder(func))
+	{
+		if (*idoms[block] != block)
+			children[*idoms[block]].push_back(block);
+	}
+
+	std::size_t time = 0;
+
+	// <block, index of its next child>
+	std::vector<std::pair<block_t, std::size_t>> walk;
+	if (!func.blocks.empty())
+	{
+		entries[0] = time++;
+		walk.push_back({ 0, 0 });
+	}
+
+	while (!walk.empty())
+	{
+		auto [block, next_child] = walk.back();
+		if (next_child == children[block].size())
+		{
+			exits[block] = time++;
+			walk.pop_back();
+			continue;
+		}
+
+		++walk.back().second;
+
+		auto child = children[block][next_child];
+		entries[child] = time++;
+		walk.push_back({ child, 0 });
+	}
+}
+
+bool ir::DominatorTree::dominates(block_t a, block_t b) const
+{
+	if (!idoms[a].has_value() || !idoms[b].has_value())
+		return a == b;
+
+	return entries[a] <= entries[b] && exits[b] <= exits[a];
+}
+
+std::vector<ir::Loop> ir::find_loops(Function const& func)
+{
+	auto order = reverse_postorder(func);
+	auto preds = predecessors(func);
+	DominatorTree doms(func);
+
+	std::vector<std::size_t> order_indices(func.blocks.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order_indices[order[i]] = i;
+
+	// an edge to a block that dominates it goes back to the header of a loop,
+	// <header, blocks the edges come from>
+	std::map<block_t, std::vector<block_t>> back_edges;
+	for (auto block : order)
+	{
+		for (auto header : successors(func.blocks[block]))
+		{
+			if (doms.dominates(header, block))
+				back_edges[header].push_back(block);
+		}
+	}
+
+	// the loop is every block that reaches one of its edges without going
+	// through the header, and each block is marked with the last header it was
+	// found from, so the blocks of a loop are only found once
+	std::vector<std::optional<block_t>> found_from(func.blocks.size());
+	std::vector<Loop> loops;
+
+	for (auto const& [header, sources] : back_edges)
+	{
+		Loop loop{ header };
+		loop.blocks.push_back(header);
+		found_from[header] = header;
+
+		std::vector<block_t> worklist(std::begin(sources), std::end(sources));
+		while (!worklist.empty())
+		{
+			auto curr = worklist.back();
+			worklist.pop_back();
+
+			if (found_from[curr] == header)
+				continue;
+
+			found_from[curr] = header;
+			loop.blocks.push_back(curr);
+			worklist.insert(std::end(worklist), std::begin(preds[curr]), std::end(preds[curr]));
+		}
+
+		std::sort(std::begin(loop.blocks), std::end(loop.blocks),
+			[&](block_t a, block_t b) { return order_indices[a] < order_indices[b]; });
+
+		loops.push_back(loop);
+	}
+
+	// an inner loop has fewer blocks than any loop containing it
+	std::stable_sort(std::begin(loops), std::end(loops),
+		[](Loop const& a, Loop const& b) { return a.blocks.size() < b.blocks.size(); });
+
+	return loops;
+}
+
+bool ir::change_loops(Function& func, std::function<bool(Loop const&, std::vector<Loop> const&)> const& change)
+{
+	bool changed = false;
+
+	bool loop_changed = true;
+	while (loop_changed)
+	{
+		loop_changed = false;
+
+		auto loops = find_loops(func);
+		std::vector<block_t> changed_headers;
+
+		for (auto const& loop : loops)
+		{
+			bool contains_changed = std::any_of(std::begin(changed_headers), std::end(changed_headers), [&](block_t header) {
+				return std::find(std::begin(loop.blocks), std::end(loop.blocks), header) != std::end(loop.blocks);
+			});
+
+			if (!contains_changed && change(loop, loops))
+			{
+				loop_changed = changed = true;
+				changed_headers.push_back(loop.header);
+			}
+		}
+	}
+
+	return changed;
+}
+
+std::optional<ir::block_t> ir::get_preheader(Function& func, Loop const& loop)
+{
+	auto preds = predecessors(func);
+
+	std::vector<block_t> outside_preds;
+	for (auto pred : preds[loop.header])
+	{
+		if (std::find(std::begin(loop.blocks), std::end(loop.blocks), pred) == std::end(loop.blocks))
+			outside_preds.push_back(pred);
+	}
+
+	if (outside_preds.empty())
+		return std::nullopt;
+
+	if (outside_preds.size() == 1 && successors(func.blocks[outside_preds[0]]).size() == 1)
+		return outside_preds[0];
+
+	auto const& header_instrs = func.blocks[loop.header].instrs;
+	if (!header_instrs.empty() && header_instrs[0].op == Op::PHI)
+		return std::nullopt;
+
+	func.blocks.emplace_back();
+
+	auto preheader = func.blocks.size() - 1;
+	func.blocks[preheader].terminator = { TerminatorType::JUMP, std::nullopt, loop.header, loop.header };
+
+	// the preheader runs once each time the loop is entered
+	if (func.blocks[loop.header].count.has_value())
+	{
+		func.blocks[preheader].count = 0;
+		for (auto pred : outside_preds)
+			*func.blocks[preheader].count += func.blocks[pred].count.value_or(0);
+	}
+
+	for (auto pred : outside_preds)
+	{
+		auto& terminator = *func.blocks[pred].terminator;
+
+		if (terminator.true_block == loop.header)
+			terminator.true_block = preheader;
+		if (terminator.false_block == loop.header)
+			terminator.false_block = preheader;
+
+		for (auto& [key, block] : terminator.cases)
+		{
+			if (block == loop.header)
+				block = preheader;
+		}
+	}
+
+	return preheader;
+}
+
+bool ir::is_used_outside(Function const& func, block_t block)
+{
+	std::vector<bool> defined_in_block(func.value_types.size(), false);
+	for (auto const& instr : func.blocks[block].instrs)
+	{
+		if (instr.result.has_value())
+			defined_in_block[*instr.result] = true;
+	}
+
+	for (block_t other = 0; other < func.blocks.size(); ++other)
+	{
+		if (other == block)
+			continue;
+
+		for (auto const& instr : func.blocks[other].instrs)
+		{
+			for (auto operand : instr.operands)
+			{
+				if (defined_in_block[operand])
+					return true;
+			}
+		}
+
+		auto const& terminator = func.blocks[other].terminator;
+		if (terminator.has_value() && terminator->value.has_value() && defined_in_block[*terminator->value])
+			return true;
+	}
+
+	return false;
+}
+
+bool ir::remove_unused_values(Function& func)
+{
+	bool changed = false;
+
+	// removing an instruction can leave its operands unused
+	bool removed = true;
+	while (removed)
+	{
+		removed = false;
+
+		std::vector<std::size_t> use_counts(func.value_types.size(), 0);
+		for (auto const& block : func.blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				for (auto operand : instr.operands)
+					++use_counts[operand];
+			}
+
+			if (block.terminator.has_value() && block.terminator->value.has_value())
+				++use_counts[*block.terminator->value];
+		}
+
+		for (auto& block : func.blocks)
+		{
+			auto it = std::remove_if(std::begin(block.instrs), std::end(block.instrs), [&](Instruction const& instr) {
+				return instr.result.has_value() && !use_counts[*instr.result] && instr.op != Op::PHI &&
+					!has_side_effects(instr) && !can_fail(instr);
+			});
+
+			if (it != std::end(block.instrs))
+			{
+				block.instrs.erase(it, std::end(block.instrs));
+				removed = changed = true;
+			}
+		}
+	}
+
+	return changed;
+}
+
+
+bytecodes_t ir::lower(Function& func)
+{
+	auto order = layout_order(func);
+	auto value_count = func.value_types.size();
+
+	// the instruction that defines each value, and the block it is in
+	std::vector<Instruction const*> defs(value_count, nullptr);
+	std::vector<block_t> def_blocks(value_count);
+
+	// number of uses of each value, and the block of the last use
+	std::vector<std::size_t> use_counts(value_count, 0);
+	std::vector<block_t> use_blocks(value_count);
+	std::vector<bool> used_by_phi(value_count, false);
+
+	for (auto block : order)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.result.has_value())
+			{
+				defs[*instr.result] = &instr;
+				def_blocks[*instr.result] = block;
+			}
+
+			for (auto operand : instr.operands)
+			{
+				++use_counts[operand];
+				use_blocks[operand] = block;
+				used_by_phi[operand] = used_by_phi[operand] || instr.op == Op::PHI;
+			}
+		}
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (terminator.has_value() && terminator->value.has_value())
+		{
+			++use_counts[*terminator->value];
+			use_blocks[*terminator->value] = block;
+		}
+	}
+
+	// values that stay on the stack between their definition and their use
+	std::vector<bool> on_stack(value_count, false);
+	for (value_t value = 0; value < value_count; ++value)
+	{
+		on_stack[value] = defs[value] && defs[value]->op != Op::CONST && defs[value]->op != Op::PHI &&
+			use_counts[value] == 1 && !used_by_phi[value] && use_blocks[value] == def_blocks[value];
+	}
+
+	// the operands left on the stack must be the first operands of their use, in
+	// the same order as on the stack, since the other operands are pushed after them
+	// values that are out of order are stored in variables instead
+	for (auto block : order)
+	{
+		std::vector<value_t> stack;
+
+		auto use = [&](std::vector<value_t> const& operands) {
+			auto count = std::min(operands.size(), stack.size());
+			while (count > 0 && !std::equal(std::begin(operands), std::begin(operands) + count, std::end(stack) - count))
+				--count;
+
+			for (auto it = std::begin(operands) + count; it != std::end(operands); ++it)
+			{
+				if (on_stack[*it])
+				{
+					on_stack[*it] = false;
+					stack.erase(std::find(std::begin(stack), std::end(stack), *it));
+				}
+			}
+
+			stack.resize(stack.size() - count);
+		};
+
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.op == Op::PHI)
+				continue;
+
+			use(instr.operands);
+
+			if (instr.result.has_value() && on_stack[*instr.result])
+				stack.push_back(*instr.result);
+		}
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (terminator.has_value() && terminator->value.has_value())
+			use({ *terminator->value });
+
+		assert(stack.empty());
+	}
+
+	// the other values, other than constants, are kept in new variables
+	auto needs_var = [&](value_t value) {
+		return defs[value] && defs[value]->op != Op::CONST && !on_stack[value] &&
+			(use_counts[value] || defs[value]->op == Op::PHI);
+	};
+
+	// values only used in the block that defines them share variables, since
+	// the variable of such a value is free after its last use
+	std::vector<bool> is_local(value_count, false);
+	for (value_t value = 0; value < value_count; ++value)
+		is_local[value] = needs_var(value) && defs[value]->op != Op::PHI && !used_by_phi[value];
+
+	for (auto block : order)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			for (auto operand : instr.operands)
+				is_local[operand] = is_local[operand] && def_blocks[operand] == block;
+		}
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (terminator.has_value() && terminator->value.has_value())
+			is_local[*terminator->value] = is_local[*terminator->value] && def_blocks[*terminator->value] == block;
+	}
+
+	// the variables are new to each function, so the codes of a function can be
+	// inlined into another without changing its variables
+	std::vector<std::optional<bytecode_t>> var_ids(value_count);
+	std::vector<bytecode_t> free_ids;
+
+	auto new_var_id = [&](value_t value) {
+		if (!free_ids.empty())
+		{
+			auto var_id = free_ids.back();
+			free_ids.pop_back();
+			return var_id;
+		}
+
+		if (ParserScope::next_var_id == bytecode_t_lim)
+		{
+			auto loc = defs[value]->loc.offset ? defs[value]->loc : func.loc;
+			throw night::error::get().create_fatal_error("only " + std::to_string(bytecode_t_lim) + " variables allowed", loc);
+		}
+
+		func.var_ids.push_back(ParserScope::next_var_id);
+		return ParserScope::next_var_id++;
+	};
+
+	for (value_t value = 0; value < value_count; ++value)
+	{
+		if (needs_var(value) && !is_local[value])
+			var_ids[value] = new_var_id(value);
+	}
+
+	for (auto block : order)
+	{
+		auto const& block_instrs = func.blocks[block].instrs;
+
+		// the last instruction of the block that uses each local value, where the
+		// terminator is after the instructions
+		std::unordered_map<value_t, std::size_t> last_uses;
+		for (std::size_t pos = 0; pos < block_instrs.size(); ++pos)
+		{
+			for (auto operand : block_instrs[pos].operands)
+			{
+				if (is_local[operand])
+					last_uses[operand] = pos;
+			}
+		}
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (terminator.has_value() && terminator->value.has_value() && is_local[*terminator->value])
+			last_uses[*terminator->value] = block_instrs.size();
+
+		// the operands of an instruction are loaded before its result is stored,
+		// so the result can have the variable of an operand
+		for (std::size_t pos = 0; pos < block_instrs.size(); ++pos)
+		{
+			for (auto operand : block_instrs[pos].operands)
+			{
+				auto last_use = last_uses.find(operand);
+				if (last_use != std::end(last_uses) && last_use->second == pos)
+				{
+					free_ids.push_back(*var_ids[operand]);
+					last_uses.erase(last_use);
+				}
+			}
+
+			auto const& result = block_instrs[pos].result;
+			if (result.has_value() && is_local[*result])
+				var_ids[*result] = new_var_id(*result);
+		}
+
+		for (auto const& [value, last_use] : last_uses)
+			free_ids.push_back(*var_ids[value]);
+	}
+
+	// targets of the jumps are labels until every block has been placed,
+	// the label of a block is its id, and the other labels come after
+	std::vector<::Instruction> instrs;
+	std::vector<std::size_t> labels(func.blocks.size());
+
+	auto emit = [&](BytecodeType type, bytecodes_t const& operands = {}) {
+		instrs.push_back({ type, 0, operands, 0 });
+	};
+
+	auto emit_jump = [&](BytecodeType type, std::size_t label) {
+		instrs.push_back({ type, 0, {}, label });
+	};
+
+	auto push_value = [&](value_t value) {
+		assert(defs[value]);
+
+		if (var_ids[value].has_value())
+		{
+			emit(BytecodeType::LOAD, { *var_ids[value] });
+			return;
+		}
+
+		assert(defs[value]->op == Op::CONST);
+
+		switch (func.value_types[value].type)
+		{
+		case ValueType::BOOL:
+		case ValueType::CHAR:
+		case ValueType::INT:
+			instrs.push_back({ BytecodeType::S_INT8, std::get<int64_t>(defs[value]->constant), {}, 0 });
+			break;
+
+		case ValueType::FLOAT: {
+			float val = std::get<float>(defs[value]->constant);
+
+			bytecodes_t operands(sizeof(float));
+			std::memcpy(operands.data(), &val, sizeof(float));
+
+			emit(BytecodeType::FLOAT4, operands);
+			break;
+		}
+		case ValueType::STR: {
+			auto const& val = std::get<std::string>(defs[value]->constant);
+
+			auto operands = expr::Value::int_to_bytecodes(val.length());
+			for (char c : val)
+				operands.push_back((bytecode_t)c);
+
+			emit(BytecodeType::STR, operands);
+			break;
+		}
+		default:
+			throw debug::unhandled_case((int)func.value_types[value].type);
+		}
+	};
+
+	// operands on the stack are already in place below the ones pushed here
+	auto push_operands = [&](std::vector<value_t> const& operands) {
+		for (auto operand : operands)
+		{
+			if (!on_stack[operand])
+				push_value(operand);
+		}
+	};
+
+	// the incoming values are all pushed before any is stored, since a phi
+	// can be the incoming value of another phi in the same block
+	auto copy_phis = [&](block_t from, block_t to) {
+		std::vector<bytecode_t> phi_ids;
+
+		for (auto const& instr : func.blocks[to].instrs)
+		{
+			if (instr.op != Op::PHI)
+				break;
+
+			auto it = std::find(std::begin(instr.blocks), std::end(instr.blocks), from);
+			assert(it != std::end(instr.blocks));
+
+			push_value(instr.operands[std::distance(std::begin(instr.blocks), it)]);
+			phi_ids.push_back(*var_ids[*instr.result]);
+		}
+
+		for (auto it = std::rbegin(phi_ids); it != std::rend(phi_ids); ++it)
+			emit(BytecodeType::STORE, { *it });
+	};
+
+	auto has_phis = [&](block_t block) {
+		return !func.blocks[block].instrs.empty() && func.blocks[block].instrs[0].op == Op::PHI;
+	};
+
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		auto const& block = func.blocks[order[i]];
+		std::optional<block_t> next;
+		if (i + 1 < order.size())
+			next = order[i + 1];
+
+		labels[order[i]] = instrs.size();
+
+		if (block.counter.has_value())
+		{
+			bytecodes_t operands;
+			for (int j = 0; j < 4; ++j)
+				operands.push_back((*block.counter >> (8 * j)) & 0xFF);
+
+			emit(BytecodeType::COUNT, operands);
+		}
+
+		for (auto const& instr : block.instrs)
+		{
+			switch (instr.op)
+			{
+			case Op::CONST:
+			case Op::PHI:
+				break;
+
+			case Op::LOAD:
+				emit(BytecodeType::LOAD, { instr.id });
+				break;
+
+			case Op::STORE:
+				push_operands(instr.operands);
+				emit(BytecodeType::STORE, { instr.id });
+				break;
+
+			case Op::SET_INDEX:
+				push_operands(instr.operands);
+				emit(instr.in_bounds ? BytecodeType::SET_INDEX_UNCHECKED : BytecodeType::SET_INDEX, { instr.id, (bytecode_t)(instr.operands.size() - 1) });
+				break;
+
+			case Op::CALL:
+				push_operands(instr.operands);
+				emit(BytecodeType::CALL, { instr.id });
+				break;
+
+			case Op::BYTECODE:
+				push_operands(instr.operands);
+				emit(instr.code, instr.immediates);
+				break;
+
+			default:
+				throw debug::unhandled_case((int)instr.op);
+			}
+
+			if (!instr.result.has_value() || instr.op == Op::CONST || instr.op == Op::PHI || on_stack[*instr.result])
+				continue;
+
+			if (var_ids[*instr.result].has_value())
+				emit(BytecodeType::STORE, { *var_ids[*instr.result] });
+			else
+				emit(BytecodeType::POP);
+		}
+
+		if (!block.terminator.has_value())
+		{
+			if (next.has_value())
+				emit(BytecodeType::RETURN);
+
+			continue;
+		}
+
+		auto const& terminator = *block.terminator;
+		switch (terminator.type)
+		{
+		case TerminatorType::JUMP:
+			copy_phis(order[i], terminator.true_block);
+
+			if (next != terminator.true_block)
+				emit_jump(BytecodeType::JUMP, terminator.true_block);
+
+			break;
+
+		case TerminatorType::BRANCH:
+			push_operands({ *terminator.value });
+
+			if (has_phis(terminator.true_block) || has_phis(terminator.false_block))
+			{
+				// each edge copies its own phis, so the false edge gets its own label
+				labels.push_back(0);
+				auto false_label = labels.size() - 1;
+
+				emit_jump(BytecodeType::JUMP_IF_FALSE, false_label);
+				copy_phis(order[i], terminator.true_block);
+				emit_jump(BytecodeType::JUMP, terminator.true_block);
+
+				labels[false_label] = instrs.size();
+				copy_phis(order[i], terminator.false_block);
+
+				if (next != terminator.false_block)
+					emit_jump(BytecodeType::JUMP, terminator.false_block);
+			}
+			else if (next == terminator.true_block)
+			{
+				emit_jump(BytecodeType::JUMP_IF_FALSE, terminator.false_block);
+			}
+			else if (next == terminator.false_block)
+			{
+				emit_jump(BytecodeType::JUMP_IF_TRUE, terminator.true_block);
+			}
+			else
+			{
+				emit_jump(BytecodeType::JUMP_IF_FALSE, terminator.false_block);
+				emit_jump(BytecodeType::JUMP, terminator.true_block);
+			}
+
+			break;
+
+		case TerminatorType::RETURN:
+			if (terminator.value.has_value())
+				push_operands({ *terminator.value });
+
+			emit(BytecodeType::RETURN);
+			break;
+
+		case TerminatorType::SWITCH: {
+			push_operands({ *terminator.value });
+
+			auto const& cases = terminator.cases;
+			assert(!cases.empty() && !has_phis(terminator.false_block));
+			assert(std::none_of(std::begin(cases), std::end(cases), [&](auto const& c) { return has_phis(c.second); }));
+
+			::Instruction instr{ BytecodeType::LOOKUP_SWITCH, 0, {}, terminator.false_block };
+
+			// keys that are close together are found by indexing a table of their
+			// blocks, and the others by a binary search
+			auto span = (uint64_t)cases.back().first - (uint64_t)cases.front().first;
+			if (span < max_table_span && span < table_density * cases.size())
+			{
+				instr.type = BytecodeType::TABLE_SWITCH;
+				instr.val = cases.front().first;
+				instr.targets.assign(span + 1, terminator.false_block);
+
+				for (auto const& [key, block] : cases)
+					instr.targets[(uint64_t)key - (uint64_t)instr.val] = block;
+			}
+			else
+			{
+				for (auto const& [key, block] : cases)
+				{
+					instr.keys.push_back(key);
+					instr.targets.push_back(block);
+				}
+			}
+
+			instrs.push_back(instr);
+			break;
+		}
+
+		default:
+			throw debug::unhandled_case((int)terminator.type);
+		}
+	}
+
+	for (auto& instr : instrs)
+		for_each_target(instr, [&](std::size_t& target) { target = labels[target]; });
+
+	auto codes = encode_instructions(instrs);
+	if (!codes.has_value())
+		throw night::error::get().create_fatal_error("'" + func.name + "' has a jump that is too long", func.loc);
+
+	return *codes;
+}
+
+
+// variables and functions are printed by name if they have one, followed by their id
+static std::string id_to_str(std::string const& name, bytecode_t id)
+{
+	return name + "#" + std::to_string(id);
+}
+
+static std::string value_to_str(ir::value_t value)
+{
+	return "%" + std::to_string(value);
+}
+
+static std::string block_to_str(ir::block_t block)
+{
+	return "bb" + std::to_string(block);
+}
+
+void ir::dump(Module const& module, std::ostream& out)
+{
+	out << "[printing ir]\n";
+
+	dump(module.main, module, out);
+	for (auto const& [id, func] : module.funcs)
+		dump(func, module, out);
+
+	out << "[end of ir]\n";
+}
+
+void ir::dump(Function const& func, Module const& module, std::ostream& out)
+{
+	auto var_to_str = [&](bytecode_t id) {
+		return id_to_str(module.var_names.contains(id) ? module.var_names.at(id) : "", id);
+	};
+
+	auto func_to_str = [&](bytecode_t id) {
+		for (auto const& [name, overloads] : ParserScope::funcs)
+		{
+			for (auto const& [param_types, func] : overloads)
+			{
+				if (func.id == id)
+					return id_to_str(symbols::name(name), id);
+			}
+		}
+
+		return id_to_str("", id);
+	};
+
+	auto operands_to_str = [](std::vector<value_t> const& operands) {
+		std::string s;
+		for (auto operand : operands)
+			s += " " + value_to_str(operand);
+
+		return s;
+	};
+
+	out << "func " << func.name << '(';
+	for (std::size_t i = 0; i < func.param_ids.size(); ++i)
+		out << (i ? ", " : "") << var_to_str(func.param_ids[i]);
+	out << ")\n";
+
+	for (block_t block = 0; block < func.blocks.size(); ++block)
+	{
+		out << block_to_str(block) << ':';
+		if (func.blocks[block].count.has_value())
+			out << " (ran " << *func.blocks[block].count << " times)";
+		out << '\n';
+
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			out << "    ";
+			if (instr.result.has_value())
+				out << value_to_str(*instr.result) << " = " << night::to_str(func.value_types[*instr.result]) << ' ';
+
+			switch (instr.op)
+			{
+			case Op::CONST:
+				out << "const ";
+				if (auto val = std::get_if<int64_t>(&instr.constant))
+					out << *val;
+				else if (auto val = std::get_if<float>(&instr.constant))
+					out << *val;
+				else
+					out << '"' << std::get<std::string>(instr.constant) << '"';
+				break;
+
+			case Op::LOAD:
+				out << "load " << var_to_str(instr.id);
+				break;
+			case Op::STORE:
+				out << "store " << var_to_str(instr.id) << operands_to_str(instr.operands);
+				break;
+			case Op::SET_INDEX:
+				out << (instr.in_bounds ? "set_index_unchecked " : "set_index ") << var_to_str(instr.id) << operands_to_str(instr.operands);
+				break;
+			case Op::CALL:
+				out << "call " << func_to_str(instr.id) << operands_to_str(instr.operands);
+				break;
+
+			case Op::PHI:
+				out << "phi";
+				for (std::size_t i = 0; i < instr.operands.size(); ++i)
+					out << (i ? ", " : " ") << '[' << block_to_str(instr.blocks[i]) << ": " << value_to_str(instr.operands[i]) << ']';
+				break;
+
+			case Op::BYTECODE:
+				out << night::to_str(instr.code) << operands_to_str(instr.operands);
+				for (auto immediate : instr.immediates)
+					out << " (" << (int)immediate << ')';
+				break;
+
+			default:
+				throw debug::unhandled_case((int)instr.op);
+			}
+
+			out << '\n';
+		}
+
+		auto const& terminator = func.blocks[block].terminator;
+		if (!terminator.has_value())
+			continue;
+
+		out << "    ";
+		switch (terminator->type)
+		{
+		case TerminatorType::JUMP:
+			out << "jump " << block_to_str(terminator->true_block);
+			break;
+		case TerminatorType::BRANCH:
+			out << "branch " << value_to_str(*terminator->value) << ' '
+				<< block_to_str(terminator->true_block) << ' ' << block_to_str(terminator->false_block);
+			break;
+		case TerminatorType::RETURN:
+			out << "return";
+			if (terminator->value.has_value())
+				out << ' ' << value_to_str(*terminator->value);
+			break;
+		case TerminatorType::SWITCH:
+			out << "switch " << value_to_str(*terminator->value);
+			for (auto const& [key, block] : terminator->cases)
+				out << " (" << key << ": " << block_to_str(block) << ')';
+			out << ' ' << block_to_str(terminator->false_block);
+			break;
+		default:
+			throw debug::unhandled_case((int)terminator->type);
+		}
+
+		out << '\n';
+	}
+
+	out << '\n';
+}
@@ -0,0 +1,308 @@
+#include "kernel.hpp"
+#include "interpreter_scope.hpp"
+#include "debug.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace
+{
+
+// a value of the program's stack, for each index of a block
+struct Column
+{
+	int64_t i[kernel_block_size];
+	float f[kernel_block_size];
+};
+
+}
+
+static bool has_operand(KernelCode code)
+{
+	return code == KernelCode::OPERAND_I || code == KernelCode::OPERAND_F ||
+		   code == KernelCode::ELEMENT_I || code == KernelCode::ELEMENT_F ||
+		   code == KernelCode::SHIFT_LEFT_I;
+}
+
+// returns the index from start up to which every array the program writes or
+// reads has an element, which is start for a negative start if there are arrays,
+// and end if there are none
+static int64_t in_bounds_end(
+	std::vector<intpr::Value> const& operands, int64_t start, int64_t end,
+	bytecodes_t const& program, bool is_map)
+{
+	bool has_arrays = is_map;
+	uint64_t limit = std::max<int64_t>(end, 0);
+	if (is_map)
+		limit = std::min<uint64_t>(limit, operands[0].v.size());
+
+	for (auto it = std::begin(program); it != std::end(program); ++it)
+	{
+		auto code = (KernelCode)*it;
+		if (code == KernelCode::ELEMENT_I || code == KernelCode::ELEMENT_F)
+		{
+			has_arrays = true;
+			limit = std::min<uint64_t>(limit, operands[*(it + 1)].v.size());
+		}
+
+		if (has_operand(code))
+			++it;
+	}
+
+	if (!has_arrays)
+		return end;
+	if (start < 0)
+		return start;
+
+	return std::max<int64_t>(start, limit);
+}
+
+// the stack never holds more values than the program has codes
+// kernels never run other code, so a single stack is shared by all of them
+static std::vector<Column>& stack_for(bytecodes_t const& program)
+{
+	static std::vector<Column> stack;
+	if (stack.size() < program.size())
+		stack.resize(program.size());
+
+	return stack;
+}
+
+// works out the program's values for count indices from first, into stack[0]
+// elements are only checked against the size of their arrays if is_checked is true
+static void run_block(
+	std::vector<intpr::Value> const& operands, bytecodes_t const& program,
+	int64_t first, std::size_t count, std::vector<Column>& stack, bool is_checked)
+{
+	std::size_t top = 0;
+
+	for (auto it = std::begin(program); it != std::end(program); ++it)
+	{
+		switch ((KernelCode)*it)
+		{
+		case KernelCode::OPERAND_I: {
+			auto val = operands[*(++it)].i;
+			auto& col = stack[top++].i;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = val;
+			break;
+		}
+		case KernelCode::OPERAND_F: {
+			auto val = operands[*(++it)].f;
+			auto& col = stack[top++].f;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = val;
+			break;
+		}
+
+		case KernelCode::ELEMENT_I: {
+			auto const& elements = operands[*(++it)].v;
+			auto& col = stack[top++].i;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = (is_checked ? elements.at(first + k) : elements[first + k]).i;
+			break;
+		}
+		case KernelCode::ELEMENT_F: {
+			auto const& elements = operands[*(++it)].v;
+			auto& col = stack[top++].f;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = (is_checked ? elements.at(first + k) : elements[first + k]).f;
+			break;
+		}
+
+		case KernelCode::INDEX: {
+			auto& col = stack[top++].i;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = first + k;
+			break;
+		}
+
+		case KernelCode::NEGATIVE_I: {
+			auto& col = stack[top - 1].i;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = (int64_t)(0 - (uint64_t)col[k]);
+			break;
+		}
+		case KernelCode::NEGATIVE_F: {
+			auto& col = stack[top - 1].f;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = -col[k];
+			break;
+		}
+
+		case KernelCode::ADD_I: {
+			auto& lhs = stack[top - 2].i;
+			auto const& rhs = stack[--top].i;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = (int64_t)((uint64_t)lhs[k] + (uint64_t)rhs[k]);
+			break;
+		}
+		case KernelCode::ADD_F: {
+			auto& lhs = stack[top - 2].f;
+			auto const& rhs = stack[--top].f;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = lhs[k] + rhs[k];
+			break;
+		}
+		case KernelCode::SUB_I: {
+			auto& lhs = stack[top - 2].i;
+			auto const& rhs = stack[--top].i;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = (int64_t)((uint64_t)lhs[k] - (uint64_t)rhs[k]);
+			break;
+		}
+		case KernelCode::SUB_F: {
+			auto& lhs = stack[top - 2].f;
+			auto const& rhs = stack[--top].f;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = lhs[k] - rhs[k];
+			break;
+		}
+		case KernelCode::MULT_I: {
+			auto& lhs = stack[top - 2].i;
+			auto const& rhs = stack[--top].i;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = (int64_t)((uint64_t)lhs[k] * (uint64_t)rhs[k]);
+			break;
+		}
+		case KernelCode::MULT_F: {
+			auto& lhs = stack[top - 2].f;
+			auto const& rhs = stack[--top].f;
+			for (std::size_t k = 0; k < count; ++k)
+				lhs[k] = lhs[k] * rhs[k];
+			break;
+		}
+
+		case KernelCode::SHIFT_LEFT_I: {
+			auto shift = *(++it);
+			auto& col = stack[top - 1].i;
+			for (std::size_t k = 0; k < count; ++k)
+				col[k] = (int64_t)((uint64_t)col[k] << shift);
+			break;
+		}
+
+		case KernelCode::I2F: {
+			auto& col = stack[top - 1];
+			for (std::size_t k = 0; k < count; ++k)
+				col.f[k] = float(col.i[k]);
+			break;
+		}
+		case KernelCode::F2I: {
+			auto& col = stack[top - 1];
+			for (std::size_t k = 0; k < count; ++k)
+				col.i[k] = int64_t(col.f[k]);
+			break;
+		}
+
+		default:
+			throw debug::unhandled_case(*it);
+		}
+	}
+}
+
+void vector_map(std::vector<intpr::Value>& operands, int64_t start, int64_t end, bytecodes_t const& program)
+{
+	if (start >= end)
+		return;
+
+	bool is_float = is_float_kernel(program);
+	auto in_bounds = in_bounds_end(operands, start, end, program, true);
+
+	auto& stack = stack_for(program);
+
+	// every element of a block is read before any is set, which is the same as the
+	// loop, since element i of the array is only read when working out element i
+	auto set_elements = [&](int64_t first, std::size_t count, bool is_checked) {
+		auto& elements = operands[0].v;
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			auto& element = is_checked ? elements.at(first + k) : elements[first + k];
+			element = is_float ? intpr::Value(stack[0].f[k]) : intpr::Value(stack[0].i[k]);
+		}
+	};
+
+	// counted by the indices left, as adding a whole block to the index can
+	// go past INT64_MAX
+	auto first = start;
+	for (uint64_t left = (uint64_t)in_bounds - (uint64_t)start; left > 0;)
+	{
+		auto count = (std::size_t)std::min<uint64_t>(kernel_block_size, left);
+
+		run_block(operands, program, first, count, stack, false);
+		set_elements(first, count, false);
+
+		left -= count;
+		first = (int64_t)((uint64_t)first + count);
+	}
+
+	// the first index out of bounds throws, from the same array as the loop
+	if (in_bounds < end)
+	{
+		run_block(operands, program, in_bounds, 1, stack, true);
+		set_elements(in_bounds, 1, true);
+	}
+}
+
+intpr::Value vector_sum(std::vector<intpr::Value> const& operands, int64_t start, int64_t end, bytecodes_t const& program)
+{
+	bool is_float = is_float_kernel(program);
+
+	int64_t sum_i = is_float ? 0 : operands[0].i;
+	float sum_f = is_float ? operands[0].f : 0;
+
+	if (start < end)
+	{
+		auto in_bounds = in_bounds_end(operands, start, end, program, false);
+		auto& stack = stack_for(program);
+
+		auto first = start;
+		for (uint64_t left = (uint64_t)in_bounds - (uint64_t)start; left > 0;)
+		{
+			auto count = (std::size_t)std::min<uint64_t>(kernel_block_size, left);
+			run_block(operands, program, first, count, stack, false);
+
+			for (std::size_t k = 0; k < count; ++k)
+			{
+				if (is_float)
+					sum_f = sum_f + stack[0].f[k];
+				else
+					sum_i = (int64_t)((uint64_t)sum_i + (uint64_t)stack[0].i[k]);
+			}
+
+			left -= count;
+			first = (int64_t)((uint64_t)first + count);
+		}
+
+		if (in_bounds < end)
+			run_block(operands, program, in_bounds, 1, stack, true);
+	}
+
+	return is_float ? intpr::Value(sum_f) : intpr::Value(sum_i);
+}
+
+bool is_float_kernel(bytecodes_t const& program)
+{
+	KernelCode last = KernelCode::INDEX;
+	for (auto it = std::begin(program); it != std::end(program); ++it)
+	{
+		last = (KernelCode)*it;
+		if (has_operand(last))
+			++it;
+	}
+
+	switch (last)
+	{
+	case KernelCode::OPERAND_F:
+	case KernelCode::ELEMENT_F:
+	case KernelCode::NEGATIVE_F:
+	case KernelCode::ADD_F:
+	case KernelCode::SUB_F:
+	case KernelCode::MULT_F:
+	case KernelCode::I2F:
+		return true;
+	default:
+		return false;
+	}
+}
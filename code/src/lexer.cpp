@@ -1,22 +1,142 @@
 #include "lexer.hpp"
 #include "token.hpp"
 #include "error.hpp"
+#include "char_scan.hpp"
+#include "source_table.hpp"
+#include "symbols.hpp"
 
 #include <fstream>
-#include <iostream>
-#include <cctype>
 #include <string>
+#include <string_view>
+#include <algorithm>
+#include <array>
 #include <vector>
-#include <unordered_map>
+#include <utility>
 #include <assert.h>
 
+namespace
+{
+
+struct Keyword
+{
+	std::string_view str;
+	TokenType type;
+};
+
+constexpr Keyword keywords[] = {
+	{ "true", TokenType::BOOL_LIT },
+	{ "false", TokenType::BOOL_LIT },
+	{ "char", TokenType::TYPE },
+	{ "bool", TokenType::TYPE },
+	{ "int", TokenType::TYPE },
+	{ "float", TokenType::TYPE },
+	{ "str", TokenType::TYPE },
+	{ "if", TokenType::IF },
+	{ "elif", TokenType::ELIF },
+	{ "else", TokenType::ELSE },
+	{ "for", TokenType::FOR },
+	{ "while", TokenType::WHILE },
+	{ "def", TokenType::DEF },
+	{ "void", TokenType::VOID },
+	{ "return", TokenType::RETURN }
+};
+
+constexpr std::size_t keyword_table_size = 32;
+
+// a perfect hash of the keywords, so looking up a word is a single comparison
+constexpr std::size_t keyword_hash(std::string_view word)
+{
+	return (word.size() + (unsigned char)word.front() + (unsigned char)word.back()) % keyword_table_size;
+}
+
+constexpr bool is_keyword_hash_perfect()
+{
+	std::array<bool, keyword_table_size> used{};
+	for (auto const& keyword : keywords)
+	{
+		if (used[keyword_hash(keyword.str)])
+			return false;
+
+		used[keyword_hash(keyword.str)] = true;
+	}
+
+	return true;
+}
+
+static_assert(is_keyword_hash_perfect(), "two keywords have the same hash, change keyword_hash()");
+
+// empty entries have an empty string, which never matches a word
+constexpr auto keyword_table = [] {
+	std::array<Keyword, keyword_table_size> table{};
+	for (auto const& keyword : keywords)
+		table[keyword_hash(keyword.str)] = keyword;
+
+	return table;
+}();
+
+// a symbol is its first character alone, or followed by a second character
+// '\0' matches the first character alone, and is tried last
+struct Symbol
+{
+	struct Match
+	{
+		char next;
+		TokenType type;
+	};
+
+	Match matches[2];
+	std::size_t count;
+};
+
+// indexed by the first character of a symbol, where characters that do not
+// start a symbol have no matches
+constexpr auto symbol_table = [] {
+	std::array<Symbol, 256> table{};
+	auto set = [&](char c, Symbol const& symbol) { table[(unsigned char)c] = symbol; };
+
+	for (char c : { '+', '-', '*', '/', '%' })
+		set(c, { { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } }, 2 });
+
+	set('>', { { { '=', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } }, 2 });
+	set('<', { { { '=', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } }, 2 });
+
+	set('|', { { { '|', TokenType::BINARY_OP } }, 1 });
+	set('&', { { { '&', TokenType::BINARY_OP } }, 1 });
+	set('!', { { { '=', TokenType::BINARY_OP }, { '\0', TokenType::UNARY_OP } }, 2 });
+
+	set('.', { { { '.', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } }, 2 });
+
+	set('=', { { { '=', TokenType::BINARY_OP }, { '\0', TokenType::ASSIGN } }, 2 });
+
+	set('(', { { { '\0', TokenType::OPEN_BRACKET } }, 1 });
+	set(')', { { { '\0', TokenType::CLOSE_BRACKET } }, 1 });
+	set('[', { { { '\0', TokenType::OPEN_SQUARE } }, 1 });
+	set(']', { { { '\0', TokenType::CLOSE_SQUARE } }, 1 });
+	set('{', { { { '\0', TokenType::OPEN_CURLY } }, 1 });
+	set('}', { { { '\0', TokenType::CLOSE_CURLY } }, 1 });
+
+	set(',', { { { '\0', TokenType::COMMA } }, 1 });
+	set(':', { { { '\0', TokenType::COLON } }, 1 });
+	set(';', { { { '\0', TokenType::SEMICOLON } }, 1 });
+
+	return table;
+}();
+
+}
+
 Lexer::Lexer(std::string const& _file_name)
-	: file(_file_name), loc({ _file_name, 1, 0 }), prev_tok(std::nullopt)
+	: loc({ _file_name, 1, 0 }), source(read_source(_file_name)), prev_tok(std::nullopt)
 {
-	if (!file.is_open())
-		throw NIGHT_CREATE_FATAL_LEXER("file '" + loc.file + "' could not be found/opened");
+	start = source_table::add_file(_file_name, source).offset;
 
-	std::getline(file, file_line);
+	set_line();
+	eat();
+}
+
+Lexer::Lexer(std::string const& _file_name, std::string _source, int first_line, SourcePos _start)
+	: loc({ _file_name, first_line, 0 }), source(std::move(_source)), start(_start.offset), prev_tok(std::nullopt)
+{
+	set_line();
 	eat();
 }
 
@@ -30,14 +150,13 @@ Token const& Lexer::eat()
 		return curr_tok;
 	}
 
-	while (loc.col < file_line.size() && std::isspace(file_line[loc.col]))
-		++loc.col;
+	loc.col = skip_spaces(file_line, loc.col);
 
 	if (loc.col == file_line.size() || file_line[loc.col] == '#')
 		return curr_tok = eat_new_line();
 
 
-	if (std::isdigit(file_line[loc.col]))
+	if (char_class::is_digit(file_line[loc.col]))
 		return curr_tok = eat_number();
 
 	if (file_line[loc.col] == '"')
@@ -46,7 +165,7 @@ Token const& Lexer::eat()
 	if (file_line[loc.col] == '\'')
 		return curr_tok = eat_character();
 
-	if (std::isalpha(file_line[loc.col]) || file_line[loc.col] == '_')
+	if (char_class::is_alpha(file_line[loc.col]) || file_line[loc.col] == '_')
 		return curr_tok = eat_keyword();
 
 	return curr_tok = eat_symbol();
@@ -58,10 +177,10 @@ Token const& Lexer::peek()
 		return curr_tok;
 
 	auto tmp_tok = curr_tok;
-	auto eat_tok = eat();
+	eat();
 
 	prev_tok = tmp_tok;
-	return eat_tok;
+	return curr_tok;
 }
 
 Token const& Lexer::curr() const
@@ -78,7 +197,7 @@ Token const& Lexer::expect(TokenType type, std::string const& err, std::source_l
 		eat();
 
 	if (curr().type != type)
-		throw night::error::get().create_fatal_error("found '" + curr().str + "', expected " + night::to_str(type) + " " + err, loc, s_loc);
+		throw night::error::get().create_fatal_error("found '" + std::string(curr().str) + "', expected " + night::to_str(type) + " " + err, loc, s_loc);
 
 	return curr();
 }
@@ -89,10 +208,23 @@ void Lexer::curr_check(TokenType type, std::source_location const& s_loc)
 		throw night::error::get().create_fatal_error("found '" + night::to_str(curr_tok.type) + "', expected '" + night::to_str(type) + "'", loc, s_loc);
 }
 
+SourcePos Lexer::pos() const
+{
+	return { start + (uint32_t)(line_start + loc.col) };
+}
+
 void Lexer::scan_code(std::string const& code)
 {
+	source = code;
+	start = source_table::add_file(loc.file, source).offset;
+	next_line = 0;
+	loc.line = 1;
 	loc.col = 0;
-	file_line = code;
+
+	curr_tok = {};
+	prev_tok.reset();
+
+	set_line();
 	eat();
 }
 
@@ -100,12 +232,26 @@ Token Lexer::eat_string()
 {
 	++loc.col;
 
+	// most strings are on a single line and have no escape sequences, so they
+	// are the same as in the source
+	auto end = find_quote_or_escape(file_line, loc.col);
+	if (end < file_line.size() && file_line[end] == '"')
+	{
+		auto str = file_line.substr(loc.col, end - loc.col);
+		loc.col = end + 1;
+
+		return { TokenType::STRING_LIT, str };
+	}
+
 	std::string str;
 
 	while (true)
 	{
-		if (loc.col == file_line.size() && !new_line())
-			std::cout << "expected closing quotes for string '" + str + "'";
+		while (loc.col == file_line.size())
+		{
+			if (!new_line())
+				throw NIGHT_CREATE_FATAL_LEXER("expected closing quotes for string '" + str + "'");
+		}
 
 		if (file_line[loc.col] == '"')
 			break;
@@ -128,11 +274,12 @@ Token Lexer::eat_string()
 			}
 		}
 
-		
+
 		if (!match)
 		{
-			str += file_line[loc.col];
-			++loc.col;
+			auto run_end = find_quote_or_escape(file_line, loc.col + 1);
+			str += file_line.substr(loc.col, run_end - loc.col);
+			loc.col = run_end;
 		}
 		else
 		{
@@ -142,7 +289,7 @@ Token Lexer::eat_string()
 	}
 
 	++loc.col;
-	return { TokenType::STRING_LIT, str };
+	return { TokenType::STRING_LIT, literals.emplace_back(std::move(str)) };
 }
 
 Token Lexer::eat_character()
@@ -155,11 +302,13 @@ Token Lexer::eat_character()
 	if (file_line[loc.col] == '\'')
 		throw night::error::get().create_fatal_error("character can not not be empty", loc);
 
-	std::string chr;
+	std::string_view chr;
 
 	if (file_line[loc.col] == '\\')
 	{
-		++loc.col;
+		if (++loc.col == file_line.length())
+			throw night::error::get().create_fatal_error("expected character after '\\'", loc);
+
 		switch (file_line[loc.col])
 		{
 		case '\\': chr = "\\"; break;
@@ -167,15 +316,18 @@ Token Lexer::eat_character()
 		case 't':  chr = "\t"; break;
 		case '"':  chr = "\""; break;
 		default:
-			throw night::error::get().create_fatal_error("unknown character '\\'" + file_line[loc.col], loc);
+			throw night::error::get().create_fatal_error(std::string("unknown character '\\") + file_line[loc.col] + "'", loc);
 		}
 	}
 	else
 	{
-		chr = file_line[loc.col];
+		chr = file_line.substr(loc.col, 1);
 	}
 
-	if (file_line[++loc.col] != '\'')
+	if (++loc.col == file_line.length())
+		throw night::error::get().create_fatal_error("expected closing quote at the end of character", loc);
+
+	if (file_line[loc.col] != '\'')
 		throw night::error::get().create_fatal_error(std::string() + "found '" + file_line[loc.col] + "', expected closing quote at the end of character", loc);
 
 	++loc.col;
@@ -184,116 +336,59 @@ Token Lexer::eat_character()
 
 Token Lexer::eat_keyword()
 {
-	static std::unordered_map<std::string, TokenType> const keywords{
-		{ "true", TokenType::BOOL_LIT },
-		{ "false", TokenType::BOOL_LIT },
-		{ "char", TokenType::TYPE },
-		{ "bool", TokenType::TYPE },
-		{ "int", TokenType::TYPE },
-		{ "float", TokenType::TYPE },
-		{ "str", TokenType::TYPE },
-		{ "if", TokenType::IF },
-		{ "elif", TokenType::ELIF },
-		{ "else", TokenType::ELSE },
-		{ "for", TokenType::FOR },
-		{ "while", TokenType::WHILE },
-		{ "def", TokenType::DEF },
-		{ "void", TokenType::VOID },
-		{ "return", TokenType::RETURN }
-	};
-
-	std::string keyword;
+	auto start = loc.col;
+	loc.col = skip_word(file_line, loc.col + 1);
 
-	do {
-		keyword += file_line[loc.col];
-		++loc.col;
-	} while (loc.col < file_line.length() && (std::isalpha(file_line[loc.col]) || std::isdigit(file_line[loc.col]) || file_line[loc.col] == '_'));
+	auto word = file_line.substr(start, loc.col - start);
 
-	if (auto it = keywords.find(keyword); it != keywords.end())
-		return Token{ it->second, keyword };
+	// types are interned too, as they are also the names of the cast functions
+	if (auto const& keyword = keyword_table[keyword_hash(word)]; keyword.str == word)
+		return Token{ keyword.type, word, keyword.type == TokenType::TYPE ? symbols::intern(word) : 0 };
 	else
-		return Token{ TokenType::VARIABLE, keyword };
+		return Token{ TokenType::VARIABLE, word, symbols::intern(word) };
 }
 
 Token Lexer::eat_number()
 {
-	std::string number;
-
-	do {
-		number += file_line[loc.col];
-		++loc.col;
-	} while (loc.col < file_line.length() && std::isdigit(file_line[loc.col]));
+	auto start = loc.col;
+	loc.col = skip_digits(file_line, loc.col + 1);
 
 	// floats
-	if (file_line[loc.col] == '.' && loc.col < file_line.length() - 1 &&
-		std::isdigit(file_line[loc.col + 1]))
+	if (loc.col < file_line.length() - 1 && file_line[loc.col] == '.' &&
+		char_class::is_digit(file_line[loc.col + 1]))
 	{
-		number += ".";
-		++loc.col;
+		loc.col = skip_digits(file_line, loc.col + 2);
 
-		do {
-			number += file_line[loc.col];
-			++loc.col;
-		} while (loc.col < file_line.length() && std::isdigit(file_line[loc.col]));
-
-		return { TokenType::FLOAT_LIT, number };
+		return { TokenType::FLOAT_LIT, file_line.substr(start, loc.col - start) };
 	}
 
-	return { TokenType::INT_LIT, number };
+	return { TokenType::INT_LIT, file_line.substr(start, loc.col - start) };
 }
 
 Token Lexer::eat_symbol()
 {
-	static std::unordered_map<char, std::vector<std::pair<char, TokenType> > > const symbols{
-		{ '+', { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } } },
-		{ '-', { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } } },
-		{ '*', { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } } },
-		{ '/', { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } } },
-		{ '%', { { '=', TokenType::ASSIGN }, { '\0', TokenType::BINARY_OP } } },
-
-		{ '>', { { '=', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } } },
-		{ '<', { { '=', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } } },
-
-		{ '|', { { '|', TokenType::BINARY_OP } } },
-		{ '&', { { '&', TokenType::BINARY_OP } } },
-		{ '!', { { '=', TokenType::BINARY_OP }, { '\0', TokenType::UNARY_OP } } },
-
-		{ '.', { { '.', TokenType::BINARY_OP }, { '\0', TokenType::BINARY_OP } } },
-
-		{ '=', { { '=', TokenType::BINARY_OP }, { '\0', TokenType::ASSIGN } } },
-
-		{ '(', { { '\0', TokenType::OPEN_BRACKET } } },
-		{ ')', { { '\0', TokenType::CLOSE_BRACKET } } },
-		{ '[', { { '\0', TokenType::OPEN_SQUARE } } },
-		{ ']', { { '\0', TokenType::CLOSE_SQUARE } } },
-		{ '{', { { '\0', TokenType::OPEN_CURLY } } },
-		{ '}', { { '\0', TokenType::CLOSE_CURLY } } },
-
-		{ ',', { { '\0', TokenType::COMMA } } },
-		{ ':', { { '\0', TokenType::COLON } } },
-		{ ';', { { '\0', TokenType::SEMICOLON } } }
-	};
-
-	auto symbol = symbols.find(file_line[loc.col]);
-	if (symbol == symbols.end())
+	auto const& symbol = symbol_table[(unsigned char)file_line[loc.col]];
+	if (symbol.count == 0)
 		throw NIGHT_CREATE_FATAL_LEXER("unknown symbol '" + std::string(1, file_line[loc.col]) + "'");
 
-	for (auto& [c, tok_type] : symbol->second)
+	for (std::size_t i = 0; i < symbol.count; ++i)
 	{
+		auto const& [c, tok_type] = symbol.matches[i];
+
 		if (c == '\0')
 		{
 			++loc.col;
-			return { tok_type, std::string(1, file_line[loc.col - 1]) };
+			return { tok_type, file_line.substr(loc.col - 1, 1) };
 		}
 
 		if (loc.col < file_line.length() - 1 && file_line[loc.col + 1] == c)
 		{
 			loc.col += 2;
-			return { tok_type, std::string(1, file_line[loc.col - 2]) + std::string(1, c) };;
+			return { tok_type, file_line.substr(loc.col - 2, 2) };
 		}
 	}
 
-	throw NIGHT_CREATE_FATAL_LEXER("unknown symbol '" + file_line.substr(loc.col, 2) + "'");
+	throw NIGHT_CREATE_FATAL_LEXER("unknown symbol '" + std::string(file_line.substr(loc.col, 2)) + "'");
 }
 
 bool Lexer::new_line()
@@ -301,7 +396,15 @@ bool Lexer::new_line()
 	++loc.line;
 	loc.col = 0;
 
-	return (bool)std::getline(file, file_line);
+	if (next_line >= source.size())
+	{
+		// the end of the file is at the start of the line after the last one
+		line_start = next_line;
+		return false;
+	}
+
+	set_line();
+	return true;
 }
 
 Token Lexer::eat_new_line()
@@ -310,4 +413,118 @@ Token Lexer::eat_new_line()
 		return { TokenType::END_OF_FILE, "end of file" };
 
 	return eat();
-}
\ No newline at end of file
+}
+
+void Lexer::set_line()
+{
+	auto end = source.find('\n', next_line);
+	if (end == std::string::npos)
+		end = source.size();
+
+	file_line = std::string_view(source).substr(next_line, end - next_line);
+	line_start = next_line;
+	next_line = end + 1;
+}
+
+std::string read_source(std::string const& file_name)
+{
+	Location loc{ file_name, 1, 0 };
+
+	std::ifstream file(file_name, std::ios::binary);
+	if (!file.is_open())
+		throw NIGHT_CREATE_FATAL_LEXER("file '" + loc.file + "' could not be found/opened");
+
+	std::string source;
+
+	file.seekg(0, std::ios::end);
+	source.resize((std::size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read(source.data(), source.size());
+
+	return source;
+}
+
+// returns true if the next word from pos, after spaces and comments, is elif or else
+static bool is_else_next(std::string_view source, std::size_t pos)
+{
+	while (true)
+	{
+		pos = skip_spaces(source, pos);
+		if (pos == source.size() || source[pos] != '#')
+			break;
+
+		pos = source.find('\n', pos);
+		if (pos == std::string_view::npos)
+			return false;
+	}
+
+	auto word = source.substr(pos, skip_word(source, pos) - pos);
+	return word == "elif" || word == "else";
+}
+
+std::vector<SourceChunk> split_source(std::string_view source, std::size_t chunk_size)
+{
+	std::vector<SourceChunk> chunks;
+
+	std::size_t start = 0;
+	int start_line = 1;
+
+	int line = 1;
+	int depth = 0;
+
+	// the last character of the last token
+	char last = '\0';
+
+	for (std::size_t i = 0; i < source.size() && depth >= 0; ++i)
+	{
+		switch (source[i])
+		{
+		case '\n':
+			++line;
+
+			if (depth == 0 && (last == ';' || last == '}') && i + 1 - start >= chunk_size &&
+				!is_else_next(source, i + 1))
+			{
+				chunks.push_back({ source.substr(start, i + 1 - start), start_line });
+				start = i + 1;
+				start_line = line;
+			}
+			continue;
+
+		case '#':
+			i = std::min(source.find('\n', i), source.size()) - 1;
+			continue;
+
+		// the same escapes as eat_string(), where strings can go over lines
+		case '"':
+			for (++i; i < source.size() && source[i] != '"'; ++i)
+			{
+				if (source[i] == '\\' && i + 1 < source.size() && (source[i + 1] == '"' || source[i + 1] == '\\'))
+					++i;
+				else if (source[i] == '\n')
+					++line;
+			}
+			break;
+
+		case '\'':
+			// a character is a single character or escape, and the closing quote
+			i += i + 1 < source.size() && source[i + 1] == '\\' ? 3 : 2;
+			break;
+
+		case '(': case '[': case '{':
+			++depth;
+			break;
+		case ')': case ']': case '}':
+			--depth;
+			break;
+		}
+
+		if (i < source.size() && !char_class::is_space(source[i]))
+			last = source[i];
+	}
+
+	if (start < source.size() || chunks.empty())
+		chunks.push_back({ source.substr(start), start_line });
+
+	return chunks;
+}
@@ -0,0 +1,129 @@
+#include "licm.hpp"
+#include "ir.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+bool ir::hoist_loop_invariants(Function& func)
+{
+	// moving instructions, and creating preheaders, changes the loops containing
+	// the loop, so they are found again before they are tried
+	// inner loops come first, so their invariants can then be moved out of the
+	// loops containing them
+	return change_loops(func, [&](Loop const& loop, std::vector<Loop> const&) {
+		return hoist_loop_invariants(func, loop);
+	});
+}
+
+bool ir::hoist_loop_invariants(Function& func, Loop const& loop)
+{
+	auto value_count = func.value_types.size();
+
+	std::vector<Instruction const*> defs(value_count, nullptr);
+	std::vector<bool> defined_in_loop(value_count, false);
+	std::unordered_set<bytecode_t> assigned_vars;
+
+	for (auto block : loop.blocks)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.result.has_value())
+			{
+				defs[*instr.result] = &instr;
+				defined_in_loop[*instr.result] = true;
+			}
+
+			if (instr.op == Op::STORE || instr.op == Op::SET_INDEX)
+				assigned_vars.insert(instr.id);
+		}
+	}
+
+	// blocks are in reverse postorder, so the operands of an instruction are seen
+	// before the instruction
+	std::vector<bool> movable(value_count, false);
+	for (auto block : loop.blocks)
+	{
+		bool has_effects = false;
+
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			bool is_invariant = std::all_of(std::begin(instr.operands), std::end(instr.operands),
+				[&](value_t operand) { return !defined_in_loop[operand] || movable[operand]; });
+
+			switch (instr.op)
+			{
+			case Op::CONST:
+			case Op::BYTECODE:
+				break;
+			case Op::LOAD:
+				is_invariant = !assigned_vars.contains(instr.id);
+				break;
+			case Op::CALL:
+				is_invariant = is_invariant && instr.is_pure && instr.result.has_value();
+				break;
+			default:
+				is_invariant = false;
+				break;
+			}
+
+			// an instruction that fails must fail at the same point, after the same
+			// side effects, and only if the loop is reached
+			if (is_invariant && can_fail(instr) && (block != loop.header || has_effects))
+				is_invariant = false;
+
+			if (is_invariant)
+				movable[*instr.result] = true;
+			else if (has_side_effects(instr) || can_fail(instr))
+				has_effects = true;
+		}
+	}
+
+	// moving a variable load or a constant on its own saves nothing
+	std::vector<bool> moved(value_count, false);
+	bool any_moved = false;
+
+	std::function<void(value_t)> move = [&](value_t value) {
+		if (!defined_in_loop[value] || moved[value])
+			return;
+
+		moved[value] = true;
+		for (auto operand : defs[value]->operands)
+			move(operand);
+	};
+
+	for (value_t value = 0; value < value_count; ++value)
+	{
+		if (movable[value] && (defs[value]->op == Op::BYTECODE || defs[value]->op == Op::CALL))
+		{
+			move(value);
+			any_moved = true;
+		}
+	}
+
+	if (!any_moved)
+		return false;
+
+	// creating the preheader can add a block, so the instructions are only moved after
+	auto preheader = get_preheader(func, loop);
+	if (!preheader.has_value())
+		return false;
+
+	for (auto block : loop.blocks)
+	{
+		auto& instrs = func.blocks[block].instrs;
+
+		for (auto const& instr : instrs)
+		{
+			if (instr.result.has_value() && moved[*instr.result])
+				func.blocks[*preheader].instrs.push_back(instr);
+		}
+
+		std::erase_if(instrs, [&](Instruction const& instr) {
+			return instr.result.has_value() && moved[*instr.result];
+		});
+	}
+
+	return true;
+}
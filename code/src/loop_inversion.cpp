@@ -0,0 +1,99 @@
+#include "loop_inversion.hpp"
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+bool ir::invert_loops(Function& func)
+{
+	// an inverted loop no longer jumps back to its header, so it is never
+	// inverted again
+	return change_loops(func, [&](Loop const& loop, std::vector<Loop> const&) {
+		return invert_loop(func, loop);
+	});
+}
+
+bool ir::invert_loop(Function& func, Loop const& loop)
+{
+	auto in_loop = [&](block_t block) {
+		return std::find(std::begin(loop.blocks), std::end(loop.blocks), block) != std::end(loop.blocks);
+	};
+
+	auto const& header = func.blocks[loop.header];
+	if (!header.terminator.has_value() || header.terminator->type != TerminatorType::BRANCH)
+		return false;
+
+	// one side of the branch stays in the loop, and the other leaves it
+	if (in_loop(header.terminator->true_block) == in_loop(header.terminator->false_block))
+		return false;
+
+	if (header.instrs.size() > inversion_threshold)
+		return false;
+
+	if (!header.instrs.empty() && header.instrs[0].op == Op::PHI)
+		return false;
+
+	if (is_used_outside(func, loop.header))
+		return false;
+
+	auto preds = predecessors(func);
+
+	std::vector<block_t> latches;
+	for (auto pred : preds[loop.header])
+	{
+		if (!in_loop(pred))
+			continue;
+
+		auto const& terminator = func.blocks[pred].terminator;
+		if (!terminator.has_value() || terminator->type != TerminatorType::JUMP)
+			return false;
+
+		latches.push_back(pred);
+	}
+
+	if (latches.empty())
+		return false;
+
+	// each latch ends with its own copy of the header, and its branch
+	for (auto latch : latches)
+	{
+		// copies are only made from the original header, since the blocks can move
+		auto const& header_instrs = func.blocks[loop.header].instrs;
+		auto header_terminator = *func.blocks[loop.header].terminator;
+
+		std::vector<std::optional<value_t>> copies(func.value_types.size());
+		auto copy_of = [&](value_t value) {
+			return copies[value].value_or(value);
+		};
+
+		std::vector<Instruction> instrs;
+		for (auto instr : header_instrs)
+		{
+			for (auto& operand : instr.operands)
+				operand = copy_of(operand);
+
+			if (instr.result.has_value())
+			{
+				func.value_types.push_back(func.value_types[*instr.result]);
+				copies[*instr.result] = func.value_types.size() - 1;
+				instr.result = func.value_types.size() - 1;
+			}
+
+			if (instr.op == Op::BYTECODE && instr.code == BytecodeType::SUBSCRIPT_UNCHECKED)
+				instr.code = BytecodeType::SUBSCRIPT;
+			instr.in_bounds = false;
+
+			instrs.push_back(instr);
+		}
+
+		auto& latch_block = func.blocks[latch];
+		latch_block.instrs.insert(std::end(latch_block.instrs), std::begin(instrs), std::end(instrs));
+
+		header_terminator.value = copy_of(*header_terminator.value);
+		latch_block.terminator = header_terminator;
+	}
+
+	return true;
+}
@@ -2,6 +2,7 @@
 #include "parser.hpp"
 #include "parser_scope.hpp"
 #include "code_gen.hpp"
+#include "profile.hpp"
 #include "interpreter.hpp"
 #include "error.hpp"
 #include "debug.hpp"
@@ -37,6 +38,13 @@ int main(int argc, char* argv[])
 		// Interprets the bytecodes.
 		InterpreterScope scope;
 		interpret_bytecodes(scope, codes);
+
+		if (ir::profile_out_file.has_value())
+			ir::write_profile(*ir::profile_out_file);
+
+		// debugging
+		if (night::error::get().debug_flag)
+			debug::log_memo_tables(std::clog);
 	}
 	catch (night::error const& e) {
 		std::cout << e.what() << '\n';
@@ -1,10 +1,16 @@
 #include "parse_args.hpp"
 #include "error.hpp"
 #include "version.hpp"
+#include "inliner.hpp"
+#include "code_gen.hpp"
+#include "unroll.hpp"
+#include "ir.hpp"
+#include "profile.hpp"
 
 #include <iostream>
 #include <vector>
 #include <string>
+#include <charconv>
 
 std::string parse_args(std::vector<std::string_view> const& args)
 {
@@ -18,6 +24,16 @@ std::string parse_args(std::vector<std::string_view> const& args)
 					   "flags:\n"
 					   "    -b           generates a bytecode file for each source file\n"
 					   "    -d           shows debug info for compiler source code (for developers)\n"
+					   "    -i <size>    inlines functions of at most <size> bytecodes, 0 turns it off (default 64)\n"
+					   "    -O1          optimizes the intermediate representation (default)\n"
+					   "    -O2          also unrolls loops, which makes the bytecodes larger\n"
+					   "    -r           prints the intermediate representation of the source file\n"
+					   "    -u <factor>  runs <factor> copies of a loop body for each test at -O2, 1 turns it off (default 4)\n"
+					   "    --memoize    keeps the results of calls to pure recursive functions\n"
+					   "    --profile-out <file>\n"
+					   "                 writes how many times each block of the program runs to <file>\n"
+					   "    --profile-in <file>\n"
+					   "                 optimizes the hot blocks of a profile written by --profile-out\n"
 					   "options:\n"
 					   "    --help       displays this message\n"
 					   "    --version    displays the version\n\n";
@@ -63,10 +79,52 @@ std::string parse_args(std::vector<std::string_view> const& args)
 
 			run_file = args[i];
 		}
+		else if (args[i] == "--memoize")
+		{
+			memoize_functions = true;
+		}
+		else if (args[i] == "--profile-out" && i + 1 < args.size())
+		{
+			ir::profile_out_file = args[++i];
+		}
+		else if (args[i] == "--profile-in" && i + 1 < args.size())
+		{
+			ir::profile_in_file = args[++i];
+		}
 		else if (args[i] == "-d")
 		{
 			night::error::get().debug_flag = true;
 		}
+		else if (args[i] == "-O1" || args[i] == "-O2")
+		{
+			optimization_level = args[i][2] - '0';
+		}
+		else if (args[i] == "-r")
+		{
+			ir::print_ir = true;
+		}
+		else if (args[i] == "-i" && i + 1 < args.size())
+		{
+			auto size = args[++i];
+			auto [ptr, ec] = std::from_chars(size.data(), size.data() + size.size(), inline_threshold);
+
+			if (ec != std::errc() || ptr != size.data() + size.size())
+			{
+				std::cout << "inline size must be a number: " << size << '\n' << more_info;
+				return "";
+			}
+		}
+		else if (args[i] == "-u" && i + 1 < args.size())
+		{
+			auto factor = args[++i];
+			auto [ptr, ec] = std::from_chars(factor.data(), factor.data() + factor.size(), ir::unroll_factor);
+
+			if (ec != std::errc() || ptr != factor.data() + factor.size() || ir::unroll_factor == 0)
+			{
+				std::cout << "unroll factor must be a positive number: " << factor << '\n' << more_info;
+				return "";
+			}
+		}
 		else
 		{
 			std::cout << "unknown option: " << args[i] << '\n' << more_info;
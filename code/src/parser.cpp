@@ -4,20 +4,31 @@
 #include "bytecode.hpp"
 #include "interpreter_scope.hpp"
 #include "ast/ast.hpp"
+#include "ast/arena.hpp"
 #include "ast/expression.hpp"
 #include "value_type.hpp"
 #include "utils.hpp"
 #include "error.hpp"
+#include "source_table.hpp"
 #include "debug.hpp"
 
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <thread>
 #include <unordered_map>
 #include <variant>
 #include <string>
+#include <vector>
 #include <assert.h>
 
-AST_Block parse_file(std::string const& main_file)
+// files smaller than this are parsed on a single thread, since starting threads
+// would take longer than parsing them
+constexpr std::size_t min_chunk_size = 256 * 1024;
+
+static AST_Block parse_chunk(std::string const& file_name, SourceChunk const& chunk, SourcePos start)
 {
-	Lexer lexer(main_file);
+	Lexer lexer(file_name, std::string(chunk.source), chunk.line, start);
 	AST_Block stmts;
 
 	while (lexer.curr().type != TokenType::END_OF_FILE)
@@ -29,6 +40,68 @@ AST_Block parse_file(std::string const& main_file)
 	return stmts;
 }
 
+AST_Block parse_file(std::string const& main_file)
+{
+	auto source = read_source(main_file);
+	auto start = source_table::add_file(main_file, source);
+
+	auto threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+	auto chunks = split_source(source, std::max(min_chunk_size, source.size() / threads_count));
+
+	auto chunk_start = [&](SourceChunk const& chunk) {
+		return SourcePos{ start.offset + (uint32_t)(chunk.source.data() - source.data()) };
+	};
+
+	if (chunks.size() == 1)
+		return parse_chunk(main_file, chunks[0], chunk_start(chunks[0]));
+
+	// each chunk is parsed on its own thread, and the errors of a thread are
+	// thrown in order of the chunks, so the first error in the file is the one
+	// that is shown, the same as parsing it on a single thread
+	std::vector<AST_Block> blocks(chunks.size());
+	std::vector<std::exception_ptr> errors(chunks.size());
+
+	// the nodes of each thread are made in its own arena, which is destroyed
+	// when the thread ends, so they are moved into the arena of this thread
+	std::vector<Arena> arenas(chunks.size());
+
+	bool debug_flag = night::error::get().debug_flag;
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		threads.emplace_back([&, i] {
+			night::error::get().debug_flag = debug_flag;
+
+			try {
+				blocks[i] = parse_chunk(main_file, chunks[i], chunk_start(chunks[i]));
+			}
+			catch (...) {
+				errors[i] = std::current_exception();
+			}
+
+			arenas[i].take(ast_arena());
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto& arena : arenas)
+		ast_arena().take(arena);
+
+	AST_Block stmts;
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		if (errors[i])
+			std::rethrow_exception(errors[i]);
+
+		stmts.insert(std::end(stmts), std::begin(blocks[i]), std::end(blocks[i]));
+	}
+
+	return stmts;
+}
+
 AST_Block parse_stmts(Lexer& lexer, bool requires_curly)
 {
 	// two cases:
@@ -58,39 +131,39 @@ AST_Block parse_stmts(Lexer& lexer, bool requires_curly)
 		return {};
 	default:
 		if (requires_curly)
-			throw NIGHT_CREATE_FATAL("found '" + lexer.curr().str + "', expected opening curly bracket");
+			throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected opening curly bracket");
 
 		return { parse_stmt(lexer) };
 	}
 }
 
-std::shared_ptr<AST> parse_stmt(Lexer& lexer)
+AST* parse_stmt(Lexer& lexer)
 {
 	switch (lexer.curr().type)
 	{
 	case TokenType::VARIABLE: return parse_var(lexer);
-	case TokenType::IF:		  return std::make_shared<Conditional>(parse_if(lexer));
+	case TokenType::IF:		  return parse_if(lexer);
 	case TokenType::ELIF:	  throw NIGHT_CREATE_FATAL("elif statement must come before an if or elif statement");
 	case TokenType::ELSE:	  throw NIGHT_CREATE_FATAL("else statement must come before an if or elif statement");
-	case TokenType::FOR:	  return std::make_shared<For>(parse_for(lexer));
-	case TokenType::WHILE:	  return std::make_shared<While>(parse_while(lexer));
-	case TokenType::DEF:	  return std::make_shared<Function>(parse_func(lexer));
-	case TokenType::RETURN:	  return std::make_shared<Return>(parse_return(lexer));
+	case TokenType::FOR:	  return parse_for(lexer);
+	case TokenType::WHILE:	  return parse_while(lexer);
+	case TokenType::DEF:	  return parse_func(lexer);
+	case TokenType::RETURN:	  return parse_return(lexer);
 
-	default: throw NIGHT_CREATE_FATAL("unknown syntax '" + lexer.curr().str + "'");
+	default: throw NIGHT_CREATE_FATAL("unknown syntax '" + std::string(lexer.curr().str) + "'");
 	}
 }
 
-std::shared_ptr<AST> parse_var(Lexer& lexer)
+AST* parse_var(Lexer& lexer)
 {
-	std::string var_name = lexer.curr().str;
+	auto var_name = lexer.curr().symbol;
 
 	switch (lexer.peek().type)
 	{
 	case TokenType::TYPE: {
 		lexer.eat();
 
-		auto const& ast = std::make_shared<VariableInit>(parse_var_init(lexer, var_name));
+		auto ast = parse_var_init(lexer, var_name);
 
 		lexer.eat();
 		return ast;
@@ -98,19 +171,18 @@ std::shared_ptr<AST> parse_var(Lexer& lexer)
 	case TokenType::ASSIGN: {
 		lexer.eat();
 
-		auto const& ast = std::make_shared<VariableAssign>(parse_var_assign(lexer, var_name));
+		auto ast = parse_var_assign(lexer, var_name);
 		lexer.curr_check(TokenType::SEMICOLON);
 
 		lexer.eat();
 		return ast;
 	}
 	case TokenType::OPEN_SQUARE: {
-		auto const& ast = std::make_shared<ArrayMethod>(parse_array_method(lexer, var_name));
-		return ast;
+		return parse_array_method(lexer, var_name);
 	}
 	case TokenType::OPEN_BRACKET: {
 		lexer.eat();
-		auto const& ast = std::make_shared<expr::FunctionCall>(parse_func_call(lexer, var_name));
+		auto ast = parse_func_call(lexer, var_name);
 		lexer.expect(TokenType::SEMICOLON);
 		lexer.eat();
 		return ast;
@@ -120,11 +192,11 @@ std::shared_ptr<AST> parse_var(Lexer& lexer)
 	}
 }
 
-VariableInit parse_var_init(Lexer& lexer, std::string const& var_name)
+VariableInit* parse_var_init(Lexer& lexer, symbol_t var_name)
 {
 	assert(lexer.curr().type == TokenType::TYPE);
 
-	ValueType var_type(token_var_type_to_val_type(lexer.curr().str));
+	ValueType var_type(token_var_type_to_val_type(std::string(lexer.curr().str)));
 
 	bool is_arr = false;
 	std::vector<std::optional<expr::expr_p>> arr_sizes;
@@ -144,9 +216,11 @@ VariableInit parse_var_init(Lexer& lexer, std::string const& var_name)
 	// default value
 	expr::expr_p expr;
 	if (is_arr)
-		expr = std::make_shared<expr::Array>(lexer.loc, std::vector<expr::expr_p>());
+		expr = make_node<expr::Array>(lexer.pos(), std::vector<expr::expr_p>());
+	else if (var_type.type == ValueType::BOOL)
+		expr = make_node<expr::Value>(lexer.pos(), var_type.type, "false");
 	else
-		expr = std::make_shared<expr::Value>(lexer.loc, var_type.type, "0");
+		expr = make_node<expr::Value>(lexer.pos(), var_type.type, "0");
 
 	if (lexer.curr().type == TokenType::ASSIGN && lexer.curr().str == "=")
 	{
@@ -155,28 +229,28 @@ VariableInit parse_var_init(Lexer& lexer, std::string const& var_name)
 	}
 	else if (lexer.curr().type == TokenType::ASSIGN && lexer.curr().str != "=")
 	{
-		throw NIGHT_CREATE_FATAL("found '" + lexer.curr().str + "', expected assignment '='")
+		throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected assignment '='")
 	}
 	else if (lexer.curr().type != TokenType::SEMICOLON)
 	{
-		throw NIGHT_CREATE_FATAL("found '" + lexer.curr().str + "' expected semicolon or assignment after variable type");
+		throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "' expected semicolon or assignment after variable type");
 	}
 
-	return VariableInit(lexer.loc, var_name, var_type, arr_sizes, expr);
+	return make_node<VariableInit>(lexer.pos(), var_name, var_type, arr_sizes, expr);
 }
 
-VariableAssign parse_var_assign(Lexer& lexer, std::string const& var_name)
+VariableAssign* parse_var_assign(Lexer& lexer, symbol_t var_name)
 {
 	assert(lexer.curr().type == TokenType::ASSIGN);
 
-	auto assign_op = lexer.curr().str;
+	std::string assign_op(lexer.curr().str);
 
 	auto expr = parse_expr(lexer, true);
 
-	return VariableAssign(lexer.loc, var_name, assign_op, expr);
+	return make_node<VariableAssign>(lexer.pos(), var_name, assign_op, expr);
 }
 
-ArrayMethod parse_array_method(Lexer& lexer, std::string const& var_name)
+ArrayMethod* parse_array_method(Lexer& lexer, symbol_t var_name)
 {
 	assert(lexer.curr().type == TokenType::VARIABLE);
 
@@ -192,7 +266,7 @@ ArrayMethod parse_array_method(Lexer& lexer, std::string const& var_name)
 	if (lexer.curr().type == TokenType::SEMICOLON)
 	{
 		lexer.eat();
-		return ArrayMethod(lexer.loc, var_name, subscripts, nullptr);
+		return make_node<ArrayMethod>(lexer.pos(), var_name, subscripts, nullptr);
 	}
 
 	lexer.curr_check(TokenType::ASSIGN);
@@ -201,10 +275,10 @@ ArrayMethod parse_array_method(Lexer& lexer, std::string const& var_name)
 	lexer.curr_check(TokenType::SEMICOLON);
 
 	lexer.eat();
-	return ArrayMethod(lexer.loc, var_name, subscripts, assign_expr);
+	return make_node<ArrayMethod>(lexer.pos(), var_name, subscripts, assign_expr);
 }
 
-expr::FunctionCall parse_func_call(Lexer& lexer, std::string const& func_name)
+expr::FunctionCall* parse_func_call(Lexer& lexer, symbol_t func_name)
 {
 	assert(lexer.curr().type == TokenType::OPEN_BRACKET);
 
@@ -232,10 +306,10 @@ expr::FunctionCall parse_func_call(Lexer& lexer, std::string const& func_name)
 		lexer.curr_check(TokenType::COMMA);
 	}
 
-	return expr::FunctionCall(lexer.loc, func_name, arg_exprs);
+	return make_node<expr::FunctionCall>(lexer.pos(), func_name, arg_exprs);
 }
 
-Conditional parse_if(Lexer& lexer)
+Conditional* parse_if(Lexer& lexer)
 {
 	assert(lexer.curr().type == TokenType::IF);
 
@@ -244,7 +318,7 @@ Conditional parse_if(Lexer& lexer)
 	do {
 		// default for else statements
 		expr::expr_p cond_expr =
-			std::make_shared<expr::Value>(lexer.loc, ValueType::BOOL, "true");
+			make_node<expr::Value>(lexer.pos(), ValueType::BOOL, "true");
 
 		// parse condition
 		if (lexer.curr().type != TokenType::ELSE)
@@ -258,14 +332,13 @@ Conditional parse_if(Lexer& lexer)
 		lexer.eat();
 		conditionals.push_back({ cond_expr, parse_stmts(lexer, false) });
 
-	} while (lexer.curr().type == TokenType::IF	  ||
-			 lexer.curr().type == TokenType::ELIF ||
+	} while (lexer.curr().type == TokenType::ELIF ||
 			 lexer.curr().type == TokenType::ELSE);
 
-	return Conditional(lexer.loc, conditionals);
+	return make_node<Conditional>(lexer.pos(), conditionals);
 }
 
-While parse_while(Lexer& lexer)
+While* parse_while(Lexer& lexer)
 {
 	assert(lexer.curr().type == TokenType::WHILE);
 
@@ -276,10 +349,10 @@ While parse_while(Lexer& lexer)
 	lexer.curr_check(TokenType::CLOSE_BRACKET);
 
 	lexer.eat();
-	return While(lexer.loc, cond_expr, parse_stmts(lexer, false));
+	return make_node<While>(lexer.pos(), cond_expr, parse_stmts(lexer, false));
 }
 
-For parse_for(Lexer& lexer)
+For* parse_for(Lexer& lexer)
 {
 	assert(lexer.curr().type == TokenType::FOR);
 
@@ -287,7 +360,7 @@ For parse_for(Lexer& lexer)
 
 	// initialization
 
-	auto var_init_name = lexer.expect(TokenType::VARIABLE).str;
+	auto var_init_name = lexer.expect(TokenType::VARIABLE).symbol;
 	lexer.expect(TokenType::TYPE);
 
 	auto var_init = parse_var_init(lexer, var_init_name);
@@ -299,7 +372,7 @@ For parse_for(Lexer& lexer)
 
 	// assignment
 
-	std::string var_assign_name = lexer.expect(TokenType::VARIABLE).str;
+	auto var_assign_name = lexer.expect(TokenType::VARIABLE).symbol;
 	lexer.eat();
 
 	auto var_assign = parse_var_assign(lexer, var_assign_name);
@@ -312,21 +385,21 @@ For parse_for(Lexer& lexer)
 
 	// increment
 
-	stmts.push_back(std::make_shared<VariableAssign>(var_assign));
+	stmts.push_back(var_assign);
 
-	return For(lexer.loc, var_init, cond_expr, stmts);
+	return make_node<For>(lexer.pos(), var_init, cond_expr, stmts);
 }
 
-Function parse_func(Lexer& lexer)
+Function* parse_func(Lexer& lexer)
 {
 	assert(lexer.curr().type == TokenType::DEF);
 
-	std::string func_name = lexer.expect(TokenType::VARIABLE).str;
+	auto func_name = lexer.expect(TokenType::VARIABLE).symbol;
 	lexer.expect(TokenType::OPEN_BRACKET);
 
 	// parse function header
 
-	std::vector<std::string> param_names;
+	std::vector<symbol_t> param_names;
 	std::vector<std::string> param_types;
 
 	lexer.eat();
@@ -336,11 +409,11 @@ Function parse_func(Lexer& lexer)
 			break;
 
 		lexer.curr_check(TokenType::VARIABLE);
-		param_names.push_back(lexer.curr().str);
+		param_names.push_back(lexer.curr().symbol);
 
 		lexer.expect(TokenType::TYPE);
 
-		param_types.push_back(lexer.curr().str);
+		param_types.push_back(std::string(lexer.curr().str));
 
 		lexer.eat();
 
@@ -354,15 +427,15 @@ Function parse_func(Lexer& lexer)
 	auto rtn_type = lexer.eat();
 
 	if (rtn_type.type != TokenType::TYPE && rtn_type.type != TokenType::VOID)
-		throw NIGHT_CREATE_FATAL("found '" + lexer.curr().str + "', expected return type");
+		throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected return type");
 
 	lexer.eat();
 	auto body = parse_stmts(lexer, true);
 
-	return Function(lexer.loc, func_name, param_names, param_types, rtn_type.str, body);
+	return make_node<Function>(lexer.pos(), func_name, param_names, param_types, std::string(rtn_type.str), body);
 }
 
-Return parse_return(Lexer& lexer)
+Return* parse_return(Lexer& lexer)
 {
 	assert(lexer.curr().type == TokenType::RETURN);
 
@@ -371,164 +444,228 @@ Return parse_return(Lexer& lexer)
 
 	lexer.eat();
 
-	return Return(lexer.loc, expr);
+	return make_node<Return>(lexer.pos(), expr);
 }
 
+// the binary operators, indexed by their first character and whether their
+// second character is '=', which is enough to tell them apart
+// operators with higher binding powers bind tighter, and operators with the
+// same binding power are left associative
+struct BinaryOpSyntax
+{
+	expr::BinaryOpType type;
+
+	// 0 if it is not a binary operator
+	int power = 0;
+};
+
+constexpr auto binary_ops = [] {
+	using enum expr::BinaryOpType;
+	std::array<std::array<BinaryOpSyntax, 2>, 256> ops{};
+
+	ops['|'][0] = { OR, 1 };
+	ops['&'][0] = { AND, 1 };
+	ops['='][1] = { EQUALS, 2 };
+	ops['!'][1] = { NOT_EQUALS, 2 };
+	ops['<'][0] = { LESSER, 3 };
+	ops['<'][1] = { LESSER_EQUALS, 3 };
+	ops['>'][0] = { GREATER, 3 };
+	ops['>'][1] = { GREATER_EQUALS, 3 };
+	ops['+'][0] = { ADD, 4 };
+	ops['-'][0] = { SUB, 4 };
+	ops['*'][0] = { MULT, 5 };
+	ops['/'][0] = { DIV, 5 };
+	ops['%'][0] = { MOD, 5 };
+
+	return ops;
+}();
+
+// subscripts bind tighter than binary operators, and unary operators bind
+// tighter than subscripts, so -arr[0] is (-arr)[0]
+constexpr int subscript_power = 6;
+constexpr int unary_op_power = 7;
+
+// parses a value, a variable, a function call, an array, an expression in
+// brackets, or a unary operator and its operand
+// returns nullptr if the current token does not start an operand
+// was_variable is set to whether the last token of the operand can be
+// followed by a subscript
+// lexer
+//   start: first token of operand
+//   end: first token after operand
+static expr::expr_p parse_operand(Lexer& lexer, bool& was_variable);
+
+// parses the operators after lhs that bind tighter than min_power, and their
+// operands, and returns the expression with lhs in its final position
+// lexer
+//   start: first token after lhs
+//   end: first token after expression
+static expr::expr_p parse_operators(Lexer& lexer, expr::expr_p lhs, int min_power, bool& was_variable);
+
 expr::expr_p parse_expr(Lexer& lexer, bool err_on_empty)
 {
-	expr::expr_p head(nullptr);
-	bool allow_unary_next = true;
+	lexer.eat();
+
 	bool was_variable = false;
+	auto lhs = parse_operand(lexer, was_variable);
 
-	while (true)
+	if (!lhs)
 	{
-		lexer.eat();
+		if (err_on_empty)
+			throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected expression");
 
-		expr::expr_p node(nullptr);
+		return nullptr;
+	}
 
-		auto curr = lexer.curr();
+	return parse_operators(lexer, lhs, 0, was_variable);
+}
 
-		if (curr.type == TokenType::TYPE)
-			curr.type = TokenType::VARIABLE;
+static expr::expr_p parse_operand(Lexer& lexer, bool& was_variable)
+{
+	expr::expr_p node(nullptr);
 
-		switch (curr.type)
-		{
-		case TokenType::BOOL_LIT:
-		{
-			node = std::make_shared<expr::Value>(lexer.loc, ValueType::BOOL, lexer.curr().str);
-			allow_unary_next = false;
-			was_variable = false;
-			break;
-		}
-		case TokenType::CHAR_LIT:
-		{
-			node = std::make_shared<expr::Value>(lexer.loc, ValueType::CHAR, lexer.curr().str);
-			allow_unary_next = false;
-			was_variable = false;
-			break;
-		}
-		case TokenType::INT_LIT:
-		{
-			node = std::make_shared<expr::Value>(lexer.loc, ValueType::INT, lexer.curr().str);
-			allow_unary_next = false;
-			was_variable = false;
-			break;
-		}
-		case TokenType::FLOAT_LIT:
-		{
-			node = std::make_shared<expr::Value>(lexer.loc, ValueType::FLOAT, lexer.curr().str);
-			allow_unary_next = false;
-			was_variable = false;
-			break;
-		}
-		case TokenType::STRING_LIT:
-		{
-			node = std::make_shared<expr::Value>(lexer.loc, ValueType::STR, lexer.curr().str);
-			allow_unary_next = false;
-			was_variable = true;
-			break;
-		}
-		case TokenType::VARIABLE:
-		{
-			auto var_name = lexer.curr().str;
+	auto type = lexer.curr().type;
 
-			if (lexer.peek().type == TokenType::OPEN_BRACKET)
-			{
-				lexer.eat();
-				node = std::make_shared<expr::FunctionCall>(parse_func_call(lexer, var_name));
-			}
-			else
-				node = std::make_shared<expr::Variable>(lexer.loc, var_name);
+	if (type == TokenType::TYPE)
+		type = TokenType::VARIABLE;
 
-			allow_unary_next = false;
-			was_variable = true;
-			break;
+	switch (type)
+	{
+	case TokenType::BOOL_LIT:
+		node = make_node<expr::Value>(lexer.pos(), ValueType::BOOL, std::string(lexer.curr().str));
+		was_variable = false;
+		break;
+	case TokenType::CHAR_LIT:
+		node = make_node<expr::Value>(lexer.pos(), ValueType::CHAR, std::string(lexer.curr().str));
+		was_variable = false;
+		break;
+	case TokenType::INT_LIT:
+		node = make_node<expr::Value>(lexer.pos(), ValueType::INT, std::string(lexer.curr().str));
+		was_variable = false;
+		break;
+	case TokenType::FLOAT_LIT:
+		node = make_node<expr::Value>(lexer.pos(), ValueType::FLOAT, std::string(lexer.curr().str));
+		was_variable = false;
+		break;
+	case TokenType::STRING_LIT:
+		node = make_node<expr::Value>(lexer.pos(), ValueType::STR, std::string(lexer.curr().str));
+		was_variable = true;
+		break;
+	case TokenType::VARIABLE:
+	{
+		auto var_name = lexer.curr().symbol;
+
+		if (lexer.peek().type == TokenType::OPEN_BRACKET)
+		{
+			lexer.eat();
+			node = parse_func_call(lexer, var_name);
 		}
-		case TokenType::OPEN_SQUARE:
+		else
+			node = make_node<expr::Variable>(lexer.pos(), var_name);
+
+		was_variable = true;
+		break;
+	}
+	case TokenType::OPEN_SQUARE:
+	{
+		std::vector<expr::expr_p> arr;
+		while (true)
 		{
-			if (was_variable)
+			auto elem = parse_expr(lexer, false);
+			if (!elem)
 			{
-				auto index_expr = parse_expr(lexer, true);
 				lexer.curr_check(TokenType::CLOSE_SQUARE);
+				break;
+			}
 
-				node = std::make_shared<expr::BinaryOp>(lexer.loc, expr::BinaryOpType::SUBSCRIPT);
-				node->insert_node(index_expr);
+			arr.push_back(elem);
 
-				allow_unary_next = false;
-				was_variable = true;
-			}
-			else
-			{
-				std::vector<expr::expr_p> arr;
-				while (true)
-				{
-					auto elem = parse_expr(lexer, false);
-					if (!elem)
-					{
-						lexer.curr_check(TokenType::CLOSE_SQUARE);
-						break;
-					}
-
-					arr.push_back(elem);
-
-					if (lexer.curr().type == TokenType::CLOSE_SQUARE)
-						break;
-
-					lexer.curr_check(TokenType::COMMA);
-				}
-
-				node = std::make_shared<expr::Array>(lexer.loc, arr);
-				allow_unary_next = false;
-				was_variable = false;
-			}
+			if (lexer.curr().type == TokenType::CLOSE_SQUARE)
+				break;
 
-			break;
+			lexer.curr_check(TokenType::COMMA);
 		}
-		case TokenType::UNARY_OP:
-		{
-			node = std::make_shared<expr::UnaryOp>(lexer.loc, lexer.curr().str);
-			allow_unary_next = true;
-			break;
-		}
-		case TokenType::BINARY_OP:
-		{
-			if (allow_unary_next && lexer.curr().str == "-")
-			{
-				node = std::make_shared<expr::UnaryOp>(lexer.loc, lexer.curr().str);
-			}
-			else
-			{
-				node = std::make_shared<expr::BinaryOp>(lexer.loc, lexer.curr().str);
-				allow_unary_next = true;
-			}
 
-			was_variable = false;
+		node = make_node<expr::Array>(lexer.pos(), arr);
+		was_variable = false;
+		break;
+	}
+	case TokenType::OPEN_BRACKET:
+	{
+		node = parse_expr(lexer, true);
+		lexer.curr_check(TokenType::CLOSE_BRACKET);
 
-			break;
-		}
-		case TokenType::OPEN_BRACKET:
+		node->guard = true;
+		was_variable = false;
+		break;
+	}
+	case TokenType::UNARY_OP:
+	case TokenType::BINARY_OP:
+	{
+		// the only binary operator that can come before its operand is negative
+		if (type == TokenType::BINARY_OP && lexer.curr().str != "-")
+			return nullptr;
+
+		auto loc = lexer.pos();
+		auto op = type == TokenType::UNARY_OP ? expr::UnaryOpType::NOT : expr::UnaryOpType::NEGATIVE;
+
+		lexer.eat();
+		auto operand = parse_operand(lexer, was_variable);
+
+		if (!operand)
+			throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected expression");
+
+		return make_node<expr::UnaryOp>(loc, op, parse_operators(lexer, operand, unary_op_power, was_variable));
+	}
+	default:
+		return nullptr;
+	}
+
+	lexer.eat();
+	return node;
+}
+
+static expr::expr_p parse_operators(Lexer& lexer, expr::expr_p lhs, int min_power, bool& was_variable)
+{
+	while (true)
+	{
+		if (lexer.curr().type == TokenType::OPEN_SQUARE && was_variable)
 		{
-			node = parse_expr(lexer, err_on_empty);
-			lexer.curr_check(TokenType::CLOSE_BRACKET);
+			if (subscript_power <= min_power)
+				return lhs;
 
-			node->guard = true;
+			auto index_expr = parse_expr(lexer, true);
+			lexer.curr_check(TokenType::CLOSE_SQUARE);
 
-			allow_unary_next = false;
-			was_variable = false;
-			break;
+			lhs = make_node<expr::BinaryOp>(lexer.pos(), expr::BinaryOpType::SUBSCRIPT, index_expr, lhs);
+			was_variable = true;
+
+			lexer.eat();
 		}
-		default:
+		else if (lexer.curr().type == TokenType::BINARY_OP)
 		{
-			if (err_on_empty && !head)
-				throw NIGHT_CREATE_FATAL("found '" + lexer.curr().str + "', expected expression");
+			auto const& str = lexer.curr().str;
+			auto const& op = binary_ops[(unsigned char)str[0]][str.length() > 1 && str[1] == '='];
 
-			return head;
-		}
-		}
+			if (!op.power)
+				throw NIGHT_CREATE_FATAL("unknown operator '" + std::string(str) + "'");
 
-		if (!head)
-			head = node;
+			if (op.power <= min_power)
+				return lhs;
+
+			auto loc = lexer.pos();
+
+			lexer.eat();
+			auto rhs = parse_operand(lexer, was_variable);
+
+			if (!rhs)
+				throw NIGHT_CREATE_FATAL("found '" + std::string(lexer.curr().str) + "', expected expression");
+
+			lhs = make_node<expr::BinaryOp>(loc, op.type, lhs, parse_operators(lexer, rhs, op.power, was_variable));
+		}
 		else
-			head->insert_node(node, &head);
+		{
+			return lhs;
+		}
 	}
 }
\ No newline at end of file
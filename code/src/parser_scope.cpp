@@ -1,76 +1,146 @@
 #include "parser_scope.hpp"
 #include "value_type.hpp"
 #include "error.hpp"
+#include "symbols.hpp"
 
+#include <algorithm>
 #include <optional>
 #include <string>
+#include <vector>
+#include <cstddef>
 
 scope_func_container ParserScope::funcs = {
-	{ "print", ParserFunction{ 0, {}, { ValueType::BOOL }, std::nullopt } },
-	{ "print", ParserFunction{ 1, {}, { ValueType::CHAR }, std::nullopt } },
-	{ "print", ParserFunction{ 2, {}, { ValueType::INT }, std::nullopt } },
-	{ "print", ParserFunction{ 3, {}, { ValueType::FLOAT }, std::nullopt } },
-	{ "print", ParserFunction{ 4, {}, { ValueType::STR }, std::nullopt } },
-	{ "input", ParserFunction{ 5, {}, {}, ValueType::STR } },
-	{ "char",   ParserFunction{ 6, {}, { ValueType::INT }, ValueType::CHAR } },
-	{ "int",   ParserFunction{ 7, {}, { ValueType::STR }, ValueType::INT } },
-	{ "int",   ParserFunction{ 8, {}, { ValueType::CHAR }, ValueType::INT } },
-	{ "str",   ParserFunction{ 9, {}, { ValueType::INT }, ValueType::STR } },
-	{ "str",   ParserFunction{ 10, {}, { ValueType::FLOAT }, ValueType::STR } },
-	{ "len",   ParserFunction{ 11, {}, { ValueType::STR }, ValueType::INT } }
+	{ symbols::intern("print"), {
+		{ { ValueType::BOOL },  ParserFunction{ 0, {}, std::nullopt, false } },
+		{ { ValueType::CHAR },  ParserFunction{ 1, {}, std::nullopt, false } },
+		{ { ValueType::INT },   ParserFunction{ 2, {}, std::nullopt, false } },
+		{ { ValueType::FLOAT }, ParserFunction{ 3, {}, std::nullopt, false } },
+		{ { ValueType::STR },   ParserFunction{ 4, {}, std::nullopt, false } } } },
+	{ symbols::intern("input"), {
+		{ {}, ParserFunction{ 5, {}, ValueType::STR, false } } } },
+	{ symbols::intern("char"), {
+		{ { ValueType::INT }, ParserFunction{ 6, {}, ValueType::CHAR, true } } } },
+	{ symbols::intern("int"), {
+		{ { ValueType::STR },  ParserFunction{ 7, {}, ValueType::INT, true } },
+		{ { ValueType::CHAR }, ParserFunction{ 8, {}, ValueType::INT, true } } } },
+	{ symbols::intern("str"), {
+		{ { ValueType::INT },   ParserFunction{ 9, {}, ValueType::STR, true } },
+		{ { ValueType::FLOAT }, ParserFunction{ 10, {}, ValueType::STR, true } } } },
+	{ symbols::intern("len"), {
+		{ { ValueType::STR }, ParserFunction{ 11, {}, ValueType::INT, true } } } }
 };
 
+std::unordered_set<bytecode_t> ParserScope::reassigned_vars = {};
+
+bytecode_t ParserScope::next_var_id = 0;
+
 ParserScope::ParserScope()
-	: vars() {}
+	: upper(nullptr) {}
 
-ParserScope::ParserScope(ParserScope const& upper_scope)
-	: vars(upper_scope.vars), rtn_type(upper_scope.rtn_type) {}
+ParserScope::ParserScope(ParserScope const* upper_scope)
+	: upper(upper_scope), rtn_type(upper_scope->rtn_type) {}
 
-ParserScope::ParserScope(ParserScope const& upper_scope, std::optional<ValueType> const& _rtn_type)
-	: vars(upper_scope.vars), rtn_type(_rtn_type) {}
+ParserScope::ParserScope(ParserScope const* upper_scope, std::optional<ValueType> const& _rtn_type)
+	: upper(upper_scope), rtn_type(_rtn_type) {}
 
 std::optional<bytecode_t> ParserScope::create_variable(
-	std::string const& name,
+	symbol_t name,
 	ValueType const& type,
-	Location const& loc)
+	SourcePos loc)
 {
-	static bytecode_t var_id = 0;
+	if (find_variable(name))
+		night::error::get().create_minor_error("variable '" + symbols::name(name) + "' is already defined", loc);
 
-	if (vars.contains(name))
-		night::error::get().create_minor_error("variable '" + name + "' is already defined", loc);
-
-	if (var_id == bytecode_t_lim)
+	if (next_var_id == bytecode_t_lim)
 		night::error::get().create_minor_error("only " + std::to_string(bytecode_t_lim) + " variables allowed per scope", loc);
 
 	if (night::error::get().has_minor_errors())
 		return std::nullopt;
 
-	vars[name] = { type, var_id };
-	return var_id++;
+	vars[name] = { type, next_var_id };
+	return next_var_id++;
 }
 
-scope_func_container::iterator ParserScope::create_function(
-	std::string const& name,
-	std::vector<std::string> const& param_names,
+ParserFunction const& ParserScope::create_function(
+	symbol_t name,
+	std::vector<symbol_t> const& param_names,
 	std::vector<ValueType> const& param_types,
 	std::optional<ValueType> const& rtn_type)
 {
-	static bytecode_t func_id = ParserScope::funcs.size();
+	// ids of user functions come after the builtin functions
+	static bytecode_t func_id = [] {
+		bytecode_t count = 0;
+		for (auto const& [_, overloads] : funcs)
+			count += (bytecode_t)overloads.size();
+
+		return count;
+	}();
+
+	auto [it, is_new] = funcs[name].try_emplace(param_types, ParserFunction{ func_id, param_names, rtn_type, false });
+	if (!is_new)
+		throw "function is already defined";
+
+	++func_id;
+	return it->second;
+}
+
+ParserFunction const* ParserScope::find_function(symbol_t name, std::vector<ValueType> const& arg_types)
+{
+	auto overloads = funcs.find(name);
+	if (overloads == std::end(funcs))
+		return nullptr;
+
+	auto func = overloads->second.find(arg_types);
+	if (func == std::end(overloads->second))
+		return nullptr;
+
+	return &func->second;
+}
+
+ParserVariable const* ParserScope::find_variable(symbol_t name) const
+{
+	for (auto scope = this; scope; scope = scope->upper)
+	{
+		if (auto it = scope->vars.find(name); it != std::end(scope->vars))
+			return &it->second;
+	}
 
-	auto [it, range_end] = ParserScope::funcs.equal_range(name);
+	return nullptr;
+}
 
-	for (; it != range_end; ++it)
+expr::Value* ParserScope::find_constant(bytecode_t id) const
+{
+	for (auto scope = this; scope; scope = scope->upper)
 	{
-		if (std::equal(std::begin(param_types), std::end(param_types),
-					   std::begin(it->second.param_types), std::end(it->second.param_types),
-					   compare_absolute_vt))
-			throw "function is already defined";
+		if (auto it = scope->constant_vars.find(id); it != std::end(scope->constant_vars))
+			return it->second;
 	}
 
-	return funcs.emplace(name, ParserFunction{ func_id++, param_names, param_types, rtn_type });
+	return nullptr;
+}
+
+void ParserScope::set_constant(bytecode_t id, expr::Value* value)
+{
+	constant_vars[id] = value;
+}
+
+std::size_t SignatureHash::operator()(std::vector<ValueType> const& param_types) const
+{
+	std::size_t hash = param_types.size();
+	for (auto const& type : param_types)
+		hash = hash * 31 + (std::size_t)type.dim * 8 + type.type;
+
+	return hash;
+}
+
+bool SignatureEqual::operator()(std::vector<ValueType> const& param_types1, std::vector<ValueType> const& param_types2) const
+{
+	return std::equal(std::begin(param_types1), std::end(param_types1),
+					  std::begin(param_types2), std::end(param_types2),
+					  compare_absolute_vt);
 }
 
-void ParserScope::check_return_type(std::optional<ValueType> const& _rtn_type, Location const& loc) const
+void ParserScope::check_return_type(std::optional<ValueType> const& _rtn_type, SourcePos loc) const
 {
 	if (_rtn_type.has_value())
 	{
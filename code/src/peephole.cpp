@@ -0,0 +1,584 @@
+#include "peephole.hpp"
+#include "interpreter.hpp"
+#include "ast/expression.hpp"
+#include "bytecode.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <cstring>
+#include <stdint.h>
+
+// encodes an integer constant in exactly count bytes
+static bytecodes_t int_to_bytecodes(uint64_t uint64, int count)
+{
+	bytecodes_t codes;
+
+	switch (count)
+	{
+	case 1: codes.push_back((bytecode_t)BytecodeType::S_INT1); break;
+	case 2: codes.push_back((bytecode_t)BytecodeType::S_INT2); break;
+	case 4: codes.push_back((bytecode_t)BytecodeType::S_INT4); break;
+	case 8: codes.push_back((bytecode_t)BytecodeType::S_INT8); break;
+	default:
+		throw debug::unhandled_case(count);
+	}
+
+	while (count--)
+	{
+		codes.push_back(uint64 & 0xFF);
+		uint64 >>= 8;
+	}
+
+	return codes;
+}
+
+// appends an integer in exactly count bytes, without a type
+static void push_fixed_int(bytecodes_t& codes, uint64_t uint64, int count)
+{
+	while (count--)
+	{
+		codes.push_back(uint64 & 0xFF);
+		uint64 >>= 8;
+	}
+}
+
+static Instruction make_int(int64_t val)
+{
+	return Instruction{ BytecodeType::S_INT8, val, {}, 0 };
+}
+
+static Instruction make_float(float val)
+{
+	bytecodes_t operands(sizeof(float));
+	std::memcpy(operands.data(), &val, sizeof(float));
+
+	return Instruction{ BytecodeType::FLOAT4, 0, operands, 0 };
+}
+
+std::vector<PeepholeRule> const peephole_rules = {
+	// STORE x; LOAD x  =>  STORE_KEEP x
+	{ { BytecodeType::STORE, BytecodeType::LOAD },
+	  [](std::vector<Instruction> const& instrs) -> std::optional<std::vector<Instruction>> {
+		if (instrs[0].operands != instrs[1].operands)
+			return std::nullopt;
+
+		return std::vector<Instruction>{ { BytecodeType::STORE_KEEP, 0, instrs[0].operands, 0 } };
+	  } },
+
+	// S_INT c; I2F  =>  FLOAT4 (float)c
+	{ { BytecodeType::S_INT8, BytecodeType::I2F },
+	  [](std::vector<Instruction> const& instrs) -> std::optional<std::vector<Instruction>> {
+		return std::vector<Instruction>{ make_float((float)instrs[0].val) };
+	  } },
+
+	// FLOAT4 c; F2I  =>  S_INT (int)c
+	{ { BytecodeType::FLOAT4, BytecodeType::F2I },
+	  [](std::vector<Instruction> const& instrs) -> std::optional<std::vector<Instruction>> {
+		float val;
+		std::memcpy(&val, instrs[0].operands.data(), sizeof(float));
+
+		// out of range conversions are left for the interpreter
+		if (!(val > (float)std::numeric_limits<int64_t>::min() && val < (float)std::numeric_limits<int64_t>::max()))
+			return std::nullopt;
+
+		return std::vector<Instruction>{ make_int((int64_t)val) };
+	  } },
+
+	// NOT_I; JUMP_IF_FALSE  =>  JUMP_IF_TRUE
+	{ { BytecodeType::NOT_I, BytecodeType::JUMP_IF_FALSE },
+	  [](std::vector<Instruction> const& instrs) -> std::optional<std::vector<Instruction>> {
+		return std::vector<Instruction>{ { BytecodeType::JUMP_IF_TRUE, 0, {}, instrs[1].target } };
+	  } },
+
+	// NOT_I; JUMP_IF_TRUE  =>  JUMP_IF_FALSE
+	{ { BytecodeType::NOT_I, BytecodeType::JUMP_IF_TRUE },
+	  [](std::vector<Instruction> const& instrs) -> std::optional<std::vector<Instruction>> {
+		return std::vector<Instruction>{ { BytecodeType::JUMP_IF_FALSE, 0, {}, instrs[1].target } };
+	  } },
+};
+
+void peephole(bytecodes_t& codes)
+{
+	auto instrs = decode_instructions(codes);
+	if (!instrs.has_value())
+		return;
+
+	// each pass can expose more rewrites to the others, so they are repeated
+	// until none of them change anything
+	bool changed = true;
+	while (changed)
+	{
+		changed = thread_jumps(*instrs);
+		changed |= remove_dead_codes(*instrs);
+		changed |= apply_rules(*instrs);
+	}
+
+	auto optimized_codes = encode_instructions(*instrs);
+	if (optimized_codes.has_value())
+		codes = *optimized_codes;
+}
+
+std::optional<std::vector<Instruction>> decode_instructions(bytecodes_t const& codes)
+{
+	std::vector<Instruction> instrs;
+
+	// byte position of each instruction, and of each jump's destination
+	std::vector<std::size_t> positions;
+	std::vector<std::size_t> target_positions;
+
+	for (auto it = std::cbegin(codes); it != std::cend(codes); ++it)
+	{
+		std::size_t pos = std::distance(std::cbegin(codes), it);
+		Instruction instr{ (BytecodeType)*it, 0, {}, 0 };
+		std::size_t target_pos = 0;
+
+		switch (instr.type)
+		{
+		case BytecodeType::S_INT1: case BytecodeType::S_INT2:
+		case BytecodeType::S_INT4: case BytecodeType::S_INT8:
+		case BytecodeType::U_INT1: case BytecodeType::U_INT2:
+		case BytecodeType::U_INT4: case BytecodeType::U_INT8:
+			instr.type = BytecodeType::S_INT8;
+			instr.val = get_int<int64_t>(it);
+			break;
+
+		case BytecodeType::FLOAT4:
+		case BytecodeType::FLOAT8: {
+			int count = instr.type == BytecodeType::FLOAT4 ? 4 : 8;
+			instr.operands.assign(it + 1, it + 1 + count);
+			std::advance(it, count);
+			break;
+		}
+		case BytecodeType::STR: {
+			auto start = it + 1;
+			int64_t length = get_int<int64_t>(++it);
+			std::advance(it, length);
+			instr.operands.assign(start, it + 1);
+			break;
+		}
+		case BytecodeType::ARR:
+		case BytecodeType::LOAD:
+		case BytecodeType::STORE:
+		case BytecodeType::STORE_KEEP:
+		case BytecodeType::CALL:
+		case BytecodeType::SHIFT_LEFT_I:
+		case BytecodeType::DIV_POW2_I:
+		case BytecodeType::MOD_POW2_I:
+			instr.operands.push_back(*(++it));
+			break;
+
+		case BytecodeType::SET_INDEX:
+		case BytecodeType::SET_INDEX_UNCHECKED:
+			instr.operands.push_back(*(++it));
+			instr.operands.push_back(*(++it));
+			break;
+
+		case BytecodeType::VECTOR_MAP:
+		case BytecodeType::VECTOR_SUM: {
+			auto start = it + 1;
+
+			++it;
+			auto length = *(++it);
+			std::advance(it, length);
+
+			instr.operands.assign(start, it + 1);
+			break;
+		}
+
+		case BytecodeType::COUNT:
+			instr.operands.assign(it + 1, it + 5);
+			std::advance(it, 4);
+			break;
+
+		case BytecodeType::DIV_MAGIC_I:
+		case BytecodeType::MOD_MAGIC_I: {
+			auto start = it + 1;
+
+			get_int<int64_t>(++it);
+			++it;
+
+			if (instr.type == BytecodeType::MOD_MAGIC_I)
+				get_int<int64_t>(++it);
+
+			instr.operands.assign(start, it + 1);
+			break;
+		}
+
+		case BytecodeType::JUMP:
+			target_pos = pos + 5 + get_fixed_int<uint32_t>(it);
+			break;
+		case BytecodeType::NJUMP:
+			instr.type = BytecodeType::JUMP;
+			target_pos = pos + 5 - get_fixed_int<uint32_t>(it);
+			break;
+
+		case BytecodeType::JUMP_IF_FALSE:
+		case BytecodeType::JUMP_IF_TRUE:
+			// the offset is the integer constant right before the jump,
+			// and the jump starts where the constant does
+			if (instrs.empty() || instrs.back().type != BytecodeType::S_INT8)
+				return std::nullopt;
+
+			target_pos = pos + 1 + instrs.back().val;
+
+			pos = positions.back();
+			instrs.pop_back();
+			positions.pop_back();
+			target_positions.pop_back();
+			break;
+
+		case BytecodeType::TABLE_SWITCH:
+		case BytecodeType::LOOKUP_SWITCH: {
+			if (instr.type == BytecodeType::TABLE_SWITCH)
+				instr.val = get_fixed_int<int64_t>(it);
+
+			auto count = get_fixed_int<uint16_t>(it);
+			std::vector<int64_t> offsets{ get_fixed_int<int32_t>(it) };
+
+			for (int i = 0; i < count; ++i)
+			{
+				if (instr.type == BytecodeType::LOOKUP_SWITCH)
+					instr.keys.push_back(get_fixed_int<int64_t>(it));
+
+				offsets.push_back(get_fixed_int<int32_t>(it));
+			}
+
+			// the offsets are from the end of the switch, and the positions of the
+			// cases are kept in the targets until every position is known
+			std::size_t end = std::distance(std::cbegin(codes), it) + 1;
+
+			target_pos = end + offsets[0];
+			for (int i = 0; i < count; ++i)
+				instr.targets.push_back(end + offsets[i + 1]);
+
+			break;
+		}
+
+		default:
+			break;
+		}
+
+		instrs.push_back(instr);
+		positions.push_back(pos);
+		target_positions.push_back(target_pos);
+	}
+
+	std::unordered_map<std::size_t, std::size_t> indices;
+	for (std::size_t i = 0; i < positions.size(); ++i)
+		indices[positions[i]] = i;
+
+	indices[codes.size()] = instrs.size();
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		if (!is_jump(instrs[i].type) && !is_switch(instrs[i].type))
+			continue;
+
+		instrs[i].target = target_positions[i];
+
+		bool is_valid = true;
+		for_each_target(instrs[i], [&](std::size_t& target) {
+			is_valid = is_valid && indices.contains(target);
+			if (is_valid)
+				target = indices[target];
+		});
+
+		if (!is_valid)
+			return std::nullopt;
+	}
+
+	return instrs;
+}
+
+std::optional<bytecodes_t> encode_instructions(std::vector<Instruction> const& instrs)
+{
+	// the size of a conditional jump depends on its offset, which depends on the
+	// sizes of the instructions it jumps over, so the number of bytes of each
+	// offset starts at one and only grows until every offset fits
+	std::vector<int> offset_counts(instrs.size(), 1);
+	std::vector<std::size_t> positions(instrs.size() + 1);
+
+	auto size_of = [&](std::size_t i) -> std::size_t {
+		switch (instrs[i].type)
+		{
+		case BytecodeType::S_INT8:
+			return expr::Value::int_to_bytecodes(instrs[i].val).size();
+		case BytecodeType::JUMP:
+			return 5;
+		case BytecodeType::JUMP_IF_FALSE:
+		case BytecodeType::JUMP_IF_TRUE:
+			return 2 + offset_counts[i];
+		case BytecodeType::TABLE_SWITCH:
+			return 15 + 4 * instrs[i].targets.size();
+		case BytecodeType::LOOKUP_SWITCH:
+			return 7 + 12 * instrs[i].targets.size();
+		default:
+			return 1 + instrs[i].operands.size();
+		}
+	};
+
+	// the offset is relative to the conditional jump, after the constant
+	auto cond_offset = [&](std::size_t i) -> int64_t {
+		return (int64_t)positions[instrs[i].target] - (int64_t)(positions[i + 1] - 1) - 1;
+	};
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (std::size_t i = 0; i < instrs.size(); ++i)
+			positions[i + 1] = positions[i] + size_of(i);
+
+		for (std::size_t i = 0; i < instrs.size(); ++i)
+		{
+			if (instrs[i].type != BytecodeType::JUMP_IF_FALSE && instrs[i].type != BytecodeType::JUMP_IF_TRUE)
+				continue;
+
+			int count = expr::Value::int_to_bytecodes(cond_offset(i)).size() - 1;
+			if (count > offset_counts[i])
+			{
+				offset_counts[i] = count;
+				changed = true;
+			}
+		}
+	}
+
+	bytecodes_t codes;
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		auto const& instr = instrs[i];
+
+		switch (instr.type)
+		{
+		case BytecodeType::S_INT8: {
+			auto int_codes = expr::Value::int_to_bytecodes(instr.val);
+			codes.insert(std::end(codes), std::begin(int_codes), std::end(int_codes));
+			break;
+		}
+		case BytecodeType::JUMP: {
+			auto target_pos = positions[instr.target];
+			auto end = positions[i + 1];
+
+			auto offset = target_pos >= end ? target_pos - end : end - target_pos;
+			if (offset > std::numeric_limits<uint32_t>::max())
+				return std::nullopt;
+
+			codes.push_back((bytecode_t)(target_pos >= end ? BytecodeType::JUMP : BytecodeType::NJUMP));
+			push_fixed_int(codes, offset, 4);
+			break;
+		}
+		case BytecodeType::JUMP_IF_FALSE:
+		case BytecodeType::JUMP_IF_TRUE: {
+			auto offset_codes = int_to_bytecodes(cond_offset(i), offset_counts[i]);
+			codes.insert(std::end(codes), std::begin(offset_codes), std::end(offset_codes));
+			codes.push_back((bytecode_t)instr.type);
+			break;
+		}
+		case BytecodeType::TABLE_SWITCH:
+		case BytecodeType::LOOKUP_SWITCH: {
+			if (instr.targets.size() > std::numeric_limits<uint16_t>::max())
+				return std::nullopt;
+
+			// the offsets are from the end of the switch
+			bool fits = true;
+			auto push_offset = [&](std::size_t target) {
+				auto offset = (int64_t)positions[target] - (int64_t)positions[i + 1];
+				fits = fits && offset >= std::numeric_limits<int32_t>::min() && offset <= std::numeric_limits<int32_t>::max();
+				push_fixed_int(codes, offset, 4);
+			};
+
+			codes.push_back((bytecode_t)instr.type);
+			if (instr.type == BytecodeType::TABLE_SWITCH)
+				push_fixed_int(codes, instr.val, 8);
+
+			push_fixed_int(codes, instr.targets.size(), 2);
+			push_offset(instr.target);
+
+			for (std::size_t j = 0; j < instr.targets.size(); ++j)
+			{
+				if (instr.type == BytecodeType::LOOKUP_SWITCH)
+					push_fixed_int(codes, instr.keys[j], 8);
+
+				push_offset(instr.targets[j]);
+			}
+
+			if (!fits)
+				return std::nullopt;
+
+			break;
+		}
+		default:
+			codes.push_back((bytecode_t)instr.type);
+			codes.insert(std::end(codes), std::begin(instr.operands), std::end(instr.operands));
+			break;
+		}
+	}
+
+	return codes;
+}
+
+bool apply_rules(std::vector<Instruction>& instrs)
+{
+	std::vector<bool> is_target(instrs.size() + 1, false);
+	for (auto& instr : instrs)
+		for_each_target(instr, [&](std::size_t& target) { is_target[target] = true; });
+
+	std::vector<Instruction> optimized;
+
+	// index in the optimized instructions of each instruction
+	std::vector<std::size_t> new_indices(instrs.size() + 1);
+	bool changed = false;
+
+	for (std::size_t i = 0; i < instrs.size();)
+	{
+		new_indices[i] = optimized.size();
+
+		std::optional<std::vector<Instruction>> replacement;
+		std::size_t window = 0;
+
+		for (auto const& rule : peephole_rules)
+		{
+			window = rule.pattern.size();
+			if (i + window > instrs.size())
+				continue;
+
+			bool matches = true;
+			for (std::size_t j = 0; j < window && matches; ++j)
+				matches = instrs[i + j].type == rule.pattern[j] && (j == 0 || !is_target[i + j]);
+
+			if (!matches)
+				continue;
+
+			replacement = rule.rewrite({ std::begin(instrs) + i, std::begin(instrs) + i + window });
+			if (replacement.has_value())
+				break;
+		}
+
+		if (!replacement.has_value())
+		{
+			optimized.push_back(instrs[i]);
+			++i;
+			continue;
+		}
+
+		for (std::size_t j = 1; j < window; ++j)
+			new_indices[i + j] = optimized.size();
+
+		optimized.insert(std::end(optimized), std::begin(*replacement), std::end(*replacement));
+		i += window;
+		changed = true;
+	}
+
+	new_indices[instrs.size()] = optimized.size();
+
+	for (auto& instr : optimized)
+		for_each_target(instr, [&](std::size_t& target) { target = new_indices[target]; });
+
+	instrs = optimized;
+	return changed;
+}
+
+bool thread_jumps(std::vector<Instruction>& instrs)
+{
+	bool changed = false;
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		bool is_conditional = instrs[i].type == BytecodeType::JUMP_IF_FALSE || instrs[i].type == BytecodeType::JUMP_IF_TRUE;
+
+		for_each_target(instrs[i], [&](std::size_t& target) {
+			if (target == instrs.size() || instrs[target].type != BytecodeType::JUMP)
+				return;
+
+			// conditional jumps only go forwards
+			auto new_target = instrs[target].target;
+			if (new_target == target || (is_conditional && new_target <= i))
+				return;
+
+			target = new_target;
+			changed = true;
+		});
+	}
+
+	return changed;
+}
+
+bool remove_dead_codes(std::vector<Instruction>& instrs)
+{
+	std::vector<bool> is_target(instrs.size() + 1, false);
+	for (auto& instr : instrs)
+		for_each_target(instr, [&](std::size_t& target) { is_target[target] = true; });
+
+	std::vector<bool> removed(instrs.size(), false);
+	bool is_reachable = true;
+	bool changed = false;
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		if (is_target[i])
+			is_reachable = true;
+
+		if (!is_reachable || (instrs[i].type == BytecodeType::JUMP && instrs[i].target == i + 1))
+		{
+			removed[i] = true;
+			changed = true;
+			continue;
+		}
+
+		if (instrs[i].type == BytecodeType::JUMP || instrs[i].type == BytecodeType::RETURN || is_switch(instrs[i].type))
+			is_reachable = false;
+	}
+
+	if (changed)
+		remove_instructions(instrs, removed);
+
+	return changed;
+}
+
+void remove_instructions(std::vector<Instruction>& instrs, std::vector<bool> const& removed)
+{
+	std::vector<Instruction> kept;
+	std::vector<std::size_t> new_indices(instrs.size() + 1);
+
+	for (std::size_t i = 0; i < instrs.size(); ++i)
+	{
+		new_indices[i] = kept.size();
+
+		if (!removed[i])
+			kept.push_back(instrs[i]);
+	}
+
+	new_indices[instrs.size()] = kept.size();
+
+	for (auto& instr : kept)
+		for_each_target(instr, [&](std::size_t& target) { target = new_indices[target]; });
+
+	instrs = kept;
+}
+
+bool is_jump(BytecodeType type)
+{
+	return type == BytecodeType::JUMP ||
+		   type == BytecodeType::JUMP_IF_FALSE ||
+		   type == BytecodeType::JUMP_IF_TRUE;
+}
+
+bool is_switch(BytecodeType type)
+{
+	return type == BytecodeType::TABLE_SWITCH ||
+		   type == BytecodeType::LOOKUP_SWITCH;
+}
+
+void for_each_target(Instruction& instr, std::function<void(std::size_t&)> const& fn)
+{
+	if (!is_jump(instr.type) && !is_switch(instr.type))
+		return;
+
+	fn(instr.target);
+	for (auto& target : instr.targets)
+		fn(target);
+}
@@ -0,0 +1,98 @@
+#include "profile.hpp"
+#include "ir.hpp"
+#include "interpreter.hpp"
+#include "error.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <utility>
+#include <vector>
+
+std::optional<std::string> ir::profile_out_file;
+std::optional<std::string> ir::profile_in_file;
+
+static std::string const profile_header = "night profile";
+
+// the function and block of each counter, where the top level code is "main"
+// and a function is its id
+static std::vector<std::pair<std::string, ir::block_t>> counter_blocks;
+
+// a function is known by its id, which stays the same for the same source,
+// unlike its name, which can be overloaded
+static std::unordered_map<std::string, ir::Function*> functions_by_name(ir::Module& module)
+{
+	std::unordered_map<std::string, ir::Function*> funcs{ { "main", &module.main } };
+	for (auto& [id, func] : module.funcs)
+		funcs[std::to_string(id)] = &func;
+
+	return funcs;
+}
+
+void ir::instrument(Module& module)
+{
+	for (auto& [name, func] : functions_by_name(module))
+	{
+		for (block_t block = 0; block < func->blocks.size(); ++block)
+		{
+			func->blocks[block].counter = (uint32_t)counter_blocks.size();
+			counter_blocks.emplace_back(name, block);
+		}
+	}
+
+	profile_counts.resize(counter_blocks.size(), 0);
+}
+
+void ir::write_profile(std::string const& file)
+{
+	std::ofstream out(file);
+	if (!out.is_open())
+		throw night::error::get().create_fatal_error("profile '" + file + "' could not be opened", { file, 0, 0 });
+
+	out << profile_header << '\n';
+	for (std::size_t i = 0; i < counter_blocks.size(); ++i)
+		out << counter_blocks[i].first << ' ' << counter_blocks[i].second << ' ' << profile_counts[i] << '\n';
+}
+
+void ir::read_profile(Module& module, std::string const& file)
+{
+	Location loc{ file, 1, 0 };
+
+	std::ifstream in(file);
+	if (!in.is_open())
+		throw night::error::get().create_fatal_error("profile '" + file + "' could not be found/opened", loc);
+
+	std::string line;
+	if (!std::getline(in, line) || line != profile_header)
+		throw night::error::get().create_fatal_error("'" + file + "' is not a profile written by --profile-out", loc);
+
+	auto funcs = functions_by_name(module);
+
+	while (std::getline(in, line))
+	{
+		++loc.line;
+
+		std::istringstream words(line);
+		std::string name;
+		block_t block;
+		uint64_t count;
+
+		if (!(words >> name >> block >> count))
+			throw night::error::get().create_fatal_error("expected a function, a block and a count", loc);
+
+		// the profile can be from an older version of the source
+		if (!funcs.contains(name) || block >= funcs[name]->blocks.size())
+			continue;
+
+		// the blocks of a function in the profile ran no times unless they have a line
+		auto& blocks = funcs[name]->blocks;
+		if (!blocks[0].count.has_value())
+		{
+			for (auto& other : blocks)
+				other.count = 0;
+		}
+
+		blocks[block].count = count;
+	}
+}
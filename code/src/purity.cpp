@@ -0,0 +1,84 @@
+#include "purity.hpp"
+#include "ir.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+bool ir::find_pure_functions(Module& module)
+{
+	// every function starts as pure, and functions are found not to be pure until
+	// nothing changes, so calls between pure functions do not make them impure
+	std::unordered_set<bytecode_t> impure_funcs;
+
+	auto is_impure_call = [&](Instruction const& instr) {
+		if (module.funcs.contains(instr.id))
+			return impure_funcs.contains(instr.id);
+
+		return !instr.is_pure;
+	};
+
+	auto is_impure = [&](Function const& func) {
+		for (auto const& block : func.blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				switch (instr.op)
+				{
+				case Op::LOAD:
+				case Op::STORE:
+				case Op::SET_INDEX:
+					if (std::find(std::begin(func.var_ids), std::end(func.var_ids), instr.id) == std::end(func.var_ids))
+						return true;
+					break;
+
+				case Op::CALL:
+					if (is_impure_call(instr))
+						return true;
+					break;
+
+				default:
+					break;
+				}
+			}
+		}
+
+		return false;
+	};
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (auto const& [id, func] : module.funcs)
+		{
+			if (!impure_funcs.contains(id) && is_impure(func))
+			{
+				impure_funcs.insert(id);
+				changed = true;
+			}
+		}
+	}
+
+	for (auto& [id, func] : module.funcs)
+		func.is_pure = !impure_funcs.contains(id);
+
+	bool marked = false;
+
+	auto mark_calls = [&](Function& func) {
+		for (auto& block : func.blocks)
+		{
+			for (auto& instr : block.instrs)
+			{
+				if (instr.op == Op::CALL && !instr.is_pure && module.funcs.contains(instr.id) && !impure_funcs.contains(instr.id))
+					marked = instr.is_pure = true;
+			}
+		}
+	};
+
+	mark_calls(module.main);
+	for (auto& [id, func] : module.funcs)
+		mark_calls(func);
+
+	return marked;
+}
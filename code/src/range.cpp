@@ -0,0 +1,743 @@
+#include "range.hpp"
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <optional>
+#include <variant>
+#include <stdint.h>
+
+// id of the builtin function len(), from ParserScope::funcs
+constexpr bytecode_t len_func_id = 11;
+
+// bounds that are not bounded stay that way, and other results saturate
+static int64_t add_bounds(int64_t a, int64_t b)
+{
+	if (a == ir::Range::min || a == ir::Range::max)
+		return a;
+	if (b == ir::Range::min || b == ir::Range::max)
+		return b;
+
+	if (b > 0 && a > ir::Range::max - b)
+		return ir::Range::max;
+	if (b < 0 && a < ir::Range::min - b)
+		return ir::Range::min;
+
+	return a + b;
+}
+
+static int64_t negate_bound(int64_t a)
+{
+	if (a == ir::Range::min)
+		return ir::Range::max;
+	if (a == ir::Range::max)
+		return ir::Range::min;
+
+	return -a;
+}
+
+// both bounds can not be negative
+static int64_t mult_bounds(int64_t a, int64_t b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	if (a == ir::Range::max || b == ir::Range::max || a > ir::Range::max / b)
+		return ir::Range::max;
+
+	return a * b;
+}
+
+static ir::Range hull(std::optional<ir::Range> const& a, ir::Range const& b)
+{
+	if (!a.has_value())
+		return b;
+
+	return { std::min(a->lo, b.lo), std::max(a->hi, b.hi) };
+}
+
+// the dimensions known by both, and the shorter length of each
+static std::vector<int64_t> meet(std::optional<std::vector<int64_t>> const& a, std::vector<int64_t> const& b)
+{
+	if (!a.has_value())
+		return b;
+
+	std::vector<int64_t> lengths;
+	for (std::size_t i = 0; i < std::min(a->size(), b.size()); ++i)
+		lengths.push_back(std::min((*a)[i], b[i]));
+
+	return lengths;
+}
+
+
+ir::RangeAnalysis::RangeAnalysis(Function const& _func)
+	: func(_func), doms(_func)
+{
+	order = reverse_postorder(func);
+	preds = predecessors(func);
+
+	defs.assign(func.value_types.size(), nullptr);
+	positions.resize(func.value_types.size());
+
+	for (auto block : order)
+	{
+		auto const& instrs = func.blocks[block].instrs;
+		for (std::size_t i = 0; i < instrs.size(); ++i)
+		{
+			if (instrs[i].result.has_value())
+			{
+				defs[*instrs[i].result] = &instrs[i];
+				positions[*instrs[i].result] = { block, i };
+			}
+		}
+	}
+
+	find_assigned_vars();
+	find_ranges();
+	find_lengths();
+}
+
+ir::Range ir::RangeAnalysis::range_of(value_t value) const
+{
+	return ranges[value];
+}
+
+ir::Range ir::RangeAnalysis::range_at(value_t value, block_t block) const
+{
+	auto range = ranges[value];
+
+	for (auto const& fact : facts_at(block))
+	{
+		int64_t strict = fact.or_equal ? 0 : 1;
+
+		if (is_same_value(fact.lhs, value))
+			range.hi = std::min(range.hi, add_bounds(ranges[fact.rhs].hi, -strict));
+		if (is_same_value(fact.rhs, value))
+			range.lo = std::max(range.lo, add_bounds(ranges[fact.lhs].lo, strict));
+	}
+
+	return range;
+}
+
+std::vector<int64_t> ir::RangeAnalysis::lengths_of(value_t container) const
+{
+	return lengths[container];
+}
+
+std::vector<int64_t> ir::RangeAnalysis::lengths_of(bytecode_t var_id, Position const& pos) const
+{
+	if (!is_assigned(var_id, pos) || !var_lengths[var_id].has_value())
+		return {};
+
+	return *var_lengths[var_id];
+}
+
+bool ir::RangeAnalysis::is_below_length(value_t index, value_t str, block_t block) const
+{
+	auto is_len_of = [&](value_t value) {
+		auto def = defs[value];
+		return def && def->op == Op::CALL && def->id == len_func_id && is_same_value(def->operands[0], str);
+	};
+
+	for (auto const& fact : facts_at(block))
+	{
+		if (!is_same_value(fact.lhs, index))
+			continue;
+
+		// index < len(str)
+		if (!fact.or_equal && is_len_of(fact.rhs))
+			return true;
+
+		// index <= len(str) - n, where n is at least one
+		auto rhs = defs[fact.rhs];
+		if (fact.or_equal && rhs && rhs->op == Op::BYTECODE && rhs->code == BytecodeType::SUB_I &&
+			is_len_of(rhs->operands[0]) && ranges[rhs->operands[1]].lo >= 1)
+			return true;
+	}
+
+	return false;
+}
+
+bool ir::RangeAnalysis::is_same_value(value_t a, value_t b) const
+{
+	return is_same_value(a, b, false);
+}
+
+std::vector<ir::RangeAnalysis::Fact> ir::RangeAnalysis::facts_at(block_t block) const
+{
+	std::vector<Fact> facts;
+	if (!doms.idoms[block].has_value())
+		return facts;
+
+	// a block that can only be reached from one side of a branch, and the blocks
+	// it dominates, know the condition of the branch
+	for (auto curr = block; ; curr = *doms.idoms[curr])
+	{
+		if (curr != order[0] && preds[curr].size() == 1)
+		{
+			auto const& terminator = func.blocks[preds[curr][0]].terminator;
+			if (terminator.has_value() && terminator->type == TerminatorType::BRANCH && terminator->true_block != terminator->false_block)
+				add_facts(*terminator->value, curr == terminator->true_block, facts);
+		}
+
+		if (*doms.idoms[curr] == curr)
+			break;
+	}
+
+	return facts;
+}
+
+void ir::RangeAnalysis::add_facts(value_t cond, bool is_true, std::vector<Fact>& facts) const
+{
+	auto def = defs[cond];
+	if (!def || def->op != Op::BYTECODE)
+		return;
+
+	switch (def->code)
+	{
+	case BytecodeType::AND:
+		if (is_true)
+		{
+			add_facts(def->operands[0], true, facts);
+			add_facts(def->operands[1], true, facts);
+		}
+		break;
+	case BytecodeType::OR:
+		if (!is_true)
+		{
+			add_facts(def->operands[0], false, facts);
+			add_facts(def->operands[1], false, facts);
+		}
+		break;
+	case BytecodeType::NOT_I:
+		add_facts(def->operands[0], !is_true, facts);
+		break;
+
+	case BytecodeType::LESSER_I:
+		facts.push_back(is_true ? Fact{ def->operands[0], def->operands[1], false } : Fact{ def->operands[1], def->operands[0], true });
+		break;
+	case BytecodeType::GREATER_I:
+		facts.push_back(is_true ? Fact{ def->operands[1], def->operands[0], false } : Fact{ def->operands[0], def->operands[1], true });
+		break;
+	case BytecodeType::LESSER_EQUALS_I:
+		facts.push_back(is_true ? Fact{ def->operands[0], def->operands[1], true } : Fact{ def->operands[1], def->operands[0], false });
+		break;
+	case BytecodeType::GREATER_EQUALS_I:
+		facts.push_back(is_true ? Fact{ def->operands[1], def->operands[0], true } : Fact{ def->operands[0], def->operands[1], false });
+		break;
+
+	case BytecodeType::EQUALS_I:
+	case BytecodeType::NOT_EQUALS_I:
+		if (is_true == (def->code == BytecodeType::EQUALS_I))
+		{
+			facts.push_back({ def->operands[0], def->operands[1], true });
+			facts.push_back({ def->operands[1], def->operands[0], true });
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool ir::RangeAnalysis::is_same_value(value_t a, value_t b, bool elements) const
+{
+	if (a == b)
+		return true;
+
+	auto def_a = defs[a];
+	auto def_b = defs[b];
+	if (!def_a || !def_b || def_a->op != def_b->op || def_a->operands.size() != def_b->operands.size())
+		return false;
+
+	switch (def_a->op)
+	{
+	case Op::CONST:
+		return def_a->constant == def_b->constant;
+
+	case Op::LOAD:
+		if (def_a->id != def_b->id)
+			return false;
+
+		if (dominates(positions[a], positions[b]))
+			return is_unchanged(def_a->id, positions[a], positions[b], elements);
+		if (dominates(positions[b], positions[a]))
+			return is_unchanged(def_a->id, positions[b], positions[a], elements);
+
+		return false;
+
+	case Op::CALL:
+		if (def_a->id != def_b->id || !def_a->is_pure)
+			return false;
+		break;
+
+	case Op::BYTECODE:
+		if (def_a->code != def_b->code || def_a->immediates != def_b->immediates)
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	for (std::size_t i = 0; i < def_a->operands.size(); ++i)
+	{
+		// the container of a subscript is only the same if its elements are
+		bool is_container = def_a->op == Op::BYTECODE && i == 1 &&
+			(def_a->code == BytecodeType::SUBSCRIPT || def_a->code == BytecodeType::SUBSCRIPT_UNCHECKED);
+
+		if (!is_same_value(def_a->operands[i], def_b->operands[i], elements || is_container))
+			return false;
+	}
+
+	return true;
+}
+
+bool ir::RangeAnalysis::is_assigned(bytecode_t var_id, Position const& pos) const
+{
+	if (assigned_vars[pos.block][var_id])
+		return true;
+
+	auto const& instrs = func.blocks[pos.block].instrs;
+	for (std::size_t i = 0; i < pos.index; ++i)
+	{
+		if (instrs[i].op == Op::STORE && instrs[i].id == var_id)
+			return true;
+	}
+
+	return false;
+}
+
+bool ir::RangeAnalysis::is_unchanged(bytecode_t var_id, Position const& from, Position const& to, bool elements) const
+{
+	auto assigns = [&](block_t block, std::size_t start, std::size_t end) {
+		auto const& instrs = func.blocks[block].instrs;
+		for (std::size_t i = start; i < std::min(end, instrs.size()); ++i)
+		{
+			if (instrs[i].id == var_id && (instrs[i].op == Op::STORE || (elements && instrs[i].op == Op::SET_INDEX)))
+				return true;
+		}
+
+		return false;
+	};
+
+	if (from.block == to.block && from.index < to.index)
+		return !assigns(from.block, from.index + 1, to.index);
+
+	// the blocks in between can be reached from the first block, and can reach
+	// the second block, without going through the first block again
+	auto reachable = [&](std::vector<block_t> const& start, auto const& next) {
+		std::vector<bool> visited(func.blocks.size(), false);
+
+		auto worklist = start;
+		while (!worklist.empty())
+		{
+			auto block = worklist.back();
+			worklist.pop_back();
+
+			if (block == from.block || visited[block])
+				continue;
+
+			visited[block] = true;
+			for (auto other : next(block))
+				worklist.push_back(other);
+		}
+
+		return visited;
+	};
+
+	auto forward = reachable(successors(func.blocks[from.block]), [&](block_t block) { return successors(func.blocks[block]); });
+	auto backward = reachable(preds[to.block], [&](block_t block) { return preds[block]; });
+
+	if (assigns(from.block, from.index + 1, func.blocks[from.block].instrs.size()))
+		return false;
+
+	for (block_t block = 0; block < func.blocks.size(); ++block)
+	{
+		if (block != to.block && forward[block] && backward[block] && assigns(block, 0, func.blocks[block].instrs.size()))
+			return false;
+	}
+
+	// all of the second block runs in between if it can reach itself
+	bool is_in_between = to.block != from.block && forward[to.block] && backward[to.block];
+	return !assigns(to.block, 0, is_in_between ? func.blocks[to.block].instrs.size() : to.index);
+}
+
+bool ir::RangeAnalysis::dominates(Position const& a, Position const& b) const
+{
+	if (a.block == b.block)
+		return a.index < b.index;
+
+	return doms.dominates(a.block, b.block);
+}
+
+void ir::RangeAnalysis::find_assigned_vars()
+{
+	VarSet all_vars;
+	all_vars.set();
+
+	assigned_vars.assign(func.blocks.size(), all_vars);
+	if (order.empty())
+		return;
+
+	std::vector<VarSet> stored_vars(func.blocks.size());
+	for (auto block : order)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.op == Op::STORE)
+				stored_vars[block].set(instr.id);
+		}
+	}
+
+	assigned_vars[order[0]].reset();
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (std::size_t i = 1; i < order.size(); ++i)
+		{
+			auto vars = all_vars;
+			for (auto pred : preds[order[i]])
+				vars &= assigned_vars[pred] | stored_vars[pred];
+
+			if (vars != assigned_vars[order[i]])
+			{
+				assigned_vars[order[i]] = vars;
+				changed = true;
+			}
+		}
+	}
+}
+
+void ir::RangeAnalysis::find_ranges()
+{
+	Range const unbounded{ Range::min, Range::max };
+
+	// values and variables have no range until a value reaches them, and the
+	// ranges grow each round until they stop changing
+	std::vector<std::optional<Range>> value_ranges;
+	std::vector<std::optional<Range>> var_ranges(bytecode_t_lim + 1);
+
+	auto compute = [&](Instruction const& instr, Position const& pos) -> std::optional<Range> {
+		if (instr.op == Op::CONST)
+		{
+			if (auto val = std::get_if<int64_t>(&instr.constant))
+				return Range{ *val, *val };
+
+			return unbounded;
+		}
+
+		if (instr.op == Op::LOAD)
+			return is_assigned(instr.id, pos) ? var_ranges[instr.id] : unbounded;
+
+		if (instr.op == Op::CALL)
+			return instr.id == len_func_id ? Range{ 0, Range::max } : unbounded;
+
+		if (instr.op == Op::PHI)
+		{
+			std::optional<Range> range;
+			for (auto operand : instr.operands)
+			{
+				// phis only join values of conditional expressions, which come before them
+				if (!value_ranges[operand].has_value())
+					return unbounded;
+
+				range = hull(range, *value_ranges[operand]);
+			}
+
+			return range;
+		}
+
+		if (std::any_of(std::begin(instr.operands), std::end(instr.operands),
+				[&](value_t operand) { return !value_ranges[operand].has_value(); }))
+			return std::nullopt;
+
+		auto operand = [&](std::size_t i) { return *value_ranges[instr.operands[i]]; };
+
+		switch (instr.code)
+		{
+		case BytecodeType::ADD_I:
+			return Range{ add_bounds(operand(0).lo, operand(1).lo), add_bounds(operand(0).hi, operand(1).hi) };
+		case BytecodeType::SUB_I:
+			return Range{ add_bounds(operand(0).lo, negate_bound(operand(1).hi)), add_bounds(operand(0).hi, negate_bound(operand(1).lo)) };
+		case BytecodeType::MULT_I:
+			if (operand(0).lo < 0 || operand(1).lo < 0)
+				return unbounded;
+
+			return Range{ mult_bounds(operand(0).lo, operand(1).lo), mult_bounds(operand(0).hi, operand(1).hi) };
+		case BytecodeType::NEGATIVE_I:
+			return Range{ negate_bound(operand(0).hi), negate_bound(operand(0).lo) };
+
+		case BytecodeType::SHIFT_LEFT_I:
+			if (operand(0).lo < 0 || instr.immediates[0] >= 63)
+				return unbounded;
+
+			return Range{ mult_bounds(operand(0).lo, int64_t(1) << instr.immediates[0]), mult_bounds(operand(0).hi, int64_t(1) << instr.immediates[0]) };
+		case BytecodeType::DIV_POW2_I:
+			if (operand(0).lo < 0)
+				return unbounded;
+
+			return Range{ operand(0).lo >> instr.immediates[0], operand(0).hi >> instr.immediates[0] };
+		case BytecodeType::MOD_POW2_I:
+			if (operand(0).lo < 0 || instr.immediates[0] >= 63)
+				return unbounded;
+
+			return Range{ 0, std::min(operand(0).hi, (int64_t(1) << instr.immediates[0]) - 1) };
+
+		case BytecodeType::NOT_I: case BytecodeType::NOT_F:
+		case BytecodeType::LESSER_I: case BytecodeType::LESSER_F: case BytecodeType::LESSER_S:
+		case BytecodeType::GREATER_I: case BytecodeType::GREATER_F: case BytecodeType::GREATER_S:
+		case BytecodeType::LESSER_EQUALS_I: case BytecodeType::LESSER_EQUALS_F: case BytecodeType::LESSER_EQUALS_S:
+		case BytecodeType::GREATER_EQUALS_I: case BytecodeType::GREATER_EQUALS_F: case BytecodeType::GREATER_EQUALS_S:
+		case BytecodeType::EQUALS_I: case BytecodeType::EQUALS_F: case BytecodeType::EQUALS_S:
+		case BytecodeType::NOT_EQUALS_I: case BytecodeType::NOT_EQUALS_F: case BytecodeType::NOT_EQUALS_S:
+		case BytecodeType::AND:
+		case BytecodeType::OR:
+			return Range{ 0, 1 };
+
+		default:
+			return unbounded;
+		}
+	};
+
+	bool changed = true;
+	while (changed)
+	{
+		value_ranges.assign(func.value_types.size(), std::nullopt);
+
+		for (auto block : order)
+		{
+			auto const& instrs = func.blocks[block].instrs;
+			for (std::size_t i = 0; i < instrs.size(); ++i)
+			{
+				if (instrs[i].result.has_value())
+					value_ranges[*instrs[i].result] = compute(instrs[i], { block, i });
+			}
+		}
+
+		auto new_var_ranges = var_ranges;
+		for (auto block : order)
+		{
+			for (auto const& instr : func.blocks[block].instrs)
+			{
+				if (instr.op == Op::STORE && value_ranges[instr.operands[0]].has_value())
+					new_var_ranges[instr.id] = hull(new_var_ranges[instr.id], *value_ranges[instr.operands[0]]);
+			}
+		}
+
+		// a bound that still moves, such as the upper bound of a loop counter,
+		// is widened to no bound, so the rounds end
+		changed = false;
+		for (std::size_t id = 0; id < var_ranges.size(); ++id)
+		{
+			auto const& old_range = var_ranges[id];
+			auto& new_range = new_var_ranges[id];
+
+			if (!new_range.has_value() || (old_range.has_value() && *old_range == *new_range))
+				continue;
+
+			if (old_range.has_value())
+			{
+				if (new_range->lo < old_range->lo)
+					new_range->lo = Range::min;
+				if (new_range->hi > old_range->hi)
+					new_range->hi = Range::max;
+			}
+
+			changed = true;
+		}
+
+		var_ranges = new_var_ranges;
+	}
+
+	ranges.resize(func.value_types.size());
+	for (value_t value = 0; value < ranges.size(); ++value)
+		ranges[value] = value_ranges[value].value_or(unbounded);
+}
+
+void ir::RangeAnalysis::find_lengths()
+{
+	// like ranges, lengths are unknown until a value reaches them, and only
+	// become shorter after
+	std::vector<std::optional<std::vector<int64_t>>> value_lengths;
+	var_lengths.assign(bytecode_t_lim + 1, std::nullopt);
+
+	auto compute = [&](Instruction const& instr, Position const& pos) -> std::optional<std::vector<int64_t>> {
+		if (instr.op == Op::CONST)
+		{
+			if (auto str = std::get_if<std::string>(&instr.constant))
+				return std::vector<int64_t>{ (int64_t)str->length() };
+
+			return std::vector<int64_t>{};
+		}
+
+		if (instr.op == Op::LOAD)
+			return is_assigned(instr.id, pos) ? var_lengths[instr.id] : std::vector<int64_t>{};
+
+		if (instr.op == Op::PHI)
+		{
+			std::optional<std::vector<int64_t>> phi_lengths;
+			for (auto operand : instr.operands)
+			{
+				if (!value_lengths[operand].has_value())
+					return std::vector<int64_t>{};
+
+				phi_lengths = meet(phi_lengths, *value_lengths[operand]);
+			}
+
+			return phi_lengths;
+		}
+
+		if (instr.op != Op::BYTECODE)
+			return std::vector<int64_t>{};
+
+		switch (instr.code)
+		{
+		// [element] [size] ALLOCATE
+		case BytecodeType::ALLOCATE: {
+			if (!value_lengths[instr.operands[0]].has_value())
+				return std::nullopt;
+
+			std::vector<int64_t> arr_lengths{ std::max<int64_t>(ranges[instr.operands[1]].lo, 0) };
+			arr_lengths.insert(std::end(arr_lengths), std::begin(*value_lengths[instr.operands[0]]), std::end(*value_lengths[instr.operands[0]]));
+			return arr_lengths;
+		}
+
+		case BytecodeType::ARR: {
+			std::optional<std::vector<int64_t>> elem_lengths;
+			for (auto operand : instr.operands)
+			{
+				if (!value_lengths[operand].has_value())
+					return std::nullopt;
+
+				elem_lengths = meet(elem_lengths, *value_lengths[operand]);
+			}
+
+			std::vector<int64_t> arr_lengths{ (int64_t)instr.operands.size() };
+			if (elem_lengths.has_value())
+				arr_lengths.insert(std::end(arr_lengths), std::begin(*elem_lengths), std::end(*elem_lengths));
+
+			return arr_lengths;
+		}
+
+		case BytecodeType::SUBSCRIPT:
+		case BytecodeType::SUBSCRIPT_UNCHECKED: {
+			auto const& container_lengths = value_lengths[instr.operands[1]];
+			if (!container_lengths.has_value())
+				return std::nullopt;
+			if (container_lengths->empty())
+				return std::vector<int64_t>{};
+
+			return std::vector<int64_t>(std::begin(*container_lengths) + 1, std::end(*container_lengths));
+		}
+
+		default:
+			return std::vector<int64_t>{};
+		}
+	};
+
+	bool changed = true;
+	while (changed)
+	{
+		value_lengths.assign(func.value_types.size(), std::nullopt);
+
+		for (auto block : order)
+		{
+			auto const& instrs = func.blocks[block].instrs;
+			for (std::size_t i = 0; i < instrs.size(); ++i)
+			{
+				if (instrs[i].result.has_value())
+					value_lengths[*instrs[i].result] = compute(instrs[i], { block, i });
+			}
+		}
+
+		auto new_var_lengths = var_lengths;
+		for (auto block : order)
+		{
+			for (auto const& instr : func.blocks[block].instrs)
+			{
+				if (instr.op == Op::STORE && value_lengths[instr.operands[0]].has_value())
+					new_var_lengths[instr.id] = meet(new_var_lengths[instr.id], *value_lengths[instr.operands[0]]);
+			}
+		}
+
+		// assigning to an element that is an array can change the lengths of
+		// the dimensions below it
+		for (auto block : order)
+		{
+			for (auto const& instr : func.blocks[block].instrs)
+			{
+				if (instr.op != Op::SET_INDEX)
+					continue;
+
+				auto& set_lengths = new_var_lengths[instr.id];
+				if (set_lengths.has_value() && set_lengths->size() > instr.operands.size() - 1)
+					set_lengths->resize(instr.operands.size() - 1);
+			}
+		}
+
+		changed = new_var_lengths != var_lengths;
+		var_lengths = new_var_lengths;
+	}
+
+	lengths.resize(func.value_types.size());
+	for (value_t value = 0; value < lengths.size(); ++value)
+		lengths[value] = value_lengths[value].value_or(std::vector<int64_t>{});
+}
+
+
+bool ir::remove_bounds_checks(Function& func)
+{
+	RangeAnalysis analysis(func);
+
+	// the analysis reads the function, so the instructions are only changed after
+	std::vector<Instruction*> in_bounds;
+
+	for (auto block : reverse_postorder(func))
+	{
+		auto& instrs = func.blocks[block].instrs;
+		for (std::size_t i = 0; i < instrs.size(); ++i)
+		{
+			auto& instr = instrs[i];
+
+			// [index] [container] SUBSCRIPT
+			if (instr.op == Op::BYTECODE && instr.code == BytecodeType::SUBSCRIPT)
+			{
+				auto range = analysis.range_at(instr.operands[0], block);
+				auto lengths = analysis.lengths_of(instr.operands[1]);
+
+				if (range.lo >= 0 && ((!lengths.empty() && range.hi < lengths[0]) ||
+						analysis.is_below_length(instr.operands[0], instr.operands[1], block)))
+					in_bounds.push_back(&instr);
+			}
+			else if (instr.op == Op::SET_INDEX)
+			{
+				auto lengths = analysis.lengths_of(instr.id, { block, i });
+				auto index_count = instr.operands.size() - 1;
+
+				bool is_in_bounds = index_count <= lengths.size();
+				for (std::size_t j = 0; j < index_count && is_in_bounds; ++j)
+				{
+					auto range = analysis.range_at(instr.operands[j], block);
+					is_in_bounds = range.lo >= 0 && range.hi < lengths[j];
+				}
+
+				if (is_in_bounds)
+					in_bounds.push_back(&instr);
+			}
+		}
+	}
+
+	for (auto instr : in_bounds)
+	{
+		if (instr->op == Op::SET_INDEX)
+			instr->in_bounds = true;
+		else
+			instr->code = BytecodeType::SUBSCRIPT_UNCHECKED;
+	}
+
+	return !in_bounds.empty();
+}
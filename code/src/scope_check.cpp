@@ -1,17 +1,18 @@
 #include "scope_check.hpp"
 #include "parser_scope.hpp"
+#include "symbols.hpp"
 
 #include <unordered_set>
 #include <string>
 
-bool check_variable_defined(ParserScope const& scope, std::string const& name, Location const& loc)
+bool check_variable_defined(ParserScope const& scope, symbol_t name, SourcePos loc)
 {
-	static std::unordered_set<std::string> undefined_variables;
+	static std::unordered_set<symbol_t> undefined_variables;
 
-	if (!scope.vars.contains(name))
+	if (!scope.find_variable(name))
 	{
 		if (!undefined_variables.contains(name))
-			night::error::get().create_minor_error("variable '" + name + "' is undefined", loc);
+			night::error::get().create_minor_error("variable '" + symbols::name(name) + "' is undefined", loc);
 
 		undefined_variables.insert(name);
 		return false;
@@ -20,14 +21,14 @@ bool check_variable_defined(ParserScope const& scope, std::string const& name, L
 	return true;
 }
 
-bool check_function_defined(ParserScope const& scope, std::string const& name, Location const& loc)
+bool check_function_defined(ParserScope const& scope, symbol_t name, SourcePos loc)
 {
-	static std::unordered_set<std::string> undefined_functions;
+	static std::unordered_set<symbol_t> undefined_functions;
 
 	if (!scope.funcs.contains(name))
 	{
 		if (!undefined_functions.contains(name))
-			night::error::get().create_minor_error("function '" + name + "' is undefined", loc);
+			night::error::get().create_minor_error("function '" + symbols::name(name) + "' is undefined", loc);
 
 		undefined_functions.insert(name);
 		return false;
@@ -0,0 +1,66 @@
+#include "source_table.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+namespace
+{
+
+struct SourceFile
+{
+	std::string name;
+	uint32_t start;
+
+	// offsets from start of the first character of each line
+	std::vector<uint32_t> line_starts;
+};
+
+std::vector<SourceFile> files;
+
+// each file takes two more offsets than its size, for the end of its last line
+// and the end of the file
+uint32_t next_offset = 1;
+
+}
+
+SourcePos source_table::add_file(std::string const& file_name, std::string_view source)
+{
+	if (source.size() + 2 > std::numeric_limits<uint32_t>::max() - next_offset)
+		throw night::error::get().create_fatal_error("file '" + file_name + "' is too large", Location{ file_name, 1, 0 });
+
+	SourceFile file{ file_name, next_offset, { 0 } };
+
+	for (auto pos = source.find('\n'); pos != std::string_view::npos; pos = source.find('\n', pos + 1))
+		file.line_starts.push_back((uint32_t)pos + 1);
+
+	// the lexer reaches the end of the file on the line after the last one,
+	// which starts after the newline the last line would have
+	if (source.empty() || source.back() != '\n')
+		file.line_starts.push_back((uint32_t)source.size() + 1);
+
+	next_offset += (uint32_t)source.size() + 2;
+	files.push_back(std::move(file));
+
+	return { files.back().start };
+}
+
+Location source_table::location(SourcePos pos)
+{
+	if (pos.offset == 0 || files.empty())
+		return { "", 0, 0 };
+
+	auto file = std::upper_bound(std::begin(files), std::end(files), pos.offset,
+		[](uint32_t offset, SourceFile const& f) { return offset < f.start; });
+	--file;
+
+	auto offset = pos.offset - file->start;
+	auto line = std::upper_bound(std::begin(file->line_starts), std::end(file->line_starts), offset);
+	--line;
+
+	return { file->name, (int)(line - std::begin(file->line_starts)) + 1, (std::size_t)(offset - *line) };
+}
@@ -0,0 +1,201 @@
+#include "switch.hpp"
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// a block that branches on whether a value equals a constant
+struct Comparison
+{
+	ir::value_t subject;
+	int64_t key;
+};
+
+}
+
+static bool has_phis(ir::Function const& func, ir::block_t block)
+{
+	auto const& instrs = func.blocks[block].instrs;
+	return !instrs.empty() && instrs[0].op == ir::Op::PHI;
+}
+
+static std::optional<Comparison> find_comparison(
+	ir::Function const& func,
+	std::vector<ir::Instruction const*> const& defs,
+	ir::block_t block)
+{
+	auto const& terminator = func.blocks[block].terminator;
+	if (!terminator.has_value() || terminator->type != ir::TerminatorType::BRANCH ||
+		terminator->true_block == terminator->false_block)
+		return std::nullopt;
+
+	auto cond = defs[*terminator->value];
+	if (!cond || cond->op != ir::Op::BYTECODE || cond->code != BytecodeType::EQUALS_I)
+		return std::nullopt;
+
+	// the constant can be on either side
+	for (int i = 0; i < 2; ++i)
+	{
+		auto subject = cond->operands[i];
+		auto constant = defs[cond->operands[1 - i]];
+
+		auto type = func.value_types[subject].type;
+		if ((type != ValueType::INT && type != ValueType::CHAR) || !constant || constant->op != ir::Op::CONST)
+			continue;
+
+		return Comparison{ subject, std::get<int64_t>(constant->constant) };
+	}
+
+	return std::nullopt;
+}
+
+// forms a switch from the chain that starts at the block
+static bool form_switch(
+	ir::Function& func,
+	ir::block_t head,
+	std::vector<ir::Instruction const*> const& defs,
+	std::vector<ir::block_t> const& def_blocks,
+	std::vector<std::vector<ir::block_t>> const& preds)
+{
+	using namespace ir;
+
+	auto first = find_comparison(func, defs, head);
+	if (!first.has_value())
+		return false;
+
+	// later blocks can load the variable again, if it is not assigned to after
+	// the head loads it
+	std::optional<bytecode_t> var_id;
+
+	auto subject_def = defs[first->subject];
+	if (subject_def && subject_def->op == Op::LOAD && def_blocks[first->subject] == head)
+	{
+		auto const& instrs = func.blocks[head].instrs;
+		auto it = std::find_if(std::begin(instrs), std::end(instrs), [&](Instruction const& instr) { return &instr == subject_def; });
+
+		bool is_assigned = std::any_of(it, std::end(instrs), [&](Instruction const& instr) {
+			return (instr.op == Op::STORE || instr.op == Op::SET_INDEX) && instr.id == subject_def->id;
+		});
+
+		if (!is_assigned)
+			var_id = subject_def->id;
+	}
+
+	auto const& head_terminator = *func.blocks[head].terminator;
+	if (has_phis(func, head_terminator.true_block))
+		return false;
+
+	std::vector<std::pair<int64_t, block_t>> cases{ { first->key, head_terminator.true_block } };
+	std::vector<block_t> chain;
+
+	for (auto next = head_terminator.false_block; ; next = func.blocks[next].terminator->false_block)
+	{
+		if (next == head || preds[next] != std::vector<block_t>{ chain.empty() ? head : chain.back() })
+			break;
+
+		auto comparison = find_comparison(func, defs, next);
+		if (!comparison.has_value() || is_used_outside(func, next))
+			break;
+
+		auto subject_def = defs[comparison->subject];
+		bool is_same = comparison->subject == first->subject ||
+			(var_id.has_value() && subject_def && subject_def->op == Op::LOAD && subject_def->id == *var_id);
+
+		if (!is_same)
+			break;
+
+		// the block can only compute the comparison
+		auto const& cond = *defs[*func.blocks[next].terminator->value];
+		bool only_compares = std::all_of(std::begin(func.blocks[next].instrs), std::end(func.blocks[next].instrs), [&](Instruction const& instr) {
+			return instr.op != Op::PHI && instr.result.has_value() &&
+				(&instr == &cond || *instr.result == cond.operands[0] || *instr.result == cond.operands[1]);
+		});
+
+		auto true_block = func.blocks[next].terminator->true_block;
+		if (!only_compares || has_phis(func, true_block) ||
+			std::find(std::begin(chain), std::end(chain), true_block) != std::end(chain))
+			break;
+
+		cases.emplace_back(comparison->key, true_block);
+		chain.push_back(next);
+	}
+
+	auto default_block = chain.empty() ? head_terminator.false_block : func.blocks[chain.back()].terminator->false_block;
+
+	// the last block of the chain becomes the default if the default has phis
+	while (!chain.empty() && has_phis(func, default_block))
+	{
+		default_block = chain.back();
+		chain.pop_back();
+		cases.pop_back();
+	}
+
+	if (cases.size() < min_switch_cases || has_phis(func, default_block))
+		return false;
+
+	// the first case with a key is the one taken
+	std::stable_sort(std::begin(cases), std::end(cases),
+		[](auto const& a, auto const& b) { return a.first < b.first; });
+
+	cases.erase(std::unique(std::begin(cases), std::end(cases),
+		[](auto const& a, auto const& b) { return a.first == b.first; }), std::end(cases));
+
+	func.blocks[head].terminator = { TerminatorType::SWITCH, first->subject, default_block, default_block, cases };
+
+	// the rest of the chain can no longer be reached
+	for (auto block : chain)
+		func.blocks[block] = {};
+
+	return true;
+}
+
+bool ir::form_switches(Function& func)
+{
+	std::vector<Instruction const*> defs;
+	std::vector<block_t> def_blocks;
+	std::vector<std::vector<block_t>> preds;
+
+	auto analyze = [&] {
+		defs.assign(func.value_types.size(), nullptr);
+		def_blocks.assign(func.value_types.size(), 0);
+
+		for (block_t block = 0; block < func.blocks.size(); ++block)
+		{
+			for (auto const& instr : func.blocks[block].instrs)
+			{
+				if (instr.result.has_value())
+				{
+					defs[*instr.result] = &instr;
+					def_blocks[*instr.result] = block;
+				}
+			}
+		}
+
+		preds = predecessors(func);
+	};
+
+	analyze();
+	bool changed = false;
+
+	// a chain is only found from its first block, since the blocks after it are
+	// reached from it
+	for (auto block : reverse_postorder(func))
+	{
+		if (form_switch(func, block, defs, def_blocks, preds))
+		{
+			analyze();
+			changed = true;
+		}
+	}
+
+	if (changed)
+		remove_unused_values(func);
+
+	return changed;
+}
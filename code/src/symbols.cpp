@@ -0,0 +1,62 @@
+#include "symbols.hpp"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace
+{
+
+struct SymbolTable
+{
+	std::mutex mutex;
+
+	// a deque, so names are not moved and views of them stay valid
+	std::deque<std::string> names;
+	std::unordered_map<std::string_view, symbol_t> symbols;
+};
+
+// made on first use, as builtin functions are interned during static
+// initialization
+SymbolTable& table()
+{
+	static SymbolTable table;
+	return table;
+}
+
+}
+
+symbol_t symbols::intern(std::string_view name)
+{
+	// most identifiers are repeated, so each thread keeps the symbols it has
+	// seen and only locks the table for new ones
+	thread_local std::unordered_map<std::string_view, symbol_t> seen;
+
+	if (auto it = seen.find(name); it != std::end(seen))
+		return it->second;
+
+	auto& t = table();
+	std::lock_guard lock(t.mutex);
+
+	auto it = t.symbols.find(name);
+	if (it == std::end(t.symbols))
+	{
+		// the key views the stored name, as the caller's string may not last
+		auto const& stored = t.names.emplace_back(name);
+		it = t.symbols.emplace(stored, (symbol_t)t.names.size() - 1).first;
+	}
+
+	seen.emplace(it->first, it->second);
+	return it->second;
+}
+
+std::string const& symbols::name(symbol_t symbol)
+{
+	auto& t = table();
+	std::lock_guard lock(t.mutex);
+
+	return t.names[symbol];
+}
@@ -0,0 +1,584 @@
+#include "unroll.hpp"
+#include "profile.hpp"
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <unordered_set>
+#include <optional>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+
+std::size_t ir::unroll_factor = 4;
+
+std::optional<ir::CountedLoop> ir::find_counted_loop(Function const& func, Loop const& loop)
+{
+	using namespace ir;
+
+	auto in_loop = [&](block_t block) {
+		return std::find(std::begin(loop.blocks), std::end(loop.blocks), block) != std::end(loop.blocks);
+	};
+
+	auto const& header = func.blocks[loop.header];
+	if (!header.terminator.has_value() || header.terminator->type != TerminatorType::BRANCH ||
+		!in_loop(header.terminator->true_block) || in_loop(header.terminator->false_block))
+		return std::nullopt;
+
+	// the header's branch is the only way out of the loop
+	for (auto block : loop.blocks)
+	{
+		if (block == loop.header)
+			continue;
+
+		for (auto succ : successors(func.blocks[block]))
+		{
+			if (!in_loop(succ))
+				return std::nullopt;
+		}
+	}
+
+	if (is_used_outside(func, loop.header))
+		return std::nullopt;
+
+	for (auto const& instr : header.instrs)
+	{
+		if (instr.op == Op::PHI || has_side_effects(instr))
+			return std::nullopt;
+	}
+
+	auto const& exit_instrs = func.blocks[header.terminator->false_block].instrs;
+	if (!exit_instrs.empty() && exit_instrs[0].op == Op::PHI)
+		return std::nullopt;
+
+	std::vector<Instruction const*> defs(func.value_types.size(), nullptr);
+	std::vector<block_t> def_blocks(func.value_types.size());
+
+	for (block_t block = 0; block < func.blocks.size(); ++block)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.result.has_value())
+			{
+				defs[*instr.result] = &instr;
+				def_blocks[*instr.result] = block;
+			}
+		}
+	}
+
+	auto constant_of = [&](value_t value) -> std::optional<int64_t> {
+		if (!defs[value] || defs[value]->op != Op::CONST)
+			return std::nullopt;
+
+		if (auto val = std::get_if<int64_t>(&defs[value]->constant))
+			return *val;
+
+		return std::nullopt;
+	};
+
+	auto cond = defs[*header.terminator->value];
+	if (!cond || def_blocks[*header.terminator->value] != loop.header || cond->op != Op::BYTECODE)
+		return std::nullopt;
+
+	auto is_counter = [&](value_t value) {
+		return defs[value] && defs[value]->op == Op::LOAD && def_blocks[value] == loop.header;
+	};
+
+	CountedLoop counted;
+
+	switch (cond->code)
+	{
+	case BytecodeType::LESSER_I:
+	case BytecodeType::GREATER_I:
+	case BytecodeType::LESSER_EQUALS_I:
+	case BytecodeType::GREATER_EQUALS_I:
+		break;
+	default:
+		return std::nullopt;
+	}
+
+	if (is_counter(cond->operands[0]))
+	{
+		counted.cmp = cond->code;
+		counted.counter = cond->operands[0];
+		counted.bound = cond->operands[1];
+	}
+	else if (is_counter(cond->operands[1]))
+	{
+		switch (cond->code)
+		{
+		case BytecodeType::LESSER_I:		 counted.cmp = BytecodeType::GREATER_I; break;
+		case BytecodeType::GREATER_I:		 counted.cmp = BytecodeType::LESSER_I; break;
+		case BytecodeType::LESSER_EQUALS_I:	 counted.cmp = BytecodeType::GREATER_EQUALS_I; break;
+		case BytecodeType::GREATER_EQUALS_I: counted.cmp = BytecodeType::LESSER_EQUALS_I; break;
+		default:
+			return std::nullopt;
+		}
+
+		counted.counter = cond->operands[1];
+		counted.bound = cond->operands[0];
+	}
+	else
+	{
+		return std::nullopt;
+	}
+
+	counted.var_id = defs[counted.counter]->id;
+
+	// the counter is only assigned to once, at the end of each iteration
+	std::unordered_set<bytecode_t> assigned_vars;
+	std::vector<std::pair<block_t, Instruction const*>> counter_stores;
+
+	for (auto block : loop.blocks)
+	{
+		for (auto const& instr : func.blocks[block].instrs)
+		{
+			if (instr.op == Op::STORE || instr.op == Op::SET_INDEX)
+				assigned_vars.insert(instr.id);
+
+			if (instr.op == Op::STORE && instr.id == counted.var_id)
+				counter_stores.push_back({ block, &instr });
+		}
+	}
+
+	if (counter_stores.size() != 1)
+		return std::nullopt;
+
+	auto [store_block, store] = counter_stores[0];
+
+	auto preds = predecessors(func);
+
+	std::vector<block_t> latches;
+	std::vector<block_t> outside_preds;
+	for (auto pred : preds[loop.header])
+		(in_loop(pred) ? latches : outside_preds).push_back(pred);
+
+	if (latches != std::vector<block_t>{ store_block } || func.blocks[store_block].terminator->type != TerminatorType::JUMP)
+		return std::nullopt;
+
+	// counter + step, step + counter, or counter - step
+	auto next = defs[store->operands[0]];
+	if (!next || next->op != Op::BYTECODE || (next->code != BytecodeType::ADD_I && next->code != BytecodeType::SUB_I))
+		return std::nullopt;
+
+	auto is_counter_load = [&](value_t value) {
+		return defs[value] && defs[value]->op == Op::LOAD && defs[value]->id == counted.var_id;
+	};
+
+	std::optional<int64_t> step;
+	if (is_counter_load(next->operands[0]))
+		step = constant_of(next->operands[1]);
+	else if (next->code == BytecodeType::ADD_I && is_counter_load(next->operands[1]))
+		step = constant_of(next->operands[0]);
+
+	if (!step.has_value() || *step == 0 || *step == std::numeric_limits<int64_t>::min())
+		return std::nullopt;
+
+	counted.step = next->code == BytecodeType::ADD_I ? *step : -*step;
+
+	bool is_increasing = counted.cmp == BytecodeType::LESSER_I || counted.cmp == BytecodeType::LESSER_EQUALS_I;
+	if (is_increasing != (counted.step > 0))
+		return std::nullopt;
+
+	// the bound does not change in the loop
+	std::function<bool(value_t)> is_invariant = [&](value_t value) {
+		if (!defs[value] || !in_loop(def_blocks[value]))
+			return true;
+
+		if (def_blocks[value] != loop.header)
+			return false;
+
+		auto const& instr = *defs[value];
+		switch (instr.op)
+		{
+		case Op::CONST:
+			return true;
+		case Op::LOAD:
+			return !assigned_vars.contains(instr.id);
+		case Op::CALL:
+			if (!instr.is_pure)
+				return false;
+			break;
+		case Op::BYTECODE:
+			break;
+		default:
+			return false;
+		}
+
+		return std::all_of(std::begin(instr.operands), std::end(instr.operands), is_invariant);
+	};
+
+	if (!is_invariant(counted.bound))
+		return std::nullopt;
+
+	if (outside_preds.size() == 1 && func.blocks[outside_preds[0]].terminator->type == TerminatorType::JUMP)
+	{
+		auto const& instrs = func.blocks[outside_preds[0]].instrs;
+		auto last_store = std::find_if(std::rbegin(instrs), std::rend(instrs), [&](Instruction const& instr) {
+			return instr.op == Op::STORE && instr.id == counted.var_id;
+		});
+
+		if (last_store != std::rend(instrs))
+			counted.start = constant_of(last_store->operands[0]);
+	}
+
+	counted.end = constant_of(counted.bound);
+
+	return counted;
+}
+
+// returns std::nullopt if the count is not known, or is too large to work out
+static std::optional<int64_t> trip_count(ir::CountedLoop const& counted)
+{
+	if (!counted.start.has_value() || !counted.end.has_value())
+		return std::nullopt;
+
+	constexpr int64_t limit = (int64_t)1 << 31;
+	if (std::abs(*counted.start) > limit || std::abs(*counted.end) > limit || std::abs(counted.step) > limit)
+		return std::nullopt;
+
+	auto distance = counted.step > 0 ? *counted.end - *counted.start : *counted.start - *counted.end;
+	if (counted.cmp == BytecodeType::LESSER_EQUALS_I || counted.cmp == BytecodeType::GREATER_EQUALS_I)
+		distance += 1;
+
+	if (distance <= 0)
+		return 0;
+
+	auto step = std::abs(counted.step);
+	return (distance + step - 1) / step;
+}
+
+// the same as the interpreter, where overflow wraps around
+static std::optional<int64_t> fold(BytecodeType code, std::vector<int64_t> const& vals, bytecodes_t const& immediates)
+{
+	switch (code)
+	{
+	case BytecodeType::NEGATIVE_I: return (int64_t)(0 - (uint64_t)vals[0]);
+	case BytecodeType::NOT_I:	   return (int64_t)!vals[0];
+
+	case BytecodeType::ADD_I:  return (int64_t)((uint64_t)vals[0] + (uint64_t)vals[1]);
+	case BytecodeType::SUB_I:  return (int64_t)((uint64_t)vals[0] - (uint64_t)vals[1]);
+	case BytecodeType::MULT_I: return (int64_t)((uint64_t)vals[0] * (uint64_t)vals[1]);
+
+	case BytecodeType::SHIFT_LEFT_I:
+		return (int64_t)((uint64_t)vals[0] << immediates[0]);
+	case BytecodeType::DIV_POW2_I: {
+		auto bias = (vals[0] >> 63) & (((int64_t)1 << immediates[0]) - 1);
+		return (vals[0] + bias) >> immediates[0];
+	}
+	case BytecodeType::MOD_POW2_I: {
+		auto mask = ((int64_t)1 << immediates[0]) - 1;
+		auto bias = (vals[0] >> 63) & mask;
+		return ((vals[0] + bias) & mask) - bias;
+	}
+
+	case BytecodeType::LESSER_I:		 return (int64_t)(vals[0] < vals[1]);
+	case BytecodeType::GREATER_I:		 return (int64_t)(vals[0] > vals[1]);
+	case BytecodeType::LESSER_EQUALS_I:	 return (int64_t)(vals[0] <= vals[1]);
+	case BytecodeType::GREATER_EQUALS_I: return (int64_t)(vals[0] >= vals[1]);
+	case BytecodeType::EQUALS_I:		 return (int64_t)(vals[0] == vals[1]);
+	case BytecodeType::NOT_EQUALS_I:	 return (int64_t)(vals[0] != vals[1]);
+	case BytecodeType::AND:				 return (int64_t)(vals[0] && vals[1]);
+	case BytecodeType::OR:				 return (int64_t)(vals[0] || vals[1]);
+
+	default:
+		return std::nullopt;
+	}
+}
+
+// copies every block of the loop other than its header, where jumps back to the
+// header go to next instead
+// if the value of the counter is known, its loads in the copy are constants,
+// and instructions that only use constants are folded
+// returns the copy of the first block of the loop's body
+static ir::block_t copy_body(
+	ir::Function& func, ir::Loop const& loop, ir::CountedLoop const& counted,
+	ir::block_t next, std::optional<int64_t> counter_value,
+	std::vector<std::optional<int64_t>>& constants)
+{
+	using namespace ir;
+
+	std::vector<std::optional<block_t>> block_copies(func.blocks.size());
+	for (auto block : loop.blocks)
+	{
+		if (block == loop.header)
+			continue;
+
+		func.blocks.emplace_back();
+		block_copies[block] = func.blocks.size() - 1;
+	}
+
+	auto copy_of = [&](block_t block) {
+		return block == loop.header ? next : block_copies[block].value_or(block);
+	};
+
+	std::vector<std::optional<value_t>> value_copies(func.value_types.size());
+
+	for (auto block : loop.blocks)
+	{
+		if (block == loop.header)
+			continue;
+
+		auto copy = func.blocks[block];
+		bool is_counter_stored = false;
+
+		for (auto& instr : copy.instrs)
+		{
+			for (auto& operand : instr.operands)
+				operand = value_copies[operand].value_or(operand);
+			for (auto& pred : instr.blocks)
+				pred = copy_of(pred);
+
+			if (instr.result.has_value())
+			{
+				func.value_types.push_back(func.value_types[*instr.result]);
+				constants.resize(func.value_types.size());
+
+				value_copies[*instr.result] = func.value_types.size() - 1;
+				instr.result = func.value_types.size() - 1;
+			}
+
+			std::optional<int64_t> constant;
+			if (counter_value.has_value() && instr.op == Op::LOAD && instr.id == counted.var_id)
+			{
+				constant = is_counter_stored ? *counter_value + counted.step : *counter_value;
+			}
+			else if (counter_value.has_value() && instr.op == Op::BYTECODE &&
+				std::all_of(std::begin(instr.operands), std::end(instr.operands), [&](value_t operand) { return constants[operand].has_value(); }))
+			{
+				std::vector<int64_t> vals;
+				for (auto operand : instr.operands)
+					vals.push_back(*constants[operand]);
+
+				constant = fold(instr.code, vals, instr.immediates);
+			}
+
+			if (constant.has_value())
+			{
+				instr = Instruction{ Op::CONST, instr.result };
+				instr.constant = *constant;
+			}
+
+			if (instr.op == Op::CONST && std::holds_alternative<int64_t>(instr.constant))
+				constants[*instr.result] = std::get<int64_t>(instr.constant);
+
+			if (instr.op == Op::STORE && instr.id == counted.var_id)
+				is_counter_stored = true;
+		}
+
+		if (copy.terminator.has_value())
+		{
+			auto& terminator = *copy.terminator;
+			terminator.true_block = copy_of(terminator.true_block);
+			terminator.false_block = copy_of(terminator.false_block);
+
+			if (terminator.value.has_value())
+				terminator.value = value_copies[*terminator.value].value_or(*terminator.value);
+
+			// a branch on a constant only goes one way
+			if (terminator.type == TerminatorType::BRANCH && constants[*terminator.value].has_value())
+			{
+				auto target = *constants[*terminator.value] ? terminator.true_block : terminator.false_block;
+				terminator = { TerminatorType::JUMP, std::nullopt, target, target };
+			}
+		}
+
+		func.blocks[*block_copies[block]] = copy;
+	}
+
+	return *block_copies[func.blocks[loop.header].terminator->true_block];
+}
+
+bool ir::unroll_loops(Function& func)
+{
+	// a loop that is partly unrolled keeps its header for the iterations that are
+	// left over, so headers are only tried once
+	std::unordered_set<block_t> tried_headers;
+
+	return change_loops(func, [&](Loop const& loop, std::vector<Loop> const& loops) {
+		bool is_innermost = std::none_of(std::begin(loops), std::end(loops), [&](Loop const& other) {
+			return other.header != loop.header &&
+				std::find(std::begin(loop.blocks), std::end(loop.blocks), other.header) != std::end(loop.blocks);
+		});
+
+		if (!is_innermost || tried_headers.contains(loop.header))
+			return false;
+
+		tried_headers.insert(loop.header);
+		return unroll_loop(func, loop);
+	});
+}
+
+bool ir::unroll_loop(Function& func, Loop const& loop)
+{
+	auto counted = find_counted_loop(func, loop);
+	if (!counted.has_value())
+		return false;
+
+	std::size_t body_size = 0;
+	for (auto block : loop.blocks)
+	{
+		if (block != loop.header)
+			body_size += func.blocks[block].instrs.size() + 1;
+	}
+
+	auto preds = predecessors(func);
+
+	std::vector<block_t> outside_preds;
+	for (auto pred : preds[loop.header])
+	{
+		if (std::find(std::begin(loop.blocks), std::end(loop.blocks), pred) == std::end(loop.blocks))
+			outside_preds.push_back(pred);
+	}
+
+	// with a profile, only hot loops are unrolled, and only partly if they ran
+	// at least unroll_factor iterations each time they were entered
+	auto header_count = func.blocks[loop.header].count;
+	bool is_hot = !header_count.has_value() || *header_count >= hot_count;
+	bool runs_long = !header_count.has_value();
+
+	if (header_count.has_value())
+	{
+		uint64_t entries = 0;
+		for (auto pred : outside_preds)
+			entries += func.blocks[pred].count.value_or(0);
+
+		runs_long = *header_count >= entries * (unroll_factor + 1);
+	}
+
+	if (!is_hot)
+		return false;
+
+	auto enter_at = [&](block_t block) {
+		for (auto pred : outside_preds)
+		{
+			auto& terminator = *func.blocks[pred].terminator;
+
+			if (terminator.true_block == loop.header)
+				terminator.true_block = block;
+			if (terminator.false_block == loop.header)
+				terminator.false_block = block;
+		}
+	};
+
+	std::vector<std::optional<int64_t>> constants(func.value_types.size());
+	for (auto const& block : func.blocks)
+	{
+		for (auto const& instr : block.instrs)
+		{
+			if (instr.op == Op::CONST && std::holds_alternative<int64_t>(instr.constant))
+				constants[*instr.result] = std::get<int64_t>(instr.constant);
+		}
+	}
+
+	auto trips = trip_count(*counted);
+	if (trips.has_value() && *trips <= (int64_t)full_unroll_count && *trips * body_size <= unroll_budget)
+	{
+		// each iteration goes on to the next, and the last one leaves the loop
+		auto next = func.blocks[loop.header].terminator->false_block;
+		for (auto i = *trips; i-- > 0;)
+			next = copy_body(func, loop, *counted, next, *counted->start + i * counted->step, constants);
+
+		enter_at(next);
+		return true;
+	}
+
+	if (unroll_factor < 2 || body_size * unroll_factor > unroll_budget || !runs_long)
+		return false;
+
+	// the new header runs every copy if the last one would still be in the loop,
+	// otherwise the original loop runs the iterations that are left
+	// the bound is moved back by the steps of the other copies, rather than
+	// moving the counter forward, as the counter of the last copy can overflow
+	// in a loop that stops just before the limits of int64_t
+	int64_t offset_value;
+	if (__builtin_mul_overflow((int64_t)(unroll_factor - 1), counted->step, &offset_value))
+		return false;
+
+	// a constant bound too close to the limits of int64_t leaves no room for
+	// the copies to run, so the loop is left as it is
+	int64_t constant_last_bound;
+	if (counted->end.has_value() && __builtin_sub_overflow(*counted->end, offset_value, &constant_last_bound))
+		return false;
+
+	func.blocks.emplace_back();
+	auto unrolled_header = func.blocks.size() - 1;
+
+	auto next = unrolled_header;
+	for (std::size_t i = 0; i < unroll_factor; ++i)
+		next = copy_body(func, loop, *counted, next, std::nullopt, constants);
+
+	auto const& header = func.blocks[loop.header];
+	std::vector<std::optional<value_t>> value_copies(func.value_types.size());
+
+	auto create_value = [&](ValueType const& type) {
+		func.value_types.push_back(type);
+		return func.value_types.size() - 1;
+	};
+
+	BasicBlock header_copy;
+	for (auto instr : header.instrs)
+	{
+		for (auto& operand : instr.operands)
+			operand = value_copies[operand].value_or(operand);
+
+		if (instr.result.has_value())
+		{
+			value_copies[*instr.result] = create_value(func.value_types[*instr.result]);
+			instr.result = value_copies[*instr.result];
+		}
+
+		if (instr.op == Op::BYTECODE && instr.code == BytecodeType::SUBSCRIPT_UNCHECKED)
+			instr.code = BytecodeType::SUBSCRIPT;
+
+		header_copy.instrs.push_back(instr);
+	}
+
+	// the bound of the last copy is compared instead of the bound
+	auto const& counter_type = func.value_types[counted->counter];
+	auto bound_copy = value_copies[counted->bound].value_or(counted->bound);
+
+	Instruction offset{ Op::CONST, create_value(counter_type) };
+	offset.constant = offset_value;
+
+	Instruction last_bound{ Op::BYTECODE, create_value(counter_type), { bound_copy, *offset.result } };
+	last_bound.code = BytecodeType::SUB_I;
+
+	auto cond_copy = *value_copies[*header.terminator->value];
+	for (auto& instr : header_copy.instrs)
+	{
+		if (instr.result == cond_copy)
+			std::replace(std::begin(instr.operands), std::end(instr.operands), bound_copy, *last_bound.result);
+	}
+
+	auto cond_it = std::find_if(std::begin(header_copy.instrs), std::end(header_copy.instrs),
+		[&](Instruction const& instr) { return instr.result == cond_copy; });
+	cond_it = header_copy.instrs.insert(cond_it, last_bound);
+	cond_it = header_copy.instrs.insert(cond_it, offset);
+
+	// a bound only known when the loop runs can wrap around when it is moved
+	// back, and then the copies must not run
+	auto branch_value = cond_copy;
+	if (!counted->end.has_value())
+	{
+		Instruction no_wrap{ Op::BYTECODE, create_value(ValueType::BOOL), { *last_bound.result, bound_copy } };
+		no_wrap.code = counted->step > 0 ? BytecodeType::LESSER_I : BytecodeType::GREATER_I;
+
+		Instruction both{ Op::BYTECODE, create_value(ValueType::BOOL), { cond_copy, *no_wrap.result } };
+		both.code = BytecodeType::AND;
+
+		// after the offset, the bound of the last copy and the comparison
+		cond_it = header_copy.instrs.insert(cond_it + 3, no_wrap);
+		header_copy.instrs.insert(cond_it + 1, both);
+
+		branch_value = *both.result;
+	}
+
+	header_copy.terminator = { TerminatorType::BRANCH, branch_value, next, loop.header };
+	func.blocks[unrolled_header] = header_copy;
+
+	enter_at(unrolled_header);
+	return true;
+}
@@ -0,0 +1,373 @@
+#include "vectorize.hpp"
+#include "unroll.hpp"
+#include "kernel.hpp"
+#include "ir.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <optional>
+#include <vector>
+
+namespace
+{
+
+// what the body of the loop does for each element
+struct Effect
+{
+	// VECTOR_MAP sets element i of the variable, VECTOR_SUM adds to the variable
+	BytecodeType code;
+	bytecode_t var_id;
+
+	// the value of the element, or the value added to the sum
+	ir::value_t value;
+
+	// position of the SET_INDEX or STORE in the body
+	std::size_t pos;
+};
+
+}
+
+static std::optional<KernelCode> kernel_code_of(BytecodeType code)
+{
+	switch (code)
+	{
+	case BytecodeType::NEGATIVE_I:	 return KernelCode::NEGATIVE_I;
+	case BytecodeType::NEGATIVE_F:	 return KernelCode::NEGATIVE_F;
+	case BytecodeType::ADD_I:		 return KernelCode::ADD_I;
+	case BytecodeType::ADD_F:		 return KernelCode::ADD_F;
+	case BytecodeType::SUB_I:		 return KernelCode::SUB_I;
+	case BytecodeType::SUB_F:		 return KernelCode::SUB_F;
+	case BytecodeType::MULT_I:		 return KernelCode::MULT_I;
+	case BytecodeType::MULT_F:		 return KernelCode::MULT_F;
+	case BytecodeType::SHIFT_LEFT_I: return KernelCode::SHIFT_LEFT_I;
+	case BytecodeType::I2F:			 return KernelCode::I2F;
+	case BytecodeType::F2I:			 return KernelCode::F2I;
+	default:
+		return std::nullopt;
+	}
+}
+
+static bool is_number(ValueType const& type)
+{
+	return type == ValueType::INT || type == ValueType::FLOAT;
+}
+
+static bool is_number_array(ValueType const& type)
+{
+	return type.dim == 1 && (type.type == ValueType::INT || type.type == ValueType::FLOAT);
+}
+
+static bool vectorize_loop(ir::Function& func, ir::Loop const& loop)
+{
+	using namespace ir;
+
+	if (loop.blocks.size() != 2)
+		return false;
+
+	auto counted = find_counted_loop(func, loop);
+	if (!counted.has_value() || counted->step != 1 ||
+		(counted->cmp != BytecodeType::LESSER_I && counted->cmp != BytecodeType::LESSER_EQUALS_I))
+		return false;
+
+	auto body = loop.blocks[0] == loop.header ? loop.blocks[1] : loop.blocks[0];
+	auto const& instrs = func.blocks[body].instrs;
+
+	if (is_used_outside(func, body))
+		return false;
+
+	std::vector<Instruction const*> defs(func.value_types.size(), nullptr);
+	for (auto const& block : func.blocks)
+	{
+		for (auto const& instr : block.instrs)
+		{
+			if (instr.result.has_value())
+				defs[*instr.result] = &instr;
+		}
+	}
+
+	std::unordered_map<value_t, std::size_t> body_pos;
+	for (std::size_t pos = 0; pos < instrs.size(); ++pos)
+	{
+		if (instrs[pos].result.has_value())
+			body_pos[*instrs[pos].result] = pos;
+	}
+
+	// the body only sets a single element or adds to a single variable, apart
+	// from adding one to the counter
+	std::optional<Effect> effect;
+	std::optional<std::size_t> counter_store;
+
+	for (std::size_t pos = 0; pos < instrs.size(); ++pos)
+	{
+		auto const& instr = instrs[pos];
+		switch (instr.op)
+		{
+		case Op::CONST:
+		case Op::LOAD:
+		case Op::BYTECODE:
+			break;
+
+		case Op::STORE:
+			if (instr.id == counted->var_id)
+			{
+				counter_store = pos;
+				break;
+			}
+
+			if (effect.has_value())
+				return false;
+
+			effect = Effect{ BytecodeType::VECTOR_SUM, instr.id, instr.operands[0], pos };
+			break;
+
+		case Op::SET_INDEX: {
+			if (effect.has_value() || instr.operands.size() != 2)
+				return false;
+
+			effect = Effect{ BytecodeType::VECTOR_MAP, instr.id, instr.operands[1], pos };
+			break;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	if (!effect.has_value() || !counter_store.has_value() || !is_number(func.value_types[effect->value]))
+		return false;
+
+	auto is_in_body = [&](value_t value) { return body_pos.contains(value); };
+
+	// the counter is read before one is added to it
+	auto is_index = [&](value_t value) {
+		return is_in_body(value) && defs[value]->op == Op::LOAD && defs[value]->id == counted->var_id &&
+			body_pos[value] < *counter_store;
+	};
+
+	// the element at the counter
+	if (effect->code == BytecodeType::VECTOR_MAP && !is_index(instrs[effect->pos].operands[0]))
+		return false;
+
+	auto is_var_load = [&](value_t value) {
+		return is_in_body(value) && defs[value]->op == Op::LOAD && defs[value]->id == effect->var_id;
+	};
+
+	// a sum adds a value to the variable it loads
+	std::optional<value_t> sum_load;
+	auto sum_value = effect->value;
+
+	if (effect->code == BytecodeType::VECTOR_SUM)
+	{
+		auto add = defs[effect->value];
+		if (!is_in_body(effect->value) || add->op != Op::BYTECODE ||
+			(add->code != BytecodeType::ADD_I && add->code != BytecodeType::ADD_F))
+			return false;
+
+		for (int i = 0; i < 2; ++i)
+		{
+			if (is_var_load(add->operands[i]))
+			{
+				sum_load = add->operands[i];
+				effect->value = add->operands[1 - i];
+				break;
+			}
+		}
+
+		if (!sum_load.has_value())
+			return false;
+	}
+
+	// the variable can only be read by the sum, or for element i of the array
+	// before it is set
+	for (auto const& instr : instrs)
+	{
+		for (std::size_t i = 0; i < instr.operands.size(); ++i)
+		{
+			auto operand = instr.operands[i];
+			if (!is_var_load(operand))
+				continue;
+
+			bool is_sum = sum_load == operand && instr.result == sum_value;
+			bool is_element = effect->code == BytecodeType::VECTOR_MAP && i == 1 && instr.op == Op::BYTECODE &&
+				(instr.code == BytecodeType::SUBSCRIPT || instr.code == BytecodeType::SUBSCRIPT_UNCHECKED) &&
+				is_index(instr.operands[0]) && body_pos[operand] < effect->pos;
+
+			if (!is_sum && !is_element)
+				return false;
+		}
+	}
+
+	// the operands of the kernel, where the first is the array or the sum, which
+	// is only known once the array is read
+	std::vector<value_t> operands{ sum_load.value_or(0) };
+	bool is_array_read = false;
+	std::unordered_map<value_t, bytecode_t> operand_indices;
+	bytecodes_t program;
+
+	auto operand_of = [&](value_t value) -> std::optional<bytecode_t> {
+		if (operand_indices.contains(value))
+			return operand_indices[value];
+
+		if (operands.size() >= bytecode_t_lim)
+			return std::nullopt;
+
+		operands.push_back(value);
+		return operand_indices[value] = (bytecode_t)(operands.size() - 1);
+	};
+
+	// values that do not change in the loop
+	auto is_invariant = [&](value_t value) {
+		// the body can not use the header's values, so the others are from before the loop
+		if (!is_in_body(value))
+			return defs[value] != nullptr;
+
+		auto const& instr = *defs[value];
+		return instr.op == Op::CONST ||
+			   (instr.op == Op::LOAD && instr.id != counted->var_id && instr.id != effect->var_id);
+	};
+
+	// the program is the value's operands, followed by its code
+	std::function<bool(value_t)> emit = [&](value_t value) {
+		auto const& type = func.value_types[value];
+		if (!is_number(type))
+			return false;
+
+		if (is_index(value))
+		{
+			program.push_back((bytecode_t)KernelCode::INDEX);
+			return true;
+		}
+
+		if (is_invariant(value))
+		{
+			auto j = operand_of(value);
+			if (!j.has_value())
+				return false;
+
+			program.push_back((bytecode_t)(type == ValueType::INT ? KernelCode::OPERAND_I : KernelCode::OPERAND_F));
+			program.push_back(*j);
+			return true;
+		}
+
+		auto const& instr = *defs[value];
+		if (!is_in_body(value) || instr.op != Op::BYTECODE)
+			return false;
+
+		if (instr.code == BytecodeType::SUBSCRIPT || instr.code == BytecodeType::SUBSCRIPT_UNCHECKED)
+		{
+			auto array = instr.operands[1];
+			if (!is_index(instr.operands[0]) || !is_number_array(func.value_types[array]))
+				return false;
+
+			std::optional<bytecode_t> j;
+			if (is_var_load(array))
+			{
+				operands[0] = array;
+				is_array_read = true;
+				j = 0;
+			}
+			else if (is_invariant(array))
+			{
+				j = operand_of(array);
+			}
+
+			if (!j.has_value())
+				return false;
+
+			program.push_back((bytecode_t)(type == ValueType::INT ? KernelCode::ELEMENT_I : KernelCode::ELEMENT_F));
+			program.push_back(*j);
+			return true;
+		}
+
+		auto code = kernel_code_of(instr.code);
+		if (!code.has_value())
+			return false;
+
+		for (auto operand : instr.operands)
+		{
+			if (!emit(operand))
+				return false;
+		}
+
+		program.push_back((bytecode_t)*code);
+		if (*code == KernelCode::SHIFT_LEFT_I)
+			program.push_back(instr.immediates[0]);
+
+		return true;
+	};
+
+	if (!emit(effect->value) || program.size() > bytecode_t_lim)
+		return false;
+
+	auto create_value = [&](ValueType const& type) {
+		func.value_types.push_back(type);
+		return func.value_types.size() - 1;
+	};
+
+	// an array that is only set is loaded for the kernel
+	std::vector<Instruction> kernel_instrs;
+	if (effect->code == BytecodeType::VECTOR_MAP && !is_array_read)
+	{
+		Instruction load{ Op::LOAD, create_value(ValueType(func.value_types[effect->value].type, 1)) };
+		load.id = effect->var_id;
+
+		operands[0] = *load.result;
+		kernel_instrs.push_back(load);
+	}
+
+	// the body keeps the loads and constants the kernel uses, in the same order
+	for (auto const& instr : instrs)
+	{
+		if (instr.result.has_value() &&
+			std::find(std::begin(operands), std::end(operands), *instr.result) != std::end(operands))
+			kernel_instrs.push_back(instr);
+	}
+
+	auto end = counted->bound;
+	if (counted->cmp == BytecodeType::LESSER_EQUALS_I)
+	{
+		Instruction one{ Op::CONST, create_value(ValueType::INT) };
+		one.constant = (int64_t)1;
+
+		Instruction add{ Op::BYTECODE, create_value(ValueType::INT), { counted->bound, *one.result } };
+		add.code = BytecodeType::ADD_I;
+
+		end = *add.result;
+		kernel_instrs.push_back(one);
+		kernel_instrs.push_back(add);
+	}
+
+	Instruction kernel{ Op::BYTECODE, create_value(func.value_types[operands[0]]), { counted->counter, end } };
+	kernel.operands.insert(std::end(kernel.operands), std::begin(operands), std::end(operands));
+	kernel.code = effect->code;
+	kernel.immediates = { (bytecode_t)operands.size(), (bytecode_t)program.size() };
+	kernel.immediates.insert(std::end(kernel.immediates), std::begin(program), std::end(program));
+
+	Instruction store_var{ Op::STORE, std::nullopt, { *kernel.result } };
+	store_var.id = effect->var_id;
+
+	// the header only runs the body if the counter starts below the end, which
+	// is where the counter stops
+	Instruction store_counter{ Op::STORE, std::nullopt, { end } };
+	store_counter.id = counted->var_id;
+
+	kernel_instrs.push_back(kernel);
+	kernel_instrs.push_back(store_var);
+	kernel_instrs.push_back(store_counter);
+
+	auto exit = func.blocks[loop.header].terminator->false_block;
+
+	func.blocks[body].instrs = kernel_instrs;
+	func.blocks[body].terminator = { TerminatorType::JUMP, std::nullopt, exit, exit };
+
+	return true;
+}
+
+bool ir::vectorize_loops(Function& func)
+{
+	return change_loops(func, [&](Loop const& loop, std::vector<Loop> const&) {
+		return vectorize_loop(func, loop);
+	});
+}
@@ -0,0 +1,1585 @@
+#include "test_ir.hpp"
+#include "night_tests.hpp"
+#include "../code/include/ir.hpp"
+#include "../code/include/purity.hpp"
+#include "../code/include/licm.hpp"
+#include "../code/include/range.hpp"
+#include "../code/include/vectorize.hpp"
+#include "../code/include/unroll.hpp"
+#include "../code/include/loop_inversion.hpp"
+#include "../code/include/cse.hpp"
+#include "../code/include/switch.hpp"
+#include "../code/include/const_eval.hpp"
+#include "../code/include/dead_code.hpp"
+#include "../code/include/profile.hpp"
+#include "../code/include/interpreter.hpp"
+#include "../code/include/interpreter_scope.hpp"
+#include "../code/include/parser_scope.hpp"
+#include "../code/include/bytecode.hpp"
+#include "../code/include/error.hpp"
+#include "../code/include/source_table.hpp"
+#include "../code/include/parser.hpp"
+#include "../code/include/lexer.hpp"
+#include "../code/include/symbols.hpp"
+#include "../code/include/inliner.hpp"
+#include "../code/include/peephole.hpp"
+#include "../code/include/code_gen.hpp"
+#include "../code/include/debug.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <cstdio>
+#include <stdexcept>
+
+#define BC(type) (bytecode_t)BytecodeType::type
+
+void test_ir()
+{
+	std::clog << "testing ir\n\n";
+
+	test_ir_lower_stack();
+	test_ir_lower_out_of_order();
+	test_ir_lower_phi();
+	test_ir_dump();
+	test_ir_find_loops();
+	test_ir_hoist_loop_invariants();
+	test_ir_remove_bounds_checks();
+	test_ir_vectorize_loops();
+	test_ir_unroll_loops();
+	test_ir_invert_loops();
+	test_ir_find_pure_functions();
+	test_ir_eliminate_common_subexpressions();
+	test_ir_form_switches();
+	test_ir_evaluate_constant_calls();
+	test_ir_remove_dead_code();
+	test_ir_profile();
+	test_ir_reduce_strength();
+	test_ir_inline_functions();
+	test_ir_memoize_functions();
+	test_ir_fold_constants();
+	test_ir_remove_dead_statements();
+}
+
+void test_ir_lower_stack()
+{
+	std::clog << "testing lowering values on the stack\n";
+
+	// var1 = var0 + 2;
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto var0 = builder.load(0, ValueType::INT);
+	auto two = builder.constant(ValueType::INT, 2);
+	builder.store(1, builder.op(BytecodeType::ADD_I, { var0, two }, ValueType::INT));
+
+	auto codes = ir::lower(module.main);
+	night_assert("values used once, in order, stay on the stack",
+		(codes == bytecodes_t{ BC(LOAD), 0, BC(S_INT1), 2, BC(ADD_I), BC(STORE), 1 }));
+}
+
+void test_ir_lower_out_of_order()
+{
+	std::clog << "testing lowering values out of stack order\n";
+
+	// var2 = var1 - var0; where var0 is loaded first
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto var0 = builder.load(0, ValueType::INT);
+	auto var1 = builder.load(1, ValueType::INT);
+	builder.store(2, builder.op(BytecodeType::SUB_I, { var1, var0 }, ValueType::INT));
+
+	ParserScope::next_var_id = 10;
+
+	auto codes = ir::lower(module.main);
+	night_assert("a value below its use's first operand is stored in a new variable",
+		(codes == bytecodes_t{ BC(LOAD), 0, BC(STORE), 10, BC(LOAD), 1, BC(LOAD), 10, BC(SUB_I), BC(STORE), 2 }));
+	night_assert("the new variable is one of the function's variables",
+		(module.main.var_ids == std::vector<bytecode_t>{ 10 }));
+
+	// the same statement, more times than there are variables
+	ir::Module many_module;
+	ir::Builder many_builder(many_module, many_module.main);
+
+	for (int i = 0; i < 300; ++i)
+	{
+		auto var0 = many_builder.load(0, ValueType::INT);
+		auto var1 = many_builder.load(1, ValueType::INT);
+		many_builder.store(2, many_builder.op(BytecodeType::SUB_I, { var1, var0 }, ValueType::INT));
+	}
+
+	ParserScope::next_var_id = 10;
+	ir::lower(many_module.main);
+
+	night_assert("a variable is used again once its value is no longer needed",
+		(many_module.main.var_ids == std::vector<bytecode_t>{ 10 } && ParserScope::next_var_id == 11));
+
+	// the statement is on the third line of a file
+	ir::Module full_module;
+	ir::Builder full_builder(full_module, full_module.main);
+
+	auto start = source_table::add_file("lower.night", "a\nb\nvar2 = var1 - var0;\n");
+	full_builder.loc = SourcePos{ start.offset + 4 };
+
+	auto full_var0 = full_builder.load(0, ValueType::INT);
+	auto full_var1 = full_builder.load(1, ValueType::INT);
+	full_builder.store(2, full_builder.op(BytecodeType::SUB_I, { full_var1, full_var0 }, ValueType::INT));
+
+	ParserScope::next_var_id = bytecode_t_lim;
+
+	std::string error;
+	try
+	{
+		ir::lower(full_module.main);
+	}
+	catch (night::error const& e)
+	{
+		error = e.what();
+	}
+
+	night_assert("running out of variables is reported at the statement that needs one",
+		(error.find("lower.night (3:0)") != std::string::npos));
+}
+
+void test_ir_lower_phi()
+{
+	std::clog << "testing lowering phis\n";
+
+	// return var0 ? 1 : 2;
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto one_block = builder.create_block();
+	auto two_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.branch(builder.load(0, ValueType::BOOL), one_block, two_block);
+
+	builder.set_block(one_block);
+	auto one = builder.constant(ValueType::INT, 1);
+	builder.jump(end_block);
+
+	builder.set_block(two_block);
+	auto two = builder.constant(ValueType::INT, 2);
+	builder.jump(end_block);
+
+	builder.set_block(end_block);
+	builder.ret(builder.phi(ValueType::INT, { { one_block, one }, { two_block, two } }));
+
+	ParserScope::next_var_id = 10;
+
+	auto codes = ir::lower(module.main);
+	night_assert("incoming values are stored in the phi's variable at the end of each predecessor",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 9, BC(JUMP_IF_FALSE),
+			BC(S_INT1), 1, BC(STORE), 10, BC(JUMP), 4, 0, 0, 0,
+			BC(S_INT1), 2, BC(STORE), 10,
+			BC(LOAD), 10, BC(RETURN) }));
+
+	InterpreterScope scope;
+
+	scope.vars[0] = intpr::Value((int64_t)1);
+	night_assert("the phi is the value from the block that was taken",
+		(interpret_bytecodes(scope, codes)->i == 1));
+
+	scope.vars[0] = intpr::Value((int64_t)0);
+	night_assert("the phi is the value from the other block that was taken",
+		(interpret_bytecodes(scope, codes)->i == 2));
+}
+
+void test_ir_dump()
+{
+	std::clog << "testing dump\n";
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	module.var_names[0] = "var0";
+
+	auto var0 = builder.load(0, ValueType::INT);
+	auto shift = builder.op(BytecodeType::SHIFT_LEFT_I, { var0 }, ValueType::INT, { 3 });
+	builder.store(0, shift);
+	builder.ret(std::nullopt);
+
+	std::stringstream out;
+	ir::dump(module.main, module, out);
+
+	night_assert("instructions are dumped one per line, with the types of their values",
+		(out.str() ==
+			"func main()\n"
+			"bb0:\n"
+			"    %0 = int load var0#0\n"
+			"    %1 = int SHIFT_LEFT_I %0 (3)\n"
+			"    store var0#0 %1\n"
+			"    return\n\n"));
+}
+
+void test_ir_find_loops()
+{
+	std::clog << "testing finding loops\n";
+
+	// while (var0) { while (var1) {} }
+	// while (var2) {}
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto outer_cond = builder.create_block();
+	auto outer_body = builder.create_block();
+	auto inner_cond = builder.create_block();
+	auto inner_body = builder.create_block();
+	auto outer_latch = builder.create_block();
+	auto second_cond = builder.create_block();
+	auto second_body = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.jump(outer_cond);
+
+	builder.set_block(outer_cond);
+	builder.branch(builder.load(0, ValueType::BOOL), outer_body, second_cond);
+	builder.set_block(outer_body);
+	builder.jump(inner_cond);
+	builder.set_block(inner_cond);
+	builder.branch(builder.load(1, ValueType::BOOL), inner_body, outer_latch);
+	builder.set_block(inner_body);
+	builder.jump(inner_cond);
+	builder.set_block(outer_latch);
+	builder.jump(outer_cond);
+
+	builder.set_block(second_cond);
+	builder.branch(builder.load(2, ValueType::BOOL), second_body, end_block);
+	builder.set_block(second_body);
+	builder.jump(second_cond);
+
+	builder.set_block(end_block);
+	builder.ret(std::nullopt);
+
+	auto loops = ir::find_loops(module.main);
+	night_assert("inner loops come before the loops containing them",
+		(loops.size() == 3 && loops[0].header == inner_cond && loops[1].header == second_cond && loops[2].header == outer_cond));
+	night_assert("the blocks of a loop are in reverse postorder, from its header",
+		(loops[2].blocks == std::vector<ir::block_t>{ outer_cond, outer_body, inner_cond, inner_body, outer_latch }));
+
+	// each loop changes the first time it is tried
+	std::vector<ir::block_t> tried;
+	ir::change_loops(module.main, [&](ir::Loop const& loop, std::vector<ir::Loop> const&) {
+		tried.push_back(loop.header);
+		return std::count(std::begin(tried), std::end(tried), loop.header) == 1;
+	});
+
+	night_assert("a loop containing one that changed is only tried once the loops are found again",
+		(tried == std::vector<ir::block_t>{
+			inner_cond, second_cond,
+			inner_cond, second_cond, outer_cond,
+			inner_cond, second_cond, outer_cond }));
+}
+
+void test_ir_hoist_loop_invariants()
+{
+	std::clog << "testing hoisting loop invariants\n";
+
+	// while (var1 < 10) var1 += var0 * 2;
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.jump(cond_block);
+
+	builder.set_block(cond_block);
+	auto cond = builder.op(BytecodeType::LESSER_I,
+		{ builder.load(1, ValueType::INT), builder.constant(ValueType::INT, 10) }, ValueType::BOOL);
+	builder.branch(cond, body_block, end_block);
+
+	builder.set_block(body_block);
+	auto var1 = builder.load(1, ValueType::INT);
+	auto mult = builder.op(BytecodeType::MULT_I,
+		{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 2) }, ValueType::INT);
+	builder.store(1, builder.op(BytecodeType::ADD_I, { var1, mult }, ValueType::INT));
+	builder.jump(cond_block);
+
+	builder.set_block(end_block);
+	builder.ret(std::nullopt);
+
+	night_assert("the loop has an invariant to hoist",
+		ir::hoist_loop_invariants(module.main));
+
+	auto const& entry = module.main.blocks[0].instrs;
+	night_assert("the invariant, and the operands it uses, are moved to the preheader",
+		(entry.size() == 3 && entry.back().result == mult));
+	night_assert("the variable assigned in the loop is not moved",
+		(module.main.blocks[body_block].instrs.front().result == var1));
+
+	night_assert("a loop with nothing left to hoist is unchanged",
+		!ir::hoist_loop_invariants(module.main));
+}
+
+void test_ir_remove_bounds_checks()
+{
+	std::clog << "testing removing bounds checks\n";
+
+	// var0 = 0; while (var0 < len(var1)) { print(var1[var0]); print(var1[var0 + 1]); var0 += 1; }
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.store(1, builder.constant(std::string("abc")));
+	builder.store(0, builder.constant(ValueType::INT, 0));
+	builder.jump(cond_block);
+
+	builder.set_block(cond_block);
+	auto len = builder.call(11, { builder.load(1, ValueType::STR) }, ValueType::INT, true);
+	builder.branch(builder.op(BytecodeType::LESSER_I, { builder.load(0, ValueType::INT), *len }, ValueType::BOOL), body_block, end_block);
+
+	builder.set_block(body_block);
+	auto in_bounds = builder.op(BytecodeType::SUBSCRIPT,
+		{ builder.load(0, ValueType::INT), builder.load(1, ValueType::STR) }, ValueType::CHAR);
+	builder.call(1, { in_bounds }, std::nullopt, false);
+
+	auto next = builder.op(BytecodeType::ADD_I, { builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 1) }, ValueType::INT);
+	auto out_of_bounds = builder.op(BytecodeType::SUBSCRIPT, { next, builder.load(1, ValueType::STR) }, ValueType::CHAR);
+	builder.call(1, { out_of_bounds }, std::nullopt, false);
+
+	builder.store(0, builder.op(BytecodeType::ADD_I, { builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 1) }, ValueType::INT));
+	builder.jump(cond_block);
+
+	builder.set_block(end_block);
+	builder.ret(std::nullopt);
+
+	ir::RangeAnalysis analysis(module.main);
+	night_assert("the loop counter is never negative",
+		(analysis.range_of(next).lo == 1));
+
+	night_assert("a subscript is unchecked",
+		ir::remove_bounds_checks(module.main));
+
+	auto const& body = module.main.blocks[body_block].instrs;
+	auto code_of = [&](ir::value_t value) {
+		return std::find_if(std::begin(body), std::end(body),
+			[&](ir::Instruction const& instr) { return instr.result == value; })->code;
+	};
+
+	night_assert("an index compared against the length of the string is in bounds",
+		(code_of(in_bounds) == BytecodeType::SUBSCRIPT_UNCHECKED));
+	night_assert("an index past the compared index is still checked",
+		(code_of(out_of_bounds) == BytecodeType::SUBSCRIPT));
+}
+
+// var0 = 0; var1 = 0; while (var0 < bound) { var1 += var0; var0 += 1; } return var1;
+static void build_counted_loop(ir::Builder& builder, ir::value_t bound, int64_t start = 0, int64_t step = 1)
+{
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.store(0, builder.constant(ValueType::INT, start));
+	builder.store(1, builder.constant(ValueType::INT, 0));
+	builder.jump(cond_block);
+
+	builder.set_block(cond_block);
+	auto cond = builder.op(BytecodeType::LESSER_I, { builder.load(0, ValueType::INT), bound }, ValueType::BOOL);
+	builder.branch(cond, body_block, end_block);
+
+	builder.set_block(body_block);
+	builder.store(1, builder.op(BytecodeType::ADD_I,
+		{ builder.load(1, ValueType::INT), builder.load(0, ValueType::INT) }, ValueType::INT));
+	builder.store(0, builder.op(BytecodeType::ADD_I,
+		{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, step) }, ValueType::INT));
+	builder.jump(cond_block);
+
+	builder.set_block(end_block);
+	builder.ret(builder.load(1, ValueType::INT));
+}
+
+void test_ir_vectorize_loops()
+{
+	std::clog << "testing vectorizing loops\n";
+
+	{
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, builder.load(2, ValueType::INT));
+
+		night_assert("a loop that adds the counter to a variable is vectorized",
+			ir::vectorize_loops(module.main));
+		night_assert("a vectorized loop is no longer a loop",
+			ir::find_loops(module.main).empty());
+
+		auto codes = ir::lower(module.main);
+		night_assert("the loop is lowered to a VECTOR_SUM",
+			(std::find(std::begin(codes), std::end(codes), BC(VECTOR_SUM)) != std::end(codes)));
+
+		for (int64_t n : { -2, 0, 3, 300 })
+		{
+			InterpreterScope scope;
+			scope.vars[2] = intpr::Value(n);
+
+			night_assert("the kernel adds every iteration for a count of " + std::to_string(n),
+				(interpret_bytecodes(scope, codes)->i == (n > 0 ? n * (n - 1) / 2 : 0)));
+			night_assert("the counter ends at its last value for a count of " + std::to_string(n),
+				(scope.vars[0].i == std::max<int64_t>(n, 0)));
+		}
+	}
+
+	{
+		// the counter starts below 0, where there are no arrays to be out of bounds of
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, builder.load(2, ValueType::INT), -300);
+
+		night_assert("a loop with a negative start is vectorized",
+			ir::vectorize_loops(module.main));
+
+		auto codes = ir::lower(module.main);
+		for (int64_t n : { -400, -300, -3, 0, 5, 300 })
+		{
+			int64_t sum = 0;
+			for (int64_t i = -300; i < n; ++i)
+				sum += i;
+
+			InterpreterScope scope;
+			scope.vars[2] = intpr::Value(n);
+
+			night_assert("the kernel adds every iteration from -300 to " + std::to_string(n),
+				(interpret_bytecodes(scope, codes)->i == sum));
+			night_assert("the counter ends at its last value from -300 to " + std::to_string(n),
+				(scope.vars[0].i == std::max<int64_t>(n, -300)));
+		}
+	}
+
+	{
+		// the last block ends at INT64_MAX
+		auto max = std::numeric_limits<int64_t>::max();
+
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, builder.load(2, ValueType::INT), max - 300);
+
+		night_assert("a loop that ends at the largest int is vectorized",
+			ir::vectorize_loops(module.main));
+
+		uint64_t sum = 0;
+		for (int64_t i = max - 300; i < max; ++i)
+			sum += (uint64_t)i;
+
+		InterpreterScope scope;
+		scope.vars[2] = intpr::Value(max);
+
+		auto codes = ir::lower(module.main);
+		night_assert("the kernel adds every iteration up to the largest int",
+			(interpret_bytecodes(scope, codes)->i == (int64_t)sum));
+	}
+
+	// for (var0 = 0; var0 < var2; var0 += 1) { var3[var0] = var4[var0] * 3 + var0; }
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.store(0, builder.constant(ValueType::INT, 0));
+	builder.jump(cond_block);
+
+	builder.set_block(cond_block);
+	auto cond = builder.op(BytecodeType::LESSER_I, { builder.load(0, ValueType::INT), builder.load(2, ValueType::INT) }, ValueType::BOOL);
+	builder.branch(cond, body_block, end_block);
+
+	builder.set_block(body_block);
+	auto element = builder.op(BytecodeType::SUBSCRIPT,
+		{ builder.load(0, ValueType::INT), builder.load(4, ValueType(ValueType::INT, 1)) }, ValueType::INT);
+	auto product = builder.op(BytecodeType::MULT_I, { element, builder.constant(ValueType::INT, 3) }, ValueType::INT);
+	builder.set_index(3, { builder.load(0, ValueType::INT) },
+		builder.op(BytecodeType::ADD_I, { product, builder.load(0, ValueType::INT) }, ValueType::INT));
+	builder.store(0, builder.op(BytecodeType::ADD_I,
+		{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 1) }, ValueType::INT));
+	builder.jump(cond_block);
+
+	builder.set_block(end_block);
+	builder.ret(std::nullopt);
+
+	night_assert("a loop that sets each element of an array is vectorized",
+		ir::vectorize_loops(module.main));
+
+	auto codes = ir::lower(module.main);
+	night_assert("the loop is lowered to a VECTOR_MAP",
+		(std::find(std::begin(codes), std::end(codes), BC(VECTOR_MAP)) != std::end(codes)));
+
+	auto make_array = [](int64_t size) {
+		std::vector<intpr::Value> elements;
+		for (int64_t i = 0; i < size; ++i)
+			elements.push_back(intpr::Value(i + 1));
+
+		return intpr::Value(elements);
+	};
+
+	InterpreterScope scope;
+	scope.vars[2] = intpr::Value((int64_t)600);
+	scope.vars[3] = make_array(600);
+	scope.vars[4] = make_array(600);
+	interpret_bytecodes(scope, codes);
+
+	night_assert("the kernel sets every element",
+		(scope.vars[3].v[0].i == 3 && scope.vars[3].v[599].i == 600 * 3 + 599));
+
+	scope.vars[3] = make_array(600);
+	scope.vars[4] = make_array(5);
+
+	bool is_out_of_range = false;
+	try
+	{
+		interpret_bytecodes(scope, codes);
+	}
+	catch (std::out_of_range const&)
+	{
+		is_out_of_range = true;
+	}
+
+	night_assert("an element out of bounds stops the kernel, like the loop",
+		is_out_of_range);
+
+	{
+		// for (var0 = 0; var0 < var2;) { var0 += 1; var3[var0] = 1; }
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+
+		auto cond_block = builder.create_block();
+		auto body_block = builder.create_block();
+		auto end_block = builder.create_block();
+
+		builder.store(0, builder.constant(ValueType::INT, 0));
+		builder.jump(cond_block);
+
+		builder.set_block(cond_block);
+		builder.branch(builder.op(BytecodeType::LESSER_I,
+			{ builder.load(0, ValueType::INT), builder.load(2, ValueType::INT) }, ValueType::BOOL), body_block, end_block);
+
+		builder.set_block(body_block);
+		builder.store(0, builder.op(BytecodeType::ADD_I,
+			{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 1) }, ValueType::INT));
+		builder.set_index(3, { builder.load(0, ValueType::INT) }, builder.constant(ValueType::INT, 1));
+		builder.jump(cond_block);
+
+		builder.set_block(end_block);
+		builder.ret(std::nullopt);
+
+		night_assert("a loop that sets the element after the one at the counter is not vectorized",
+			!ir::vectorize_loops(module.main));
+	}
+}
+
+void test_ir_unroll_loops()
+{
+	std::clog << "testing unrolling loops\n";
+
+	{
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, builder.constant(ValueType::INT, 4));
+
+		night_assert("a loop with a constant count is unrolled",
+			ir::unroll_loops(module.main));
+		night_assert("a fully unrolled loop is no longer a loop",
+			ir::find_loops(module.main).empty());
+
+		InterpreterScope scope;
+		night_assert("the unrolled loop runs every iteration",
+			(interpret_bytecodes(scope, ir::lower(module.main))->i == 6));
+	}
+
+	{
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, builder.load(2, ValueType::INT));
+
+		ir::unroll_factor = 4;
+		night_assert("a loop with a count only known when it runs is unrolled",
+			ir::unroll_loops(module.main));
+		night_assert("the original loop is kept for the iterations that are left over",
+			(ir::find_loops(module.main).size() == 2));
+
+		auto codes = ir::lower(module.main);
+		for (int64_t n : { 0, 3, 4, 10 })
+		{
+			InterpreterScope scope;
+			scope.vars[2] = intpr::Value(n);
+
+			night_assert("the unrolled loop runs the same iterations for a count of " + std::to_string(n),
+				(interpret_bytecodes(scope, codes)->i == n * (n - 1) / 2));
+		}
+	}
+
+	// a loop that stops just before the limit of int64_t, where the counter of
+	// the last copy would overflow
+	constexpr int64_t max = std::numeric_limits<int64_t>::max();
+
+	uint64_t sum = 0;
+	for (int64_t i = max - 30; i < max - 1; i += 3)
+		sum += (uint64_t)i;
+
+	for (bool is_constant : { true, false })
+	{
+		ir::Module module;
+		ir::Builder builder(module, module.main);
+		build_counted_loop(builder, is_constant ? builder.constant(ValueType::INT, max - 1) : builder.load(2, ValueType::INT), max - 30, 3);
+
+		ir::unroll_factor = 4;
+		ir::unroll_loops(module.main);
+
+		InterpreterScope scope;
+		scope.vars[2] = intpr::Value(max - 1);
+
+		night_assert(std::string("the unrolled loop stops at the limit of int64_t with a ") + (is_constant ? "constant" : "variable") + " bound",
+			(interpret_bytecodes(scope, ir::lower(module.main))->i == (int64_t)sum));
+	}
+}
+
+void test_ir_invert_loops()
+{
+	std::clog << "testing inverting loops\n";
+
+	// var0 = 0; while (var0 < 5) var0 += 2; return var0;
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto cond_block = builder.create_block();
+	auto body_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	builder.store(0, builder.constant(ValueType::INT, 0));
+	builder.jump(cond_block);
+
+	builder.set_block(cond_block);
+	auto cond = builder.op(BytecodeType::LESSER_I,
+		{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 5) }, ValueType::BOOL);
+	builder.branch(cond, body_block, end_block);
+
+	builder.set_block(body_block);
+	builder.store(0, builder.op(BytecodeType::ADD_I,
+		{ builder.load(0, ValueType::INT), builder.constant(ValueType::INT, 2) }, ValueType::INT));
+	builder.jump(cond_block);
+
+	builder.set_block(end_block);
+	builder.ret(builder.load(0, ValueType::INT));
+
+	night_assert("the loop is inverted",
+		ir::invert_loops(module.main));
+
+	auto const& latch = module.main.blocks[body_block];
+	night_assert("the body ends with a copy of the condition, branching back to itself",
+		(latch.terminator->type == ir::TerminatorType::BRANCH && latch.terminator->value != cond &&
+		 latch.terminator->true_block == body_block && latch.terminator->false_block == end_block));
+	night_assert("the header is only a guard before the loop",
+		(ir::predecessors(module.main)[cond_block] == std::vector<ir::block_t>{ 0 }));
+
+	InterpreterScope scope;
+	night_assert("the inverted loop runs the same number of iterations",
+		(interpret_bytecodes(scope, ir::lower(module.main))->i == 6));
+}
+
+void test_ir_find_pure_functions()
+{
+	std::clog << "testing finding pure functions\n";
+
+	// def twice(var0) { return var0 + var0; }
+	// def global() { return var1; }
+	// def calls_global(var2) { return global() + var2; }
+	ir::Module module;
+
+	auto& twice = module.funcs[12];
+	twice.var_ids = { 0 };
+	ir::Builder twice_builder(module, twice);
+	twice_builder.ret(twice_builder.op(BytecodeType::ADD_I,
+		{ twice_builder.load(0, ValueType::INT), twice_builder.load(0, ValueType::INT) }, ValueType::INT));
+
+	auto& global = module.funcs[13];
+	ir::Builder global_builder(module, global);
+	global_builder.ret(global_builder.load(1, ValueType::INT));
+
+	auto& calls_global = module.funcs[14];
+	calls_global.var_ids = { 2 };
+	ir::Builder calls_global_builder(module, calls_global);
+	auto global_val = calls_global_builder.call(13, {}, ValueType::INT, false);
+	calls_global_builder.ret(calls_global_builder.op(BytecodeType::ADD_I,
+		{ *global_val, calls_global_builder.load(2, ValueType::INT) }, ValueType::INT));
+
+	ir::Builder builder(module, module.main);
+	auto arg = builder.constant(ValueType::INT, 1);
+	auto twice_val = builder.call(12, { arg }, ValueType::INT, false);
+	auto calls_global_val = builder.call(14, { arg }, ValueType::INT, false);
+	builder.call(2, { builder.op(BytecodeType::ADD_I, { *twice_val, *calls_global_val }, ValueType::INT) }, std::nullopt, false);
+
+	night_assert("a call is marked as pure",
+		ir::find_pure_functions(module));
+
+	auto const& instrs = module.main.blocks[0].instrs;
+	auto call_of = [&](ir::value_t value) {
+		return *std::find_if(std::begin(instrs), std::end(instrs),
+			[&](ir::Instruction const& instr) { return instr.result == value; });
+	};
+
+	night_assert("a function that only uses its parameters is pure",
+		call_of(*twice_val).is_pure);
+	night_assert("a function that calls a function using a global variable is not pure",
+		!call_of(*calls_global_val).is_pure);
+	night_assert("print is not pure",
+		!instrs.back().is_pure);
+}
+
+void test_ir_eliminate_common_subexpressions()
+{
+	std::clog << "testing eliminating common subexpressions\n";
+
+	// var2 = var1[var0]; if (var2) var3 = var1[var0]; var1 = ""; var4 = var1[var0];
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	auto then_block = builder.create_block();
+	auto end_block = builder.create_block();
+
+	auto subscript = [&]() {
+		return builder.op(BytecodeType::SUBSCRIPT,
+			{ builder.load(0, ValueType::INT), builder.load(1, ValueType::STR) }, ValueType::CHAR);
+	};
+
+	auto first = subscript();
+	builder.store(2, first);
+	builder.branch(first, then_block, end_block);
+
+	builder.set_block(then_block);
+	builder.store(3, subscript());
+	builder.jump(end_block);
+
+	builder.set_block(end_block);
+	builder.store(1, builder.constant(std::string("")));
+	builder.store(4, subscript());
+	builder.ret(std::nullopt);
+
+	night_assert("a subscript is reused",
+		ir::eliminate_common_subexpressions(module.main));
+
+	auto const& then_instrs = module.main.blocks[then_block].instrs;
+	night_assert("a subscript in a dominated block uses the first subscript's value, and its loads are removed",
+		(then_instrs.size() == 1 && then_instrs[0].operands[0] == first));
+
+	auto const& end_instrs = module.main.blocks[end_block].instrs;
+	night_assert("a subscript after its string is assigned is computed again",
+		std::any_of(std::begin(end_instrs), std::end(end_instrs),
+			[](ir::Instruction const& instr) { return instr.op == ir::Op::BYTECODE && instr.code == BytecodeType::SUBSCRIPT; }));
+}
+
+void test_ir_form_switches()
+{
+	std::clog << "testing forming switches\n";
+
+	// if (var0 == 1) { return 10; } elif (var0 == 2) { return 20; }
+	// elif (3 == var0) { return 30; } elif (var0 == 2) { return 40; }
+	// return 0;
+	auto build_chain = [](ir::Module& module, std::vector<int64_t> const& keys) {
+		ir::Builder builder(module, module.main);
+
+		for (std::size_t i = 0; i < keys.size(); ++i)
+		{
+			auto case_block = builder.create_block();
+			auto next_block = builder.create_block();
+
+			auto var0 = builder.load(0, ValueType::INT);
+			auto key = builder.constant(ValueType::INT, keys[i]);
+			auto operands = i == 2 ? std::vector<ir::value_t>{ key, var0 } : std::vector<ir::value_t>{ var0, key };
+			builder.branch(builder.op(BytecodeType::EQUALS_I, operands, ValueType::BOOL), case_block, next_block);
+
+			builder.set_block(case_block);
+			builder.ret(builder.constant(ValueType::INT, 10 * (i + 1)));
+
+			builder.set_block(next_block);
+		}
+
+		builder.ret(builder.constant(ValueType::INT, 0));
+	};
+
+	ir::Module module;
+	build_chain(module, { 1, 2, 3, 2 });
+
+	night_assert("a chain of comparisons to constants is a switch",
+		(ir::form_switches(module.main) && module.main.blocks[0].terminator->type == ir::TerminatorType::SWITCH));
+
+	auto const& cases = module.main.blocks[0].terminator->cases;
+	night_assert("the first case with a key is kept",
+		(cases.size() == 3 && cases[1].first == 2 && cases[1].second == 3));
+	night_assert("only the first block loads the variable",
+		(module.main.blocks[0].instrs.size() == 1));
+
+	auto codes = ir::lower(module.main);
+	night_assert("close keys are lowered to a TABLE_SWITCH",
+		(std::find(std::begin(codes), std::end(codes), BC(TABLE_SWITCH)) != std::end(codes)));
+
+	InterpreterScope scope;
+	for (int64_t val : { 0, 1, 2, 3, 4 })
+	{
+		scope.vars[0] = intpr::Value(val);
+		night_assert("the switch goes to the case of the value, or the default",
+			(interpret_bytecodes(scope, codes)->i == (val >= 1 && val <= 3 ? 10 * val : 0)));
+	}
+
+	ir::Module sparse_module;
+	build_chain(sparse_module, { -50, 7, 1000 });
+	ir::form_switches(sparse_module.main);
+
+	codes = ir::lower(sparse_module.main);
+	night_assert("keys that are far apart are lowered to a LOOKUP_SWITCH",
+		(std::find(std::begin(codes), std::end(codes), BC(LOOKUP_SWITCH)) != std::end(codes)));
+
+	for (int64_t val : { -50, 7, 1000, 8 })
+	{
+		scope.vars[0] = intpr::Value(val);
+		night_assert("the binary search finds the case of the value, or the default",
+			(interpret_bytecodes(scope, codes)->i == (val == -50 ? 10 : val == 7 ? 20 : val == 1000 ? 30 : 0)));
+	}
+
+	ir::Module short_module;
+	build_chain(short_module, { 1, 2 });
+	night_assert("a chain with too few cases is left as branches",
+		!ir::form_switches(short_module.main));
+}
+
+void test_ir_evaluate_constant_calls()
+{
+	std::clog << "testing evaluating constant calls\n";
+
+	// def divide(var0, var1) { return var0 / var1; }
+	ir::Module module;
+
+	auto& divide = module.funcs[12];
+	divide.param_ids = { 0, 1 };
+	divide.var_ids = { 0, 1 };
+	ir::Builder divide_builder(module, divide);
+	divide_builder.ret(divide_builder.op(BytecodeType::DIV_I,
+		{ divide_builder.load(0, ValueType::INT), divide_builder.load(1, ValueType::INT) }, ValueType::INT));
+
+	// print(divide(divide(84, 2), 2)); print(divide(1, 0));
+	ir::Builder builder(module, module.main);
+	auto inner = builder.call(12, { builder.constant(ValueType::INT, 84), builder.constant(ValueType::INT, 2) }, ValueType::INT, false);
+	auto outer = builder.call(12, { *inner, builder.constant(ValueType::INT, 2) }, ValueType::INT, false);
+	builder.call(2, { *outer }, std::nullopt, false);
+	auto by_zero = builder.call(12, { builder.constant(ValueType::INT, 1), builder.constant(ValueType::INT, 0) }, ValueType::INT, false);
+	builder.call(2, { *by_zero }, std::nullopt, false);
+
+	ir::find_pure_functions(module);
+
+	night_assert("a call is evaluated",
+		ir::evaluate_constant_calls(module));
+
+	auto const& instrs = module.main.blocks[0].instrs;
+	auto def_of = [&](ir::value_t value) {
+		return *std::find_if(std::begin(instrs), std::end(instrs),
+			[&](ir::Instruction const& instr) { return instr.result == value; });
+	};
+
+	night_assert("a call with the result of an evaluated call as its argument is evaluated",
+		(def_of(*outer).op == ir::Op::CONST && std::get<int64_t>(def_of(*outer).constant) == 21));
+	night_assert("a call that would divide by zero is left for when the program runs",
+		(def_of(*by_zero).op == ir::Op::CALL));
+
+	// def spin(var0) { while (var0 > 0) var0 -= 1; return var0; }
+	// where each iteration is a step
+	ir::Module spin_module;
+
+	auto& spin = spin_module.funcs[12];
+	spin.param_ids = { 0 };
+	spin.var_ids = { 0 };
+	ir::Builder spin_builder(spin_module, spin);
+
+	auto cond_block = spin_builder.create_block();
+	auto body_block = spin_builder.create_block();
+	auto end_block = spin_builder.create_block();
+
+	spin_builder.jump(cond_block);
+
+	spin_builder.set_block(cond_block);
+	spin_builder.branch(spin_builder.op(BytecodeType::GREATER_I,
+		{ spin_builder.load(0, ValueType::INT), spin_builder.constant(ValueType::INT, 0) }, ValueType::BOOL), body_block, end_block);
+
+	spin_builder.set_block(body_block);
+	spin_builder.store(0, spin_builder.op(BytecodeType::SUB_I,
+		{ spin_builder.load(0, ValueType::INT), spin_builder.constant(ValueType::INT, 1) }, ValueType::INT));
+	spin_builder.jump(cond_block);
+
+	spin_builder.set_block(end_block);
+	spin_builder.ret(spin_builder.load(0, ValueType::INT));
+
+	// print(spin(n)); print(spin(n + 1)); print(spin(1));
+	// where n is more than half of the steps
+	int64_t n = ir::eval_step_budget * 3 / 5;
+
+	ir::Builder main_builder(spin_module, spin_module.main);
+	std::vector<ir::value_t> spins;
+	for (int64_t arg : { n, n + 1, (int64_t)1 })
+	{
+		spins.push_back(*main_builder.call(12, { main_builder.constant(ValueType::INT, arg) }, ValueType::INT, false));
+		main_builder.call(2, { spins.back() }, std::nullopt, false);
+	}
+
+	ir::find_pure_functions(spin_module);
+	ir::evaluate_constant_calls(spin_module);
+
+	auto const& spin_instrs = spin_module.main.blocks[0].instrs;
+	auto spin_op = [&](ir::value_t value) {
+		return std::find_if(std::begin(spin_instrs), std::end(spin_instrs),
+			[&](ir::Instruction const& instr) { return instr.result == value; })->op;
+	};
+
+	night_assert("a call within the steps is evaluated",
+		(spin_op(spins[0]) == ir::Op::CONST));
+	night_assert("calls share the steps of the module, so a second long call runs out of them",
+		(spin_op(spins[1]) == ir::Op::CALL));
+	night_assert("a function that ran out of steps is not evaluated again",
+		(spin_op(spins[2]) == ir::Op::CALL));
+}
+
+void test_ir_remove_dead_code()
+{
+	std::clog << "testing removing dead code\n";
+
+	// def used(var10) { return var10; }
+	// def unused() { return used(1); }
+	// var20 = used(2); var30 = 3; print(var20);
+	ir::Module module;
+
+	auto& used = module.funcs[12];
+	used.param_ids = { 10 };
+	used.var_ids = { 10, 11 };
+	ir::Builder used_builder(module, used);
+	used_builder.ret(used_builder.load(10, ValueType::INT));
+
+	auto& unused = module.funcs[13];
+	ir::Builder unused_builder(module, unused);
+	unused_builder.ret(unused_builder.call(12, { unused_builder.constant(ValueType::INT, 1) }, ValueType::INT, false));
+
+	ir::Builder builder(module, module.main);
+	builder.store(20, *builder.call(12, { builder.constant(ValueType::INT, 2) }, ValueType::INT, false));
+	builder.store(30, builder.constant(ValueType::INT, 3));
+	builder.call(2, { builder.load(20, ValueType::INT) }, std::nullopt, false);
+
+	night_assert("a function that is never called from the top level code is removed",
+		(ir::remove_dead_functions(module) && module.funcs.size() == 1 && module.funcs.contains(12)));
+
+	night_assert("a variable that is never read is not assigned",
+		ir::remove_dead_variables(module));
+	night_assert("only the assignment to the variable is removed",
+		(module.main.blocks[0].instrs.size() == 5));
+
+	ir::renumber_variables(module);
+	night_assert("the variables that are left are given the lowest ids",
+		(module.main.blocks[0].instrs[2].id == 0 && module.funcs[12].param_ids == std::vector<bytecode_t>{ 1 }));
+	night_assert("variables declared but never used are left out",
+		(module.funcs[12].var_ids == std::vector<bytecode_t>{ 1 }));
+	night_assert("new variables start after the ones that are left",
+		(ParserScope::next_var_id == 2));
+}
+
+void test_ir_profile()
+{
+	std::clog << "testing profiles\n";
+
+	// if (var0) { print(1); } else { print(2); }
+	auto build_branch = [](ir::Module& module) {
+		ir::Builder builder(module, module.main);
+
+		auto true_block = builder.create_block();
+		auto false_block = builder.create_block();
+		auto end_block = builder.create_block();
+
+		builder.branch(builder.load(0, ValueType::BOOL), true_block, false_block);
+
+		for (auto [block, val] : { std::pair{ true_block, 1 }, std::pair{ false_block, 2 } })
+		{
+			builder.set_block(block);
+			builder.call(2, { builder.constant(ValueType::INT, val) }, std::nullopt, false);
+			builder.jump(end_block);
+		}
+
+		builder.set_block(end_block);
+	};
+
+	ir::Module module;
+	build_branch(module);
+	ir::instrument(module);
+
+	auto codes = ir::lower(module.main);
+	night_assert("each block starts by adding to its counter",
+		(std::count(std::begin(codes), std::end(codes), BC(COUNT)) == 4));
+
+	InterpreterScope scope;
+	for (int i = 0; i < 3; ++i)
+	{
+		scope.vars[0] = intpr::Value((int64_t)(i == 0));
+		interpret_bytecodes(scope, codes);
+	}
+
+	night_assert("the counters are the times each block ran",
+		(profile_counts == std::vector<uint64_t>{ 3, 1, 2, 3 }));
+
+	auto file = "test_ir_profile.txt";
+	ir::write_profile(file);
+
+	ir::Module profiled;
+	build_branch(profiled);
+	ir::read_profile(profiled, file);
+	std::remove(file);
+
+	night_assert("the counts are read back into the blocks",
+		(profiled.main.blocks[1].count == 1 && profiled.main.blocks[2].count == 2));
+	night_assert("the side of a branch that ran more comes first",
+		(ir::layout_order(profiled.main) == std::vector<ir::block_t>{ 0, 2, 1, 3 }));
+
+	codes = ir::lower(profiled.main);
+	night_assert("the hot side of the branch falls through",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 9, BC(JUMP_IF_TRUE),
+			BC(S_INT1), 2, BC(CALL), 2,
+			BC(JUMP), 4, 0, 0, 0,
+			BC(S_INT1), 1, BC(CALL), 2 }));
+}
+
+// returns the codes that return the value of the expression, where x is an int
+// variable with the id 0
+static bytecodes_t lower_int_expr(std::string const& code)
+{
+	ParserScope::next_var_id = 0;
+
+	ParserScope scope;
+	scope.create_variable(symbols::intern("x"), ValueType(ValueType::INT), {});
+
+	// the expression starts after the first token
+	Lexer lexer;
+	lexer.scan_code("return " + code);
+
+	auto expr = parse_expr(lexer, true);
+	expr->type_check(scope);
+	expr = expr->optimize(scope);
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+	builder.ret(expr->generate_value(builder));
+
+	return ir::lower(module.main);
+}
+
+void test_ir_reduce_strength()
+{
+	std::clog << "testing reducing operations by constants\n";
+
+	auto min = std::numeric_limits<int64_t>::min();
+	auto max = std::numeric_limits<int64_t>::max();
+
+	night_assert("the high bits of the product of two positive values",
+		(mult_high(max, max) == ((int64_t)1 << 62) - 1 && mult_high((int64_t)1 << 32, (int64_t)1 << 32) == 1));
+	night_assert("the high bits of the product of a negative and a positive value",
+		(mult_high(-1, 1) == -1 && mult_high(min, max) == -((int64_t)1 << 62) && mult_high(3, -((int64_t)1 << 62)) == -1));
+	night_assert("the high bits of the product of two negative values",
+		(mult_high(-1, -1) == 0 && mult_high(min, min) == (int64_t)1 << 62 && mult_high(min, -1) == 0));
+
+	std::vector<int64_t> vals{ 0, 1, -1, 2, -2, 6, -6, 7, -7, 9, -9, 640, -640, 641, -641, 1282, -1283,
+		999999, -999999, min, min + 1, max, max - 1, max / 2, min / 2 };
+	std::vector<int64_t> divisors{ 3, 7, 10, 641, 1000000007, max / 3, max - 1, max };
+
+	bool is_same = true;
+	for (auto divisor : divisors)
+	{
+		auto [magic, shift] = division_magic(divisor);
+		for (auto val : vals)
+			is_same = is_same && div_magic(val, magic, shift) == val / divisor;
+	}
+
+	night_assert("dividing with the magic number is the same as dividing", is_same);
+
+	// the codes load x, and then do the operation, whose immediates can be any
+	// byte, so the other codes are not counted
+	auto is_op = [](bytecodes_t const& codes, BytecodeType type) {
+		return codes.size() > 2 && codes[0] == BC(LOAD) && codes[1] == 0 && codes[2] == (bytecode_t)type;
+	};
+
+	// each operation is lowered once, and run with every value of x
+	auto is_same_for_vals = [&](bytecodes_t const& codes, auto const& expected) {
+		for (auto val : vals)
+		{
+			InterpreterScope scope;
+			scope.vars[0] = intpr::Value(val);
+
+			if (interpret_bytecodes(scope, codes)->i != expected(val))
+				return false;
+		}
+
+		return true;
+	};
+
+	for (int64_t divisor : { (int64_t)2, (int64_t)8, (int64_t)1024, (int64_t)1 << 40, (int64_t)1 << 62 })
+	{
+		auto str = std::to_string(divisor);
+
+		auto div_codes = lower_int_expr("x / " + str);
+		night_assert("division by " + str + " is a shift",
+			is_op(div_codes, BytecodeType::DIV_POW2_I));
+		night_assert("the shift is the same as dividing by " + str,
+			is_same_for_vals(div_codes, [&](int64_t val) { return val / divisor; }));
+
+		auto mod_codes = lower_int_expr("x % " + str);
+		night_assert("modulo by " + str + " is a mask",
+			is_op(mod_codes, BytecodeType::MOD_POW2_I));
+		night_assert("the mask is the same as the remainder of dividing by " + str,
+			is_same_for_vals(mod_codes, [&](int64_t val) { return val % divisor; }));
+
+		// signed overflow wraps around in the interpreter
+		auto mult_codes = lower_int_expr("x * " + str);
+		night_assert("multiplication by " + str + " is a shift",
+			is_op(mult_codes, BytecodeType::SHIFT_LEFT_I));
+		night_assert("the shift is the same as multiplying by " + str,
+			is_same_for_vals(mult_codes, [&](int64_t val) { return (int64_t)((uint64_t)val * (uint64_t)divisor); }));
+	}
+
+	for (auto divisor : divisors)
+	{
+		auto str = std::to_string(divisor);
+
+		auto div_codes = lower_int_expr("x / " + str);
+		night_assert("division by " + str + " is a multiplication by its magic number",
+			is_op(div_codes, BytecodeType::DIV_MAGIC_I));
+		night_assert("the multiplication is the same as dividing by " + str,
+			is_same_for_vals(div_codes, [&](int64_t val) { return val / divisor; }));
+
+		auto mod_codes = lower_int_expr("x % " + str);
+		night_assert("modulo by " + str + " is a multiplication by its magic number",
+			is_op(mod_codes, BytecodeType::MOD_MAGIC_I));
+		night_assert("the multiplication is the same as the remainder of dividing by " + str,
+			is_same_for_vals(mod_codes, [&](int64_t val) { return val % divisor; }));
+	}
+
+	night_assert("multiplication by a value that is not a power of two is left as it is",
+		(lower_int_expr("x * 7") == bytecodes_t{ BC(LOAD), 0, BC(S_INT1), 7, BC(MULT_I), BC(RETURN) }));
+}
+
+// returns the ids of the functions the codes call
+static std::vector<bytecode_t> calls_in(bytecodes_t const& codes)
+{
+	auto instrs = decode_instructions(codes);
+
+	std::vector<bytecode_t> calls;
+	for (auto const& instr : *instrs)
+	{
+		if (instr.type == BytecodeType::CALL)
+			calls.push_back(instr.operands[0]);
+	}
+
+	return calls;
+}
+
+void test_ir_inline_functions()
+{
+	std::clog << "testing inlining functions\n";
+
+	ir::Module module;
+	ParserScope::next_var_id = 40;
+
+	// def add_one(var10) { return var10 + 1; }
+	auto& add_one = module.funcs[20];
+	add_one.param_ids = add_one.var_ids = { 10 };
+	ir::Builder add_one_builder(module, add_one);
+	add_one_builder.ret(add_one_builder.op(BytecodeType::ADD_I,
+		{ add_one_builder.load(10, ValueType::INT), add_one_builder.constant(ValueType::INT, 1) }, ValueType::INT));
+
+	// def add_two(var11) { return add_one(add_one(var11)); }
+	auto& add_two = module.funcs[21];
+	add_two.param_ids = add_two.var_ids = { 11 };
+	ir::Builder add_two_builder(module, add_two);
+	auto add_two_inner = add_two_builder.call(20, { add_two_builder.load(11, ValueType::INT) }, ValueType::INT, true);
+	add_two_builder.ret(add_two_builder.call(20, { *add_two_inner }, ValueType::INT, true));
+
+	// def clamp(var12) { if (var12 < 0) return 0; return var12; }
+	auto& clamp = module.funcs[22];
+	clamp.param_ids = clamp.var_ids = { 12 };
+	ir::Builder clamp_builder(module, clamp);
+
+	auto negative_block = clamp_builder.create_block();
+	auto positive_block = clamp_builder.create_block();
+
+	clamp_builder.branch(clamp_builder.op(BytecodeType::LESSER_I,
+		{ clamp_builder.load(12, ValueType::INT), clamp_builder.constant(ValueType::INT, 0) }, ValueType::BOOL), negative_block, positive_block);
+
+	clamp_builder.set_block(negative_block);
+	clamp_builder.ret(clamp_builder.constant(ValueType::INT, 0));
+
+	clamp_builder.set_block(positive_block);
+	clamp_builder.ret(clamp_builder.load(12, ValueType::INT));
+
+	// def count_down(var13) { if (var13 <= 0) return 0; return count_down(var13 - 1); }
+	auto& count_down = module.funcs[23];
+	count_down.param_ids = count_down.var_ids = { 13 };
+	ir::Builder count_down_builder(module, count_down);
+
+	auto done_block = count_down_builder.create_block();
+	auto recurse_block = count_down_builder.create_block();
+
+	count_down_builder.branch(count_down_builder.op(BytecodeType::LESSER_EQUALS_I,
+		{ count_down_builder.load(13, ValueType::INT), count_down_builder.constant(ValueType::INT, 0) }, ValueType::BOOL), done_block, recurse_block);
+
+	count_down_builder.set_block(done_block);
+	count_down_builder.ret(count_down_builder.constant(ValueType::INT, 0));
+
+	count_down_builder.set_block(recurse_block);
+	count_down_builder.ret(count_down_builder.call(23, { count_down_builder.op(BytecodeType::SUB_I,
+		{ count_down_builder.load(13, ValueType::INT), count_down_builder.constant(ValueType::INT, 1) }, ValueType::INT) }, ValueType::INT, true));
+
+	// def set_global(var14) { var30 = var14; return var14; }
+	auto& set_global = module.funcs[24];
+	set_global.param_ids = set_global.var_ids = { 14 };
+	ir::Builder set_global_builder(module, set_global);
+	set_global_builder.store(30, set_global_builder.load(14, ValueType::INT));
+	set_global_builder.ret(set_global_builder.load(14, ValueType::INT));
+
+	for (auto& [id, func] : module.funcs)
+		InterpreterScope::funcs[id] = { func.param_ids, ir::lower(func), func.var_ids };
+
+	// lowers the top level code, and inlines the calls in it
+	auto lower_main = [&](auto const& build) {
+		ir::Module main_module;
+		ir::Builder builder(main_module, main_module.main);
+		builder.ret(build(builder));
+
+		auto codes = ir::lower(main_module.main);
+		inline_functions(codes);
+
+		return codes;
+	};
+
+	auto run = [](bytecodes_t const& codes, int64_t var0) {
+		InterpreterScope scope;
+		scope.vars[0] = intpr::Value(var0);
+		scope.vars[30] = intpr::Value((int64_t)-1);
+
+		return std::pair{ interpret_bytecodes(scope, codes)->i, scope.vars[30].i };
+	};
+
+	// return add_two(var0);
+	auto nested_codes = lower_main([](ir::Builder& builder) {
+		return *builder.call(21, { builder.load(0, ValueType::INT) }, ValueType::INT, true);
+	});
+
+	night_assert("a call to a function that calls another function is inlined, along with the calls inside it",
+		calls_in(nested_codes).empty());
+	night_assert("the calls inside a function are inlined into the function",
+		calls_in(InterpreterScope::funcs[21].codes).empty());
+	night_assert("the nested calls return the same value",
+		(run(nested_codes, 5).first == 7));
+
+	// return clamp(var0) + 10;
+	auto clamp_codes = lower_main([](ir::Builder& builder) {
+		return builder.op(BytecodeType::ADD_I,
+			{ *builder.call(22, { builder.load(0, ValueType::INT) }, ValueType::INT, true), builder.constant(ValueType::INT, 10) }, ValueType::INT);
+	});
+
+	night_assert("a function that returns from the middle of its body is inlined",
+		calls_in(clamp_codes).empty());
+	night_assert("returning early from the inlined codes goes on with the codes after them",
+		(run(clamp_codes, -3).first == 10 && run(clamp_codes, 4).first == 14));
+
+	// return count_down(var0);
+	auto count_down_codes = lower_main([](ir::Builder& builder) {
+		return *builder.call(23, { builder.load(0, ValueType::INT) }, ValueType::INT, true);
+	});
+
+	night_assert("a function that calls itself is not inlined",
+		(calls_in(count_down_codes) == std::vector<bytecode_t>{ 23 } && calls_in(InterpreterScope::funcs[23].codes) == std::vector<bytecode_t>{ 23 }));
+	night_assert("the function that calls itself still returns its value",
+		(run(count_down_codes, 3).first == 0));
+
+	// return set_global(var0);
+	auto set_global_codes = lower_main([](ir::Builder& builder) {
+		return *builder.call(24, { builder.load(0, ValueType::INT) }, ValueType::INT, false);
+	});
+
+	night_assert("a function that assigns to a variable that is not its own is not inlined",
+		(calls_in(set_global_codes) == std::vector<bytecode_t>{ 24 }));
+	night_assert("the assignment is to the call's copy of the variables",
+		(run(set_global_codes, 6) == std::pair<int64_t, int64_t>{ 6, -1 }));
+
+	for (auto const& [id, func] : module.funcs)
+		InterpreterScope::funcs.erase(id);
+}
+
+void test_ir_memoize_functions()
+{
+	std::clog << "testing memoizing functions\n";
+
+	// def add_one(var10) { return var10 + 1; }
+	ir::Module module;
+	ParserScope::next_var_id = 40;
+
+	auto& add_one = module.funcs[25];
+	add_one.param_ids = add_one.var_ids = { 10 };
+	ir::Builder add_one_builder(module, add_one);
+	add_one_builder.ret(add_one_builder.op(BytecodeType::ADD_I,
+		{ add_one_builder.load(10, ValueType::INT), add_one_builder.constant(ValueType::INT, 1) }, ValueType::INT));
+
+	InterpreterScope::funcs[25] = { add_one.param_ids, ir::lower(add_one), add_one.var_ids };
+	InterpreterScope::funcs[25].memo.emplace(1);
+
+	// return add_one(var0) + add_one(var0);
+	ir::Builder builder(module, module.main);
+	auto first = builder.call(25, { builder.load(0, ValueType::INT) }, ValueType::INT, true);
+	auto second = builder.call(25, { builder.load(0, ValueType::INT) }, ValueType::INT, true);
+	builder.ret(builder.op(BytecodeType::ADD_I, { *first, *second }, ValueType::INT));
+
+	auto codes = ir::lower(module.main);
+	auto const& memo = *InterpreterScope::funcs[25].memo;
+
+	InterpreterScope scope;
+	scope.vars[0] = intpr::Value((int64_t)4);
+
+	night_assert("a memoized call returns the same value",
+		(interpret_bytecodes(scope, codes)->i == 10));
+	night_assert("a second call with the same argument finds the result of the first",
+		(memo.hits == 1 && memo.misses == 1 && memo.size() == 1));
+
+	scope.vars[0] = intpr::Value((int64_t)5);
+	interpret_bytecodes(scope, codes);
+
+	night_assert("a call with a new argument adds its result",
+		(memo.hits == 2 && memo.misses == 2 && memo.size() == 2));
+
+	std::stringstream stats;
+	debug::log_memo_tables(stats);
+
+	night_assert("the statistics are the hits, misses and results of each table",
+		(stats.str() == "[memo] function 25: 2 hits, 2 misses, 2 results\n"));
+
+	InterpreterScope::funcs.erase(25);
+
+	// a table keeps the results it has once it is full
+	MemoTable table(1);
+	for (int64_t i = 0; i < (int64_t)MemoTable::max_results + 10; ++i)
+		table.insert({ intpr::Value(i) }, intpr::Value(2 * i));
+
+	auto last = (int64_t)MemoTable::max_results - 1;
+	night_assert("a full table holds max_results results",
+		(table.size() == MemoTable::max_results));
+	night_assert("the results added before the table was full are kept",
+		(table.find({ intpr::Value((int64_t)0) })->i == 0 && table.find({ intpr::Value(last) })->i == 2 * last));
+	night_assert("the results added after the table was full are not",
+		(table.find({ intpr::Value(last + 1) }) == nullptr && table.find({ intpr::Value(last + 10) }) == nullptr));
+
+	// def fib_memo(n int) int { ... } with --memoize, called with arguments that
+	// are not constants, so the calls are left for when the program runs
+	Lexer lexer;
+	lexer.scan_code(
+		"def fib_memo(n int) int { if (n < 2) { return n; } return fib_memo(n - 1) + fib_memo(n - 2); }\n"
+		"i int = 0;\n"
+		"while (i < 3) { print(fib_memo(i + 30)); print(' '); i += 1; }\n");
+
+	AST_Block block;
+	while (lexer.curr().type != TokenType::END_OF_FILE)
+	{
+		auto stmts = parse_stmts(lexer, false);
+		block.insert(std::end(block), std::begin(stmts), std::end(stmts));
+	}
+
+	memoize_functions = true;
+	auto program_codes = code_gen(block);
+	memoize_functions = false;
+
+	std::stringstream out;
+	auto cout_buf = std::cout.rdbuf(out.rdbuf());
+
+	InterpreterScope program_scope;
+	interpret_bytecodes(program_scope, program_codes);
+
+	std::cout.rdbuf(cout_buf);
+
+	auto fib_id = ParserScope::find_function(symbols::intern("fib_memo"), { ValueType(ValueType::INT) })->id;
+	auto const& fib_memo = InterpreterScope::funcs[fib_id].memo;
+
+	night_assert("a pure function that calls itself is memoized with --memoize",
+		fib_memo.has_value());
+	night_assert("the memoized function returns the same values",
+		(out.str() == "832040 1346269 2178309 "));
+	// fib_memo(30) misses 30 down to 0, and finds n - 2 for each n from 3, and
+	// fib_memo(31) and fib_memo(32) only miss themselves
+	night_assert("each argument misses once, and the calls after it hit",
+		(fib_memo.has_value() && fib_memo->misses == 33 && fib_memo->size() == 33 && fib_memo->hits == 28 + 2 + 2));
+
+	InterpreterScope::funcs.erase(fib_id);
+}
+
+// parses the program, and builds its IR after it is type checked and optimized,
+// without the passes on the IR
+static ir::Module build_module(std::string const& code)
+{
+	Lexer lexer;
+	lexer.scan_code(code);
+
+	AST_Block block;
+	while (lexer.curr().type != TokenType::END_OF_FILE)
+	{
+		auto stmts = parse_stmts(lexer, false);
+		block.insert(std::end(block), std::begin(stmts), std::end(stmts));
+	}
+
+	ParserScope global_scope;
+	for (auto const& ast : block)
+		ast->check(global_scope);
+
+	optimize_block(block, global_scope);
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	for (auto const& ast : block)
+		ast->generate_ir(builder);
+
+	return module;
+}
+
+// returns the first operand of each instruction of the function that matches,
+// which is std::nullopt if it is not a constant
+template <typename Pred>
+static std::vector<std::optional<int64_t>> constant_operands(ir::Function const& func, Pred matches)
+{
+	std::vector<ir::Instruction const*> defs(func.value_types.size(), nullptr);
+	for (auto const& block : func.blocks)
+	{
+		for (auto const& instr : block.instrs)
+		{
+			if (instr.result.has_value())
+				defs[*instr.result] = &instr;
+		}
+	}
+
+	std::vector<std::optional<int64_t>> operands;
+	for (auto const& block : func.blocks)
+	{
+		for (auto const& instr : block.instrs)
+		{
+			if (!matches(instr))
+				continue;
+
+			auto def = defs[instr.operands[0]];
+			if (def->op == ir::Op::CONST && std::holds_alternative<int64_t>(def->constant))
+				operands.push_back(std::get<int64_t>(def->constant));
+			else
+				operands.push_back(std::nullopt);
+		}
+	}
+
+	return operands;
+}
+
+// returns the values printed by the function
+static std::vector<std::optional<int64_t>> printed_constants(ir::Function const& func)
+{
+	return constant_operands(func, [](ir::Instruction const& instr) { return instr.op == ir::Op::CALL && instr.id <= 4; });
+}
+
+// returns the values stored to the variable by the function
+static std::vector<std::optional<int64_t>> stored_constants(ir::Function const& func, bytecode_t var_id)
+{
+	return constant_operands(func, [var_id](ir::Instruction const& instr) { return instr.op == ir::Op::STORE && instr.id == var_id; });
+}
+
+void test_ir_fold_constants()
+{
+	std::clog << "testing folding constants\n";
+
+	auto module = build_module(
+		"print(1 + 2 * 3 - 8 / 2 % 3);\n"
+		"print(-(-(-7)) * -(2 - 5));\n"
+		"print(!!!(1 < 2));\n"
+		"a int = 6;\n"
+		"print(-a * 2 + a % 4);\n");
+
+	night_assert("chains of binary and unary operators on constants are folded to their values",
+		(printed_constants(module.main) == std::vector<std::optional<int64_t>>{ 6, -21, 0, -10 }));
+
+	auto const& instrs = module.main.blocks[0].instrs;
+	night_assert("nothing is left to compute when the program runs",
+		std::none_of(std::begin(instrs), std::end(instrs), [](ir::Instruction const& instr) { return instr.op == ir::Op::BYTECODE; }));
+
+	auto branch_module = build_module(
+		"b int = 2;\n"
+		"if (b * 3 > 5 && !(b == 3)) { print(1); } else { print(2); }\n"
+		"if (b - 2 != 0) { print(3); } elif (-b < 0) { print(4); }\n"
+		"while (b * b < 4) { print(5); }\n");
+
+	auto is_branch = [](ir::BasicBlock const& block) {
+		return block.terminator.has_value() && block.terminator->type == ir::TerminatorType::BRANCH;
+	};
+
+	night_assert("branches whose conditions fold are taken or left out without testing them",
+		std::none_of(std::begin(branch_module.main.blocks), std::end(branch_module.main.blocks), is_branch));
+	night_assert("only the branches whose conditions fold to true are left",
+		(printed_constants(branch_module.main) == std::vector<std::optional<int64_t>>{ 1, 4 }));
+
+	// c can change, so its conditions are tested
+	auto variable_module = build_module(
+		"c int = 2;\n"
+		"c = 3;\n"
+		"if (c * 3 > 5) { print(1); }\n");
+
+	night_assert("a condition on a variable that is reassigned is tested",
+		std::any_of(std::begin(variable_module.main.blocks), std::end(variable_module.main.blocks), is_branch));
+}
+
+void test_ir_remove_dead_statements()
+{
+	std::clog << "testing removing dead statements\n";
+
+	auto module = build_module(
+		"def return_early(n int) int\n"
+		"{\n"
+		"	return n;\n"
+		"	n = 5;\n"
+		"	print(n);\n"
+		"}\n"
+		"def sign_of(n int) int\n"
+		"{\n"
+		"	if (n < 0) { return -1; } elif (n > 0) { return 1; } else { return 0; }\n"
+		"	print(7);\n"
+		"	return 2;\n"
+		"}\n"
+		"y int = 0;\n"
+		"if (1 > 2) { y = 1; } elif (true) { y = 2; } else { y = 3; }\n"
+		"while (false) { y = 4; print(y); }\n"
+		"print(return_early(y) + sign_of(y));\n");
+
+	auto find_func = [&](std::string const& name) -> ir::Function const& {
+		auto it = std::find_if(std::begin(module.funcs), std::end(module.funcs),
+			[&](auto const& func) { return func.second.name == name; });
+		return it->second;
+	};
+
+	auto const& return_early = find_func("return_early");
+	auto const& sign_of = find_func("sign_of");
+
+	night_assert("a store after a return is removed",
+		stored_constants(return_early, return_early.param_ids[0]).empty());
+	night_assert("a print after a return is removed",
+		printed_constants(return_early).empty());
+
+	night_assert("a print after branches that all return is removed",
+		printed_constants(sign_of).empty());
+
+	auto returns = std::count_if(std::begin(sign_of.blocks), std::end(sign_of.blocks), [](ir::BasicBlock const& block) {
+		return block.terminator.has_value() && block.terminator->type == ir::TerminatorType::RETURN;
+	});
+	night_assert("a return after branches that all return is removed", returns == 3);
+
+	auto stores = constant_operands(module.main, [](ir::Instruction const& instr) { return instr.op == ir::Op::STORE; });
+	night_assert("stores in branches that are never taken or in loops that never run are removed",
+		(stores == std::vector<std::optional<int64_t>>{ 0, 2 }));
+	night_assert("a loop that never runs is removed", printed_constants(module.main).size() == 1);
+}
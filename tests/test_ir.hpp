@@ -0,0 +1,24 @@
+#pragma once
+
+void test_ir();
+void test_ir_lower_stack();
+void test_ir_lower_out_of_order();
+void test_ir_lower_phi();
+void test_ir_dump();
+void test_ir_find_loops();
+void test_ir_hoist_loop_invariants();
+void test_ir_remove_bounds_checks();
+void test_ir_vectorize_loops();
+void test_ir_unroll_loops();
+void test_ir_invert_loops();
+void test_ir_find_pure_functions();
+void test_ir_eliminate_common_subexpressions();
+void test_ir_form_switches();
+void test_ir_evaluate_constant_calls();
+void test_ir_remove_dead_code();
+void test_ir_profile();
+void test_ir_reduce_strength();
+void test_ir_inline_functions();
+void test_ir_memoize_functions();
+void test_ir_fold_constants();
+void test_ir_remove_dead_statements();
@@ -0,0 +1,436 @@
+#include "test_lexer.hpp"
+#include "night_tests.hpp"
+#include "../code/include/lexer.hpp"
+#include "../code/include/char_scan.hpp"
+#include "../code/include/token.hpp"
+#include "../code/include/source_table.hpp"
+#include "../code/include/symbols.hpp"
+#include "../code/include/error.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// returns true if the code is the tokens, followed by the end of the file
+static bool lexes_to(std::string const& code, std::vector<std::pair<TokenType, std::string_view> > const& tokens)
+{
+	Lexer lexer;
+	lexer.scan_code(code);
+
+	for (auto const& [type, str] : tokens)
+	{
+		if (lexer.curr().type != type || lexer.curr().str != str)
+			return false;
+
+		lexer.eat();
+	}
+
+	return lexer.curr().type == TokenType::END_OF_FILE;
+}
+
+void test_lexer()
+{
+	std::clog << "testing lexer\n\n";
+
+	test_lexer_char_classes();
+	test_lexer_scan_runs();
+	test_lexer_long_tokens();
+	test_lexer_keywords();
+	test_lexer_split_source();
+	test_lexer_source_positions();
+	test_lexer_symbols();
+	test_lexer_operators();
+}
+
+void test_lexer_char_classes()
+{
+	std::clog << "testing character classes\n";
+
+	bool is_same = true;
+	for (int c = 0; c < 256; ++c)
+	{
+		is_same = is_same &&
+			char_class::is_space((char)c) == (bool)std::isspace(c) &&
+			char_class::is_alpha((char)c) == (bool)std::isalpha(c) &&
+			char_class::is_digit((char)c) == (bool)std::isdigit(c);
+	}
+
+	night_assert("character classes are the same as the C locale", is_same);
+}
+
+void test_lexer_scan_runs()
+{
+	std::clog << "testing scanning runs of characters\n";
+
+	// every length from 0 to past two vectors, so the run ends in the vector and
+	// in the characters after it
+	bool is_correct = true;
+	for (std::size_t len = 0; len < 40; ++len)
+	{
+		std::string spaces = std::string(len, ' ') + "x" + std::string(20, ' ');
+		std::string word = std::string(len, 'a') + "+" + std::string(20, 'a');
+		std::string digits = std::string(len, '7') + "." + std::string(20, '7');
+		std::string quotes = std::string(len, 'a') + "\"" + std::string(20, 'a');
+
+		is_correct = is_correct &&
+			skip_spaces(spaces, 0) == len && skip_word(word, 0) == len &&
+			skip_digits(digits, 0) == len && find_quote_or_escape(quotes, 0) == len;
+	}
+
+	night_assert("runs end at the first character that is not in them", is_correct);
+
+	night_assert("every space character is skipped",
+		skip_spaces(" \t\n\v\f\r \t\n\v\f\r \t\n\v\f\r|", 0) == 18);
+	night_assert("letters, digits and underscores are one word",
+		skip_word("abcXYZ_019azAZ_09mnop[", 0) == 21);
+	night_assert("characters around the ranges end runs",
+		skip_word("@", 0) == 0 && skip_word("[", 0) == 0 && skip_word("`", 0) == 0 &&
+		skip_word("{", 0) == 0 && skip_digits("/", 0) == 0 && skip_digits(":", 0) == 0);
+	night_assert("characters past 127 end runs",
+		skip_word(std::string(20, 'a') + "\xc1", 0) == 20 && skip_spaces(std::string(20, ' ') + "\xa0", 0) == 20);
+	night_assert("escapes are found before quotes",
+		find_quote_or_escape(std::string(20, 'a') + "\\\"", 3) == 20);
+	night_assert("runs to the end are the size", skip_digits(std::string(50, '1'), 5) == 50);
+	night_assert("starting at the end is the size", skip_spaces("abc", 3) == 3);
+}
+
+void test_lexer_long_tokens()
+{
+	std::clog << "testing tokens longer than a vector\n";
+
+	std::string name = "a_very_long_variable_name_with_digits_0123456789";
+	night_assert("long variable", (lexes_to(
+		"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t" + name + "=" + name + ";",
+		{ { TokenType::VARIABLE, name }, { TokenType::ASSIGN, "=" }, { TokenType::VARIABLE, name }, { TokenType::SEMICOLON, ";" } })));
+
+	night_assert("long numbers", (lexes_to(
+		"12345678901234567890 12345678901234567890.12345678901234567890",
+		{ { TokenType::INT_LIT, "12345678901234567890" }, { TokenType::FLOAT_LIT, "12345678901234567890.12345678901234567890" } })));
+
+	night_assert("long string", (lexes_to(
+		"\"a string that is longer than a single vector\"",
+		{ { TokenType::STRING_LIT, "a string that is longer than a single vector" } })));
+
+	night_assert("long string with escapes", (lexes_to(
+		"\"a string that is longer than a \\\"single\\\" vector\\n\\q\"",
+		{ { TokenType::STRING_LIT, "a string that is longer than a \"single\" vector\n\\q" } })));
+
+	night_assert("string over two lines", (lexes_to(
+		"\"first line \nsecond line\"",
+		{ { TokenType::STRING_LIT, "first line second line" } })));
+
+	night_assert("comment after spaces", (lexes_to(
+		"x                                   # comment\n   y",
+		{ { TokenType::VARIABLE, "x" }, { TokenType::VARIABLE, "y" } })));
+}
+
+void test_lexer_keywords()
+{
+	std::clog << "testing keywords\n";
+
+	night_assert("keywords", (lexes_to(
+		"true false char bool int float str if elif else for while def void return",
+		{ { TokenType::BOOL_LIT, "true" }, { TokenType::BOOL_LIT, "false" },
+		  { TokenType::TYPE, "char" }, { TokenType::TYPE, "bool" }, { TokenType::TYPE, "int" },
+		  { TokenType::TYPE, "float" }, { TokenType::TYPE, "str" },
+		  { TokenType::IF, "if" }, { TokenType::ELIF, "elif" }, { TokenType::ELSE, "else" },
+		  { TokenType::FOR, "for" }, { TokenType::WHILE, "while" },
+		  { TokenType::DEF, "def" }, { TokenType::VOID, "void" }, { TokenType::RETURN, "return" } })));
+
+	// "iF" has the same hash as "if"
+	night_assert("words that are not keywords", (lexes_to(
+		"iF If int_ returns whilE _if",
+		{ { TokenType::VARIABLE, "iF" }, { TokenType::VARIABLE, "If" }, { TokenType::VARIABLE, "int_" },
+		  { TokenType::VARIABLE, "returns" }, { TokenType::VARIABLE, "whilE" }, { TokenType::VARIABLE, "_if" } })));
+
+	// words that start or end like a keyword, or are a keyword with a letter
+	// missing, changed or added
+	bool near_misses_are_variables = true;
+	for (std::string_view word : { "iff", "i", "elf", "elsif", "els", "fo", "fore", "whiles", "de", "define",
+		"voids", "retur", "rturn", "tru", "truef", "falsey", "chars", "boo", "in", "integer", "floats", "string", "st" })
+	{
+		near_misses_are_variables = near_misses_are_variables &&
+			lexes_to(std::string(word), { { TokenType::VARIABLE, word } });
+	}
+
+	night_assert("words close to keywords are variables", near_misses_are_variables);
+
+	night_assert("keywords are split from the symbols next to them", (lexes_to(
+		"if(iff){return-1;}",
+		{ { TokenType::IF, "if" }, { TokenType::OPEN_BRACKET, "(" }, { TokenType::VARIABLE, "iff" },
+		  { TokenType::CLOSE_BRACKET, ")" }, { TokenType::OPEN_CURLY, "{" }, { TokenType::RETURN, "return" },
+		  { TokenType::BINARY_OP, "-" }, { TokenType::INT_LIT, "1" }, { TokenType::SEMICOLON, ";" },
+		  { TokenType::CLOSE_CURLY, "}" } })));
+}
+
+// returns the error from lexing the code, or an empty string if there is none
+static std::string lex_error(std::string const& code)
+{
+	std::string msg;
+
+	// errors are kept for each thread, so they do not leak into other tests
+	std::thread([&] {
+		try
+		{
+			Lexer lexer;
+			lexer.scan_code(code);
+
+			while (lexer.curr().type != TokenType::END_OF_FILE)
+				lexer.eat();
+		}
+		catch (night::error const& e)
+		{
+			msg = e.what();
+		}
+	}).join();
+
+	return msg;
+}
+
+void test_lexer_operators()
+{
+	std::clog << "testing operators\n";
+
+	night_assert("every symbol", (lexes_to(
+		"+ - * / % += -= *= /= %= < > <= >= == != ! || && . .. = ( ) [ ] { } , : ;",
+		{ { TokenType::BINARY_OP, "+" }, { TokenType::BINARY_OP, "-" }, { TokenType::BINARY_OP, "*" },
+		  { TokenType::BINARY_OP, "/" }, { TokenType::BINARY_OP, "%" },
+		  { TokenType::ASSIGN, "+=" }, { TokenType::ASSIGN, "-=" }, { TokenType::ASSIGN, "*=" },
+		  { TokenType::ASSIGN, "/=" }, { TokenType::ASSIGN, "%=" },
+		  { TokenType::BINARY_OP, "<" }, { TokenType::BINARY_OP, ">" }, { TokenType::BINARY_OP, "<=" },
+		  { TokenType::BINARY_OP, ">=" }, { TokenType::BINARY_OP, "==" }, { TokenType::BINARY_OP, "!=" },
+		  { TokenType::UNARY_OP, "!" }, { TokenType::BINARY_OP, "||" }, { TokenType::BINARY_OP, "&&" },
+		  { TokenType::BINARY_OP, "." }, { TokenType::BINARY_OP, ".." }, { TokenType::ASSIGN, "=" },
+		  { TokenType::OPEN_BRACKET, "(" }, { TokenType::CLOSE_BRACKET, ")" },
+		  { TokenType::OPEN_SQUARE, "[" }, { TokenType::CLOSE_SQUARE, "]" },
+		  { TokenType::OPEN_CURLY, "{" }, { TokenType::CLOSE_CURLY, "}" },
+		  { TokenType::COMMA, "," }, { TokenType::COLON, ":" }, { TokenType::SEMICOLON, ";" } })));
+
+	night_assert("symbols take the longest match", (lexes_to(
+		"+==!!=<<=...",
+		{ { TokenType::ASSIGN, "+=" }, { TokenType::ASSIGN, "=" }, { TokenType::UNARY_OP, "!" },
+		  { TokenType::BINARY_OP, "!=" }, { TokenType::BINARY_OP, "<" }, { TokenType::BINARY_OP, "<=" },
+		  { TokenType::BINARY_OP, ".." }, { TokenType::BINARY_OP, "." } })));
+
+	night_assert("a symbol at the end of a line",
+		(lexes_to("a <\n= b", { { TokenType::VARIABLE, "a" }, { TokenType::BINARY_OP, "<" },
+			{ TokenType::ASSIGN, "=" }, { TokenType::VARIABLE, "b" } })));
+
+	night_assert("a single bar or ampersand is not a symbol",
+		lex_error("a | b").find("unknown symbol '| '") != std::string::npos &&
+		lex_error("a &").find("unknown symbol '&'") != std::string::npos);
+
+	night_assert("characters that do not start a symbol are not symbols",
+		lex_error("a @ b").find("unknown symbol '@'") != std::string::npos &&
+		lex_error("a $").find("unknown symbol '$'") != std::string::npos);
+}
+
+// returns the first line and the source of each chunk
+static std::vector<std::pair<int, std::string_view> > split(std::string_view source, std::size_t chunk_size)
+{
+	std::vector<std::pair<int, std::string_view> > chunks;
+	for (auto const& chunk : split_source(source, chunk_size))
+		chunks.push_back({ chunk.line, chunk.source });
+
+	return chunks;
+}
+
+void test_lexer_split_source()
+{
+	std::clog << "testing splitting source into chunks\n";
+
+	night_assert("every top level statement is a chunk", (split(
+		"a int = 1;\nb int = 2;\n",
+		1) == std::vector<std::pair<int, std::string_view> >{ { 1, "a int = 1;\n" }, { 2, "b int = 2;\n" } }));
+
+	night_assert("chunks are at least the chunk size", (split(
+		"a int = 1;\nb int = 2;\nc int = 3;\n",
+		12) == std::vector<std::pair<int, std::string_view> >{ { 1, "a int = 1;\nb int = 2;\n" }, { 3, "c int = 3;\n" } }));
+
+	night_assert("statements in curly brackets and for loops are not split", (split(
+		"def f() void\n{\n\tx int = 1;\n}\nfor (i int = 0;\ni < 2;\ni += 1) {}\n",
+		1) == std::vector<std::pair<int, std::string_view> >{
+			{ 1, "def f() void\n{\n\tx int = 1;\n}\n" }, { 5, "for (i int = 0;\ni < 2;\ni += 1) {}\n" } }));
+
+	night_assert("if statements are not split from their elif and else", (split(
+		"if (x) {\n}\n\n# comment\nelif (y) z = 1;\nelse\n{}\nelsewhere = 1;\n",
+		1) == std::vector<std::pair<int, std::string_view> >{
+			{ 1, "if (x) {\n}\n\n# comment\nelif (y) z = 1;\nelse\n{}\n" }, { 8, "elsewhere = 1;\n" } }));
+
+	night_assert("brackets and semicolons in strings, characters and comments are skipped", (split(
+		"s str = \"{;\\\"\n}\";\nc char = '{';\nd char = '\\\\';\ne int = 1; # {\n",
+		1) == std::vector<std::pair<int, std::string_view> >{
+			{ 1, "s str = \"{;\\\"\n}\";\n" }, { 3, "c char = '{';\n" }, { 4, "d char = '\\\\';\n" }, { 5, "e int = 1; # {\n" } }));
+
+	night_assert("the rest is a single chunk after an unmatched bracket", (split(
+		"a int = 1;\n}\nb int = 2;\n",
+		1) == std::vector<std::pair<int, std::string_view> >{ { 1, "a int = 1;\n" }, { 2, "}\nb int = 2;\n" } }));
+
+	night_assert("an unfinished statement is in the last chunk", (split(
+		"a int = 1;\nb int = 2",
+		1) == std::vector<std::pair<int, std::string_view> >{ { 1, "a int = 1;\n" }, { 2, "b int = 2" } }));
+
+	night_assert("empty source is a single chunk", (split("", 1).size() == 1));
+
+	// a lexer made where another lexer reached the end of its file does not start
+	// from the token of the old lexer
+	alignas(Lexer) unsigned char storage[sizeof(Lexer)];
+
+	auto ended = new (storage) Lexer();
+	ended->scan_code("");
+	ended->~Lexer();
+
+	std::string chunk = "while (true) { y int = 1 }\n";
+	auto lexer = new (storage) Lexer("chunk.night", chunk, 1, source_table::add_file("chunk.night", chunk));
+
+	std::size_t tokens = 1;
+	for (; lexer->curr().type != TokenType::END_OF_FILE; lexer->eat())
+		++tokens;
+
+	night_assert("a lexer of a chunk reads every token of the chunk", (tokens == 11));
+	lexer->~Lexer();
+}
+
+// returns true if the position of the lexer is found as the same location as
+// the lexer, after every token of the code
+static bool positions_match(std::string const& code)
+{
+	Lexer lexer;
+	lexer.scan_code(code);
+
+	while (true)
+	{
+		auto loc = source_table::location(lexer.pos());
+		if (loc.line != lexer.loc.line || loc.col != lexer.loc.col)
+			return false;
+
+		if (lexer.curr().type == TokenType::END_OF_FILE)
+			return true;
+
+		lexer.eat();
+	}
+}
+
+void test_lexer_source_positions()
+{
+	std::clog << "testing source positions\n";
+
+	night_assert("positions are on the same line and column as the lexer",
+		positions_match("a int = 1;\n\n  b = a + 2; # comment\nprint(b);\n"));
+
+	night_assert("positions are correct after a string over many lines",
+		positions_match("s str = \"a\nb\nc\";\nprint(s);"));
+
+	night_assert("positions of different files do not overlap",
+		source_table::location(source_table::add_file("a.night", "x\n")).file == "a.night" &&
+		source_table::location(source_table::add_file("b.night", "")).file == "b.night");
+
+	night_assert("the empty position is not in a file",
+		source_table::location(SourcePos{}).line == 0);
+}
+
+// returns the symbols of the variable and type tokens of the code
+static std::vector<symbol_t> symbols_of(std::string const& code)
+{
+	Lexer lexer;
+	lexer.scan_code(code);
+
+	std::vector<symbol_t> syms;
+	for (; lexer.curr().type != TokenType::END_OF_FILE; lexer.eat())
+	{
+		if (lexer.curr().type == TokenType::VARIABLE || lexer.curr().type == TokenType::TYPE)
+			syms.push_back(lexer.curr().symbol);
+	}
+
+	return syms;
+}
+
+void test_lexer_symbols()
+{
+	std::clog << "testing symbols\n";
+
+	auto syms = symbols_of("abc int = abd + abc;\nprint(int(abd));");
+
+	night_assert("equal names have the same symbol",
+		syms.size() == 7 && syms[0] == syms[3] && syms[2] == syms[6] && syms[1] == syms[5]);
+
+	night_assert("different names have different symbols",
+		syms[0] != syms[2] && syms[0] != syms[1] && syms[4] != syms[5]);
+
+	night_assert("symbols keep their names",
+		symbols::name(syms[0]) == "abc" && symbols::name(syms[1]) == "int" && symbols::name(syms[4]) == "print");
+
+	// chunks of a file are lexed on different threads
+	std::vector<symbol_t> thread_syms[4];
+	std::vector<std::thread> threads;
+	for (auto& ts : thread_syms)
+		threads.emplace_back([&ts] { ts = symbols_of("shared_1 = shared_2 + abc;"); });
+
+	for (auto& thread : threads)
+		thread.join();
+
+	bool threads_agree = true;
+	for (auto const& ts : thread_syms)
+		threads_agree = threads_agree && ts == thread_syms[0] && ts[2] == syms[0];
+
+	night_assert("threads interning the same names get the same symbols", threads_agree);
+}
+
+void bench_lexer()
+{
+	std::clog << "benchmarking lexer\n";
+
+	std::string const program =
+		"# works out the sum of the squares of the first numbers\n"
+		"def sum_of_squares(count int) int\n"
+		"{\n"
+		"    total int = 0;\n"
+		"    for (index int = 0; index < count; index += 1) {\n"
+		"        total += index * index;\n"
+		"    }\n"
+		"    return total;\n"
+		"}\n"
+		"\n"
+		"values float[4] = [ 1.25, 2.5, 3.75, 10.0 ];\n"
+		"message str = \"the sum of the squares is \";\n"
+		"if (sum_of_squares(10) >= 285 && !(values[0] == 0.0)) {\n"
+		"    print(message + str(sum_of_squares(10)) + \"\\n\");\n"
+		"}\n";
+
+	std::string code;
+	while (code.size() < 8 * 1024 * 1024)
+		code += program;
+
+	// the fastest of a few passes, so other programs running at the same time
+	// do not slow it down
+	Lexer lexer;
+	std::size_t tokens = 0;
+	double seconds = 0;
+
+	for (int i = 0; i < 5; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		tokens = 0;
+		lexer.scan_code(code);
+		while (lexer.curr().type != TokenType::END_OF_FILE)
+		{
+			lexer.eat();
+			++tokens;
+		}
+
+		std::chrono::duration<double> pass = std::chrono::steady_clock::now() - start;
+		if (i == 0 || pass.count() < seconds)
+			seconds = pass.count();
+	}
+
+	double megabytes = (double)code.size() / (1024 * 1024);
+	std::clog << " . " << megabytes / seconds << " MB/s, "
+			  << tokens / seconds / 1e6 << " million tokens/s\n";
+}
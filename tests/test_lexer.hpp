@@ -0,0 +1,14 @@
+#pragma once
+
+void test_lexer();
+void test_lexer_char_classes();
+void test_lexer_scan_runs();
+void test_lexer_long_tokens();
+void test_lexer_keywords();
+void test_lexer_split_source();
+void test_lexer_source_positions();
+void test_lexer_symbols();
+void test_lexer_operators();
+
+// prints how many megabytes of source the lexer turns into tokens each second
+void bench_lexer();
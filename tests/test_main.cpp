@@ -1,4 +1,7 @@
+#include "test_lexer.hpp"
 #include "test_parser.hpp"
+#include "test_peephole.hpp"
+#include "test_ir.hpp"
 
 #include <iostream>
 
@@ -6,5 +9,10 @@ int main()
 {
 	std::cout << "running tests\n\n";
 
+	test_lexer();
 	test_parser();
+	test_peephole();
+	test_ir();
+
+	bench_lexer();
 }
\ No newline at end of file
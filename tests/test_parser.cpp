@@ -1,10 +1,20 @@
 #include "test_parser.hpp"
+#include "night_tests.hpp"
 #include "../code/include/lexer.hpp"
 #include "../code/include/parser.hpp"
+#include "../code/include/ir.hpp"
 #include "../code/include/bytecode.hpp"
+#include "../code/include/interpreter.hpp"
+#include "../code/include/code_gen.hpp"
+#include "../code/include/interpreter_scope.hpp"
+#include "../code/include/symbols.hpp"
 #include "../code/include/error.hpp"
 
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <optional>
 
 ParserScope Test::scope;
 Lexer Test::lexer;
@@ -17,6 +27,8 @@ void test_parser()
 	std::clog << "testing parser\n\n";
 
 	test_parse_var();
+	test_parse_expr();
+	test_parse_overloads();
 }
 
 void test_parse_var()
@@ -107,6 +119,177 @@ void test_parse_for()
 void test_parse_while() {}
 void test_parse_rtn() {}
 
+// returns the codes that return the value of the expression, where a, b and c
+// are variables of the type with the ids 0, 1 and 2
+static bytecodes_t lower_expr(std::string const& code, ValueType::PrimType type)
+{
+	ParserScope::next_var_id = 0;
+
+	ParserScope scope;
+	for (auto name : { "a", "b", "c" })
+		scope.create_variable(symbols::intern(name), ValueType(type), {});
+
+	// the expression starts after the first token
+	Lexer lexer;
+	lexer.scan_code("return " + code);
+
+	auto expr = parse_expr(lexer, true);
+	expr->type_check(scope);
+	expr = expr->optimize(scope);
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+	builder.ret(expr->generate_value(builder));
+
+	return ir::lower(module.main);
+}
+
+static int64_t eval_expr(bytecodes_t const& codes, int64_t a, int64_t b, int64_t c)
+{
+	InterpreterScope scope;
+	scope.vars[0] = intpr::Value(a);
+	scope.vars[1] = intpr::Value(b);
+	scope.vars[2] = intpr::Value(c);
+
+	return interpret_bytecodes(scope, codes)->i;
+}
+
+// returns the error from parsing the statement, or an empty string if there is none
+static std::string parse_error(std::string const& code)
+{
+	Lexer lexer;
+	lexer.scan_code(code);
+
+	try
+	{
+		parse_stmt(lexer);
+	}
+	catch (night::error const& e)
+	{
+		return e.what();
+	}
+
+	return "";
+}
+
+void test_parse_expr()
+{
+	std::clog << "testing parse_expr\n";
+
+	night_assert("negative binds tighter than multiplication",
+		(lower_expr("-a * b", ValueType::INT) == lower_expr("(-a) * b", ValueType::INT) &&
+		 lower_expr("-a * b", ValueType::INT) != lower_expr("-(a * b)", ValueType::INT)));
+
+	auto not_and = lower_expr("!a && b", ValueType::BOOL);
+	night_assert("not binds tighter than and",
+		(not_and == lower_expr("(!a) && b", ValueType::BOOL) && not_and != lower_expr("!(a && b)", ValueType::BOOL)));
+	night_assert("not and is true only when a is false and b is true",
+		(eval_expr(not_and, 0, 1, 0) == 1 && eval_expr(not_and, 1, 0, 0) == 0 &&
+		 eval_expr(not_and, 0, 0, 0) == 0 && eval_expr(not_and, 1, 1, 0) == 0));
+
+	auto sub_sub = lower_expr("a - b - c", ValueType::INT);
+	night_assert("subtraction is left associative",
+		(sub_sub == lower_expr("(a - b) - c", ValueType::INT) && eval_expr(sub_sub, 10, 3, 2) == 5));
+
+	night_assert("an assignment is not an expression, so assignments can not be chained",
+		(parse_error("a = b = c;").find("found 'assignment', expected 'semicolon'") != std::string::npos));
+	night_assert("a binary operator without its right operand is an error",
+		(parse_error("a = b * ;").find("found ';', expected expression") != std::string::npos));
+	night_assert("a negative without its operand is an error",
+		(parse_error("a = -;").find("found ';', expected expression") != std::string::npos));
+	night_assert("an expression that is only an operator is an error",
+		(parse_error("a = * b;").find("found '*', expected expression") != std::string::npos));
+}
+
+// returns what the program prints, or its error
+// errors stay with the thread that made them, so each program is compiled on its
+// own thread
+static std::string run_code(std::string const& code)
+{
+	std::string out;
+
+	std::thread([&] {
+		try
+		{
+			Lexer lexer;
+			lexer.scan_code(code);
+
+			AST_Block block;
+			while (lexer.curr().type != TokenType::END_OF_FILE)
+			{
+				auto stmts = parse_stmts(lexer, false);
+				block.insert(std::end(block), std::begin(stmts), std::end(stmts));
+			}
+
+			auto codes = code_gen(block);
+
+			std::stringstream ss;
+			auto cout_buf = std::cout.rdbuf(ss.rdbuf());
+
+			InterpreterScope scope;
+			interpret_bytecodes(scope, codes);
+
+			std::cout.rdbuf(cout_buf);
+			out = ss.str();
+		}
+		catch (night::error const& e)
+		{
+			out = e.what();
+		}
+	}).join();
+
+	return out;
+}
+
+void test_parse_overloads()
+{
+	std::clog << "testing parse_func overloads\n";
+
+	night_assert("a call goes to the overload with the types of its arguments",
+		(run_code(
+			"def which(x int) int { return 1; }\n"
+			"def which(x float) int { return 2; }\n"
+			"def which(x char) int { return 3; }\n"
+			"def which(x int, y float) int { return 4; }\n"
+			"def which(x float, y int) int { return 5; }\n"
+			"print(which(7)); print(which(7.5)); print(which('a')); print(which(1, 2.0)); print(which(1.0, 2));\n")
+		== "12345"));
+
+	night_assert("overloads that only differ in the names of their parameters are defined twice",
+		(run_code(
+			"def twice(x int) int { return 1; }\n"
+			"def twice(y int) int { return 2; }\n"
+			"print(twice(1));\n").find("function is already defined") != std::string::npos));
+
+	// parameters of the parser do not have array types, so these are made directly
+	// returns the id of the new overload, or std::nullopt if it is already defined
+	auto name = symbols::intern("depth");
+	auto define = [&](int dim, std::optional<ValueType> const& rtn_type) -> std::optional<bytecode_t> {
+		try
+		{
+			return ParserScope::create_function(name, { name }, { ValueType(ValueType::INT, dim) }, rtn_type).id;
+		}
+		catch (char const*)
+		{
+			return std::nullopt;
+		}
+	};
+
+	auto vector_id = define(1, ValueType(ValueType::INT));
+	auto matrix_id = define(2, ValueType(ValueType::INT));
+
+	night_assert("overloads that only differ in the depth of an array are different functions",
+		(vector_id.has_value() && matrix_id.has_value() && vector_id != matrix_id));
+	night_assert("a call goes to the overload with the depth of its array",
+		(ParserScope::find_function(name, { ValueType(ValueType::INT, 1) })->id == vector_id &&
+		 ParserScope::find_function(name, { ValueType(ValueType::INT, 2) })->id == matrix_id));
+	night_assert("a call with an array of another depth has no overload",
+		(ParserScope::find_function(name, { ValueType(ValueType::INT, 3) }) == nullptr &&
+		 ParserScope::find_function(name, { ValueType(ValueType::INT) }) == nullptr));
+	night_assert("an overload with the same array depth is defined twice, whatever it returns",
+		!define(2, std::nullopt).has_value());
+}
+
 void test_generate_func()
 {
 	Test::test("function without paramters",
@@ -120,7 +303,12 @@ void Test::test(std::string const& msg, std::string const& code)
 	lexer.scan_code(code);
 
 	i = 0;
-	codes = parse_stmt(lexer, scope)->generate_codes();
+
+	ir::Module module;
+	ir::Builder builder(module, module.main);
+
+	parse_stmt(lexer, scope)->generate_ir(builder);
+	codes = ir::lower(module.main);
 }
 
 void Test::expect(bytecode_t value)
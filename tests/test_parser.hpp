@@ -13,6 +13,8 @@ void test_parse_for();
 void test_parse_while();
 void test_generate_func();
 void test_parse_rtn();
+void test_parse_expr();
+void test_parse_overloads();
 
 struct Test
 {
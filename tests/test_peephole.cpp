@@ -0,0 +1,232 @@
+#include "test_peephole.hpp"
+#include "night_tests.hpp"
+#include "../code/include/peephole.hpp"
+#include "../code/include/bytecode.hpp"
+#include "../code/include/kernel.hpp"
+
+#include <iostream>
+
+#define BC(type) (bytecode_t)BytecodeType::type
+
+void test_peephole()
+{
+	std::clog << "testing peephole\n\n";
+
+	test_peephole_store_load();
+	test_peephole_int_to_float();
+	test_peephole_float_to_int();
+	test_peephole_not_jump();
+	test_peephole_thread_jumps();
+	test_peephole_dead_codes();
+	test_peephole_offsets();
+	test_peephole_switches();
+	test_peephole_kernels();
+}
+
+void test_peephole_store_load()
+{
+	std::clog << "testing STORE LOAD\n";
+
+	bytecodes_t codes = { BC(S_INT1), 4, BC(STORE), 0, BC(LOAD), 0, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("STORE then LOAD of the same variable is STORE_KEEP",
+		(codes == bytecodes_t{ BC(S_INT1), 4, BC(STORE_KEEP), 0, BC(CALL), 2 }));
+
+	codes = { BC(S_INT1), 4, BC(STORE), 0, BC(LOAD), 1, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("STORE then LOAD of different variables is unchanged",
+		(codes == bytecodes_t{ BC(S_INT1), 4, BC(STORE), 0, BC(LOAD), 1, BC(CALL), 2 }));
+
+	// the LOAD is the start of a loop, so it can be reached without the STORE
+	codes = { BC(S_INT1), 4, BC(STORE), 0, BC(LOAD), 0, BC(CALL), 2, BC(NJUMP), 9, 0, 0, 0 };
+	peephole(codes);
+	night_assert("STORE then LOAD that is jumped to is unchanged",
+		(codes == bytecodes_t{ BC(S_INT1), 4, BC(STORE), 0, BC(LOAD), 0, BC(CALL), 2, BC(NJUMP), 9, 0, 0, 0 }));
+}
+
+void test_peephole_int_to_float()
+{
+	std::clog << "testing integer constant I2F\n";
+
+	bytecodes_t codes = { BC(S_INT1), 3, BC(I2F), BC(STORE), 0 };
+	peephole(codes);
+	night_assert("integer constant then I2F is a float constant",
+		(codes == bytecodes_t{ BC(FLOAT4), 0, 0, 64, 64, BC(STORE), 0 }));
+}
+
+void test_peephole_float_to_int()
+{
+	std::clog << "testing float constant F2I\n";
+
+	// 2.5
+	bytecodes_t codes = { BC(FLOAT4), 0, 0, 32, 64, BC(F2I), BC(STORE), 0 };
+	peephole(codes);
+	night_assert("float constant then F2I is an integer constant",
+		(codes == bytecodes_t{ BC(S_INT1), 2, BC(STORE), 0 }));
+
+	// 3.0 goes through both casts
+	codes = { BC(FLOAT4), 0, 0, 64, 64, BC(F2I), BC(I2F), BC(STORE), 0 };
+	peephole(codes);
+	night_assert("float constant then F2I then I2F is a float constant",
+		(codes == bytecodes_t{ BC(FLOAT4), 0, 0, 64, 64, BC(STORE), 0 }));
+}
+
+void test_peephole_not_jump()
+{
+	std::clog << "testing NOT_I JUMP_IF_FALSE\n";
+
+	bytecodes_t codes = { BC(LOAD), 0, BC(NOT_I), BC(S_INT1), 4, BC(JUMP_IF_FALSE), BC(S_INT1), 1, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("NOT_I then JUMP_IF_FALSE is JUMP_IF_TRUE",
+		(codes == bytecodes_t{ BC(LOAD), 0, BC(S_INT1), 4, BC(JUMP_IF_TRUE), BC(S_INT1), 1, BC(CALL), 2 }));
+
+	codes = { BC(LOAD), 0, BC(NOT_I), BC(NOT_I), BC(S_INT1), 4, BC(JUMP_IF_FALSE), BC(S_INT1), 1, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("NOT_I then NOT_I then JUMP_IF_FALSE is JUMP_IF_FALSE",
+		(codes == bytecodes_t{ BC(LOAD), 0, BC(S_INT1), 4, BC(JUMP_IF_FALSE), BC(S_INT1), 1, BC(CALL), 2 }));
+}
+
+void test_peephole_thread_jumps()
+{
+	std::clog << "testing jumps to JUMP\n";
+
+	// if (var0) { print(1); } inside a loop, where the end of the
+	// conditional is the NJUMP back to the start of the loop
+	bytecodes_t codes = {
+		BC(LOAD), 0, BC(S_INT1), 9, BC(JUMP_IF_FALSE),
+		BC(S_INT1), 1, BC(CALL), 2,
+		BC(JUMP), 0, 0, 0, 0,
+		BC(NJUMP), 19, 0, 0, 0
+	};
+	peephole(codes);
+	night_assert("JUMP to NJUMP is NJUMP",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 9, BC(JUMP_IF_FALSE),
+			BC(S_INT1), 1, BC(CALL), 2,
+			BC(NJUMP), 14, 0, 0, 0,
+			BC(NJUMP), 19, 0, 0, 0 }));
+
+	// the JUMP_IF_FALSE goes to a JUMP, which leaves the codes between them unreachable
+	codes = {
+		BC(LOAD), 0, BC(S_INT1), 5, BC(JUMP_IF_FALSE),
+		BC(JUMP), 5, 0, 0, 0,
+		BC(JUMP), 2, 0, 0, 0,
+		BC(S_INT1), 1, BC(CALL), 2
+	};
+	peephole(codes);
+	night_assert("JUMP_IF_FALSE to JUMP goes to its target",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 2, BC(JUMP_IF_FALSE),
+			BC(S_INT1), 1, BC(CALL), 2 }));
+}
+
+void test_peephole_dead_codes()
+{
+	std::clog << "testing dead codes\n";
+
+	bytecodes_t codes = { BC(S_INT1), 1, BC(CALL), 2, BC(JUMP), 0, 0, 0, 0, BC(S_INT1), 2, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("JUMP to the next instruction is removed",
+		(codes == bytecodes_t{ BC(S_INT1), 1, BC(CALL), 2, BC(S_INT1), 2, BC(CALL), 2 }));
+
+	// if (var0) { return 1; } else { return 2; }
+	codes = {
+		BC(LOAD), 0, BC(S_INT1), 8, BC(JUMP_IF_FALSE),
+		BC(S_INT1), 1, BC(RETURN),
+		BC(JUMP), 8, 0, 0, 0,
+		BC(S_INT1), 2, BC(RETURN),
+		BC(JUMP), 0, 0, 0, 0
+	};
+	peephole(codes);
+	night_assert("codes after RETURN that are not jumped to are removed",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 3, BC(JUMP_IF_FALSE),
+			BC(S_INT1), 1, BC(RETURN),
+			BC(S_INT1), 2, BC(RETURN) }));
+}
+
+void test_peephole_offsets()
+{
+	std::clog << "testing offsets\n";
+
+	// the conditional jump and the loop jump both cross the rewritten codes,
+	// which grow by two bytes
+	bytecodes_t codes = {
+		BC(LOAD), 0, BC(S_INT1), 10, BC(JUMP_IF_FALSE),
+		BC(S_INT1), 3, BC(I2F), BC(CALL), 3,
+		BC(NJUMP), 15, 0, 0, 0
+	};
+	peephole(codes);
+	night_assert("offsets are moved with the rewritten codes",
+		(codes == bytecodes_t{
+			BC(LOAD), 0, BC(S_INT1), 12, BC(JUMP_IF_FALSE),
+			BC(FLOAT4), 0, 0, 64, 64, BC(CALL), 3,
+			BC(NJUMP), 17, 0, 0, 0 }));
+
+	// a loop of 400 bytes, whose offset does not fit in one bytecode
+	codes.clear();
+	for (int i = 0; i < 100; ++i)
+		codes.insert(std::end(codes), { BC(LOAD), 0, BC(CALL), 2 });
+	codes.insert(std::end(codes), { BC(NJUMP), 149, 1, 0, 0 });
+
+	auto instrs = decode_instructions(codes);
+	night_assert("a jump with a long offset goes to its target",
+		(instrs.has_value() && instrs->back().target == 0));
+
+	auto original = codes;
+	peephole(codes);
+	night_assert("a jump with a long offset is encoded again unchanged",
+		(codes == original));
+}
+
+void test_peephole_switches()
+{
+	std::clog << "testing switches\n";
+
+	// the case for 2 goes to a JUMP to the default
+	bytecodes_t codes = {
+		BC(LOAD), 0,
+		BC(TABLE_SWITCH), 1, 0, 0, 0, 0, 0, 0, 0, 2, 0, 10, 0, 0, 0, 0, 0, 0, 0, 5, 0, 0, 0,
+		BC(S_INT1), 1, BC(CALL), 2, BC(RETURN),
+		BC(JUMP), 0, 0, 0, 0,
+		BC(S_INT1), 2, BC(CALL), 2
+	};
+	peephole(codes);
+	night_assert("a case that goes to a JUMP goes to its target",
+		(codes == bytecodes_t{
+			BC(LOAD), 0,
+			BC(TABLE_SWITCH), 1, 0, 0, 0, 0, 0, 0, 0, 2, 0, 5, 0, 0, 0, 0, 0, 0, 0, 5, 0, 0, 0,
+			BC(S_INT1), 1, BC(CALL), 2, BC(RETURN),
+			BC(S_INT1), 2, BC(CALL), 2 }));
+
+	// the keys are -5 and 300
+	codes = {
+		BC(LOAD), 0,
+		BC(LOOKUP_SWITCH), 2, 0, 5, 0, 0, 0,
+		251, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0,
+		44, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		BC(S_INT1), 1, BC(CALL), 2, BC(RETURN),
+		BC(S_INT1), 2, BC(CALL), 2
+	};
+	auto original = codes;
+	peephole(codes);
+	night_assert("a LOOKUP_SWITCH is decoded and encoded again unchanged",
+		(codes == original));
+}
+
+void test_peephole_kernels()
+{
+	std::clog << "testing kernels\n";
+
+	// the program of the kernel is not read as codes
+	bytecodes_t codes = {
+		BC(S_INT1), 0, BC(S_INT1), 9, BC(S_INT1), 0,
+		BC(VECTOR_SUM), 1, 1, (bytecode_t)KernelCode::INDEX,
+		BC(STORE), 0, BC(LOAD), 0, BC(CALL), 2 };
+	peephole(codes);
+	night_assert("the codes after a kernel are optimized",
+		(codes == bytecodes_t{
+			BC(S_INT1), 0, BC(S_INT1), 9, BC(S_INT1), 0,
+			BC(VECTOR_SUM), 1, 1, (bytecode_t)KernelCode::INDEX,
+			BC(STORE_KEEP), 0, BC(CALL), 2 }));
+}
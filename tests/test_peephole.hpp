@@ -0,0 +1,12 @@
+#pragma once
+
+void test_peephole();
+void test_peephole_store_load();
+void test_peephole_int_to_float();
+void test_peephole_float_to_int();
+void test_peephole_not_jump();
+void test_peephole_thread_jumps();
+void test_peephole_dead_codes();
+void test_peephole_offsets();
+void test_peephole_switches();
+void test_peephole_kernels();